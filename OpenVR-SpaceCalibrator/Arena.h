@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Bump allocator for scratch memory that is reused across solves.
+//
+// Allocations that do not fit in the current block spill into overflow blocks. On the next
+// Reset() the block is grown to the high-water mark of the previous cycle, so once a workload
+// has been seen, repeating it makes no heap allocations at all.
+class Arena
+{
+public:
+	static const size_t Alignment = 64;
+
+	Arena() { }
+	~Arena()
+	{
+		FreeOverflow();
+		delete[] storage;
+	}
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	// Resets the arena on entry and exit, so memory that spilled during the scope is folded
+	// into the block right away instead of on the next use.
+	class Scope
+	{
+	public:
+		explicit Scope(Arena &arena) : arena(arena) { arena.Reset(); }
+		~Scope() { arena.Reset(); }
+
+	private:
+		Arena &arena;
+	};
+
+	// Rewinds the arena. Memory handed out since the last reset becomes invalid.
+	void Reset()
+	{
+		FreeOverflow();
+
+		if (highWater > capacity)
+		{
+			delete[] storage;
+			capacity = highWater;
+			storage = new char[capacity + Alignment];
+			block = Align(storage);
+		}
+
+		offset = 0;
+		highWater = 0;
+	}
+
+	// Returns uninitialized storage for count objects of type T.
+	template<class T> T *Allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+
+		size_t bytes = RoundUp(count * sizeof(T));
+		highWater += bytes;
+
+		if (offset + bytes <= capacity)
+		{
+			char *ptr = block + offset;
+			offset += bytes;
+			return reinterpret_cast<T *>(ptr);
+		}
+
+		// Overflow blocks are chained through their first aligned slot.
+		char *raw = new char[bytes + 2 * Alignment];
+		*reinterpret_cast<char **>(Align(raw)) = overflow;
+		overflow = raw;
+		return reinterpret_cast<T *>(Align(raw) + Alignment);
+	}
+
+	size_t Capacity() const { return capacity; }
+
+private:
+	static size_t RoundUp(size_t bytes)
+	{
+		return (bytes + Alignment - 1) & ~(Alignment - 1);
+	}
+
+	static char *Align(char *ptr)
+	{
+		return reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(ptr) + Alignment - 1) & ~(uintptr_t) (Alignment - 1));
+	}
+
+	void FreeOverflow()
+	{
+		while (overflow)
+		{
+			char *next = *reinterpret_cast<char **>(Align(overflow));
+			delete[] overflow;
+			overflow = next;
+		}
+	}
+
+	char *storage = nullptr, *block = nullptr, *overflow = nullptr;
+	size_t capacity = 0, offset = 0, highWater = 0;
+};
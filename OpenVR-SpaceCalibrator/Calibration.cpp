@@ -1,8 +1,13 @@
-#include "stdafx.h"
 #include "Calibration.h"
+#include "CalibrationSolver.h"
 #include "Configuration.h"
-#include "IPCClient.h"
+#include "PoseTrace.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -10,45 +15,63 @@
 #include <Eigen/Dense>
 
 
-static IPCClient Driver;
+static DriverConnection *Driver = nullptr;
+static CalibrationWorkspace Workspace;
+static PoseTraceWriter Trace;
+static int32_t TraceDeviceClasses[vr::k_unMaxTrackedDeviceCount];
+static std::vector<Sample> Samples;
 CalibrationContext CalCtx;
 
-void InitCalibrator()
+// The tracking system transform the last scan sent, so scans only send changes. Sending a
+// transform to a single device clears it, which makes the next scan send everything again.
+static struct
 {
-	Driver.Connect();
-}
+	bool valid = false;
+	std::string trackingSystem;
+	bool enabled = false;
+	vr::HmdVector3d_t translation;
+	vr::HmdQuaternion_t rotation;
+} SentSystemTransform;
 
-struct Pose
-{
-	Eigen::Matrix3d rot;
-	Eigen::Vector3d trans;
+// The mount offsets the last scan sent.
+static std::vector<CalibrationContext::MountOffset> SentMountOffsets;
 
-	Pose() { }
-	Pose(vr::HmdMatrix34_t hmdMatrix)
-	{
-		for (int i = 0; i < 3; i++) {
-			for (int j = 0; j < 3; j++) {
-				rot(i,j) = hmdMatrix.m[i][j];
-			}
-		}
-		trans = Eigen::Vector3d(hmdMatrix.m[0][3], hmdMatrix.m[1][3], hmdMatrix.m[2][3]);
-	}
-	Pose(double x, double y, double z) : trans(Eigen::Vector3d(x,y,z)) { }
-};
+// The smoothing the last scan sent.
+static std::vector<CalibrationContext::DeviceSmoothing> SentSmoothing;
+
+// The time offsets the last scan sent.
+static std::map<std::string, double> SentTimeOffsetsMs;
+
+// The stage budget the last scan sent, which the driver starts with.
+static double SentStageBudgetNs = protocol::DefaultStageBudgetNs;
 
-struct Sample
+// The moving platform the last scan sent, an empty serial for none.
+static struct
 {
-	Pose ref, target;
-	bool valid;
-	Sample() : valid(false) { }
-	Sample(Pose ref, Pose target) : valid(true), ref(ref), target(target) { }
-};
+	bool valid = false;
+	std::string trackingSystem, serial;
+} SentMovingPlatform;
 
-struct DSample
+// The fused tracker the last scan sent.
+static struct
 {
-	bool valid;
-	Eigen::Vector3d ref, target;
-};
+	bool valid = false;
+	CalibrationContext::FusedTracker tracker;
+} SentFusedTracker;
+
+void InitCalibrator(DriverConnection &driver)
+{
+	Workspace.precision = SolverPrecision::Mixed;
+	Driver = &driver;
+	Driver->Connect();
+	SentSystemTransform.valid = false;
+	SentMountOffsets.clear();
+	SentSmoothing.clear();
+	SentTimeOffsetsMs.clear();
+	SentStageBudgetNs = protocol::DefaultStageBudgetNs;
+	SentMovingPlatform.valid = false;
+	SentFusedTracker.valid = false;
+}
 
 bool StartsWith(const std::string &str, const std::string &prefix)
 {
@@ -66,282 +89,334 @@ bool EndsWith(const std::string &str, const std::string &suffix)
 	return str.compare(str.length() - suffix.length(), suffix.length(), suffix) == 0;
 }
 
-Eigen::Vector3d AxisFromRotationMatrix3(Eigen::Matrix3d rot)
+Sample CollectSample(const CalibrationContext &ctx)
 {
-	return Eigen::Vector3d(rot(2,1) - rot(1,2), rot(0,2) - rot(2,0), rot(1,0) - rot(0,1));
+	vr::TrackedDevicePose_t reference, target;
+	reference.bPoseIsValid = false;
+	target.bPoseIsValid = false;
+
+	reference = ctx.devicePoses[ctx.referenceID];
+	target = ctx.devicePoses[ctx.targetID];
+
+	bool ok = true;
+	if (!reference.bPoseIsValid)
+	{
+		CalCtx.Log("Reference device is not tracking\n"); ok = false;
+	}
+	if (!target.bPoseIsValid)
+	{
+		CalCtx.Log("Target device is not tracking\n"); ok = false;
+	}
+	if (!ok)
+	{
+		CalCtx.Log("Aborting calibration!\n");
+		CalCtx.state = CalibrationState::None;
+		return Sample();
+	}
+
+	return Sample(
+		Pose(reference.mDeviceToAbsoluteTracking),
+		Pose(target.mDeviceToAbsoluteTracking)
+	);
 }
 
-double AngleFromRotationMatrix3(Eigen::Matrix3d rot)
+static void SendDeviceTransform(const protocol::SetDeviceTransform &tf)
 {
-	return acos((rot(0,0) + rot(1,1) + rot(2,2) - 1.0) / 2.0);
+	SentSystemTransform.valid = false;
+
+	protocol::Request req(protocol::RequestSetDeviceTransform);
+	req.setDeviceTransform = tf;
+	Driver->SendBlocking(req);
 }
 
-DSample DeltaRotationSamples(Sample s1, Sample s2)
+static void SendSystemTransform(const std::string &trackingSystem, bool enabled, const vr::HmdVector3d_t &translation, const vr::HmdQuaternion_t &rotation)
 {
-	// Difference in rotation between samples.
-	auto dref = s1.ref.rot * s2.ref.rot.transpose();
-	auto dtarget = s1.target.rot * s2.target.rot.transpose();
+	protocol::Request req(protocol::RequestSetSystemTransform);
+	auto &tf = req.setSystemTransform;
+	memset(&tf, 0, sizeof tf);
+	snprintf(tf.trackingSystem, sizeof tf.trackingSystem, "%s", trackingSystem.c_str());
+	tf.enabled = enabled;
+	tf.translation = translation;
+	tf.rotation = rotation;
+	Driver->SendBlocking(req);
+}
 
-	// When stuck together, the two tracked objects rotate as a pair,
-	// therefore their axes of rotation must be equal between any given pair of samples.
-	DSample ds;
-	ds.ref = AxisFromRotationMatrix3(dref);
-	ds.target = AxisFromRotationMatrix3(dtarget);
+void ResetAndDisableOffsets(uint32_t id)
+{
+	vr::HmdVector3d_t zeroV;
+	zeroV.v[0] = zeroV.v[1] = zeroV.v[2] = 0;
 
-	// Reject samples that were too close to each other.
-	auto refA = AngleFromRotationMatrix3(dref);
-	auto targetA = AngleFromRotationMatrix3(dtarget);
-	ds.valid = refA > 0.4 && targetA > 0.4 && ds.ref.norm() > 0.01 && ds.target.norm() > 0.01;
+	vr::HmdQuaternion_t zeroQ;
+	zeroQ.x = 0; zeroQ.y = 0; zeroQ.z = 0; zeroQ.w = 1;
 
-	ds.ref.normalize();
-	ds.target.normalize();
-	return ds;
+	SendDeviceTransform({ id, false, zeroV, zeroQ });
 }
 
-Eigen::Vector3d CalibrateRotation(const std::vector<Sample> &samples)
+// The driver keys devices by serial, so a serial too long for the request is left out and logged
+// rather than cut short into what might be another device's.
+template<size_t N> static bool CopySerial(char (&out)[N], const std::string &serial)
 {
-	std::vector<DSample> deltas;
-
-	for (size_t i = 0; i < samples.size(); i++)
+	if (serial.size() >= N)
 	{
-		for (size_t j = 0; j < i; j++)
-		{
-			auto delta = DeltaRotationSamples(samples[i], samples[j]);
-			if (delta.valid)
-				deltas.push_back(delta);
-		}
+		CalCtx.Log("Serial too long for the driver, not sent: " + serial + "\n");
+		return false;
 	}
-	char buf[256];
-	snprintf(buf, sizeof buf, "Got %zd samples with %zd delta samples\n", samples.size(), deltas.size());
-	CalCtx.Log(buf);
 
-	// Kabsch algorithm
-
-	Eigen::MatrixXd refPoints(deltas.size(), 3), targetPoints(deltas.size(), 3);
-	Eigen::Vector3d refCentroid(0,0,0), targetCentroid(0,0,0);
+	memcpy(out, serial.c_str(), serial.size() + 1);
+	return true;
+}
 
-	for (size_t i = 0; i < deltas.size(); i++)
-	{
-		refPoints.row(i) = deltas[i].ref;
-		refCentroid += deltas[i].ref;
+static bool SameMountOffset(const CalibrationContext::MountOffset &a, const CalibrationContext::MountOffset &b)
+{
+	return a.serial == b.serial && a.rotation == b.rotation && a.translation == b.translation;
+}
 
-		targetPoints.row(i) = deltas[i].target;
-		targetCentroid += deltas[i].target;
-	}
+// Sends the mount offsets when they differ from those sent last, up to MaxMountOffsets per
+// request, and disables the offsets of serials no longer listed, which the driver would keep.
+static void SendMountOffsets(const CalibrationContext &ctx)
+{
+	auto &offsets = ctx.mountOffsets;
+	if (offsets.size() == SentMountOffsets.size() && std::equal(offsets.begin(), offsets.end(), SentMountOffsets.begin(), SameMountOffset))
+		return;
 
-	refCentroid /= (double) deltas.size();
-	targetCentroid /= (double) deltas.size();
+	protocol::Request req(protocol::RequestSetMountOffsets);
+	auto &batch = req.setMountOffsets;
+	memset(&batch, 0, sizeof batch);
 
-	for (size_t i = 0; i < deltas.size(); i++)
-	{
-		refPoints.row(i) -= refCentroid;
-		targetPoints.row(i) -= targetCentroid;
-	}
+	auto add = [&](const std::string &serial, bool enabled, const vr::HmdVector3d_t &translation, const vr::HmdQuaternion_t &rotation) {
+		auto &entry = batch.offsets[batch.count];
+		if (!CopySerial(entry.serial, serial))
+			return;
 
-	auto crossCV = refPoints.transpose() * targetPoints;
+		batch.count++;
+		entry.enabled = enabled;
+		entry.translation = translation;
+		entry.rotation = rotation;
 
-	Eigen::BDCSVD<Eigen::MatrixXd> bdcsvd;
-	auto svd = bdcsvd.compute(crossCV, Eigen::ComputeThinU | Eigen::ComputeThinV);
+		if (batch.count == protocol::MaxMountOffsets)
+		{
+			Driver->SendBlocking(req);
+			memset(&batch, 0, sizeof batch);
+		}
+	};
 
-	Eigen::Matrix3d i = Eigen::Matrix3d::Identity();
-	if ((svd.matrixU() * svd.matrixV().transpose()).determinant() < 0)
+	for (auto &sent : SentMountOffsets)
 	{
-		i(2,2) = -1;
+		auto listed = std::find_if(offsets.begin(), offsets.end(), [&](const CalibrationContext::MountOffset &offset) { return offset.serial == sent.serial; });
+		if (listed == offsets.end())
+			add(sent.serial, false, { { 0.0, 0.0, 0.0 } }, { 1.0, 0.0, 0.0, 0.0 });
 	}
 
-	Eigen::Matrix3d rot = svd.matrixV() * i * svd.matrixU().transpose();
-	rot.transposeInPlace();
+	for (auto &offset : offsets)
+		add(offset.serial, true, VRTranslationVec(offset.translation), VRRotationQuat(offset.rotation));
 
-	Eigen::Vector3d euler = rot.eulerAngles(2, 1, 0) * 180.0 / EIGEN_PI;
+	if (batch.count)
+		Driver->SendBlocking(req);
 
-	snprintf(buf, sizeof buf, "Calibrated rotation: yaw=%.2f pitch=%.2f roll=%.2f\n", euler[1], euler[2], euler[0]);
-	CalCtx.Log(buf);
-	return euler;
+	SentMountOffsets = offsets;
 }
 
-Eigen::Vector3d CalibrateTranslation(const std::vector<Sample> &samples)
+static bool SameSmoothing(const CalibrationContext::DeviceSmoothing &a, const CalibrationContext::DeviceSmoothing &b)
 {
-	std::vector<std::pair<Eigen::Vector3d, Eigen::Matrix3d>> deltas;
+	return a.serial == b.serial && a.minCutoffHz == b.minCutoffHz && a.beta == b.beta;
+}
 
-	for (size_t i = 0; i < samples.size(); i++)
-	{
-		for (size_t j = 0; j < i; j++)
-		{
-			auto QAi = samples[i].ref.rot.transpose();
-			auto QAj = samples[j].ref.rot.transpose();
-			auto dQA = QAj - QAi;
-			auto CA = QAj * (samples[j].ref.trans - samples[j].target.trans) - QAi * (samples[i].ref.trans - samples[i].target.trans);
-			deltas.push_back(std::make_pair(CA, dQA));
-
-			auto QBi = samples[i].target.rot.transpose();
-			auto QBj = samples[j].target.rot.transpose();
-			auto dQB = QBj - QBi;
-			auto CB = QBj * (samples[j].ref.trans - samples[j].target.trans) - QBi * (samples[i].ref.trans - samples[i].target.trans);
-			deltas.push_back(std::make_pair(CB, dQB));
-		}
-	}
+// Like SendMountOffsets, for the devices the driver smooths.
+static void SendSmoothing(const CalibrationContext &ctx)
+{
+	auto &smoothing = ctx.smoothing;
+	if (smoothing.size() == SentSmoothing.size() && std::equal(smoothing.begin(), smoothing.end(), SentSmoothing.begin(), SameSmoothing))
+		return;
 
-	Eigen::VectorXd constants(deltas.size() * 3);
-	Eigen::MatrixXd coefficients(deltas.size() * 3, 3);
+	protocol::Request req(protocol::RequestSetSmoothing);
+	auto &batch = req.setSmoothing;
+	memset(&batch, 0, sizeof batch);
 
-	for (size_t i = 0; i < deltas.size(); i++)
-	{
-		for (int axis = 0; axis < 3; axis++)
+	auto add = [&](const CalibrationContext::DeviceSmoothing &device, bool enabled) {
+		auto &entry = batch.devices[batch.count];
+		if (!CopySerial(entry.serial, device.serial))
+			return;
+
+		batch.count++;
+		entry.enabled = enabled;
+		entry.minCutoffHz = device.minCutoffHz;
+		entry.beta = device.beta;
+
+		if (batch.count == protocol::MaxDeviceSmoothing)
 		{
-			constants(i * 3 + axis) = deltas[i].first(axis);
-			coefficients.row(i * 3 + axis) = deltas[i].second.row(axis);
+			Driver->SendBlocking(req);
+			memset(&batch, 0, sizeof batch);
 		}
+	};
+
+	for (auto &sent : SentSmoothing)
+	{
+		auto listed = std::find_if(smoothing.begin(), smoothing.end(), [&](const CalibrationContext::DeviceSmoothing &device) { return device.serial == sent.serial; });
+		if (listed == smoothing.end())
+			add(sent, false);
 	}
 
-	Eigen::Vector3d trans = coefficients.bdcSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(constants);
-	auto transcm = trans * 100.0;
+	for (auto &device : smoothing)
+		add(device, true);
+
+	if (batch.count)
+		Driver->SendBlocking(req);
 
-	char buf[256];
-	snprintf(buf, sizeof buf, "Calibrated translation x=%.2f y=%.2f z=%.2f\n", transcm[0], transcm[1], transcm[2]);
-	CalCtx.Log(buf);
-	return transcm;
+	SentSmoothing = smoothing;
 }
 
-Sample CollectSample(const CalibrationContext &ctx)
+static void SendTimeOffset(const std::string &trackingSystem, double ms)
 {
-	vr::TrackedDevicePose_t reference, target;
-	reference.bPoseIsValid = false;
-	target.bPoseIsValid = false;
+	protocol::Request req(protocol::RequestSetTimeOffset);
+	auto &offset = req.setTimeOffset;
+	memset(&offset, 0, sizeof offset);
+	snprintf(offset.trackingSystem, sizeof offset.trackingSystem, "%s", trackingSystem.c_str());
+	offset.seconds = ms / 1000.0;
+	Driver->SendBlocking(req);
+}
 
-	reference = ctx.devicePoses[ctx.referenceID];
-	target = ctx.devicePoses[ctx.targetID];
+// Sends the time offsets that changed, and zero for systems no longer listed.
+static void SendTimeOffsets(const CalibrationContext &ctx)
+{
+	auto &offsets = ctx.timeOffsetsMs;
+	if (offsets == SentTimeOffsetsMs)
+		return;
 
-	bool ok = true;
-	if (!reference.bPoseIsValid)
+	for (auto &sent : SentTimeOffsetsMs)
 	{
-		CalCtx.Log("Reference device is not tracking\n"); ok = false;
-	}
-	if (!target.bPoseIsValid)
-	{
-		CalCtx.Log("Target device is not tracking\n"); ok = false;
+		if (offsets.find(sent.first) == offsets.end())
+			SendTimeOffset(sent.first, 0.0);
 	}
-	if (!ok)
+
+	for (auto &offset : offsets)
 	{
-		CalCtx.Log("Aborting calibration!\n");
-		CalCtx.state = CalibrationState::None;
-		return Sample();
+		auto sent = SentTimeOffsetsMs.find(offset.first);
+		if (sent == SentTimeOffsetsMs.end() || sent->second != offset.second)
+			SendTimeOffset(offset.first, offset.second);
 	}
 
-	return Sample(
-		Pose(reference.mDeviceToAbsoluteTracking),
-		Pose(target.mDeviceToAbsoluteTracking)
-	);
+	SentTimeOffsetsMs = offsets;
 }
 
-vr::HmdQuaternion_t VRRotationQuat(Eigen::Vector3d eulerdeg)
+static void SendStageBudget(const CalibrationContext &ctx)
 {
-	auto euler = eulerdeg * EIGEN_PI / 180.0;
-
-	Eigen::Quaterniond rotQuat =
-		Eigen::AngleAxisd(euler(0), Eigen::Vector3d::UnitZ()) *
-		Eigen::AngleAxisd(euler(1), Eigen::Vector3d::UnitY()) *
-		Eigen::AngleAxisd(euler(2), Eigen::Vector3d::UnitX());
+	if (ctx.stageBudgetNs == SentStageBudgetNs)
+		return;
 
-	vr::HmdQuaternion_t vrRotQuat;
-	vrRotQuat.x = rotQuat.coeffs()[0];
-	vrRotQuat.y = rotQuat.coeffs()[1];
-	vrRotQuat.z = rotQuat.coeffs()[2];
-	vrRotQuat.w = rotQuat.coeffs()[3];
-	return vrRotQuat;
+	protocol::Request req(protocol::RequestSetStageBudget);
+	req.setStageBudget.budgetNs = ctx.stageBudgetNs;
+	Driver->SendBlocking(req);
+	SentStageBudgetNs = ctx.stageBudgetNs;
 }
 
-vr::HmdVector3d_t VRTranslationVec(Eigen::Vector3d transcm)
+// Sends the moving platform when it or the target system changed. The driver anchors the
+// platform to the system transform itself, so the scan never has to follow the platform's motion.
+static void SendMovingPlatform(const CalibrationContext &ctx)
 {
-	auto trans = transcm * 0.01;
-	vr::HmdVector3d_t vrTrans;
-	vrTrans.v[0] = trans[0];
-	vrTrans.v[1] = trans[1];
-	vrTrans.v[2] = trans[2];
-	return vrTrans;
+	auto &sent = SentMovingPlatform;
+	if (sent.valid && sent.serial == ctx.platformSerial && (ctx.platformSerial.empty() || sent.trackingSystem == ctx.targetTrackingSystem))
+		return;
+
+	protocol::Request req(protocol::RequestSetMovingPlatform);
+	auto &platform = req.setMovingPlatform;
+	memset(&platform, 0, sizeof platform);
+	snprintf(platform.trackingSystem, sizeof platform.trackingSystem, "%s", ctx.targetTrackingSystem.c_str());
+	platform.enabled = CopySerial(platform.serial, ctx.platformSerial) && !ctx.platformSerial.empty() && !ctx.targetTrackingSystem.empty();
+	Driver->SendBlocking(req);
+
+	sent.valid = true;
+	sent.trackingSystem = ctx.targetTrackingSystem;
+	sent.serial = ctx.platformSerial;
 }
 
-void ResetAndDisableOffsets(uint32_t id)
+static void SendFusedTracker(const CalibrationContext &ctx)
 {
-	vr::HmdVector3d_t zeroV;
-	zeroV.v[0] = zeroV.v[1] = zeroV.v[2] = 0;
-
-	vr::HmdQuaternion_t zeroQ;
-	zeroQ.x = 0; zeroQ.y = 0; zeroQ.z = 0; zeroQ.w = 1;
+	auto &sent = SentFusedTracker;
+	auto &tracker = ctx.fusedTracker;
+	if (sent.valid && sent.tracker.primarySerial == tracker.primarySerial && sent.tracker.secondarySerial == tracker.secondarySerial && sent.tracker.blend == tracker.blend)
+		return;
 
-	protocol::Request req(protocol::RequestSetDeviceTransform);
-	req.setDeviceTransform = { id, false, zeroV, zeroQ };
-	Driver.SendBlocking(req);
+	protocol::Request req(protocol::RequestSetFusedTracker);
+	auto &fused = req.setFusedTracker;
+	memset(&fused, 0, sizeof fused);
+	bool copied = CopySerial(fused.primarySerial, tracker.primarySerial);
+	copied = CopySerial(fused.secondarySerial, tracker.secondarySerial) && copied;
+	fused.enabled = copied && !tracker.primarySerial.empty() && !tracker.secondarySerial.empty();
+	fused.blend = tracker.blend;
+	Driver->SendBlocking(req);
+
+	sent.valid = true;
+	sent.tracker = tracker;
 }
 
 static_assert(vr::k_unTrackedDeviceIndex_Hmd == 0, "HMD index expected to be 0");
 
+// The driver registers every device by tracking system, so a scan sends the target system's
+// transform once when it changes and the driver resolves it for each device as it appears.
 void ScanAndApplyProfile(CalibrationContext &ctx)
 {
 	char buffer[vr::k_unMaxPropertyStringSize];
 	ctx.enabled = ctx.validProfile;
 
-	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
+	vr::ETrackedPropertyError err = vr::TrackedProp_Success;
+	vr::VRSystem()->GetStringTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_TrackingSystemName_String, buffer, vr::k_unMaxPropertyStringSize, &err);
+	if (err == vr::TrackedProp_Success && ctx.referenceTrackingSystem != buffer)
 	{
-		auto deviceClass = vr::VRSystem()->GetTrackedDeviceClass(id);
-		if (deviceClass == vr::TrackedDeviceClass_Invalid)
-			continue;
+		// Currently using an HMD with a different tracking system than the calibration.
+		ctx.enabled = false;
+	}
 
-		/*if (deviceClass == vr::TrackedDeviceClass_HMD) // for debugging unexpected universe switches
+	auto &sent = SentSystemTransform;
+	if (!sent.valid)
+	{
+		// Devices outside the target system may still hold transforms sent to them alone, which
+		// the target system's transform does not cover. A disabled transform for their own system
+		// clears them without the driver taking them as overridden, which would stop their smoothing.
+		std::vector<std::string> otherSystems;
+		for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
 		{
-			vr::ETrackedPropertyError err = vr::TrackedProp_Success;
-			auto universeId = vr::VRSystem()->GetUint64TrackedDeviceProperty(id, vr::Prop_CurrentUniverseId_Uint64, &err);
-			printf("uid %d err %d\n", universeId, err);
-			ResetAndDisableOffsets(id);
-			continue;
-		}*/
+			if (vr::VRSystem()->GetTrackedDeviceClass(id) == vr::TrackedDeviceClass_Invalid)
+				continue;
 
-		if (!ctx.enabled)
-		{
-			ResetAndDisableOffsets(id);
-			continue;
+			vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_TrackingSystemName_String, buffer, vr::k_unMaxPropertyStringSize, &err);
+			if (err == vr::TrackedProp_Success && ctx.targetTrackingSystem != buffer &&
+				std::find(otherSystems.begin(), otherSystems.end(), buffer) == otherSystems.end())
+				otherSystems.push_back(buffer);
 		}
 
-		vr::ETrackedPropertyError err = vr::TrackedProp_Success;
-		vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_TrackingSystemName_String, buffer, vr::k_unMaxPropertyStringSize, &err);
-
-		if (err != vr::TrackedProp_Success)
-		{
-			ResetAndDisableOffsets(id);
-			continue;
-		}
+		for (auto &system : otherSystems)
+			SendSystemTransform(system, false, { { 0.0, 0.0, 0.0 } }, { 1.0, 0.0, 0.0, 0.0 });
+	}
 
-		std::string trackingSystem(buffer);
+	vr::HmdVector3d_t translation = { { 0.0, 0.0, 0.0 } };
+	vr::HmdQuaternion_t rotation = { 1.0, 0.0, 0.0, 0.0 };
+	if (ctx.enabled)
+	{
+		translation = VRTranslationVec(ctx.calibratedTranslation);
+		rotation = VRRotationQuat(ctx.calibratedRotation);
+	}
 
-		if (id == vr::k_unTrackedDeviceIndex_Hmd)
-		{
-			//auto p = ctx.devicePoses[id].mDeviceToAbsoluteTracking.m;
-			//printf("HMD %d: %f %f %f\n", id, p[0][3], p[1][3], p[2][3]);
+	if (sent.valid && !sent.trackingSystem.empty() && sent.trackingSystem != ctx.targetTrackingSystem)
+		SendSystemTransform(sent.trackingSystem, false, { { 0.0, 0.0, 0.0 } }, { 1.0, 0.0, 0.0, 0.0 });
 
-			if (trackingSystem != ctx.referenceTrackingSystem)
-			{
-				// Currently using an HMD with a different tracking system than the calibration.
-				ctx.enabled = false;
-			}
+	bool changed = !sent.valid || sent.trackingSystem != ctx.targetTrackingSystem || sent.enabled != ctx.enabled ||
+		memcmp(&sent.translation, &translation, sizeof translation) != 0 || memcmp(&sent.rotation, &rotation, sizeof rotation) != 0;
 
-			ResetAndDisableOffsets(id);
-			continue;
-		}
+	if (changed && !ctx.targetTrackingSystem.empty())
+		SendSystemTransform(ctx.targetTrackingSystem, ctx.enabled, translation, rotation);
 
-		if (trackingSystem != ctx.targetTrackingSystem)
-		{
-			ResetAndDisableOffsets(id);
-			continue;
-		}
+	sent.valid = true;
+	sent.trackingSystem = ctx.targetTrackingSystem;
+	sent.enabled = ctx.enabled;
+	sent.translation = translation;
+	sent.rotation = rotation;
 
-		protocol::Request req(protocol::RequestSetDeviceTransform);
-		req.setDeviceTransform = {
-			id,
-			true,
-			VRTranslationVec(ctx.calibratedTranslation),
-			VRRotationQuat(ctx.calibratedRotation)
-		};
-		Driver.SendBlocking(req);
-	}
+	SendMountOffsets(ctx);
+	SendSmoothing(ctx);
+	SendTimeOffsets(ctx);
+	SendStageBudget(ctx);
+	SendMovingPlatform(ctx);
+	SendFusedTracker(ctx);
 
 	if (ctx.enabled && ctx.chaperone.valid && ctx.chaperone.autoApply)
 	{
@@ -357,6 +432,70 @@ void ScanAndApplyProfile(CalibrationContext &ctx)
 	}
 }
 
+static void StartTrace()
+{
+	char path[64];
+	time_t now = time(nullptr);
+	tm local;
+#ifdef _WIN32
+	localtime_s(&local, &now);
+#else
+	localtime_r(&now, &local);
+#endif
+	strftime(path, sizeof path, "SpaceCalibrator-%Y%m%d-%H%M%S.sctrace", &local);
+
+	try
+	{
+		Trace.Open(path, vr::TrackingUniverseRawAndUncalibrated);
+		CalCtx.Log(std::string("Recording pose trace to ") + path + "\n");
+	}
+	catch (const std::runtime_error &e)
+	{
+		CalCtx.Log(std::string("Not recording pose trace: ") + e.what() + "\n");
+	}
+
+	for (auto &deviceClass : TraceDeviceClasses)
+		deviceClass = vr::TrackedDeviceClass_Invalid;
+}
+
+// Trace records have fixed size name fields, so longer names are cut to fit.
+template<size_t N> static void CopyTruncated(char (&out)[N], const char *value)
+{
+	size_t length = strnlen(value, N - 1);
+	memcpy(out, value, length);
+	out[length] = '\0';
+}
+
+static void RecordTraceTick(CalibrationContext &ctx, double time)
+{
+	char buffer[vr::k_unMaxPropertyStringSize];
+
+	// Device identities are only looked up again when a slot changes class, which keeps the
+	// per-tick cost to one class query per slot.
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
+	{
+		auto deviceClass = vr::VRSystem()->GetTrackedDeviceClass(id);
+		if (deviceClass == TraceDeviceClasses[id])
+			continue;
+
+		TraceDeviceClasses[id] = deviceClass;
+
+		TraceDeviceInfo info;
+		info.deviceClass = deviceClass;
+		info.controllerRole = vr::VRSystem()->GetControllerRoleForTrackedDeviceIndex(id);
+
+		vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_TrackingSystemName_String, buffer, vr::k_unMaxPropertyStringSize);
+		CopyTruncated(info.trackingSystem, buffer);
+
+		vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_SerialNumber_String, buffer, vr::k_unMaxPropertyStringSize);
+		CopyTruncated(info.serial, buffer);
+
+		Trace.SetDeviceInfo(id, info);
+	}
+
+	Trace.AppendTick(time, ctx.devicePoses);
+}
+
 void StartCalibration()
 {
 	CalCtx.state = CalibrationState::Begin;
@@ -364,6 +503,61 @@ void StartCalibration()
 	CalCtx.messages.clear();
 }
 
+void SetDriverPoseTap(bool enabled)
+{
+	protocol::Request req(protocol::RequestSetPoseTap);
+	req.setPoseTap.enabled = enabled;
+	if (Driver->SendBlocking(req).type == protocol::ResponseSuccess)
+	{
+		CalCtx.driverPoseTap = enabled;
+		CalCtx.Log(enabled ? "Driver is recording raw poses to its working directory\n" : "Driver stopped recording raw poses\n");
+	}
+}
+
+static void UpdateHookTiming(CalibrationContext &ctx, uint32_t id)
+{
+	if (!ctx.driverTimesHook)
+		return;
+
+	protocol::Request req(protocol::RequestHookTiming);
+	req.hookTimingQuery.openVRID = id;
+	auto response = Driver->SendBlocking(req);
+	ctx.hookTimingValid[id] = response.type == protocol::ResponseHookTiming;
+	if (ctx.hookTimingValid[id])
+		ctx.hookTiming[id] = response.hookTiming;
+	else
+		ctx.driverTimesHook = false;
+}
+
+// One request for the stats of every device, and one for the hook timing of the device whose
+// tooltip is showing, if any.
+static void UpdateDeviceStats(CalibrationContext &ctx)
+{
+	auto response = Driver->SendBlocking(protocol::Request(protocol::RequestDeviceStats));
+	bool answered = response.type == protocol::ResponseDeviceStats;
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		ctx.deviceStatsValid[id] = answered && ctx.devicePoses[id].bDeviceIsConnected;
+		if (ctx.deviceStatsValid[id])
+			ctx.deviceStats[id] = response.deviceStats.devices[id];
+		ctx.hookTimingValid[id] = false;
+	}
+
+	int id = ctx.hookTimingDevice;
+	if (id >= 0 && id < (int) vr::k_unMaxTrackedDeviceCount && ctx.devicePoses[id].bDeviceIsConnected)
+		UpdateHookTiming(ctx, (uint32_t) id);
+}
+
+// The hook timing of every connected device, for the device report.
+void UpdateHookTiming()
+{
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		if (CalCtx.devicePoses[id].bDeviceIsConnected)
+			UpdateHookTiming(CalCtx, id);
+	}
+}
+
 void CalibrationTick(double time)
 {
 	if (!vr::VRSystem())
@@ -376,6 +570,14 @@ void CalibrationTick(double time)
 	ctx.timeLastTick = time;
 	vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseRawAndUncalibrated, 0.0f, ctx.devicePoses, vr::k_unMaxTrackedDeviceCount);
 
+	if (Trace.IsOpen())
+	{
+		if (ctx.state == CalibrationState::Rotation || ctx.state == CalibrationState::Translation)
+			RecordTraceTick(ctx, time);
+		else
+			Trace.Close();
+	}
+
 	if (ctx.state == CalibrationState::None)
 	{
 		ctx.wantedUpdateInterval = 1.0;
@@ -383,6 +585,7 @@ void CalibrationTick(double time)
 		if ((time - ctx.timeLastScan) >= 1.0)
 		{
 			ScanAndApplyProfile(ctx);
+			UpdateDeviceStats(ctx);
 			ctx.timeLastScan = time;
 		}
 		return;
@@ -430,12 +633,24 @@ void CalibrationTick(double time)
 		}
 
 		ResetAndDisableOffsets(ctx.targetID);
+		Samples.clear();
+		Workspace.gates = ctx.Gates();
 		ctx.state = CalibrationState::Rotation;
 		ctx.wantedUpdateInterval = 0.0;
 
 		char buf[256];
 		snprintf(buf, sizeof buf, "Starting calibration, referenceID=%d targetID=%d\n", ctx.referenceID, ctx.targetID);
 		CalCtx.Log(buf);
+
+		if (ctx.calibrationSpeed == CalibrationContext::PRESET && ctx.preset.valid)
+		{
+			snprintf(buf, sizeof buf, "Using preset %s: %zd samples, pair gates %.3f rad and %.4f\n",
+				ctx.preset.name.c_str(), ctx.preset.sampleCount, ctx.preset.gates.minAngle, ctx.preset.gates.minAxisNorm);
+			CalCtx.Log(buf);
+		}
+
+		if (ctx.recordTrace)
+			StartTrace();
 		return;
 	}
 
@@ -445,35 +660,63 @@ void CalibrationTick(double time)
 		return;
 	}
 
-	static std::vector<Sample> samples;
-	samples.push_back(sample);
+	Samples.push_back(sample);
 
-	CalCtx.Progress(samples.size(), CalCtx.SampleCount());
+	CalCtx.Progress(Samples.size(), CalCtx.SampleCount());
 
-	if (samples.size() == CalCtx.SampleCount())
+	if (Samples.size() == CalCtx.SampleCount())
 	{
 		CalCtx.Log("\n");
 		if (ctx.state == CalibrationState::Rotation)
 		{
-			ctx.calibratedRotation = CalibrateRotation(samples);
+			ctx.calibratedRotation = CalibrateRotation(Samples, Workspace);
+
+			char buf[256];
+			snprintf(buf, sizeof buf, "Got %zd samples with %zd delta samples\n", Samples.size(), Workspace.rotationDeltaCount);
+			CalCtx.Log(buf);
+
+			if (Workspace.rotationFallback)
+				CalCtx.Log("Rotation samples poorly conditioned, solved in double precision\n");
+
+			auto &euler = ctx.calibratedRotation;
+			snprintf(buf, sizeof buf, "Calibrated rotation: yaw=%.2f pitch=%.2f roll=%.2f\n", euler[1], euler[2], euler[0]);
+			CalCtx.Log(buf);
+
+			auto &rotStd = ctx.uncertainty.rotation;
+			rotStd = RotationUncertainty(Samples, ctx.calibratedRotation, CrossValidationFolds, Workspace.gates);
+			snprintf(buf, sizeof buf, "Rotation std dev (deg): x=%.3f y=%.3f z=%.3f\n", rotStd[0], rotStd[1], rotStd[2]);
+			CalCtx.Log(buf);
 
 			auto vrRotQuat = VRRotationQuat(ctx.calibratedRotation);
 
-			protocol::Request req(protocol::RequestSetDeviceTransform);
-			req.setDeviceTransform = { ctx.targetID, true, vrRotQuat };
-			Driver.SendBlocking(req);
+			SendDeviceTransform({ ctx.targetID, true, vrRotQuat });
 
 			ctx.state = CalibrationState::Translation;
 		}
 		else if (ctx.state == CalibrationState::Translation)
 		{
-			ctx.calibratedTranslation = CalibrateTranslation(samples);
+			ctx.calibratedTranslation = CalibrateTranslation(Samples, Workspace);
+
+			if (Workspace.translationFallback)
+				CalCtx.Log("Translation samples poorly conditioned, solved in double precision\n");
+
+			auto &transcm = ctx.calibratedTranslation;
+			char buf[256];
+			snprintf(buf, sizeof buf, "Calibrated translation x=%.2f y=%.2f z=%.2f\n", transcm[0], transcm[1], transcm[2]);
+			CalCtx.Log(buf);
+
+			auto &transStd = ctx.uncertainty.translation;
+			transStd = TranslationUncertainty(Samples);
+			ctx.uncertainty.valid = true;
+			snprintf(buf, sizeof buf, "Translation std dev (cm): x=%.3f y=%.3f z=%.3f\n", transStd[0], transStd[1], transStd[2]);
+			CalCtx.Log(buf);
+
+			if (ctx.uncertainty.TooHigh())
+				CalCtx.Log("Warning: calibration spread is high, recalibrate recommended\n");
 
 			auto vrTrans = VRTranslationVec(ctx.calibratedTranslation);
 
-			protocol::Request req(protocol::RequestSetDeviceTransform);
-			req.setDeviceTransform = { ctx.targetID, true, vrTrans };
-			Driver.SendBlocking(req);
+			SendDeviceTransform({ ctx.targetID, true, vrTrans });
 
 			ctx.validProfile = true;
 			SaveProfile(ctx);
@@ -482,7 +725,7 @@ void CalibrationTick(double time)
 			ctx.state = CalibrationState::None;
 		}
 
-		samples.clear();
+		Samples.clear();
 	}
 }
 
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "CalibrationSolver.h"
+#include "DriverConnection.h"
+
 #include <Eigen/Core>
 #include <openvr.h>
+#include <iostream>
+#include <map>
+#include <string>
 #include <vector>
 
 enum class CalibrationState
@@ -20,12 +26,15 @@ struct CalibrationContext
 
 	Eigen::Vector3d calibratedRotation;
 	Eigen::Vector3d calibratedTranslation;
+	CalibrationUncertainty uncertainty;
 
 	std::string referenceTrackingSystem;
 	std::string targetTrackingSystem;
 
 	bool enabled = false;
 	bool validProfile = false;
+	bool recordTrace = false;
+	bool driverPoseTap = false;
 	double timeLastTick = 0, timeLastScan = 0;
 	double wantedUpdateInterval = 1.0;
 
@@ -33,12 +42,74 @@ struct CalibrationContext
 	{
 		FAST = 0,
 		SLOW = 1,
-		VERY_SLOW = 2
+		VERY_SLOW = 2,
+		PRESET = 3
 	};
 	Speed calibrationSpeed = FAST;
 
+	// Tuned alternative to the fixed speeds, usually picked by the tools' sweep command.
+	struct Preset
+	{
+		bool valid = false;
+		std::string name;
+		size_t sampleCount = 100;
+		RotationGates gates;
+	} preset;
+
+	// Where devices sit on what they are mounted to, by serial, applied by the driver on top of
+	// the calibration. Rotation and translation are in the calibration's units: roll, yaw and
+	// pitch in degrees, x, y and z in centimeters.
+	struct MountOffset
+	{
+		std::string serial;
+		Eigen::Vector3d rotation = Eigen::Vector3d::Zero();
+		Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+	};
+	std::vector<MountOffset> mountOffsets;
+
+	// Devices whose poses the driver smooths, by serial. See protocol::DeviceSmoothing.
+	struct DeviceSmoothing
+	{
+		std::string serial;
+		double minCutoffHz = 1.0;
+		double beta = 50.0;
+	};
+	std::vector<DeviceSmoothing> smoothing;
+
+	// How many milliseconds each tracking system's poses lag the reference system's, by tracking
+	// system, as measured by the tools' tap compensate. See protocol::SetTimeOffset.
+	std::map<std::string, double> timeOffsetsMs;
+
+	// How long the driver's optional pose stages may take per pose before it turns them off, zero
+	// for never. See protocol::SetStageBudget.
+	double stageBudgetNs = protocol::DefaultStageBudgetNs;
+
+	// Serial of a device of another tracking system whose live pose the target system's transform
+	// follows, for a target system that moves with a platform. Empty for a fixed play space.
+	std::string platformSerial;
+
+	// Serials of two rigidly attached devices of different tracking systems the driver fuses into
+	// a virtual tracker, none if either is empty. See protocol::SetFusedTracker.
+	struct FusedTracker
+	{
+		std::string primarySerial, secondarySerial;
+		bool blend = true;
+	} fusedTracker;
+
 	vr::TrackedDevicePose_t devicePoses[vr::k_unMaxTrackedDeviceCount];
 
+	// Tracking quality the driver measured for each device, refreshed with every profile scan.
+	protocol::DeviceStats deviceStats[vr::k_unMaxTrackedDeviceCount];
+	bool deviceStatsValid[vr::k_unMaxTrackedDeviceCount] = {};
+
+	// How long the driver's pose hook takes for each device, when the driver was built to time it.
+	// Each scan only asks about hookTimingDevice, the device whose tooltip is showing. A driver
+	// that refuses once was built without timing, and is not asked again.
+	protocol::HookTiming hookTiming[vr::k_unMaxTrackedDeviceCount];
+	bool hookTimingValid[vr::k_unMaxTrackedDeviceCount] = {};
+	int hookTimingDevice = -1;
+	bool driverTimesHook = true;
+
 	struct Chaperone
 	{
 		bool valid = false;
@@ -57,8 +128,15 @@ struct CalibrationContext
 
 		calibratedRotation = Eigen::Vector3d();
 		calibratedTranslation = Eigen::Vector3d();
+		uncertainty = CalibrationUncertainty();
 		referenceTrackingSystem = "";
 		targetTrackingSystem = "";
+		mountOffsets.clear();
+		smoothing.clear();
+		timeOffsetsMs.clear();
+		stageBudgetNs = protocol::DefaultStageBudgetNs;
+		platformSerial = "";
+		fusedTracker = FusedTracker();
 		enabled = false;
 		validProfile = false;
 	}
@@ -73,10 +151,20 @@ struct CalibrationContext
 			return 250;
 		case VERY_SLOW:
 			return 500;
+		case PRESET:
+			if (preset.valid)
+				return preset.sampleCount;
 		}
 		return 100;
 	}
 
+	RotationGates Gates()
+	{
+		if (calibrationSpeed == PRESET && preset.valid)
+			return preset.gates;
+		return RotationGates();
+	}
+
 	struct Message
 	{
 		enum Type
@@ -114,8 +202,10 @@ struct CalibrationContext
 
 extern CalibrationContext CalCtx;
 
-void InitCalibrator();
+void InitCalibrator(DriverConnection &driver);
 void CalibrationTick(double time);
 void StartCalibration();
+void SetDriverPoseTap(bool enabled);
+void UpdateHookTiming();
 void LoadChaperoneBounds();
 void ApplyChaperoneBounds();
\ No newline at end of file
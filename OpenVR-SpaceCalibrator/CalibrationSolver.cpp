@@ -0,0 +1,662 @@
+#include "CalibrationSolver.h"
+
+#include <Eigen/Dense>
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+#include <memory>
+#include <thread>
+
+// The single precision pair loops use SSE2, which every x64 CPU has. A register holds four floats
+// against two doubles, so each instruction covers twice as many pairs as in double precision.
+static const size_t MixedLanes = 4;
+
+// Rows of the stacked translation system gathered before they are folded into its triangular
+// factor, six per sample pair. Enough to amortize the reflections without leaving the L1 cache.
+static const size_t TranslationBlockRows = 120;
+
+// Smallest ratio of singular values at which the single precision sums are still trusted.
+static const double MixedRotationConditionLimit = 0.05;
+static const double MixedTranslationConditionLimit = 1e-3;
+
+// Iterative refinement steps of the single precision translation solve. Each step reduces the
+// error by about the relative error of the single precision sums, so two reach double precision.
+static const int MixedTranslationRefinementSteps = 2;
+
+// Single precision copies of one 3x3 matrix (row major) or 3-vector per sample, stored as
+// structure of arrays: component k of sample j lives at data[k * stride + j]. The stride is padded
+// to a whole number of lanes and the padding is zeroed, so every lane group can be loaded aligned.
+struct ComponentArrays
+{
+	float *data;
+	size_t stride;
+
+	const float *operator[](int k) const { return data + k * stride; }
+};
+
+static ComponentArrays AllocateComponents(Arena &arena, int components, size_t n)
+{
+	ComponentArrays arrays;
+	arrays.stride = (n + MixedLanes - 1) / MixedLanes * MixedLanes;
+	arrays.data = arena.Allocate<float>(components * arrays.stride);
+	std::fill(arrays.data, arrays.data + components * arrays.stride, 0.0f);
+	return arrays;
+}
+
+template<class Derived> static void StoreComponents(ComponentArrays &arrays, size_t j, const Eigen::MatrixBase<Derived> &m)
+{
+	for (int r = 0; r < m.rows(); r++)
+		for (int c = 0; c < m.cols(); c++)
+			arrays.data[(r * m.cols() + c) * arrays.stride + j] = (float) m(r, c);
+}
+
+// Broadcasts the components of sample j to all lanes.
+static void SplatComponents(const ComponentArrays &arrays, int components, size_t j, __m128 *out)
+{
+	for (int k = 0; k < components; k++)
+		out[k] = _mm_set1_ps(arrays[k][j]);
+}
+
+static inline __m128 Dot3(__m128 a0, __m128 a1, __m128 a2, __m128 b0, __m128 b1, __m128 b2)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, b0), _mm_mul_ps(a1, b1)), _mm_mul_ps(a2, b2));
+}
+
+// Lanes whose pair index j0 + lane is below i.
+static inline __m128 PairMask(size_t j0, size_t i)
+{
+	__m128 j = _mm_add_ps(_mm_set1_ps((float) j0), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+	return _mm_cmplt_ps(j, _mm_set1_ps((float) i));
+}
+
+static inline double SumLanes(__m128 v)
+{
+	float lanes[MixedLanes];
+	_mm_storeu_ps(lanes, v);
+	return (double) lanes[0] + (double) lanes[1] + (double) lanes[2] + (double) lanes[3];
+}
+
+Eigen::Vector3d AxisFromRotationMatrix3(const Eigen::Matrix3d &rot)
+{
+	return Eigen::Vector3d(rot(2,1) - rot(1,2), rot(0,2) - rot(2,0), rot(1,0) - rot(0,1));
+}
+
+double AngleFromRotationMatrix3(const Eigen::Matrix3d &rot)
+{
+	return acos((rot(0,0) + rot(1,1) + rot(2,2) - 1.0) / 2.0);
+}
+
+DSample DeltaRotationSamples(const Sample &s1, const Sample &s2, const RotationGates &gates)
+{
+	// Difference in rotation between samples.
+	Eigen::Matrix3d dref = s1.ref.rot * s2.ref.rot.transpose();
+	Eigen::Matrix3d dtarget = s1.target.rot * s2.target.rot.transpose();
+
+	// When stuck together, the two tracked objects rotate as a pair,
+	// therefore their axes of rotation must be equal between any given pair of samples.
+	DSample ds;
+	ds.ref = AxisFromRotationMatrix3(dref);
+	ds.target = AxisFromRotationMatrix3(dtarget);
+
+	// Reject samples that were too close to each other.
+	auto refA = AngleFromRotationMatrix3(dref);
+	auto targetA = AngleFromRotationMatrix3(dtarget);
+	ds.valid = refA > gates.minAngle && targetA > gates.minAngle && ds.ref.norm() > gates.minAxisNorm && ds.target.norm() > gates.minAxisNorm;
+
+	ds.ref.normalize();
+	ds.target.normalize();
+	return ds;
+}
+
+RotationAccumulator AccumulateRotationDeltas(const std::vector<Sample> &samples, CalibrationWorkspace &workspace)
+{
+	RotationAccumulator acc;
+
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		for (size_t j = 0; j < i; j++)
+		{
+			auto delta = DeltaRotationSamples(samples[i], samples[j], workspace.gates);
+			if (!delta.valid)
+				continue;
+
+			acc.cross.noalias() += delta.ref * delta.target.transpose();
+			acc.refSum += delta.ref;
+			acc.targetSum += delta.target;
+			acc.count++;
+		}
+	}
+
+	workspace.rotationDeltaCount = acc.count;
+	return acc;
+}
+
+// Unnormalized rotation axis and trace of A * B^T, the quantities DeltaRotationSamples derives
+// from the full product. a holds one sample's matrix broadcast to all lanes, b the matrices of
+// samples j to j + 3.
+static inline void DeltaAxisTrace(const __m128 *a, const ComponentArrays &b, size_t j, __m128 &x, __m128 &y, __m128 &z, __m128 &trace)
+{
+	__m128 b0 = _mm_load_ps(b[0] + j), b1 = _mm_load_ps(b[1] + j), b2 = _mm_load_ps(b[2] + j);
+	__m128 b3 = _mm_load_ps(b[3] + j), b4 = _mm_load_ps(b[4] + j), b5 = _mm_load_ps(b[5] + j);
+	__m128 b6 = _mm_load_ps(b[6] + j), b7 = _mm_load_ps(b[7] + j), b8 = _mm_load_ps(b[8] + j);
+
+	// Element (r, c) of A * B^T is row r of A dotted with row c of B.
+	trace = _mm_add_ps(_mm_add_ps(Dot3(a[0], a[1], a[2], b0, b1, b2), Dot3(a[3], a[4], a[5], b3, b4, b5)), Dot3(a[6], a[7], a[8], b6, b7, b8));
+	x = _mm_sub_ps(Dot3(a[6], a[7], a[8], b3, b4, b5), Dot3(a[3], a[4], a[5], b6, b7, b8));
+	y = _mm_sub_ps(Dot3(a[0], a[1], a[2], b6, b7, b8), Dot3(a[6], a[7], a[8], b0, b1, b2));
+	z = _mm_sub_ps(Dot3(a[3], a[4], a[5], b0, b1, b2), Dot3(a[0], a[1], a[2], b3, b4, b5));
+}
+
+RotationAccumulator AccumulateRotationDeltasMixed(const std::vector<Sample> &samples, CalibrationWorkspace &workspace)
+{
+	size_t n = samples.size();
+	Arena::Scope scratch(workspace.arena);
+
+	auto ref = AllocateComponents(workspace.arena, 9, n);
+	auto target = AllocateComponents(workspace.arena, 9, n);
+	for (size_t i = 0; i < n; i++)
+	{
+		StoreComponents(ref, i, samples[i].ref.rot);
+		StoreComponents(target, i, samples[i].target.rot);
+	}
+
+	// The gates of DeltaRotationSamples, with the angle test done on the trace: angle > a <=> (trace - 1) / 2 < cos(a).
+	auto &gates = workspace.gates;
+	const __m128 maxTrace = _mm_set1_ps((float) (2.0 * cos(gates.minAngle) + 1.0));
+	const __m128 minAxisNormSq = _mm_set1_ps((float) (gates.minAxisNorm * gates.minAxisNorm));
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	RotationAccumulator acc;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		__m128 a[9], b[9];
+		SplatComponents(ref, 9, i, a);
+		SplatComponents(target, 9, i, b);
+
+		__m128 cross[9], refSum[3], targetSum[3], count = _mm_setzero_ps();
+		for (int k = 0; k < 9; k++)
+			cross[k] = _mm_setzero_ps();
+		for (int k = 0; k < 3; k++)
+			refSum[k] = targetSum[k] = _mm_setzero_ps();
+
+		for (size_t j = 0; j < i; j += MixedLanes)
+		{
+			__m128 rx, ry, rz, rtrace, tx, ty, tz, ttrace;
+			DeltaAxisTrace(a, ref, j, rx, ry, rz, rtrace);
+			DeltaAxisTrace(b, target, j, tx, ty, tz, ttrace);
+
+			__m128 rnorm = Dot3(rx, ry, rz, rx, ry, rz);
+			__m128 tnorm = Dot3(tx, ty, tz, tx, ty, tz);
+
+			__m128 valid = PairMask(j, i);
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmplt_ps(rtrace, maxTrace), _mm_cmplt_ps(ttrace, maxTrace)));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(rnorm, minAxisNormSq), _mm_cmpgt_ps(tnorm, minAxisNormSq)));
+
+			// Invalid pairs are scaled to zero rather than skipped.
+			__m128 rs = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(rnorm)));
+			__m128 ts = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(tnorm)));
+			__m128 r[3] = { _mm_mul_ps(rx, rs), _mm_mul_ps(ry, rs), _mm_mul_ps(rz, rs) };
+			__m128 t[3] = { _mm_mul_ps(tx, ts), _mm_mul_ps(ty, ts), _mm_mul_ps(tz, ts) };
+
+			for (int row = 0; row < 3; row++)
+			{
+				for (int col = 0; col < 3; col++)
+					cross[row * 3 + col] = _mm_add_ps(cross[row * 3 + col], _mm_mul_ps(r[row], t[col]));
+				refSum[row] = _mm_add_ps(refSum[row], r[row]);
+				targetSum[row] = _mm_add_ps(targetSum[row], t[row]);
+			}
+			count = _mm_add_ps(count, _mm_and_ps(valid, one));
+		}
+
+		// Fold each row into the double precision sums, so single precision rounding only builds up over one row.
+		for (int k = 0; k < 9; k++)
+			acc.cross(k / 3, k % 3) += SumLanes(cross[k]);
+		for (int k = 0; k < 3; k++)
+		{
+			acc.refSum(k) += SumLanes(refSum[k]);
+			acc.targetSum(k) += SumLanes(targetSum[k]);
+		}
+		acc.count += (size_t) SumLanes(count);
+	}
+
+	workspace.rotationDeltaCount = acc.count;
+	return acc;
+}
+
+static Eigen::Matrix3d CenteredCrossCovariance(const RotationAccumulator &acc)
+{
+	// Cross-covariance of the centered pair axes: sum((r - rc) * (t - tc)^T) = sum(r * t^T) - n * rc * tc^T.
+	return acc.cross - acc.refSum * acc.targetSum.transpose() / (double) acc.count;
+}
+
+bool RotationWellConditioned(const RotationAccumulator &acc)
+{
+	if (acc.count < 3)
+		return false;
+
+	// Kabsch is determined by the two largest singular directions, the third follows from the handedness.
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(CenteredCrossCovariance(acc));
+	auto s = svd.singularValues();
+	return s(1) > s(0) * MixedRotationConditionLimit;
+}
+
+Eigen::Matrix3d SolveRotationKabsch(const RotationAccumulator &acc)
+{
+	Eigen::Matrix3d crossCV = CenteredCrossCovariance(acc);
+
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(crossCV, Eigen::ComputeFullU | Eigen::ComputeFullV);
+
+	Eigen::Matrix3d i = Eigen::Matrix3d::Identity();
+	if ((svd.matrixU() * svd.matrixV().transpose()).determinant() < 0)
+	{
+		i(2,2) = -1;
+	}
+
+	Eigen::Matrix3d rot = svd.matrixV() * i * svd.matrixU().transpose();
+	rot.transposeInPlace();
+	return rot;
+}
+
+// Rows of the stacked translation system by column: dQ in columns 0 to 2, C in column 3.
+struct TranslationRows
+{
+	double columns[4][TranslationBlockRows];
+	size_t count = 0;
+
+	void Add(const Eigen::Matrix3d &dQ, const Eigen::Vector3d &dC)
+	{
+		for (int row = 0; row < 3; row++, count++)
+		{
+			for (int col = 0; col < 3; col++)
+				columns[col][count] = dQ(row, col);
+			columns[3][count] = dC(row);
+		}
+	}
+};
+
+// Folds the rows into the triangular factor and empties them: Householder reflections zero each
+// column of R stacked on the rows below R's diagonal, so R and d stay the QR decomposition of every
+// row folded so far without keeping any of them.
+static void FoldTranslationRows(TranslationAccumulator &acc, TranslationRows &rows)
+{
+	size_t n = rows.count;
+	for (int c = 0; c < 3; c++)
+	{
+		// The column's squared norm and its products with the later columns, in one pass with two
+		// sets of sums so consecutive rows do not wait on each other's additions.
+		const double *x = rows.columns[c];
+		double sums[2][4] = {};
+		for (size_t k = 0; k < n; k++)
+		{
+			auto &sum = sums[k & 1];
+			sum[c] += x[k] * x[k];
+			for (int c2 = c + 1; c2 < 4; c2++)
+				sum[c2] += x[k] * rows.columns[c2][k];
+		}
+
+		double sigma = sums[0][c] + sums[1][c], dots[4];
+		for (int c2 = c + 1; c2 < 4; c2++)
+			dots[c2] = sums[0][c2] + sums[1][c2];
+		if (sigma == 0.0)
+			continue;
+
+		// H = I - tau * u * u^T with u = (1, x / (alpha - beta)) maps (alpha, x) to (beta, 0).
+		double alpha = acc.r(c, c), norm = std::sqrt(alpha * alpha + sigma), beta = alpha > 0.0 ? -norm : norm;
+		double tau = (beta - alpha) / beta, scale = 1.0 / (alpha - beta);
+
+		for (int c2 = c + 1; c2 < 4; c2++)
+		{
+			double &top = c2 < 3 ? acc.r(c, c2) : acc.d(c);
+			double s = tau * (top + scale * dots[c2]), f = s * scale;
+			top -= s;
+
+			double *w = rows.columns[c2];
+			for (size_t k = 0; k < n; k++)
+				w[k] -= f * x[k];
+		}
+		acc.r(c, c) = beta;
+	}
+	rows.count = 0;
+}
+
+TranslationAccumulator AccumulateTranslationSystem(const std::vector<Sample> &samples, CalibrationWorkspace &workspace)
+{
+	size_t n = samples.size();
+	Arena::Scope scratch(workspace.arena);
+
+	// Per-sample terms of the pair equations, computed once instead of once per pair.
+	auto QA = workspace.arena.Allocate<Eigen::Matrix3d>(n);
+	auto QB = workspace.arena.Allocate<Eigen::Matrix3d>(n);
+	auto CA = workspace.arena.Allocate<Eigen::Vector3d>(n);
+	auto CB = workspace.arena.Allocate<Eigen::Vector3d>(n);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		Eigen::Vector3d offset = samples[i].ref.trans - samples[i].target.trans;
+		QA[i] = samples[i].ref.rot.transpose();
+		QB[i] = samples[i].target.rot.transpose();
+		CA[i] = QA[i] * offset;
+		CB[i] = QB[i] * offset;
+	}
+
+	TranslationAccumulator acc;
+	TranslationRows rows;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t j = 0; j < i; j++)
+		{
+			if (rows.count + 6 > TranslationBlockRows)
+				FoldTranslationRows(acc, rows);
+
+			rows.Add(QA[j] - QA[i], CA[j] - CA[i]);
+			rows.Add(QB[j] - QB[i], CB[j] - CB[i]);
+			acc.count += 2;
+		}
+	}
+
+	FoldTranslationRows(acc, rows);
+	return acc;
+}
+
+// Adds the normal equations of pairs (i, j) to (i, j + 3) for one side (reference or target) of the
+// translation system. q and c hold sample i broadcast to all lanes, mask selects the real pairs.
+static inline void AccumulatePairEquations(const __m128 *q, const __m128 *c, const ComponentArrays &qs, const ComponentArrays &cs, size_t j, __m128 mask,
+	__m128 *normal, __m128 *rhs)
+{
+	__m128 d[9], e[3];
+	for (int k = 0; k < 9; k++)
+		d[k] = _mm_and_ps(mask, _mm_sub_ps(_mm_load_ps(qs[k] + j), q[k]));
+	for (int k = 0; k < 3; k++)
+		e[k] = _mm_and_ps(mask, _mm_sub_ps(_mm_load_ps(cs[k] + j), c[k]));
+
+	// dQ^T * dQ is symmetric, so only the upper triangle is summed. Column a of dQ is d[a], d[a + 3], d[a + 6].
+	normal[0] = _mm_add_ps(normal[0], Dot3(d[0], d[3], d[6], d[0], d[3], d[6]));
+	normal[1] = _mm_add_ps(normal[1], Dot3(d[0], d[3], d[6], d[1], d[4], d[7]));
+	normal[2] = _mm_add_ps(normal[2], Dot3(d[0], d[3], d[6], d[2], d[5], d[8]));
+	normal[3] = _mm_add_ps(normal[3], Dot3(d[1], d[4], d[7], d[1], d[4], d[7]));
+	normal[4] = _mm_add_ps(normal[4], Dot3(d[1], d[4], d[7], d[2], d[5], d[8]));
+	normal[5] = _mm_add_ps(normal[5], Dot3(d[2], d[5], d[8], d[2], d[5], d[8]));
+	rhs[0] = _mm_add_ps(rhs[0], Dot3(d[0], d[3], d[6], e[0], e[1], e[2]));
+	rhs[1] = _mm_add_ps(rhs[1], Dot3(d[1], d[4], d[7], e[0], e[1], e[2]));
+	rhs[2] = _mm_add_ps(rhs[2], Dot3(d[2], d[5], d[8], e[0], e[1], e[2]));
+}
+
+TranslationNormalEquations AccumulateTranslationSystemMixed(const std::vector<Sample> &samples, CalibrationWorkspace &workspace)
+{
+	size_t n = samples.size();
+	Arena::Scope scratch(workspace.arena);
+
+	// Same per-sample terms as the double precision loop, rounded once to single precision.
+	auto QA = AllocateComponents(workspace.arena, 9, n);
+	auto QB = AllocateComponents(workspace.arena, 9, n);
+	auto CA = AllocateComponents(workspace.arena, 3, n);
+	auto CB = AllocateComponents(workspace.arena, 3, n);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		Eigen::Vector3d offset = samples[i].ref.trans - samples[i].target.trans;
+		Eigen::Matrix3d qa = samples[i].ref.rot.transpose();
+		Eigen::Matrix3d qb = samples[i].target.rot.transpose();
+		StoreComponents(QA, i, qa);
+		StoreComponents(QB, i, qb);
+		StoreComponents(CA, i, qa * offset);
+		StoreComponents(CB, i, qb * offset);
+	}
+
+	static const int Upper[6][2] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 1, 1 }, { 1, 2 }, { 2, 2 } };
+	TranslationNormalEquations acc;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		__m128 qa[9], qb[9], ca[3], cb[3];
+		SplatComponents(QA, 9, i, qa);
+		SplatComponents(QB, 9, i, qb);
+		SplatComponents(CA, 3, i, ca);
+		SplatComponents(CB, 3, i, cb);
+
+		__m128 normal[6], rhs[3];
+		for (int k = 0; k < 6; k++)
+			normal[k] = _mm_setzero_ps();
+		for (int k = 0; k < 3; k++)
+			rhs[k] = _mm_setzero_ps();
+
+		for (size_t j = 0; j < i; j += MixedLanes)
+		{
+			__m128 mask = PairMask(j, i);
+			AccumulatePairEquations(qa, ca, QA, CA, j, mask, normal, rhs);
+			AccumulatePairEquations(qb, cb, QB, CB, j, mask, normal, rhs);
+		}
+
+		for (int k = 0; k < 6; k++)
+			acc.normal(Upper[k][0], Upper[k][1]) += SumLanes(normal[k]);
+		for (int k = 0; k < 3; k++)
+			acc.rhs(k) += SumLanes(rhs[k]);
+		acc.count += 2 * i;
+	}
+
+	acc.normal(1, 0) = acc.normal(0, 1);
+	acc.normal(2, 0) = acc.normal(0, 2);
+	acc.normal(2, 1) = acc.normal(1, 2);
+	return acc;
+}
+
+bool TranslationWellConditioned(const TranslationNormalEquations &eq)
+{
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(eq.normal);
+	auto s = svd.singularValues();
+	return s(2) > s(0) * MixedTranslationConditionLimit;
+}
+
+Eigen::Vector3d RefineTranslation(const std::vector<Sample> &samples, const TranslationNormalEquations &eq, const Eigen::Vector3d &trans)
+{
+	// The pair residual is dC - dQ * x = (C_j - Q_j x) - (C_i - Q_i x), the difference of the
+	// per-sample residuals r_k = Q_k (offset_k - x). Summed over all pairs i < j, the products of two
+	// such differences equal n times the sum of the products of each term's deviation from its mean,
+	// so the gradient of every pair equation is found in double precision in a pass over the samples.
+	size_t n = samples.size();
+	if (n < 2)
+		return trans;
+
+	Eigen::Matrix3d meanQ[2] = { Eigen::Matrix3d::Zero(), Eigen::Matrix3d::Zero() };
+	Eigen::Vector3d meanR[2] = { Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero() };
+	for (auto &sample : samples)
+	{
+		Eigen::Vector3d offset = sample.ref.trans - sample.target.trans - trans;
+		meanQ[0] += sample.ref.rot.transpose();
+		meanQ[1] += sample.target.rot.transpose();
+		meanR[0] += sample.ref.rot.transpose() * offset;
+		meanR[1] += sample.target.rot.transpose() * offset;
+	}
+	for (int side = 0; side < 2; side++)
+	{
+		meanQ[side] /= (double) n;
+		meanR[side] /= (double) n;
+	}
+
+	Eigen::Vector3d gradient = Eigen::Vector3d::Zero();
+	for (auto &sample : samples)
+	{
+		Eigen::Vector3d offset = sample.ref.trans - sample.target.trans - trans;
+		Eigen::Matrix3d q[2] = { sample.ref.rot.transpose(), sample.target.rot.transpose() };
+		for (int side = 0; side < 2; side++)
+			gradient.noalias() += (q[side] - meanQ[side]).transpose() * (q[side] * offset - meanR[side]);
+	}
+
+	// The single precision normal matrix is close enough to the exact one to solve for the correction.
+	TranslationNormalEquations correction = eq;
+	correction.rhs = gradient * (double) n;
+	return trans + SolveTranslationSystem(correction);
+}
+
+Eigen::Vector3d SolveTranslationSystem(const TranslationAccumulator &acc)
+{
+	// R has the singular values and right singular vectors of the stacked system, so its SVD gives
+	// the same minimum-norm least-squares solution as solving the stacked system directly.
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(acc.r, Eigen::ComputeFullU | Eigen::ComputeFullV);
+	return svd.solve(acc.d);
+}
+
+Eigen::Vector3d SolveTranslationSystem(const TranslationNormalEquations &eq)
+{
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(eq.normal, Eigen::ComputeFullU | Eigen::ComputeFullV);
+	return svd.solve(eq.rhs);
+}
+
+Eigen::Vector3d CalibrateRotation(const std::vector<Sample> &samples, CalibrationWorkspace &workspace)
+{
+	RotationAccumulator acc;
+	workspace.rotationFallback = false;
+
+	if (workspace.precision == SolverPrecision::Mixed)
+	{
+		acc = AccumulateRotationDeltasMixed(samples, workspace);
+		workspace.rotationFallback = !RotationWellConditioned(acc);
+	}
+
+	if (workspace.precision == SolverPrecision::Double || workspace.rotationFallback)
+		acc = AccumulateRotationDeltas(samples, workspace);
+
+	// Kabsch algorithm
+	Eigen::Matrix3d rot = SolveRotationKabsch(acc);
+
+	Eigen::Vector3d euler = rot.eulerAngles(2, 1, 0) * 180.0 / EIGEN_PI;
+	return euler;
+}
+
+Eigen::Vector3d CalibrateTranslation(const std::vector<Sample> &samples, CalibrationWorkspace &workspace)
+{
+	workspace.translationFallback = false;
+
+	if (workspace.precision == SolverPrecision::Mixed)
+	{
+		auto eq = AccumulateTranslationSystemMixed(samples, workspace);
+		workspace.translationFallback = !TranslationWellConditioned(eq);
+		if (!workspace.translationFallback)
+		{
+			Eigen::Vector3d trans = SolveTranslationSystem(eq);
+			for (int step = 0; step < MixedTranslationRefinementSteps; step++)
+				trans = RefineTranslation(samples, eq, trans);
+			return trans * 100.0;
+		}
+	}
+
+	auto acc = AccumulateTranslationSystem(samples, workspace);
+	Eigen::Vector3d trans = SolveTranslationSystem(acc);
+	return trans * 100.0;
+}
+
+// Runs solve(subset, workspace) once per fold, each on the samples outside that fold, on its own
+// thread. Folds are contiguous blocks, so each covers a stretch of the recorded motion. A spread
+// estimate does not need double precision, so the folds always use the faster mixed solver.
+template<class Solve> static std::vector<Eigen::Vector3d> SolveFolds(const std::vector<Sample> &samples, int folds, const RotationGates &gates, Solve solve)
+{
+	size_t n = samples.size();
+	std::vector<Eigen::Vector3d> results(folds);
+	std::unique_ptr<CalibrationWorkspace[]> workspaces(new CalibrationWorkspace[folds]);
+	std::vector<std::thread> threads;
+
+	for (int f = 0; f < folds; f++)
+	{
+		threads.push_back(std::thread([&, f] {
+			size_t begin = n * f / folds, end = n * (f + 1) / folds;
+			std::vector<Sample> subset;
+			subset.reserve(n - (end - begin));
+			subset.insert(subset.end(), samples.begin(), samples.begin() + begin);
+			subset.insert(subset.end(), samples.begin() + end, samples.end());
+
+			workspaces[f].precision = SolverPrecision::Mixed;
+			workspaces[f].gates = gates;
+			results[f] = solve(subset, workspaces[f]);
+		}));
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+
+	return results;
+}
+
+// Delete-a-group jackknife: the spread of leave-one-fold-out estimates, scaled by (k - 1) / k,
+// estimates the variance of the estimate on all samples.
+static Eigen::Vector3d JackknifeStdDev(const std::vector<Eigen::Vector3d> &estimates)
+{
+	double k = (double) estimates.size();
+	Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+	for (auto &e : estimates)
+		mean += e;
+	mean /= k;
+
+	Eigen::Vector3d sumSq = Eigen::Vector3d::Zero();
+	for (auto &e : estimates)
+		sumSq += (e - mean).cwiseAbs2();
+
+	return (sumSq * (k - 1.0) / k).cwiseSqrt();
+}
+
+static Eigen::Matrix3d RotationMatrixFromEuler(const Eigen::Vector3d &eulerdeg)
+{
+	auto q = VRRotationQuat(eulerdeg);
+	return Eigen::Quaterniond(q.w, q.x, q.y, q.z).toRotationMatrix();
+}
+
+Eigen::Vector3d RotationUncertainty(const std::vector<Sample> &samples, const Eigen::Vector3d &rotation, int folds, const RotationGates &gates)
+{
+	folds = std::min(folds, (int) samples.size());
+	if (folds < 2)
+		return Eigen::Vector3d::Zero();
+
+	// Euler angles wrap and couple, so each fold solution is expressed as a small rotation vector
+	// relative to the full solution instead.
+	Eigen::Matrix3d full = RotationMatrixFromEuler(rotation);
+	auto estimates = SolveFolds(samples, folds, gates, [&](const std::vector<Sample> &subset, CalibrationWorkspace &workspace) {
+		Eigen::AngleAxisd delta(RotationMatrixFromEuler(CalibrateRotation(subset, workspace)) * full.transpose());
+		return Eigen::Vector3d(delta.axis() * delta.angle() * 180.0 / EIGEN_PI);
+	});
+
+	return JackknifeStdDev(estimates);
+}
+
+Eigen::Vector3d TranslationUncertainty(const std::vector<Sample> &samples, int folds)
+{
+	folds = std::min(folds, (int) samples.size());
+	if (folds < 2)
+		return Eigen::Vector3d::Zero();
+
+	auto estimates = SolveFolds(samples, folds, RotationGates(), [](const std::vector<Sample> &subset, CalibrationWorkspace &workspace) {
+		return CalibrateTranslation(subset, workspace);
+	});
+
+	return JackknifeStdDev(estimates);
+}
+
+vr::HmdQuaternion_t VRRotationQuat(Eigen::Vector3d eulerdeg)
+{
+	auto euler = eulerdeg * EIGEN_PI / 180.0;
+
+	Eigen::Quaterniond rotQuat =
+		Eigen::AngleAxisd(euler(0), Eigen::Vector3d::UnitZ()) *
+		Eigen::AngleAxisd(euler(1), Eigen::Vector3d::UnitY()) *
+		Eigen::AngleAxisd(euler(2), Eigen::Vector3d::UnitX());
+
+	vr::HmdQuaternion_t vrRotQuat;
+	vrRotQuat.x = rotQuat.coeffs()[0];
+	vrRotQuat.y = rotQuat.coeffs()[1];
+	vrRotQuat.z = rotQuat.coeffs()[2];
+	vrRotQuat.w = rotQuat.coeffs()[3];
+	return vrRotQuat;
+}
+
+vr::HmdVector3d_t VRTranslationVec(Eigen::Vector3d transcm)
+{
+	auto trans = transcm * 0.01;
+	vr::HmdVector3d_t vrTrans;
+	vrTrans.v[0] = trans[0];
+	vrTrans.v[1] = trans[1];
+	vrTrans.v[2] = trans[2];
+	return vrTrans;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+// Solver math for the calibration, shared with the command line tools.
+
+#include "Arena.h"
+
+#include <Eigen/Core>
+#include <openvr.h>
+#include <vector>
+
+struct Pose
+{
+	Eigen::Matrix3d rot;
+	Eigen::Vector3d trans;
+
+	Pose() { }
+	Pose(vr::HmdMatrix34_t hmdMatrix)
+	{
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				rot(i,j) = hmdMatrix.m[i][j];
+			}
+		}
+		trans = Eigen::Vector3d(hmdMatrix.m[0][3], hmdMatrix.m[1][3], hmdMatrix.m[2][3]);
+	}
+	Pose(double x, double y, double z) : trans(Eigen::Vector3d(x,y,z)) { }
+};
+
+struct Sample
+{
+	Pose ref, target;
+	bool valid;
+	Sample() : valid(false) { }
+	Sample(Pose ref, Pose target) : valid(true), ref(ref), target(target) { }
+};
+
+struct DSample
+{
+	bool valid;
+	Eigen::Vector3d ref, target;
+};
+
+// Sums gathered by the rotation pair loop. They are enough to run Kabsch on the pair axes
+// without storing every pair.
+struct RotationAccumulator
+{
+	Eigen::Matrix3d cross = Eigen::Matrix3d::Zero(); // sum of ref * target^T
+	Eigen::Vector3d refSum = Eigen::Vector3d::Zero();
+	Eigen::Vector3d targetSum = Eigen::Vector3d::Zero();
+	size_t count = 0;
+};
+
+// The stacked translation least-squares problem reduced to its triangular factor, gathered by the
+// translation pair loop: the QR decomposition of every pair's equations, with R x = d having the
+// same least-squares solutions as the stacked system, at the same conditioning.
+struct TranslationAccumulator
+{
+	Eigen::Matrix3d r = Eigen::Matrix3d::Zero(); // upper triangular
+	Eigen::Vector3d d = Eigen::Vector3d::Zero(); // Q^T * C
+	size_t count = 0;
+};
+
+// Normal equations of the same problem, gathered by the single precision pair loop. Cheaper to
+// sum, but they square the condition number, so they are only used while it is small.
+struct TranslationNormalEquations
+{
+	Eigen::Matrix3d normal = Eigen::Matrix3d::Zero(); // sum of dQ^T * dQ
+	Eigen::Vector3d rhs = Eigen::Vector3d::Zero();    // sum of dQ^T * C
+	size_t count = 0;
+};
+
+enum class SolverPrecision
+{
+	// Pair loops and solves entirely in double precision.
+	Double,
+	// Pair loops in single precision, with per-row sums folded into double precision. Rotation is
+	// the Kabsch solve of the single precision sums, done in double. Translation is solved from its
+	// single precision normal equations, then iteratively refined against residuals computed in
+	// double. Falls back to Double when the accumulated system is poorly conditioned.
+	Mixed,
+};
+
+// Gates deciding which pairs of rotation samples carry enough rotation to be used. The defaults
+// are the values the calibrator has always used; presets found by the tools' sweep may differ.
+struct RotationGates
+{
+	double minAngle = 0.4;     // radians both devices must have turned between the two samples
+	double minAxisNorm = 0.01; // length of the unnormalized axis, which also vanishes near 180 degrees
+};
+
+// Scratch state reused across solves. After the first solve of a given size, further solves
+// of that size or smaller make no heap allocations.
+struct CalibrationWorkspace
+{
+	Arena arena;
+	SolverPrecision precision = SolverPrecision::Double;
+	RotationGates gates;
+
+	// Statistics of the last solve.
+	size_t rotationDeltaCount = 0;
+	bool rotationFallback = false, translationFallback = false; // mixed precision solve was redone in double
+};
+
+Eigen::Vector3d AxisFromRotationMatrix3(const Eigen::Matrix3d &rot);
+double AngleFromRotationMatrix3(const Eigen::Matrix3d &rot);
+DSample DeltaRotationSamples(const Sample &s1, const Sample &s2, const RotationGates &gates = RotationGates());
+
+// Individual solver stages, exposed separately so they can be benchmarked.
+RotationAccumulator AccumulateRotationDeltas(const std::vector<Sample> &samples, CalibrationWorkspace &workspace);
+RotationAccumulator AccumulateRotationDeltasMixed(const std::vector<Sample> &samples, CalibrationWorkspace &workspace);
+Eigen::Matrix3d SolveRotationKabsch(const RotationAccumulator &acc);
+TranslationAccumulator AccumulateTranslationSystem(const std::vector<Sample> &samples, CalibrationWorkspace &workspace);
+TranslationNormalEquations AccumulateTranslationSystemMixed(const std::vector<Sample> &samples, CalibrationWorkspace &workspace);
+Eigen::Vector3d SolveTranslationSystem(const TranslationAccumulator &acc);
+Eigen::Vector3d SolveTranslationSystem(const TranslationNormalEquations &eq);
+
+// One step of iterative refinement of a translation solved from eq: the residual of every pair
+// equation at trans, in double precision, is solved with eq's matrix for the correction.
+Eigen::Vector3d RefineTranslation(const std::vector<Sample> &samples, const TranslationNormalEquations &eq, const Eigen::Vector3d &trans);
+
+// Whether the sums are well enough conditioned for the rounding of the single precision pair loops not to matter.
+bool RotationWellConditioned(const RotationAccumulator &acc);
+bool TranslationWellConditioned(const TranslationNormalEquations &eq);
+
+// Both solves use the pair loops selected by workspace.precision.
+
+// Returns the calibrated rotation as euler angles in degrees (roll, yaw, pitch order as stored in profiles).
+Eigen::Vector3d CalibrateRotation(const std::vector<Sample> &samples, CalibrationWorkspace &workspace);
+
+// Returns the calibrated translation in centimeters. Expects target poses to already have the calibrated rotation applied.
+Eigen::Vector3d CalibrateTranslation(const std::vector<Sample> &samples, CalibrationWorkspace &workspace);
+
+// Spread of a calibration, estimated by re-solving it with each of k folds of the samples left out.
+// Values are jackknife standard deviations, so they describe the solution on all samples rather
+// than the smaller fold solutions.
+struct CalibrationUncertainty
+{
+	Eigen::Vector3d rotation = Eigen::Vector3d::Zero();    // degrees, about the reference x, y and z axes
+	Eigen::Vector3d translation = Eigen::Vector3d::Zero(); // centimeters
+	bool valid = false;
+
+	// Spread above which the calibration is considered unreliable.
+	static constexpr double RotationLimitDeg = 0.3;
+	static constexpr double TranslationLimitCm = 0.5;
+
+	bool TooHigh() const
+	{
+		return valid && (rotation.maxCoeff() > RotationLimitDeg || translation.maxCoeff() > TranslationLimitCm);
+	}
+};
+
+static const int CrossValidationFolds = 5;
+
+// Fold solves run in parallel in mixed precision, each with its own workspace. folds is clamped to
+// the sample count. rotation is the euler solution on all samples, as returned by CalibrateRotation
+// with the same gates.
+Eigen::Vector3d RotationUncertainty(const std::vector<Sample> &samples, const Eigen::Vector3d &rotation, int folds = CrossValidationFolds, const RotationGates &gates = RotationGates());
+Eigen::Vector3d TranslationUncertainty(const std::vector<Sample> &samples, int folds = CrossValidationFolds);
+
+vr::HmdQuaternion_t VRRotationQuat(Eigen::Vector3d eulerdeg);
+vr::HmdVector3d_t VRTranslationVec(Eigen::Vector3d transcm);
@@ -4,3 +4,6 @@
 
 void LoadProfile(CalibrationContext &ctx);
 void SaveProfile(CalibrationContext &ctx);
+
+// Reads a calibration preset file into ctx.preset. Returns false and logs if it cannot be used.
+bool LoadCalibrationPreset(CalibrationContext &ctx, const std::string &path);
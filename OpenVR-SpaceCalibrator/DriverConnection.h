@@ -0,0 +1,16 @@
+#pragma once
+
+#include <openvr.h>
+
+#include "../Protocol.h"
+
+// Channel the calibrator sends device transforms through. IPCClient talks to the driver inside
+// SteamVR; the tools substitute their own to capture the requests while replaying traces.
+class DriverConnection
+{
+public:
+	virtual ~DriverConnection() { }
+
+	virtual void Connect() = 0;
+	virtual protocol::Response SendBlocking(const protocol::Request &request) = 0;
+};
@@ -1,14 +1,14 @@
 #pragma once
 
-#include "../Protocol.h"
+#include "DriverConnection.h"
 
-class IPCClient
+class IPCClient : public DriverConnection
 {
 public:
 	~IPCClient();
 
-	void Connect();
-	protocol::Response SendBlocking(const protocol::Request &request);
+	void Connect() override;
+	protocol::Response SendBlocking(const protocol::Request &request) override;
 
 	void Send(const protocol::Request &request);
 	protocol::Response Receive();
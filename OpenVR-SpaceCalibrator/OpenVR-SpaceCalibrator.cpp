@@ -2,6 +2,7 @@
 #include "Calibration.h"
 #include "Configuration.h"
 #include "EmbeddedFiles.h"
+#include "IPCClient.h"
 #include "UserInterface.h"
 
 #include <imgui/imgui.h>
@@ -46,6 +47,7 @@ static GLuint fboHandle = 0, fboTextureHandle = 0;
 static int fboTextureWidth = 0, fboTextureHeight = 0;
 
 static char cwd[MAX_PATH];
+static IPCClient Driver;
 
 void CreateGLFWWindow()
 {
@@ -338,7 +340,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 	try {
 		InitVR();
 		CreateGLFWWindow();
-		InitCalibrator();
+		InitCalibrator(Driver);
 		LoadProfile(CalCtx);
 		RunLoop();
 
@@ -0,0 +1,281 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "PoseTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static int64_t SteadyNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PoseTraceWriter::Open(const std::string &path, vr::ETrackingUniverseOrigin universe, uint32_t flags)
+{
+	Close();
+
+	file = fopen(path.c_str(), "wb");
+	if (!file)
+		throw std::runtime_error("cannot create trace " + path);
+
+	TraceFileHeader header = {};
+	memcpy(header.magic, PoseTraceMagic, sizeof header.magic);
+	header.version = PoseTraceVersion;
+	header.headerSize = sizeof(TraceFileHeader);
+	header.slotCount = vr::k_unMaxTrackedDeviceCount;
+	header.poseSize = sizeof(vr::TrackedDevicePose_t);
+	header.startUnixNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	header.trackingUniverse = universe;
+	header.flags = flags;
+
+	if (fwrite(&header, sizeof header, 1, file) != 1)
+	{
+		fclose(file);
+		file = nullptr;
+		throw std::runtime_error("cannot write trace " + path);
+	}
+
+	startNs = SteadyNs();
+	stopping = false;
+	dropped = 0;
+	pending.clear();
+	for (auto &device : devices)
+		device = TraceDeviceInfo();
+
+	thread = std::thread(&PoseTraceWriter::WriterThread, this);
+}
+
+void PoseTraceWriter::Close()
+{
+	if (!file)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+
+	fclose(file);
+	file = nullptr;
+}
+
+void PoseTraceWriter::SetDeviceInfo(uint32_t slot, const TraceDeviceInfo &info)
+{
+	if (!file || slot >= vr::k_unMaxTrackedDeviceCount || memcmp(&devices[slot], &info, sizeof info) == 0)
+		return;
+
+	devices[slot] = info;
+
+	TraceDeviceInfoRecord record = {};
+	record.header.type = TraceRecordDeviceInfo;
+	record.header.size = sizeof record;
+	record.slot = slot;
+	record.info = info;
+	Enqueue(&record, sizeof record);
+}
+
+void PoseTraceWriter::AppendTick(double appTime, const vr::TrackedDevicePose_t *poses)
+{
+	AppendTick(appTime, poses, SteadyNs() - startNs);
+}
+
+void PoseTraceWriter::AppendTick(double appTime, const vr::TrackedDevicePose_t *poses, int64_t timestampNs)
+{
+	if (!file)
+		return;
+
+	TraceTickRecord record;
+	record.header.type = TraceRecordTick;
+	record.header.size = sizeof record;
+	record.timestampNs = timestampNs;
+	record.appTime = appTime;
+	memcpy(record.poses, poses, sizeof record.poses);
+	Enqueue(&record, sizeof record);
+}
+
+void PoseTraceWriter::Enqueue(const void *record, size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (pending.size() + size > MaxPendingBytes)
+		{
+			dropped++;
+			return;
+		}
+
+		auto bytes = static_cast<const char *>(record);
+		pending.insert(pending.end(), bytes, bytes + size);
+	}
+	wake.notify_one();
+}
+
+void PoseTraceWriter::WriterThread()
+{
+	std::vector<char> writing;
+
+	for (;;)
+	{
+		bool stop;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !pending.empty(); });
+			writing.swap(pending);
+			stop = stopping;
+		}
+
+		if (!writing.empty())
+		{
+			fwrite(writing.data(), 1, writing.size(), file);
+			writing.clear();
+		}
+
+		if (stop)
+			break;
+	}
+
+	fflush(file);
+}
+
+void PoseTraceReader::Open(const std::string &path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("cannot open trace " + path);
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(handle, &fileSize);
+	size = (size_t) fileSize.QuadPart;
+
+	if (size > 0)
+	{
+		mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping)
+			data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	CloseHandle(handle);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("cannot open trace " + path);
+
+	struct stat st;
+	fstat(fd, &st);
+	size = (size_t) st.st_size;
+
+	if (size > 0)
+	{
+		void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED)
+			data = static_cast<const char *>(view);
+	}
+	close(fd);
+#endif
+
+	if (!data)
+	{
+		Close();
+		throw std::runtime_error("cannot map trace " + path);
+	}
+
+	auto &header = Header();
+	if (size < sizeof(TraceFileHeader) || memcmp(header.magic, PoseTraceMagic, sizeof header.magic) != 0)
+	{
+		Close();
+		throw std::runtime_error(path + " is not a pose trace");
+	}
+
+	if (header.version != PoseTraceVersion || header.headerSize < sizeof(TraceFileHeader) || header.headerSize % 8 != 0 || header.slotCount != vr::k_unMaxTrackedDeviceCount || header.poseSize != sizeof(vr::TrackedDevicePose_t))
+	{
+		Close();
+		throw std::runtime_error(path + " has an unsupported trace version or layout");
+	}
+
+	// Index every complete record. Unknown record types are skipped, so newer writers can add
+	// records without breaking older readers.
+	size_t offset = header.headerSize;
+	while (offset + sizeof(TraceRecordHeader) <= size)
+	{
+		auto record = reinterpret_cast<const TraceRecordHeader *>(data + offset);
+		if (record->size < sizeof(TraceRecordHeader) || record->size % 8 != 0 || record->size > size - offset)
+			break;
+
+		if (record->type == TraceRecordTick && record->size >= sizeof(TraceTickRecord))
+		{
+			ticks.push_back(reinterpret_cast<const TraceTickRecord *>(record));
+		}
+		else if (record->type == TraceRecordDeviceInfo && record->size >= sizeof(TraceDeviceInfoRecord))
+		{
+			auto info = reinterpret_cast<const TraceDeviceInfoRecord *>(record);
+			if (info->slot < vr::k_unMaxTrackedDeviceCount)
+				deviceChanges[info->slot].push_back({ ticks.size(), &info->info });
+		}
+
+		offset += record->size;
+	}
+}
+
+void PoseTraceReader::Close()
+{
+	if (data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<char *>(data), size);
+#endif
+	}
+
+#ifdef _WIN32
+	if (mapping)
+		CloseHandle(mapping);
+#endif
+
+	data = nullptr;
+	mapping = nullptr;
+	size = 0;
+	ticks.clear();
+	for (auto &changes : deviceChanges)
+		changes.clear();
+}
+
+PoseTraceTick PoseTraceReader::Tick(size_t index) const
+{
+	auto record = ticks.at(index);
+	return { record->timestampNs, record->appTime, record->poses };
+}
+
+size_t PoseTraceReader::Seek(int64_t timestampNs) const
+{
+	auto it = std::lower_bound(ticks.begin(), ticks.end(), timestampNs, [](const TraceTickRecord *record, int64_t t) {
+		return record->timestampNs < t;
+	});
+	return it - ticks.begin();
+}
+
+const TraceDeviceInfo *PoseTraceReader::DeviceInfo(size_t tick, uint32_t slot) const
+{
+	if (slot >= vr::k_unMaxTrackedDeviceCount)
+		return nullptr;
+
+	// Changes are in file order, so the last one recorded at or before the tick applies.
+	auto &changes = deviceChanges[slot];
+	auto it = std::upper_bound(changes.begin(), changes.end(), tick, [](size_t t, const DeviceChange &change) {
+		return t < change.tick;
+	});
+	return it == changes.begin() ? nullptr : (it - 1)->info;
+}
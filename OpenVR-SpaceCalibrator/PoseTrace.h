@@ -0,0 +1,177 @@
+#pragma once
+
+// Binary recording of the poses the calibrator sees, for capturing sessions and analyzing them
+// offline.
+//
+// A trace is a TraceFileHeader followed by a stream of records. Every record starts with a
+// TraceRecordHeader and has a size that is a multiple of 8, so record payloads are aligned and
+// can be used in place from a memory mapping. A trace that was cut short, e.g. by a crash, is
+// still readable up to its last complete record.
+
+#include <openvr.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char PoseTraceMagic[8] = { 'S', 'C', 'P', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t PoseTraceVersion = 1;
+
+struct TraceFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t slotCount;  // vr::k_unMaxTrackedDeviceCount when written
+	uint32_t poseSize;   // sizeof(vr::TrackedDevicePose_t) when written
+	int64_t startUnixNs; // wall clock time at timestampNs 0
+	uint32_t trackingUniverse; // vr::ETrackingUniverseOrigin of the poses
+	uint32_t flags;            // TraceFlags
+	uint32_t reserved[6];
+};
+
+enum TraceFlags : uint32_t
+{
+	// Poses were captured before the driver applied any calibration, as in generated traces.
+	// Without it, poses include whatever transform the driver applied during recording.
+	TraceFlagRawPoses = 1,
+};
+
+enum TraceRecordType : uint32_t
+{
+	TraceRecordTick = 1,
+	TraceRecordDeviceInfo = 2,
+};
+
+struct TraceRecordHeader
+{
+	uint32_t type;
+	uint32_t size; // including this header
+};
+
+// Poses of every device slot at one calibration tick.
+struct TraceTickRecord
+{
+	TraceRecordHeader header;
+	int64_t timestampNs; // steady clock, relative to the trace start
+	double appTime;      // time passed to CalibrationTick
+	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
+};
+
+// Identity of the device in a slot. Applies to every tick that follows it, until the next
+// record for the same slot.
+struct TraceDeviceInfo
+{
+	int32_t deviceClass = vr::TrackedDeviceClass_Invalid;
+	int32_t controllerRole = vr::TrackedControllerRole_Invalid;
+	char trackingSystem[64] = {};
+	char serial[128] = {};
+};
+
+struct TraceDeviceInfoRecord
+{
+	TraceRecordHeader header;
+	uint32_t slot;
+	uint32_t padding;
+	TraceDeviceInfo info;
+};
+
+static_assert(sizeof(TraceFileHeader) % 8 == 0, "trace header must keep records aligned");
+static_assert(sizeof(TraceTickRecord) % 8 == 0, "trace records must be a multiple of 8 bytes");
+static_assert(sizeof(TraceDeviceInfoRecord) % 8 == 0, "trace records must be a multiple of 8 bytes");
+
+// Appends records to a trace file from a background thread, so recording never waits on the disk.
+// Records are copied into a buffer that the thread swaps out and writes. If the disk falls far
+// behind, further records are dropped and counted rather than growing the buffer without bound.
+class PoseTraceWriter
+{
+public:
+	static const size_t MaxPendingBytes = 64 * 1024 * 1024;
+
+	~PoseTraceWriter() { Close(); }
+
+	// Creates or truncates the file and starts the writer thread. Throws on failure.
+	void Open(const std::string &path, vr::ETrackingUniverseOrigin universe, uint32_t flags = 0);
+
+	// Flushes everything pending and stops the writer thread.
+	void Close();
+
+	bool IsOpen() const { return file != nullptr; }
+
+	// Records the identity of a slot if it differs from the last one recorded.
+	void SetDeviceInfo(uint32_t slot, const TraceDeviceInfo &info);
+
+	// Records the poses of all k_unMaxTrackedDeviceCount slots, timestamped now or at an explicit
+	// time since the trace start.
+	void AppendTick(double appTime, const vr::TrackedDevicePose_t *poses);
+	void AppendTick(double appTime, const vr::TrackedDevicePose_t *poses, int64_t timestampNs);
+
+	uint64_t DroppedRecords() const { return dropped; }
+
+private:
+	void Enqueue(const void *record, size_t size);
+	void WriterThread();
+
+	FILE *file = nullptr;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<char> pending;
+	bool stopping = false;
+	uint64_t dropped = 0;
+
+	int64_t startNs = 0;
+	TraceDeviceInfo devices[vr::k_unMaxTrackedDeviceCount];
+};
+
+struct PoseTraceTick
+{
+	int64_t timestampNs;
+	double appTime;
+	const vr::TrackedDevicePose_t *poses; // k_unMaxTrackedDeviceCount entries, points into the mapping
+};
+
+// Reads a trace through a read-only memory mapping. Ticks and device infos are returned as views
+// into the mapping and stay valid until the reader is closed or destroyed.
+class PoseTraceReader
+{
+public:
+	PoseTraceReader() { }
+	~PoseTraceReader() { Close(); }
+
+	PoseTraceReader(const PoseTraceReader &) = delete;
+	PoseTraceReader &operator=(const PoseTraceReader &) = delete;
+
+	// Maps the file and indexes its records. Throws if it is not a readable trace.
+	void Open(const std::string &path);
+	void Close();
+
+	const TraceFileHeader &Header() const { return *reinterpret_cast<const TraceFileHeader *>(data); }
+
+	size_t TickCount() const { return ticks.size(); }
+	PoseTraceTick Tick(size_t index) const;
+
+	// Index of the first tick at or after timestampNs, or TickCount() if there is none.
+	size_t Seek(int64_t timestampNs) const;
+
+	// Identity of the device in a slot as of a tick, or nullptr if none was recorded yet.
+	const TraceDeviceInfo *DeviceInfo(size_t tick, uint32_t slot) const;
+
+private:
+	struct DeviceChange
+	{
+		size_t tick; // number of ticks recorded before the change
+		const TraceDeviceInfo *info;
+	};
+
+	const char *data = nullptr;
+	size_t size = 0;
+	void *mapping = nullptr;
+
+	std::vector<const TraceTickRecord *> ticks;
+	std::vector<DeviceChange> deviceChanges[vr::k_unMaxTrackedDeviceCount];
+};
@@ -0,0 +1,365 @@
+#include "ProfileJson.h"
+
+#include <picojson.h>
+
+#include <stdexcept>
+#include <string>
+
+static picojson::array FloatArray(const float *buf, int numFloats)
+{
+	picojson::array arr;
+
+	for (int i = 0; i < numFloats; i++)
+		arr.push_back(picojson::value(double(buf[i])));
+
+	return arr;
+}
+
+static void LoadFloatArray(const picojson::value &obj, float *buf, int numFloats)
+{
+	if (!obj.is<picojson::array>())
+		throw std::runtime_error("expected array, got " + obj.to_str());
+
+	auto &arr = obj.get<picojson::array>();
+	if (arr.size() != numFloats)
+		throw std::runtime_error("wrong buffer size");
+
+	for (int i = 0; i < numFloats; i++)
+		buf[i] = (float) arr[i].get<double>();
+}
+
+static picojson::array VectorArray(const Eigen::Vector3d &vec)
+{
+	picojson::array arr;
+
+	for (int i = 0; i < 3; i++)
+		arr.push_back(picojson::value(vec(i)));
+
+	return arr;
+}
+
+static void LoadVectorArray(const picojson::value &obj, Eigen::Vector3d &vec)
+{
+	if (!obj.is<picojson::array>())
+		throw std::runtime_error("expected array, got " + obj.to_str());
+
+	auto &arr = obj.get<picojson::array>();
+	if (arr.size() != 3)
+		throw std::runtime_error("wrong vector size");
+
+	for (int i = 0; i < 3; i++)
+		vec(i) = arr[i].get<double>();
+}
+
+static void LoadPreset(picojson::object &obj, CalibrationContext::Preset &preset)
+{
+	if (!obj["samples"].is<double>() || !obj["min_pair_angle"].is<double>() || !obj["min_pair_axis_norm"].is<double>())
+		throw std::runtime_error("preset needs samples, min_pair_angle and min_pair_axis_norm");
+
+	double samples = obj["samples"].get<double>();
+	double angle = obj["min_pair_angle"].get<double>();
+	double axisNorm = obj["min_pair_axis_norm"].get<double>();
+	if (samples < 10 || samples > 5000)
+		throw std::runtime_error("preset sample count out of range");
+	if (angle < 0.0 || angle >= 3.1 || axisNorm < 0.0 || axisNorm >= 1.0)
+		throw std::runtime_error("preset pair gates out of range");
+
+	preset.name = obj["name"].is<std::string>() ? obj["name"].get<std::string>() : "preset";
+	preset.sampleCount = (size_t) samples;
+	preset.gates.minAngle = angle;
+	preset.gates.minAxisNorm = axisNorm;
+	preset.valid = true;
+}
+
+static picojson::object PresetObject(const CalibrationContext::Preset &preset)
+{
+	picojson::object obj;
+	obj["name"] = picojson::value(preset.name);
+	obj["samples"] = picojson::value((double) preset.sampleCount);
+	obj["min_pair_angle"] = picojson::value(preset.gates.minAngle);
+	obj["min_pair_axis_norm"] = picojson::value(preset.gates.minAxisNorm);
+	return obj;
+}
+
+void ParsePreset(CalibrationContext::Preset &preset, std::istream &stream)
+{
+	picojson::value v;
+	std::string err = picojson::parse(v, stream);
+	if (!err.empty())
+		throw std::runtime_error(err);
+
+	if (!v.is<picojson::object>())
+		throw std::runtime_error("preset is not an object");
+
+	LoadPreset(v.get<picojson::object>(), preset);
+}
+
+void WritePreset(const CalibrationContext::Preset &preset, std::ostream &out)
+{
+	out << picojson::value(PresetObject(preset)).serialize(true);
+}
+
+void ParseProfile(CalibrationContext &ctx, std::istream &stream)
+{
+	picojson::value v;
+	std::string err = picojson::parse(v, stream);
+	if (!err.empty())
+		throw std::runtime_error(err);
+
+	auto arr = v.get<picojson::array>();
+	if (arr.size() < 1)
+		throw std::runtime_error("no profiles in file");
+
+	auto obj = arr[0].get<picojson::object>();
+
+	ctx.referenceTrackingSystem = obj["reference_tracking_system"].get<std::string>();
+	ctx.targetTrackingSystem = obj["target_tracking_system"].get<std::string>();
+	ctx.calibratedRotation(0) = obj["roll"].get<double>();
+	ctx.calibratedRotation(1) = obj["yaw"].get<double>();
+	ctx.calibratedRotation(2) = obj["pitch"].get<double>();
+	ctx.calibratedTranslation(0) = obj["x"].get<double>();
+	ctx.calibratedTranslation(1) = obj["y"].get<double>();
+	ctx.calibratedTranslation(2) = obj["z"].get<double>();
+
+	if (obj["calibration_speed"].is<double>())
+		ctx.calibrationSpeed = (CalibrationContext::Speed)(int) obj["calibration_speed"].get<double>();
+
+	if (obj["calibration_preset"].is<picojson::object>())
+		LoadPreset(obj["calibration_preset"].get<picojson::object>(), ctx.preset);
+
+	if (obj["uncertainty"].is<picojson::object>())
+	{
+		auto uncertainty = obj["uncertainty"].get<picojson::object>();
+		LoadVectorArray(uncertainty["rotation_std_deg"], ctx.uncertainty.rotation);
+		LoadVectorArray(uncertainty["translation_std_cm"], ctx.uncertainty.translation);
+		ctx.uncertainty.valid = true;
+	}
+
+	if (obj["mount_offsets"].is<picojson::array>())
+	{
+		for (auto &entry : obj["mount_offsets"].get<picojson::array>())
+		{
+			auto offsetObj = entry.get<picojson::object>();
+			CalibrationContext::MountOffset offset;
+			offset.serial = offsetObj["serial"].get<std::string>();
+			if (offset.serial.empty() || offset.serial.size() >= sizeof(protocol::MountOffset::serial))
+				throw std::runtime_error("mount offset serial empty or too long: " + offset.serial);
+			offset.rotation(0) = offsetObj["roll"].get<double>();
+			offset.rotation(1) = offsetObj["yaw"].get<double>();
+			offset.rotation(2) = offsetObj["pitch"].get<double>();
+			offset.translation(0) = offsetObj["x"].get<double>();
+			offset.translation(1) = offsetObj["y"].get<double>();
+			offset.translation(2) = offsetObj["z"].get<double>();
+			ctx.mountOffsets.push_back(offset);
+		}
+	}
+
+	if (obj["smoothing"].is<picojson::array>())
+	{
+		for (auto &entry : obj["smoothing"].get<picojson::array>())
+		{
+			auto smoothingObj = entry.get<picojson::object>();
+			CalibrationContext::DeviceSmoothing smoothing;
+			smoothing.serial = smoothingObj["serial"].get<std::string>();
+			if (smoothing.serial.empty() || smoothing.serial.size() >= sizeof(protocol::DeviceSmoothing::serial))
+				throw std::runtime_error("smoothing serial empty or too long: " + smoothing.serial);
+			if (smoothingObj["min_cutoff_hz"].is<double>())
+				smoothing.minCutoffHz = smoothingObj["min_cutoff_hz"].get<double>();
+			if (smoothingObj["beta"].is<double>())
+				smoothing.beta = smoothingObj["beta"].get<double>();
+			if (!(smoothing.minCutoffHz > 0.0) || !(smoothing.beta >= 0.0))
+				throw std::runtime_error("smoothing for " + smoothing.serial + " needs a positive min_cutoff_hz and a beta of at least 0");
+			ctx.smoothing.push_back(smoothing);
+		}
+	}
+
+	if (obj["time_offsets_ms"].is<picojson::object>())
+	{
+		for (auto &entry : obj["time_offsets_ms"].get<picojson::object>())
+		{
+			if (entry.first.empty() || entry.first.size() >= sizeof(protocol::SetTimeOffset::trackingSystem))
+				throw std::runtime_error("time offset tracking system empty or too long: " + entry.first);
+			if (!entry.second.is<double>())
+				throw std::runtime_error("time offset for " + entry.first + " is not a number");
+			ctx.timeOffsetsMs[entry.first] = entry.second.get<double>();
+		}
+	}
+
+	if (obj["stage_budget_ns"].is<double>())
+	{
+		ctx.stageBudgetNs = obj["stage_budget_ns"].get<double>();
+		if (!(ctx.stageBudgetNs >= 0.0))
+			throw std::runtime_error("stage_budget_ns must be at least 0");
+	}
+
+	if (obj["moving_platform_serial"].is<std::string>())
+	{
+		ctx.platformSerial = obj["moving_platform_serial"].get<std::string>();
+		if (ctx.platformSerial.size() >= sizeof(protocol::SetMovingPlatform::serial))
+			throw std::runtime_error("moving platform serial too long: " + ctx.platformSerial);
+	}
+
+	if (obj["fused_tracker"].is<picojson::object>())
+	{
+		auto fusedObj = obj["fused_tracker"].get<picojson::object>();
+		auto &fused = ctx.fusedTracker;
+		fused.primarySerial = fusedObj["primary"].get<std::string>();
+		fused.secondarySerial = fusedObj["secondary"].get<std::string>();
+		if (fused.primarySerial.empty() || fused.primarySerial.size() >= sizeof(protocol::SetFusedTracker::primarySerial) ||
+			fused.secondarySerial.empty() || fused.secondarySerial.size() >= sizeof(protocol::SetFusedTracker::secondarySerial))
+			throw std::runtime_error("fused tracker serials empty or too long: " + fused.primarySerial + ", " + fused.secondarySerial);
+		if (fused.primarySerial == fused.secondarySerial)
+			throw std::runtime_error("fused tracker needs two devices, got " + fused.primarySerial + " twice");
+		if (fusedObj["mode"].is<std::string>())
+		{
+			auto mode = fusedObj["mode"].get<std::string>();
+			if (mode != "blend" && mode != "switch")
+				throw std::runtime_error("fused tracker mode must be blend or switch, not " + mode);
+			fused.blend = mode == "blend";
+		}
+	}
+
+	if (obj["chaperone"].is<picojson::object>())
+	{
+		auto chaperone = obj["chaperone"].get<picojson::object>();
+		ctx.chaperone.autoApply = chaperone["auto_apply"].get<bool>();
+
+		LoadFloatArray(chaperone["play_space_size"], ctx.chaperone.playSpaceSize.v, 2);
+
+		LoadFloatArray(
+			chaperone["standing_center"],
+			(float *) ctx.chaperone.standingCenter.m,
+			sizeof(ctx.chaperone.standingCenter.m) / sizeof(float)
+		);
+
+		if (!chaperone["geometry"].is<picojson::array>())
+			throw std::runtime_error("chaperone geometry is not an array");
+
+		auto &geometry = chaperone["geometry"].get<picojson::array>();
+
+		if (geometry.size() > 0)
+		{
+			ctx.chaperone.geometry.resize(geometry.size() * sizeof(float) / sizeof(ctx.chaperone.geometry[0]));
+			LoadFloatArray(chaperone["geometry"], (float *) ctx.chaperone.geometry.data(), geometry.size());
+
+			ctx.chaperone.valid = true;
+		}
+	}
+
+	ctx.validProfile = true;
+}
+
+void WriteProfile(CalibrationContext &ctx, std::ostream &out)
+{
+	if (!ctx.validProfile)
+		return;
+
+	picojson::object profile;
+	profile["reference_tracking_system"].set<std::string>(ctx.referenceTrackingSystem);
+	profile["target_tracking_system"].set<std::string>(ctx.targetTrackingSystem);
+	profile["roll"].set<double>(ctx.calibratedRotation(0));
+	profile["yaw"].set<double>(ctx.calibratedRotation(1));
+	profile["pitch"].set<double>(ctx.calibratedRotation(2));
+	profile["x"].set<double>(ctx.calibratedTranslation(0));
+	profile["y"].set<double>(ctx.calibratedTranslation(1));
+	profile["z"].set<double>(ctx.calibratedTranslation(2));
+
+	double speed = (int) ctx.calibrationSpeed;
+	profile["calibration_speed"].set<double>(speed);
+
+	if (ctx.preset.valid)
+		profile["calibration_preset"].set<picojson::object>(PresetObject(ctx.preset));
+
+	if (ctx.uncertainty.valid)
+	{
+		picojson::object uncertainty;
+		uncertainty["rotation_std_deg"].set<picojson::array>(VectorArray(ctx.uncertainty.rotation));
+		uncertainty["translation_std_cm"].set<picojson::array>(VectorArray(ctx.uncertainty.translation));
+		profile["uncertainty"].set<picojson::object>(uncertainty);
+	}
+
+	if (!ctx.mountOffsets.empty())
+	{
+		picojson::array offsets;
+		for (auto &offset : ctx.mountOffsets)
+		{
+			picojson::object offsetObj;
+			offsetObj["serial"].set<std::string>(offset.serial);
+			offsetObj["roll"].set<double>(offset.rotation(0));
+			offsetObj["yaw"].set<double>(offset.rotation(1));
+			offsetObj["pitch"].set<double>(offset.rotation(2));
+			offsetObj["x"].set<double>(offset.translation(0));
+			offsetObj["y"].set<double>(offset.translation(1));
+			offsetObj["z"].set<double>(offset.translation(2));
+			offsets.push_back(picojson::value(offsetObj));
+		}
+		profile["mount_offsets"].set<picojson::array>(offsets);
+	}
+
+	if (!ctx.smoothing.empty())
+	{
+		picojson::array smoothing;
+		for (auto &device : ctx.smoothing)
+		{
+			picojson::object smoothingObj;
+			smoothingObj["serial"].set<std::string>(device.serial);
+			smoothingObj["min_cutoff_hz"].set<double>(device.minCutoffHz);
+			smoothingObj["beta"].set<double>(device.beta);
+			smoothing.push_back(picojson::value(smoothingObj));
+		}
+		profile["smoothing"].set<picojson::array>(smoothing);
+	}
+
+	if (!ctx.timeOffsetsMs.empty())
+	{
+		picojson::object offsets;
+		for (auto &offset : ctx.timeOffsetsMs)
+			offsets[offset.first].set<double>(offset.second);
+		profile["time_offsets_ms"].set<picojson::object>(offsets);
+	}
+
+	if (ctx.stageBudgetNs != protocol::DefaultStageBudgetNs)
+		profile["stage_budget_ns"].set<double>(ctx.stageBudgetNs);
+
+	if (!ctx.platformSerial.empty())
+		profile["moving_platform_serial"].set<std::string>(ctx.platformSerial);
+
+	if (!ctx.fusedTracker.primarySerial.empty())
+	{
+		picojson::object fusedObj;
+		fusedObj["primary"].set<std::string>(ctx.fusedTracker.primarySerial);
+		fusedObj["secondary"].set<std::string>(ctx.fusedTracker.secondarySerial);
+		fusedObj["mode"].set<std::string>(ctx.fusedTracker.blend ? "blend" : "switch");
+		profile["fused_tracker"].set<picojson::object>(fusedObj);
+	}
+
+	if (ctx.chaperone.valid)
+	{
+		picojson::object chaperone;
+		chaperone["auto_apply"].set<bool>(ctx.chaperone.autoApply);
+		chaperone["play_space_size"].set<picojson::array>(FloatArray(ctx.chaperone.playSpaceSize.v, 2));
+
+		chaperone["standing_center"].set<picojson::array>(FloatArray(
+			(float *) ctx.chaperone.standingCenter.m,
+			sizeof(ctx.chaperone.standingCenter.m) / sizeof(float)
+		));
+
+		chaperone["geometry"].set<picojson::array>(FloatArray(
+			(float *) ctx.chaperone.geometry.data(),
+			sizeof(ctx.chaperone.geometry[0]) / sizeof(float) * ctx.chaperone.geometry.size()
+		));
+
+		profile["chaperone"].set<picojson::object>(chaperone);
+	}
+
+	picojson::value profileV;
+	profileV.set<picojson::object>(profile);
+
+	picojson::array profiles;
+	profiles.push_back(profileV);
+
+	picojson::value profilesV;
+	profilesV.set<picojson::array>(profiles);
+
+	out << profilesV.serialize(true);
+}
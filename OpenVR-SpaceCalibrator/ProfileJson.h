@@ -0,0 +1,21 @@
+#pragma once
+
+// JSON form of a calibration profile, independent of where it is stored. Configuration.cpp keeps
+// it in the registry; the tools read and write it as files.
+
+#include "Calibration.h"
+
+#include <istream>
+#include <ostream>
+
+// Reads the first profile of a profile array into ctx and marks it valid. Throws on malformed input.
+void ParseProfile(CalibrationContext &ctx, std::istream &stream);
+
+// Writes ctx as a single element profile array, or nothing if it holds no valid profile.
+void WriteProfile(CalibrationContext &ctx, std::ostream &out);
+
+// A calibration preset on its own, as written by the tools' sweep command:
+// { "name": ..., "samples": ..., "min_pair_angle": ..., "min_pair_axis_norm": ... }.
+// Parsing validates the values and throws on anything a calibration could not run with.
+void ParsePreset(CalibrationContext::Preset &preset, std::istream &stream);
+void WritePreset(const CalibrationContext::Preset &preset, std::ostream &out);
@@ -3,6 +3,9 @@
 #include "Calibration.h"
 #include "Configuration.h"
 
+#include <cstdio>
+#include <ctime>
+#include <fstream>
 #include <thread>
 #include <string>
 #include <vector>
@@ -33,6 +36,7 @@ VRState LoadVRState();
 void BuildSystemSelection(const VRState &state);
 void BuildDeviceSelections(const VRState &state);
 void BuildProfileEditor();
+void ExportDeviceReport(const VRState &state);
 void BuildMenu(bool runningInOverlay);
 
 static const ImGuiWindowFlags bareWindowFlags =
@@ -155,6 +159,30 @@ void BuildMenu(bool runningInOverlay)
 			CalCtx.calibrationSpeed = CalibrationContext::VERY_SLOW;
 
 		ImGui::Columns(1);
+
+		if (CalCtx.preset.valid)
+		{
+			char label[256];
+			snprintf(label, sizeof label, " Preset %s (%zd samples)", CalCtx.preset.name.c_str(), CalCtx.preset.sampleCount);
+			if (ImGui::RadioButton(label, speed == CalibrationContext::PRESET))
+				CalCtx.calibrationSpeed = CalibrationContext::PRESET;
+			ImGui::SameLine();
+		}
+
+		if (ImGui::Button("Load calibration_preset.json"))
+		{
+			if (LoadCalibrationPreset(CalCtx, "calibration_preset.json"))
+			{
+				CalCtx.calibrationSpeed = CalibrationContext::PRESET;
+				SaveProfile(CalCtx);
+			}
+		}
+
+		ImGui::Checkbox(" Record a pose trace of the next calibration", &CalCtx.recordTrace);
+
+		bool poseTap = CalCtx.driverPoseTap;
+		if (ImGui::Checkbox(" Record raw driver poses at native rate", &poseTap))
+			SetDriverPoseTap(poseTap);
 	}
 	else if (CalCtx.state == CalibrationState::Editing)
 	{
@@ -295,6 +323,38 @@ void AppendSeparated(std::string &buffer, const std::string &suffix)
 	buffer += suffix;
 }
 
+// Short form of the driver's measurements for the device panes, the tooltip has the rest.
+std::string StatsSummary(int id)
+{
+	if (!CalCtx.deviceStatsValid[id] || CalCtx.deviceStats[id].poseCount == 0)
+		return "";
+
+	auto &stats = CalCtx.deviceStats[id];
+	char buf[64];
+	if (stats.stationaryWindows > 0)
+		snprintf(buf, sizeof buf, "%.0f Hz, %.2f mm", stats.updateRateHz, stats.positionNoiseMm);
+	else
+		snprintf(buf, sizeof buf, "%.0f Hz", stats.updateRateHz);
+	return buf;
+}
+
+// The upper end of the driver's log2 bucket holding the given fraction of pose hook calls.
+static double HookTimingPercentileNs(const protocol::HookTiming &timing, double fraction)
+{
+	if (timing.calls == 0 || !(timing.cyclesPerNs > 0.0))
+		return 0.0;
+
+	uint64_t seen = 0, wanted = (uint64_t) (fraction * (double) timing.calls);
+	uint32_t b = 0;
+	for (; b < protocol::HookTimingBuckets - 1; b++)
+	{
+		seen += timing.buckets[b];
+		if (seen > wanted)
+			break;
+	}
+	return (double) (1ull << b) / timing.cyclesPerNs;
+}
+
 std::string LabelString(const VRDevice &device)
 {
 	std::string label;
@@ -364,9 +424,36 @@ void BuildDeviceSelection(const VRState &state, int &selected, const std::string
 		if (selected == -1)
 			selected = device.id;
 
+		// The summary changes with every scan, the ID after ## keeps the selectable the same item.
 		auto label = LabelString(device);
+		auto summary = StatsSummary(device.id);
+		if (!summary.empty())
+			AppendSeparated(label, summary);
+		label += "##" + std::to_string(device.id);
 		if (ImGui::Selectable(label.c_str(), selected == device.id))
 			selected = device.id;
+
+		if (ImGui::IsItemHovered() && CalCtx.deviceStatsValid[device.id])
+		{
+			CalCtx.hookTimingDevice = device.id;
+			auto &stats = CalCtx.deviceStats[device.id];
+			char hook[96] = "";
+			if (CalCtx.hookTimingValid[device.id] && CalCtx.hookTiming[device.id].calls > 0)
+			{
+				auto &timing = CalCtx.hookTiming[device.id];
+				snprintf(hook, sizeof hook, "\nPose hook: half under %.0f ns, 99%% under %.0f ns",
+					HookTimingPercentileNs(timing, 0.5), HookTimingPercentileNs(timing, 0.99));
+			}
+
+			ImGui::SetTooltip(
+				"%.1f Hz, interval jitter %.2f ms, longest interval %.1f ms\n"
+				"Noise at rest: %.3f mm, %.4f deg (%u windows)\n"
+				"%llu poses, %u invalid%s",
+				stats.updateRateHz, stats.intervalJitterMs, stats.maxIntervalMs,
+				stats.positionNoiseMm, stats.rotationNoiseDeg, stats.stationaryWindows,
+				(unsigned long long) stats.poseCount, stats.invalidPoses, hook
+			);
+		}
 	}
 }
 
@@ -375,6 +462,9 @@ void BuildDeviceSelections(const VRState &state)
 	ImGuiStyle &style = ImGui::GetStyle();
 	ImVec2 paneSize(ImGui::GetWindowContentRegionWidth() / 2 - style.FramePadding.x, ImGui::GetTextLineHeightWithSpacing() * 5 + style.ItemSpacing.y * 4);
 
+	// Set again by whichever device's tooltip is showing.
+	CalCtx.hookTimingDevice = -1;
+
 	ImGui::BeginChild("left device pane", paneSize, true);
 	static int selectedRefDevice = -1;
 	BuildDeviceSelection(state, selectedRefDevice, CalCtx.referenceTrackingSystem);
@@ -389,7 +479,8 @@ void BuildDeviceSelections(const VRState &state)
 	CalCtx.targetID = selectedCalDevice;
 	ImGui::EndChild();
 
-	if (ImGui::Button("Identify selected devices (blinks LED or vibrates)", ImVec2(ImGui::GetWindowContentRegionWidth(), ImGui::GetTextLineHeightWithSpacing() + 4.0f)))
+	float buttonWidth = ImGui::GetWindowContentRegionWidth() * 2.0f / 3.0f - style.FramePadding.x;
+	if (ImGui::Button("Identify selected devices (blinks LED or vibrates)", ImVec2(buttonWidth, ImGui::GetTextLineHeightWithSpacing() + 4.0f)))
 	{
 		for (unsigned i = 0; i < 100; ++i)
 		{
@@ -398,6 +489,61 @@ void BuildDeviceSelections(const VRState &state)
 			std::this_thread::sleep_for(std::chrono::milliseconds(5));
 		}
 	}
+
+	ImGui::SameLine();
+	if (ImGui::Button("Export device report", ImVec2(ImGui::GetWindowContentRegionWidth() - buttonWidth - style.ItemSpacing.x, ImGui::GetTextLineHeightWithSpacing() + 4.0f)))
+	{
+		ExportDeviceReport(state);
+	}
+}
+
+// Writes the driver's measurements of every device to a CSV file in the working directory.
+void ExportDeviceReport(const VRState &state)
+{
+	char path[64];
+	time_t now = time(nullptr);
+	tm local;
+	localtime_s(&local, &now);
+	strftime(path, sizeof path, "SpaceCalibrator-devices-%Y%m%d-%H%M%S.csv", &local);
+
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cerr << "Cannot write device report " << path << std::endl;
+		return;
+	}
+
+	UpdateHookTiming();
+
+	out << "id,tracking_system,model,serial,update_rate_hz,interval_jitter_ms,max_interval_ms,"
+		"position_noise_mm,rotation_noise_deg,stationary_windows,poses,invalid_poses,hook_p50_ns,hook_p99_ns\n";
+
+	for (auto &device : state.devices)
+	{
+		out << device.id << "," << device.trackingSystem << "," << device.model << "," << device.serial;
+		if (CalCtx.deviceStatsValid[device.id])
+		{
+			auto &stats = CalCtx.deviceStats[device.id];
+			out << "," << stats.updateRateHz << "," << stats.intervalJitterMs << "," << stats.maxIntervalMs;
+			if (stats.stationaryWindows > 0)
+				out << "," << stats.positionNoiseMm << "," << stats.rotationNoiseDeg;
+			else
+				out << ",,";
+			out << "," << stats.stationaryWindows << "," << stats.poseCount << "," << stats.invalidPoses;
+		}
+		else
+		{
+			out << ",,,,,,,,";
+		}
+		if (CalCtx.hookTimingValid[device.id] && CalCtx.hookTiming[device.id].calls > 0)
+		{
+			auto &timing = CalCtx.hookTiming[device.id];
+			out << "," << HookTimingPercentileNs(timing, 0.5) << "," << HookTimingPercentileNs(timing, 0.99);
+		}
+		out << "\n";
+	}
+
+	std::cout << "Wrote device report " << path << std::endl;
 }
 
 VRState LoadVRState()
@@ -0,0 +1,134 @@
+#include "DeviceProfiler.h"
+#include "QuaternionMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+void DeviceProfiler::Reset()
+{
+	windowStart = lastTimestamp = lastPublish = 0;
+	windowPoses = 0.0;
+	memset(&stats, 0, sizeof stats);
+	positionM2 = positionDof = rotationM2 = rotationDof = 0.0;
+	published.Store(stats);
+}
+
+void DeviceProfiler::StartWindow(int64_t timestampNs, const vr::DriverPose_t &pose)
+{
+	windowStart = lastTimestamp = timestampNs;
+	windowPoses = 1.0;
+	stationary = true;
+	maxInterval = 0.0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		origin[i] = pose.vecPosition[i];
+		position[i].Clear();
+		rotation[i].Clear();
+	}
+	interval.Clear();
+
+	auto &q = pose.qRotation;
+	double norm = q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z;
+	originInverse = { q.w / norm, -q.x / norm, -q.y / norm, -q.z / norm };
+}
+
+void DeviceProfiler::FinishWindow()
+{
+	if (interval.n >= 1.0)
+	{
+		double span = (lastTimestamp - windowStart) * 1e-9;
+		stats.updateRateHz = span > 0.0 ? interval.n / span : 0.0;
+		stats.intervalJitterMs = interval.n > 1.0 ? std::sqrt(interval.m2 / (interval.n - 1.0)) * 1e3 : 0.0;
+		stats.maxIntervalMs = maxInterval * 1e3;
+	}
+
+	// Ten poses are enough for a variance that means something, even from a slow device.
+	if (stationary && windowPoses >= 10.0)
+	{
+		positionM2 *= NoiseDecay;
+		positionDof *= NoiseDecay;
+		rotationM2 *= NoiseDecay;
+		rotationDof *= NoiseDecay;
+
+		for (int i = 0; i < 3; i++)
+		{
+			positionM2 += position[i].m2;
+			positionDof += position[i].n - 1.0;
+			rotationM2 += rotation[i].m2;
+			rotationDof += rotation[i].n - 1.0;
+		}
+
+		stats.positionNoiseMm = std::sqrt(positionM2 / positionDof) * 1e3;
+		stats.rotationNoiseDeg = std::sqrt(rotationM2 / rotationDof) * 180.0 / 3.14159265358979323846;
+		stats.stationaryWindows++;
+	}
+
+	published.Store(stats);
+	lastPublish = lastTimestamp;
+	windowPoses = 0.0;
+}
+
+void DeviceProfiler::AddPose(int64_t timestampNs, const vr::DriverPose_t &pose)
+{
+	stats.poseCount++;
+
+	if (!pose.poseIsValid || pose.result != vr::TrackingResult_Running_OK)
+	{
+		stats.invalidPoses++;
+		if (windowPoses > 0.0)
+			FinishWindow();
+		else if ((timestampNs - lastPublish) * 1e-9 >= WindowSeconds)
+		{
+			published.Store(stats);
+			lastPublish = timestampNs;
+		}
+		return;
+	}
+
+	if (windowPoses == 0.0)
+	{
+		StartWindow(timestampNs, pose);
+		return;
+	}
+
+	double dt = (timestampNs - lastTimestamp) * 1e-9;
+	if (dt > MaxIntervalSeconds)
+	{
+		FinishWindow();
+		StartWindow(timestampNs, pose);
+		return;
+	}
+
+	interval.Add(dt);
+	maxInterval = std::max(maxInterval, dt);
+	lastTimestamp = timestampNs;
+	windowPoses += 1.0;
+
+	double moveSq = 0.0;
+	for (int i = 0; i < 3; i++)
+	{
+		double d = pose.vecPosition[i] - origin[i];
+		position[i].Add(d);
+		moveSq += d * d;
+	}
+
+	// Rotation from the window's first pose as a rotation vector, which is twice the vector part
+	// of the quaternion for the small angles of a device at rest.
+	auto q = Multiply(originInverse, pose.qRotation);
+	double sign = q.w < 0.0 ? -2.0 : 2.0;
+	double r[3] = { q.x * sign, q.y * sign, q.z * sign };
+	for (int i = 0; i < 3; i++)
+		rotation[i].Add(r[i]);
+
+	double turnSq = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+	if (moveSq > MaxStationaryMoveMeters * MaxStationaryMoveMeters || turnSq > MaxStationaryTurnRadians * MaxStationaryTurnRadians)
+		stationary = false;
+
+	if ((timestampNs - windowStart) * 1e-9 >= WindowSeconds)
+	{
+		FinishWindow();
+		StartWindow(timestampNs, pose);
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Measures the tracking quality of one device from its pose stream: how regularly poses arrive,
+// and how much the pose wanders while the device lies still. Runs on the device's pose thread
+// after the pose has been passed on; Stats can be read from any thread.
+//
+// Poses are grouped into windows of about half a second. Each window keeps Welford running
+// means and variances of the pose interval, the position and the rotation relative to the
+// window's first pose. A window in which the device stayed within a few millimeters and a
+// fraction of a degree counts as stationary, and its variances are pooled into the noise figures.
+
+#include "../Protocol.h"
+#include "SeqLock.h"
+
+#include <cstdint>
+
+class DeviceProfiler
+{
+public:
+	DeviceProfiler() { Reset(); }
+
+	// Poses of one device must not be added from two threads at once.
+	void AddPose(int64_t timestampNs, const vr::DriverPose_t &pose);
+
+	protocol::DeviceStats Stats() const { return published.Load(); }
+
+	// Pose thread only, or while no poses arrive.
+	void Reset();
+
+	static constexpr double WindowSeconds = 0.5;
+	static constexpr double MaxStationaryMoveMeters = 0.003;
+	static constexpr double MaxStationaryTurnRadians = 0.5 * 3.14159265358979323846 / 180.0;
+
+	// Weight of the pooled noise sums kept at each new stationary window, so a tracker or base
+	// station that starts to degrade shows up within a minute of rest.
+	static constexpr double NoiseDecay = 0.9;
+
+	// A longer silence ends the window instead of counting as a pose interval, e.g. a device waking up.
+	static constexpr double MaxIntervalSeconds = 0.25;
+
+private:
+	// Welford accumulator of one quantity.
+	struct Running
+	{
+		double n, mean, m2;
+
+		void Clear() { n = mean = m2 = 0.0; }
+		void Add(double x)
+		{
+			n += 1.0;
+			double delta = x - mean;
+			mean += delta / n;
+			m2 += delta * (x - mean);
+		}
+	};
+
+	void StartWindow(int64_t timestampNs, const vr::DriverPose_t &pose);
+	void FinishWindow();
+
+	// Current window.
+	int64_t windowStart, lastTimestamp, lastPublish;
+	double windowPoses;
+	bool stationary;
+	double origin[3];
+	vr::HmdQuaternion_t originInverse;
+	Running interval, position[3], rotation[3];
+	double maxInterval;
+
+	// Across windows.
+	protocol::DeviceStats stats;
+	double positionM2, positionDof, rotationM2, rotationDof;
+
+	SeqLock<protocol::DeviceStats> published;
+};
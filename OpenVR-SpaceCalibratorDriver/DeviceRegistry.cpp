@@ -0,0 +1,127 @@
+#include "DeviceRegistry.h"
+
+bool DeviceRegistry::Register(uint32_t openVRID, const std::string &trackingSystem, const std::string &serial)
+{
+	if (openVRID >= vr::k_unMaxTrackedDeviceCount)
+		return false;
+
+	auto &device = devices[openVRID];
+	bool replaced = !device.serial.empty() && (device.serial != serial || device.trackingSystem != trackingSystem);
+
+	if (device.registered)
+	{
+		systems[device.trackingSystem].devices &= ~(1ull << openVRID);
+		auto held = serials.find(device.serial);
+		if (held != serials.end() && held->second == openVRID)
+			serials.erase(held);
+	}
+
+	// A serial moving to another slot leaves its old one.
+	auto previous = serials.find(serial);
+	if (previous != serials.end() && previous->second != openVRID)
+	{
+		auto &old = devices[previous->second];
+		systems[old.trackingSystem].devices &= ~(1ull << previous->second);
+		old.registered = false;
+	}
+
+	device.registered = true;
+	device.trackingSystem = trackingSystem;
+	device.serial = serial;
+	serials[serial] = openVRID;
+	systems[trackingSystem].devices |= 1ull << openVRID;
+	return replaced;
+}
+
+uint32_t DeviceRegistry::Unregister(const std::string &serial)
+{
+	auto it = serials.find(serial);
+	if (it == serials.end())
+		return vr::k_unTrackedDeviceIndexInvalid;
+
+	uint32_t openVRID = it->second;
+	auto &device = devices[openVRID];
+	systems[device.trackingSystem].devices &= ~(1ull << openVRID);
+	device.registered = false;
+	serials.erase(it);
+	return openVRID;
+}
+
+uint32_t DeviceRegistry::FindSerial(const std::string &serial) const
+{
+	auto it = serials.find(serial);
+	return it != serials.end() ? it->second : vr::k_unTrackedDeviceIndexInvalid;
+}
+
+uint64_t DeviceRegistry::SystemDevices(const std::string &trackingSystem) const
+{
+	auto it = systems.find(trackingSystem);
+	return it != systems.end() ? it->second.devices : 0;
+}
+
+void DeviceRegistry::SetSystemTransform(const std::string &trackingSystem, const RegisteredTransform &tf)
+{
+	auto &system = systems[trackingSystem];
+	system.hasTransform = true;
+	system.transform = tf;
+}
+
+bool DeviceRegistry::SystemTransform(const std::string &trackingSystem, RegisteredTransform &tf) const
+{
+	auto it = systems.find(trackingSystem);
+	if (it == systems.end() || !it->second.hasTransform)
+		return false;
+
+	tf = it->second.transform;
+	return true;
+}
+
+bool DeviceRegistry::ResolveTransform(uint32_t openVRID, RegisteredTransform &tf) const
+{
+	return openVRID != vr::k_unTrackedDeviceIndex_Hmd && Registered(openVRID) && SystemTransform(devices[openVRID].trackingSystem, tf);
+}
+
+double DeviceRegistry::ResolveTimeOffset(uint32_t openVRID) const
+{
+	if (!Registered(openVRID))
+		return 0.0;
+
+	auto it = systems.find(devices[openVRID].trackingSystem);
+	return it != systems.end() ? it->second.timeOffset : 0.0;
+}
+
+void DeviceRegistry::SetMountOffset(const std::string &serial, const RegisteredTransform &offset)
+{
+	mountOffsets[serial] = offset;
+}
+
+bool DeviceRegistry::ResolveMountOffset(uint32_t openVRID, RegisteredTransform &offset) const
+{
+	if (!Registered(openVRID))
+		return false;
+
+	auto it = mountOffsets.find(devices[openVRID].serial);
+	if (it == mountOffsets.end())
+		return false;
+
+	offset = it->second;
+	return true;
+}
+
+void DeviceRegistry::SetSmoothing(const std::string &serial, const SmoothingSettings &smoothing)
+{
+	smoothings[serial] = smoothing;
+}
+
+bool DeviceRegistry::ResolveSmoothing(uint32_t openVRID, SmoothingSettings &smoothing) const
+{
+	if (!Registered(openVRID))
+		return false;
+
+	auto it = smoothings.find(devices[openVRID].serial);
+	if (it == smoothings.end())
+		return false;
+
+	smoothing = it->second;
+	return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+// Which device holds each slot, by tracking system and serial, the transforms and time offsets
+// the app set per tracking system and the mount offsets and smoothing it set per serial. The
+// driver registers a device after its first pose, reading both properties once, and resolves its
+// settings with a hash lookup each, so the app sends them once rather than for every slot on
+// every scan. SteamVR announces devices through TrackedDeviceAdded, after which the driver
+// registers a returning serial again. A tracking system's transform never applies to the HMD,
+// which stays where its own system puts it, as it did when the app sent transforms per slot.
+//
+// Not thread safe: the provider only uses it while holding the lock that serializes
+// TransformTable::Set. Devices are registered from RunFrame; the pose path only reaches the
+// registry when the moving platform anchors, once per anchor.
+
+#include "PoseFilter.h"
+
+#include <openvr_driver.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+struct RegisteredTransform
+{
+	bool enabled = false;
+	vr::HmdVector3d_t translation = { { 0.0, 0.0, 0.0 } };
+	vr::HmdQuaternion_t rotation = { 1.0, 0.0, 0.0, 0.0 };
+};
+
+class DeviceRegistry
+{
+public:
+	// Binds the slot to a device. Returns whether a different device held the slot before, whose
+	// transform the slot may still have.
+	bool Register(uint32_t openVRID, const std::string &trackingSystem, const std::string &serial);
+
+	// Unbinds the slot holding the serial and returns it, or k_unTrackedDeviceIndexInvalid if no
+	// slot does. The slot remembers the device, so registering it again is no change.
+	uint32_t Unregister(const std::string &serial);
+
+	bool Registered(uint32_t openVRID) const { return openVRID < vr::k_unMaxTrackedDeviceCount && devices[openVRID].registered; }
+	const std::string &TrackingSystem(uint32_t openVRID) const { return devices[openVRID].trackingSystem; }
+	const std::string &Serial(uint32_t openVRID) const { return devices[openVRID].serial; }
+
+	// The registered slot holding the serial, or k_unTrackedDeviceIndexInvalid.
+	uint32_t FindSerial(const std::string &serial) const;
+
+	// Registered slots of the tracking system, one bit per slot.
+	uint64_t SystemDevices(const std::string &trackingSystem) const;
+
+	// The ones its transform applies to: all but the HMD.
+	uint64_t SystemTransformDevices(const std::string &trackingSystem) const
+	{
+		return SystemDevices(trackingSystem) & ~(1ull << vr::k_unTrackedDeviceIndex_Hmd);
+	}
+
+	void SetSystemTransform(const std::string &trackingSystem, const RegisteredTransform &tf);
+
+	// The transform set for the tracking system, if there is one.
+	bool SystemTransform(const std::string &trackingSystem, RegisteredTransform &tf) const;
+
+	// The transform set for the tracking system of a registered device other than the HMD, if
+	// there is one.
+	bool ResolveTransform(uint32_t openVRID, RegisteredTransform &tf) const;
+
+	void SetTimeOffset(const std::string &trackingSystem, double seconds) { systems[trackingSystem].timeOffset = seconds; }
+
+	// The time offset set for the tracking system of a registered device, zero if none is.
+	double ResolveTimeOffset(uint32_t openVRID) const;
+
+	void SetMountOffset(const std::string &serial, const RegisteredTransform &offset);
+
+	// The mount offset set for the serial of a registered device, if there is one.
+	bool ResolveMountOffset(uint32_t openVRID, RegisteredTransform &offset) const;
+
+	void SetSmoothing(const std::string &serial, const SmoothingSettings &smoothing);
+
+	// The smoothing set for the serial of a registered device, if there is one.
+	bool ResolveSmoothing(uint32_t openVRID, SmoothingSettings &smoothing) const;
+
+private:
+	static_assert(vr::k_unMaxTrackedDeviceCount <= 64, "one device bit per slot");
+
+	struct Device
+	{
+		bool registered = false;
+		std::string trackingSystem, serial;
+	};
+
+	struct System
+	{
+		uint64_t devices = 0;
+		bool hasTransform = false;
+		RegisteredTransform transform;
+		double timeOffset = 0.0;
+	};
+
+	Device devices[vr::k_unMaxTrackedDeviceCount];
+	std::unordered_map<std::string, uint32_t> serials;
+	std::unordered_map<std::string, System> systems;
+	std::unordered_map<std::string, RegisteredTransform> mountOffsets;
+	std::unordered_map<std::string, SmoothingSettings> smoothings;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+// The state the driver keeps per device for its pose thread: the profiler, pose counters and
+// whatever later stages of the pose hook need to remember between poses. SteamVR updates
+// devices from several threads at up to 1 kHz each, so every device's slot starts on its own
+// cache line; two trackers updating at once never write to the same line.
+//
+// Transforms live in TransformTable, whose slots are aligned the same way, because they are
+// written by the IPC thread rather than the pose threads.
+
+#include "DeviceProfiler.h"
+#include "HookTiming.h"
+#include "PoseFilter.h"
+#include "SeqLock.h"
+#include "StageWatchdog.h"
+
+#include <atomic>
+#include <cstdint>
+
+struct alignas(CacheLineSize) DeviceSlot
+{
+	DeviceProfiler profiler;
+	PoseFilter filter;
+
+	// Set by the provider's writers one at a time, read by the pose thread.
+	std::atomic<uint32_t> stages { 0 };
+	std::atomic<double> timeOffset { 0.0 }; // seconds the device's poses are older than they claim
+
+	// Set by the provider's writers while the app's own transform for the device replaces its
+	// tracking system's, as while calibrating it: its poses then skip the stages that would move
+	// them away from the raw pose, until the system's transform is set again.
+	std::atomic<bool> overridden { false };
+
+	// The pose thread's, stages the watchdog turned off.
+	StageWatchdog watchdog;
+	std::atomic<uint32_t> degraded { 0 };
+
+	// The enabled stages the watchdog left on, without those an override turns off.
+	uint32_t Stages() const
+	{
+		uint32_t active = stages.load(std::memory_order_relaxed) & ~Degraded();
+		return Overridden() ? active & ~OverriddenStages : active;
+	}
+	uint32_t Degraded() const { return degraded.load(std::memory_order_relaxed); }
+	bool Overridden() const { return overridden.load(std::memory_order_relaxed); }
+
+	// The device's pose thread only.
+	void Degrade(uint32_t stage)
+	{
+		degraded.store(Degraded() | stage, std::memory_order_relaxed);
+	}
+
+	void SetSmoothing(const SmoothingSettings &smoothing)
+	{
+		filter.Configure(smoothing);
+		SetStage(StageSmoothing, filter.Enabled());
+	}
+
+	void SetTimeOffset(double seconds)
+	{
+		timeOffset.store(seconds, std::memory_order_relaxed);
+		SetStage(StageTimeOffset, seconds != 0.0);
+	}
+
+	// Dates the pose back by the offset, so SteamVR predicts it that much further ahead with the
+	// device's own velocities.
+	void CompensateLatency(vr::DriverPose_t &pose) const
+	{
+		pose.poseTimeOffset -= timeOffset.load(std::memory_order_relaxed);
+	}
+
+	// Written by the device's pose thread only, read from any thread.
+	std::atomic<uint64_t> poses { 0 };
+	std::atomic<uint64_t> transformedPoses { 0 };
+#ifdef POSE_HOOK_TIMING
+	CycleHistogram hookCycles;
+#endif
+
+	// Set once the driver has registered the device and resolved its transform, cleared when
+	// SteamVR adds the device again.
+	std::atomic<bool> registered { false };
+
+	void SetStage(uint32_t stage, bool enabled)
+	{
+		uint32_t current = stages.load(std::memory_order_relaxed);
+		stages.store(enabled ? current | stage : current & ~stage, std::memory_order_relaxed);
+	}
+
+	void CountPose(bool transformed)
+	{
+		poses.store(poses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (transformed)
+			transformedPoses.store(transformedPoses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+};
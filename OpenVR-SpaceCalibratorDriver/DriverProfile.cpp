@@ -0,0 +1,167 @@
+#include "DriverProfile.h"
+#include "QuaternionMath.h"
+#include "../Protocol.h"
+
+#include <openvr_driver.h>
+#include <picojson.h>
+
+#include <cmath>
+#include <stdexcept>
+
+static double Number(picojson::object &obj, const char *name)
+{
+	if (!obj[name].is<double>())
+		throw std::runtime_error(std::string("profile has no number ") + name);
+	return obj[name].get<double>();
+}
+
+static std::string String(picojson::object &obj, const char *name)
+{
+	if (!obj[name].is<std::string>())
+		throw std::runtime_error(std::string("profile has no string ") + name);
+	return obj[name].get<std::string>();
+}
+
+// Roll, yaw and pitch in degrees turn about z, y and x, applied in that order as in VRRotationQuat.
+static void EulerRotation(picojson::object &obj, double rotation[4])
+{
+	const double halfRadians = 3.14159265358979323846 / 360.0;
+	double roll = Number(obj, "roll") * halfRadians, yaw = Number(obj, "yaw") * halfRadians, pitch = Number(obj, "pitch") * halfRadians;
+	vr::HmdQuaternion_t qz = { std::cos(roll), 0.0, 0.0, std::sin(roll) };
+	vr::HmdQuaternion_t qy = { std::cos(yaw), 0.0, std::sin(yaw), 0.0 };
+	vr::HmdQuaternion_t qx = { std::cos(pitch), std::sin(pitch), 0.0, 0.0 };
+	auto q = Multiply(Multiply(qz, qy), qx);
+	rotation[0] = q.w;
+	rotation[1] = q.x;
+	rotation[2] = q.y;
+	rotation[3] = q.z;
+}
+
+// x, y and z in centimeters.
+static void Translation(picojson::object &obj, double translation[3])
+{
+	translation[0] = Number(obj, "x") * 0.01;
+	translation[1] = Number(obj, "y") * 0.01;
+	translation[2] = Number(obj, "z") * 0.01;
+}
+
+// A serial as the protocol carries it, null terminated in a fixed field.
+static std::string Serial(picojson::object &obj, const char *name, const char *what)
+{
+	auto serial = String(obj, name);
+	if (serial.empty() || serial.size() >= sizeof(protocol::MountOffset::serial))
+		throw std::runtime_error(std::string(what) + " serial empty or too long: " + serial);
+	return serial;
+}
+
+DriverProfile ParseDriverProfile(const std::string &json)
+{
+	picojson::value v;
+	std::string err = picojson::parse(v, json);
+	if (!err.empty())
+		throw std::runtime_error(err);
+
+	if (!v.is<picojson::array>() || v.get<picojson::array>().empty())
+		throw std::runtime_error("no profiles in file");
+
+	auto &first = v.get<picojson::array>()[0];
+	if (!first.is<picojson::object>())
+		throw std::runtime_error("profile is not an object");
+
+	auto obj = first.get<picojson::object>();
+
+	DriverProfile profile;
+	profile.referenceTrackingSystem = String(obj, "reference_tracking_system");
+	profile.targetTrackingSystem = String(obj, "target_tracking_system");
+
+	EulerRotation(obj, profile.rotation);
+	Translation(obj, profile.translation);
+
+	if (obj["mount_offsets"].is<picojson::array>())
+	{
+		for (auto &entry : obj["mount_offsets"].get<picojson::array>())
+		{
+			if (!entry.is<picojson::object>())
+				throw std::runtime_error("mount offset is not an object");
+
+			auto offsetObj = entry.get<picojson::object>();
+			DriverProfile::MountOffset offset;
+			offset.serial = Serial(offsetObj, "serial", "mount offset");
+			EulerRotation(offsetObj, offset.rotation);
+			Translation(offsetObj, offset.translation);
+			profile.mountOffsets.push_back(offset);
+		}
+	}
+
+	if (obj["smoothing"].is<picojson::array>())
+	{
+		for (auto &entry : obj["smoothing"].get<picojson::array>())
+		{
+			if (!entry.is<picojson::object>())
+				throw std::runtime_error("smoothing entry is not an object");
+
+			auto smoothingObj = entry.get<picojson::object>();
+			DriverProfile::Smoothing smoothing;
+			smoothing.serial = Serial(smoothingObj, "serial", "smoothing");
+			if (smoothingObj["min_cutoff_hz"].is<double>())
+				smoothing.minCutoffHz = smoothingObj["min_cutoff_hz"].get<double>();
+			if (smoothingObj["beta"].is<double>())
+				smoothing.beta = smoothingObj["beta"].get<double>();
+			if (!(smoothing.minCutoffHz > 0.0) || !(smoothing.beta >= 0.0))
+				throw std::runtime_error("smoothing for " + smoothing.serial + " needs a positive min_cutoff_hz and a beta of at least 0");
+			profile.smoothing.push_back(smoothing);
+		}
+	}
+
+	if (obj["time_offsets_ms"].is<picojson::object>())
+	{
+		for (auto &entry : obj["time_offsets_ms"].get<picojson::object>())
+		{
+			if (entry.first.empty() || entry.first.size() >= sizeof(protocol::SetTimeOffset::trackingSystem))
+				throw std::runtime_error("time offset tracking system empty or too long: " + entry.first);
+			if (!entry.second.is<double>())
+				throw std::runtime_error("time offset for " + entry.first + " is not a number");
+			profile.timeOffsetsMs[entry.first] = entry.second.get<double>();
+		}
+	}
+
+	profile.stageBudgetNs = protocol::DefaultStageBudgetNs;
+	if (obj["stage_budget_ns"].is<double>())
+	{
+		profile.stageBudgetNs = obj["stage_budget_ns"].get<double>();
+		if (!(profile.stageBudgetNs >= 0.0))
+			throw std::runtime_error("stage_budget_ns must be at least 0");
+	}
+
+	if (obj["moving_platform_serial"].is<std::string>())
+	{
+		profile.platformSerial = obj["moving_platform_serial"].get<std::string>();
+		if (profile.platformSerial.size() >= sizeof(protocol::SetMovingPlatform::serial))
+			throw std::runtime_error("moving platform serial too long: " + profile.platformSerial);
+	}
+
+	if (obj["fused_tracker"].is<picojson::object>())
+	{
+		auto fusedObj = obj["fused_tracker"].get<picojson::object>();
+		profile.fusedPrimarySerial = Serial(fusedObj, "primary", "fused tracker primary");
+		profile.fusedSecondarySerial = Serial(fusedObj, "secondary", "fused tracker secondary");
+		if (profile.fusedPrimarySerial == profile.fusedSecondarySerial)
+			throw std::runtime_error("fused tracker needs two devices, got " + profile.fusedPrimarySerial + " twice");
+		if (fusedObj["mode"].is<std::string>())
+		{
+			auto mode = fusedObj["mode"].get<std::string>();
+			if (mode != "blend" && mode != "switch")
+				throw std::runtime_error("fused tracker mode must be blend or switch, not " + mode);
+			profile.fusedBlend = mode == "blend";
+		}
+	}
+
+	profile.valid = true;
+	return profile;
+}
+
+bool DriverProfileApplies(const DriverProfile &profile, uint32_t openVRID, const std::string &hmdTrackingSystem, const std::string &deviceTrackingSystem)
+{
+	return profile.valid && openVRID != vr::k_unTrackedDeviceIndex_Hmd &&
+		hmdTrackingSystem == profile.referenceTrackingSystem && deviceTrackingSystem == profile.targetTrackingSystem;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// The part of the app's calibration profile the driver needs to apply it by itself. The driver
+// reads the profile the app saved when SteamVR loads it, and applies it to each device from the
+// device's first pose, so a calibration holds from startup and even if the app never runs. That
+// covers what the app would send the driver for it: the transform, mount offsets, smoothing, time
+// offsets, the stage budget, the moving platform and the fused tracker. Once the app sets a
+// transform it is in charge again, as its own scans apply the same profile.
+//
+// It does not include the OpenVR headers, so the tools can check it against the app's reading
+// of a profile in a file that includes openvr.h.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct DriverProfile
+{
+	bool valid = false;
+	std::string referenceTrackingSystem, targetTrackingSystem;
+	double translation[3] = { 0.0, 0.0, 0.0 }; // meters
+	double rotation[4] = { 1.0, 0.0, 0.0, 0.0 }; // w, x, y, z
+
+	struct MountOffset
+	{
+		std::string serial;
+		double translation[3]; // meters
+		double rotation[4];    // w, x, y, z
+	};
+	std::vector<MountOffset> mountOffsets;
+
+	struct Smoothing
+	{
+		std::string serial;
+		double minCutoffHz = 1.0;
+		double beta = 50.0;
+	};
+	std::vector<Smoothing> smoothing;
+
+	std::map<std::string, double> timeOffsetsMs; // by tracking system
+	double stageBudgetNs = 1000.0;               // protocol::DefaultStageBudgetNs unless set
+	std::string platformSerial;                  // empty for no moving platform
+
+	// Both empty for no fused tracker.
+	std::string fusedPrimarySerial, fusedSecondarySerial;
+	bool fusedBlend = true;
+};
+
+// Reads the first profile of the app's profile JSON, as ParseProfile does, converting rotations
+// from degrees and translations from centimeters. Throws std::runtime_error on malformed input,
+// and on serials and tracking systems too long for the protocol, as the app does.
+DriverProfile ParseDriverProfile(const std::string &json);
+
+// Whether the profile's transform belongs on a device, decided as ScanAndApplyProfile does: the
+// HMD must be of the reference tracking system, and the device of the target one.
+bool DriverProfileApplies(const DriverProfile &profile, uint32_t openVRID, const std::string &hmdTrackingSystem, const std::string &deviceTrackingSystem);
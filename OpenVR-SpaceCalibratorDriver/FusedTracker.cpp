@@ -0,0 +1,306 @@
+#include "FusedTracker.h"
+#include "QuaternionMath.h"
+
+#include <cmath>
+#include <cstring>
+
+static void Cross(const double a[3], const double b[3], double out[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// (1 - t) a + t b on the shorter arc, normalized; identity if both are zero, as for a source
+// that never had a pose.
+static void Nlerp(const double a[4], const double b[4], double t, double out[4])
+{
+	double sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0 ? -t : t;
+	double norm = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		out[i] = (1.0 - t) * a[i] + sign * b[i];
+		norm += out[i] * out[i];
+	}
+
+	norm = std::sqrt(norm);
+	for (int i = 0; i < 4; i++)
+		out[i] = norm > 0.0 ? out[i] / norm : (i == 0 ? 1.0 : 0.0);
+}
+
+static void Lerp(const double a[3], const double b[3], double t, double out[3])
+{
+	for (int i = 0; i < 3; i++)
+		out[i] = a[i] + t * (b[i] - a[i]);
+}
+
+static void ToArray(const vr::HmdQuaternion_t &q, double out[4])
+{
+	out[0] = q.w;
+	out[1] = q.x;
+	out[2] = q.y;
+	out[3] = q.z;
+}
+
+// The pose SteamVR places: world-from-driver, then the device, then driver-from-head, with its
+// velocities moved to the head point.
+static FusionSample Sample(int64_t nowNs, const vr::DriverPose_t &pose, double quality)
+{
+	double world[4], rotation[4], head[4], deviceRotation[4];
+	ToArray(pose.qWorldFromDriverRotation, world);
+	ToArray(pose.qRotation, rotation);
+	ToArray(pose.qDriverFromHeadRotation, head);
+
+	FusionSample sample;
+	Multiply(world, rotation, deviceRotation);
+	Multiply(deviceRotation, head, sample.rotation);
+
+	double lever[3], position[3];
+	Rotate(deviceRotation, pose.vecDriverFromHeadTranslation, lever);
+	Rotate(world, pose.vecPosition, position);
+	Rotate(world, pose.vecVelocity, sample.velocity);
+	Rotate(world, pose.vecAngularVelocity, sample.angularVelocity);
+
+	double turning[3];
+	Cross(sample.angularVelocity, lever, turning);
+	for (int i = 0; i < 3; i++)
+	{
+		sample.position[i] = position[i] + lever[i] + pose.vecWorldFromDriverTranslation[i];
+		sample.velocity[i] += turning[i];
+	}
+
+	sample.timeNs = nowNs + (int64_t) (pose.poseTimeOffset * 1e9);
+	sample.receivedNs = nowNs;
+	sample.quality = quality;
+	sample.valid = true;
+	return sample;
+}
+
+// The sample moved to timeNs by its velocities.
+static FusionSample Extrapolate(const FusionSample &sample, int64_t timeNs)
+{
+	FusionSample moved = sample;
+	moved.timeNs = timeNs;
+	if (!sample.valid)
+		return moved;
+
+	double dt = (double) (timeNs - sample.timeNs) * 1e-9;
+	for (int i = 0; i < 3; i++)
+		moved.position[i] += sample.velocity[i] * dt;
+
+	auto &w = sample.angularVelocity;
+	double speed = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+	if (speed > 0.0)
+	{
+		double half = 0.5 * speed * dt, s = std::sin(half) / speed;
+		double turn[4] = { std::cos(half), w[0] * s, w[1] * s, w[2] * s };
+		Multiply(turn, sample.rotation, moved.rotation);
+	}
+	return moved;
+}
+
+FusedTracker::FusedTracker()
+{
+	for (auto &id : ids)
+		id.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_relaxed);
+	for (auto &input : inputs)
+		memset(&input.latest, 0, sizeof input.latest);
+}
+
+double FusedTracker::Quality(const vr::DriverPose_t &pose)
+{
+	if (!pose.poseIsValid || !pose.deviceIsConnected)
+		return 0.0;
+
+	switch (pose.result)
+	{
+	case vr::TrackingResult_Running_OK: return 1.0;
+	case vr::TrackingResult_Running_OutOfRange: return OutOfRangeQuality;
+	default: return 0.0;
+	}
+}
+
+void FusedTracker::Configure(bool blend)
+{
+	blending.store(blend, std::memory_order_relaxed);
+	generation.store(generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	enabled.store(true, std::memory_order_release);
+}
+
+void FusedTracker::Stop()
+{
+	enabled.store(false, std::memory_order_release);
+	for (auto &id : ids)
+		id.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_relaxed);
+
+	// A pose thread may be fusing one last pose; the writer waits it out rather than the other way.
+	while (busy.test_and_set(std::memory_order_acquire))
+		;
+	auto pose = last.Load();
+	pose.poseIsValid = false;
+	pose.deviceIsConnected = false;
+	pose.result = vr::TrackingResult_Uninitialized;
+	last.Store(pose);
+	busy.clear(std::memory_order_release);
+}
+
+bool FusedTracker::Update(uint32_t openVRID, int64_t nowNs, const vr::DriverPose_t &pose, vr::DriverPose_t &fused)
+{
+	int source = SourceIndex(openVRID);
+	if (source < 0 || !Enabled())
+		return false;
+
+	auto &input = inputs[source];
+	if (input.lastNs)
+	{
+		int64_t interval = nowNs - input.lastNs, average = input.intervalNs.load(std::memory_order_relaxed);
+		input.intervalNs.store(average ? average + (interval - average) / 8 : interval, std::memory_order_relaxed);
+	}
+	input.lastNs = nowNs;
+
+	// A pose without tracking keeps the last tracked one to extrapolate from, at no quality.
+	double quality = Quality(pose);
+	if (quality > 0.0)
+		input.latest = Sample(nowNs, pose, quality);
+	else
+		input.latest.quality = 0.0;
+	input.latest.receivedNs = nowNs;
+	input.sample.Store(input.latest);
+
+	// The faster source publishes, the slower one only once the faster one missed a few poses.
+	auto &otherInput = inputs[1 - source];
+	auto other = otherInput.sample.Load();
+	int64_t own = input.intervalNs.load(std::memory_order_relaxed), theirs = otherInput.intervalNs.load(std::memory_order_relaxed);
+	int64_t silence = nowNs - other.receivedNs;
+	bool quiet = other.receivedNs == 0 || silence > QuietIntervals * theirs || (double) silence > StaleSeconds * 1e9;
+	bool faster = own > 0 && (theirs == 0 || own < theirs || (own == theirs && source == Primary));
+	if (!quiet && !faster)
+		return false;
+
+	if (busy.test_and_set(std::memory_order_acquire))
+		return false;
+
+	Fuse(source, input.latest, other, nowNs, fused);
+	last.Store(fused);
+	busy.clear(std::memory_order_release);
+	return true;
+}
+
+void FusedTracker::Fuse(int publisher, const FusionSample &own, const FusionSample &other, int64_t nowNs, vr::DriverPose_t &fused)
+{
+	uint32_t current = generation.load(std::memory_order_acquire);
+	if (current != fusedGeneration)
+	{
+		fusedGeneration = current;
+		offsetKnown = false;
+		weight = 0.0;
+		correcting = false;
+		previous.valid = false;
+	}
+
+	// Both sources at the moment the publisher's pose was true, the other's only if recent.
+	int64_t timeNs = own.valid ? own.timeNs : nowNs;
+	FusionSample at[Sources];
+	double quality[Sources];
+	at[publisher] = own;
+	at[1 - publisher] = Extrapolate(other, timeNs);
+	quality[publisher] = own.valid ? own.quality : 0.0;
+	quality[1 - publisher] = other.valid && std::abs((double) (timeNs - other.timeNs)) <= StaleSeconds * 1e9 ? other.quality : 0.0;
+
+	auto &p = at[Primary], &s = at[Secondary];
+
+	// Where the primary sits on the secondary, learned while both track well: secondary⁻¹ · primary.
+	if (quality[Primary] >= 1.0 && quality[Secondary] >= 1.0)
+	{
+		double inverse[4] = { s.rotation[0], -s.rotation[1], -s.rotation[2], -s.rotation[3] };
+		double rotation[4], translation[3], offset[3] = { p.position[0] - s.position[0], p.position[1] - s.position[1], p.position[2] - s.position[2] };
+		Multiply(inverse, p.rotation, rotation);
+		Rotate(inverse, offset, translation);
+
+		double rate = offsetKnown ? OffsetRate : 1.0;
+		Nlerp(offsetRotation, rotation, rate, offsetRotation);
+		Lerp(offsetTranslation, translation, rate, offsetTranslation);
+		offsetKnown = true;
+	}
+
+	// The secondary moved to the primary's point, or no use until the offset is known.
+	if (offsetKnown)
+	{
+		double rotation[4], lever[3], turning[3];
+		Multiply(s.rotation, offsetRotation, rotation);
+		Rotate(s.rotation, offsetTranslation, lever);
+		Cross(s.angularVelocity, lever, turning);
+		memcpy(s.rotation, rotation, sizeof rotation);
+		for (int i = 0; i < 3; i++)
+		{
+			s.position[i] += lever[i];
+			s.velocity[i] += turning[i];
+		}
+	}
+	else
+	{
+		quality[Secondary] = 0.0;
+	}
+
+	// Blended by quality or the better source alone; while neither has a pose, as before.
+	double total = quality[Primary] + quality[Secondary];
+	double target = weight;
+	if (total > 0.0)
+		target = blending.load(std::memory_order_relaxed) ? quality[Secondary] / total : (quality[Secondary] > quality[Primary] ? 1.0 : 0.0);
+
+	FusionSample out;
+	Nlerp(p.rotation, s.rotation, target, out.rotation);
+	Lerp(p.position, s.position, target, out.position);
+	Lerp(p.velocity, s.velocity, target, out.velocity);
+	Lerp(p.angularVelocity, s.angularVelocity, target, out.angularVelocity);
+	out.timeNs = timeNs;
+	out.valid = total > 0.0;
+
+	// A new weight would move the tracker at once by however far apart the sources are. Instead,
+	// the difference from where the last fused pose was heading is carried over and faded out.
+	if (target != weight && previous.valid)
+	{
+		auto expected = Extrapolate(previous, timeNs);
+		double inverse[4] = { out.rotation[0], -out.rotation[1], -out.rotation[2], -out.rotation[3] };
+		Multiply(expected.rotation, inverse, correctionRotation);
+		for (int i = 0; i < 3; i++)
+			correctionPosition[i] = expected.position[i] - out.position[i];
+		correctionNs = timeNs;
+		correcting = true;
+	}
+	weight = target;
+
+	if (correcting)
+	{
+		double left = 1.0 - (double) (timeNs - correctionNs) * 1e-9 / TransitionSeconds;
+		if (left <= 0.0)
+		{
+			correcting = false;
+		}
+		else
+		{
+			static const double identity[4] = { 1.0, 0.0, 0.0, 0.0 };
+			double correction[4], rotation[4];
+			Nlerp(identity, correctionRotation, left > 1.0 ? 1.0 : left, correction);
+			Multiply(correction, out.rotation, rotation);
+			memcpy(out.rotation, rotation, sizeof rotation);
+			for (int i = 0; i < 3; i++)
+				out.position[i] += (left > 1.0 ? 1.0 : left) * correctionPosition[i];
+		}
+	}
+	if (out.valid)
+		previous = out;
+
+	memset(&fused, 0, sizeof fused);
+	fused.qWorldFromDriverRotation = { 1.0, 0.0, 0.0, 0.0 };
+	fused.qDriverFromHeadRotation = { 1.0, 0.0, 0.0, 0.0 };
+	fused.qRotation = { out.rotation[0], out.rotation[1], out.rotation[2], out.rotation[3] };
+	memcpy(fused.vecPosition, out.position, sizeof out.position);
+	memcpy(fused.vecVelocity, out.velocity, sizeof out.velocity);
+	memcpy(fused.vecAngularVelocity, out.angularVelocity, sizeof out.angularVelocity);
+
+	fused.poseTimeOffset = (double) (timeNs - nowNs) * 1e-9;
+	fused.poseIsValid = out.valid;
+	fused.result = quality[Primary] >= 1.0 || quality[Secondary] >= 1.0 ? vr::TrackingResult_Running_OK : vr::TrackingResult_Running_OutOfRange;
+	fused.deviceIsConnected = true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+// A virtual tracker fused from two devices of different tracking systems that are rigidly
+// attached to each other, such as a lighthouse tracker strapped to an inside-out controller. It
+// reports the primary device's point, from whichever of the two tracks it better, so it rides
+// out one system losing sight of its device without any application knowing.
+//
+// Each source's pose is taken as SteamVR gets it, after the calibration, so both are in the same
+// space. While both track well, the fusion learns where the primary sits on the secondary and
+// keeps refining it, so neither the mounting nor a later calibration has to be measured. Each
+// fused pose blends the two by tracking quality, or switches to the better one. When the weights
+// change, the step that would make in the tracker's pose fades out over TransitionSeconds
+// instead, so the tracker never jumps, even when a source drops out at once.
+//
+// The fused pose is published from the faster source's pose thread, on each of its poses, with
+// the other source's latest pose extrapolated to the same moment by its own velocities; the
+// slower source publishes only once the faster one has missed a few poses. Every fused pose
+// does the same fixed amount of math with no allocation, which driver fusion keeps in check. A
+// source's pose thread stores its pose without locks; the fusion itself is guarded by a flag
+// that a second thread arriving at once skips rather than waits on.
+
+#include "SeqLock.h"
+
+#include <openvr_driver.h>
+
+#include <atomic>
+#include <cstdint>
+
+// A source's latest pose in world space, at the moment it was true.
+struct FusionSample
+{
+	double rotation[4];        // w, x, y, z
+	double position[3];
+	double velocity[3];        // m/s, in world space
+	double angularVelocity[3]; // rad/s, in world space
+	int64_t timeNs;            // on the pose tap's clock
+	int64_t receivedNs;        // when it reached the driver
+	double quality;            // 0 for no pose to 1 for tracking well
+	bool valid;
+};
+
+class FusedTracker
+{
+public:
+	enum { Primary, Secondary, Sources };
+
+	static constexpr double OutOfRangeQuality = 0.25; // of a device its system tracks poorly
+	static constexpr double StaleSeconds = 0.05;      // a source quiet for longer has no pose
+	static const int64_t QuietIntervals = 3;          // missed poses before the slower source publishes
+	static constexpr double TransitionSeconds = 0.1;
+	static constexpr double OffsetRate = 0.02;        // of the offset learned from each fused pose
+
+	FusedTracker();
+
+	// Writers, one at a time. Configure starts learning the offset over; the sources are given
+	// by slot as they register. Stop leaves a disconnected pose for the tracker.
+	void Configure(bool blend);
+	void SetSource(int source, uint32_t openVRID) { ids[source].store(openVRID, std::memory_order_relaxed); }
+	void Stop();
+
+	// Any thread.
+	bool Enabled() const { return enabled.load(std::memory_order_acquire); }
+	uint32_t Source(int source) const { return ids[source].load(std::memory_order_relaxed); }
+	int SourceIndex(uint32_t openVRID) const
+	{
+		if (openVRID >= vr::k_unMaxTrackedDeviceCount)
+			return -1;
+		return Source(Primary) == openVRID ? Primary : Source(Secondary) == openVRID ? Secondary : -1;
+	}
+	vr::DriverPose_t LastPose() const { return last.Load(); }
+
+	// The source's pose thread, with the pose SteamVR got and when it arrived. Returns whether
+	// this call fused a pose to publish.
+	bool Update(uint32_t openVRID, int64_t nowNs, const vr::DriverPose_t &pose, vr::DriverPose_t &fused);
+
+	static double Quality(const vr::DriverPose_t &pose);
+
+private:
+	struct alignas(CacheLineSize) Input
+	{
+		SeqLock<FusionSample> sample;
+		std::atomic<int64_t> intervalNs { 0 }; // average time between poses, 0 until known
+
+		// The source's pose thread's.
+		FusionSample latest;
+		int64_t lastNs = 0;
+	};
+
+	void Fuse(int publisher, const FusionSample &own, const FusionSample &other, int64_t nowNs, vr::DriverPose_t &fused);
+
+	Input inputs[Sources];
+	std::atomic<uint32_t> ids[Sources];
+	std::atomic<bool> enabled { false };
+	std::atomic<bool> blending { true };
+	std::atomic<uint32_t> generation { 0 };
+	std::atomic_flag busy = ATOMIC_FLAG_INIT;
+	SeqLock<vr::DriverPose_t> last; // stored while busy
+
+	// Whichever thread holds busy.
+	uint32_t fusedGeneration = 0;
+	bool offsetKnown = false;
+	double offsetRotation[4] = { 1.0, 0.0, 0.0, 0.0 }; // the primary in the secondary's frame
+	double offsetTranslation[3] = {};
+	double weight = 0.0; // of the secondary
+	FusionSample previous = {}; // the last fused pose with tracking
+	bool correcting = false;
+	double correctionRotation[4], correctionPosition[3]; // fading out from correctionNs
+	int64_t correctionNs = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+// The fused tracker as SteamVR sees it: a generic tracker the driver adds itself, whose poses
+// come from FusedTracker through the pose hook. It has no inputs or components of its own.
+
+#include "FusedTracker.h"
+
+#include <openvr_driver.h>
+#include <atomic>
+
+class FusedTrackerDevice : public vr::ITrackedDeviceServerDriver
+{
+public:
+	static constexpr const char *Serial = "SpaceCalibrator-Fused";
+	static constexpr const char *TrackingSystem = "spacecalibrator";
+
+	explicit FusedTrackerDevice(const FusedTracker &fusion) : fusion(fusion) { }
+
+	// Any thread, invalid until SteamVR activates the device.
+	uint32_t ID() const { return openVRID.load(std::memory_order_acquire); }
+
+	virtual vr::EVRInitError Activate(uint32_t unObjectId) override
+	{
+		auto properties = vr::VRProperties();
+		auto container = properties->TrackedDeviceToPropertyContainer(unObjectId);
+		properties->SetStringProperty(container, vr::Prop_TrackingSystemName_String, TrackingSystem);
+		properties->SetStringProperty(container, vr::Prop_SerialNumber_String, Serial);
+		properties->SetStringProperty(container, vr::Prop_ModelNumber_String, "Fused tracker");
+		properties->SetStringProperty(container, vr::Prop_ManufacturerName_String, "OpenVR-SpaceCalibrator");
+		properties->SetStringProperty(container, vr::Prop_RenderModelName_String, "{htc}vr_tracker_vive_1_0");
+		properties->SetBoolProperty(container, vr::Prop_NeverTracked_Bool, false);
+		openVRID.store(unObjectId, std::memory_order_release);
+		return vr::VRInitError_None;
+	}
+
+	virtual void Deactivate() override { openVRID.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_release); }
+	virtual void EnterStandby() override { }
+	virtual void *GetComponent(const char *) override { return nullptr; }
+
+	virtual void DebugRequest(const char *, char *pchResponseBuffer, uint32_t unResponseBufferSize) override
+	{
+		if (unResponseBufferSize > 0)
+			pchResponseBuffer[0] = '\0';
+	}
+
+	virtual vr::DriverPose_t GetPose() override { return fusion.LastPose(); }
+
+private:
+	const FusedTracker &fusion;
+	std::atomic<uint32_t> openVRID { vr::k_unTrackedDeviceIndexInvalid };
+};
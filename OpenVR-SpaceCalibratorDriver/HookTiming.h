@@ -0,0 +1,131 @@
+#pragma once
+
+// Timing of the pose hook per device: one detour call in SampleEvery is timed with the CPU's
+// cycle counter and counted in a log2 histogram of the device's, which the app reads through the
+// IPC server. A timed call costs two counter reads and one increment, the others one increment.
+// The counter reads alone take 15 ns or more each where a hypervisor traps them, so timing every
+// call would not fit in 20 ns; sampled, timing adds a few nanoseconds per call on average. Nothing
+// is shared between devices, so pose threads never contend.
+//
+// The driver only times its hook when built with POSE_HOOK_TIMING; without it neither the
+// histograms nor the counter reads are compiled in, and the query is not answered.
+//
+// The cycle counter is the time stamp counter on x86, which runs at a constant rate on every CPU
+// SteamVR supports. Its rate is measured against the steady clock over the driver's lifetime
+// rather than assumed. Elsewhere the steady clock in nanoseconds stands in for it.
+
+#include "../Protocol.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HOOK_TIMING_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+inline uint64_t ReadCycleCounter()
+{
+#ifdef HOOK_TIMING_TSC
+	return __rdtsc();
+#else
+	return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// The cycle counter's rate, from how far it and the steady clock have moved since construction.
+class CycleClock
+{
+public:
+	CycleClock() : startCycles(ReadCycleCounter()), startTime(std::chrono::steady_clock::now()) { }
+
+	double CyclesPerNs() const
+	{
+		uint64_t cycles = ReadCycleCounter() - startCycles;
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+		return ns > 0.0 ? (double) cycles / ns : 0.0;
+	}
+
+private:
+	uint64_t startCycles;
+	std::chrono::steady_clock::time_point startTime;
+};
+
+// Bucket b counts durations of 2^(b-1) up to 2^b cycles, bucket 0 those of none; the last bucket
+// also takes everything longer.
+class CycleHistogram
+{
+public:
+	static const uint32_t Buckets = protocol::HookTimingBuckets;
+	static const uint32_t SampleEvery = protocol::HookTimingSampleEvery; // a power of two
+
+	CycleHistogram()
+	{
+		for (auto &bucket : buckets)
+			bucket.store(0, std::memory_order_relaxed);
+	}
+
+	// The device's pose thread only, like the other counters in DeviceSlot. Whether to time this call.
+	bool Sample() { return (++calls & (SampleEvery - 1)) == 0; }
+
+	// The device's pose thread only.
+	void Add(uint64_t cycles)
+	{
+		uint32_t b = BitWidth(cycles);
+		auto &bucket = buckets[b < Buckets ? b : Buckets - 1];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	// Any thread. Buckets are read one by one, so a read racing the pose thread may miss its
+	// latest calls but never counts one twice.
+	void Read(protocol::HookTiming &timing) const
+	{
+		timing.calls = 0;
+		for (uint32_t b = 0; b < Buckets; b++)
+		{
+			timing.buckets[b] = buckets[b].load(std::memory_order_relaxed);
+			timing.calls += timing.buckets[b];
+		}
+	}
+
+	// The upper end of the bucket holding the given fraction of calls, in nanoseconds.
+	static double PercentileNs(const protocol::HookTiming &timing, double fraction)
+	{
+		if (timing.calls == 0 || !(timing.cyclesPerNs > 0.0))
+			return 0.0;
+
+		uint64_t seen = 0, wanted = (uint64_t) (fraction * (double) timing.calls);
+		uint32_t b = 0;
+		for (; b < Buckets - 1; b++)
+		{
+			seen += timing.buckets[b];
+			if (seen > wanted)
+				break;
+		}
+		return (double) (1ull << b) / timing.cyclesPerNs;
+	}
+
+	static uint32_t BitWidth(uint64_t v)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		return _BitScanReverse64(&index, v) ? index + 1 : 0;
+#elif defined(__GNUC__)
+		return v ? 64 - __builtin_clzll(v) : 0;
+#else
+		uint32_t width = 0;
+		for (; v; v >>= 1)
+			width++;
+		return width;
+#endif
+	}
+
+private:
+	std::atomic<uint64_t> buckets[Buckets];
+	uint32_t calls = 0;
+};
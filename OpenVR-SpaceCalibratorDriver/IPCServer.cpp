@@ -4,6 +4,9 @@
 
 void IPCServer::HandleRequest(const protocol::Request &request, protocol::Response &response)
 {
+	// The response buffer is reused per pipe, a request that fails must not answer with the last result.
+	response.type = protocol::ResponseInvalid;
+
 	switch (request.type)
 	{
 	case protocol::RequestHandshake:
@@ -16,6 +19,59 @@ void IPCServer::HandleRequest(const protocol::Request &request, protocol::Respon
 		response.type = protocol::ResponseSuccess;
 		break;
 
+	case protocol::RequestSetSystemTransform:
+		driver->SetSystemTransform(request.setSystemTransform);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestSetMountOffsets:
+		driver->SetMountOffsets(request.setMountOffsets);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestSetMovingPlatform:
+		driver->SetMovingPlatform(request.setMovingPlatform);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestSetSmoothing:
+		driver->SetSmoothing(request.setSmoothing);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestSetTimeOffset:
+		driver->SetTimeOffset(request.setTimeOffset);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestSetStageBudget:
+		driver->SetStageBudget(request.setStageBudget);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestSetFusedTracker:
+		driver->SetFusedTracker(request.setFusedTracker);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestSetPoseTap:
+		driver->SetPoseTap(request.setPoseTap);
+		response.type = protocol::ResponseSuccess;
+		break;
+
+	case protocol::RequestDeviceStats:
+		driver->GetDeviceStats(response.deviceStats);
+		response.type = protocol::ResponseDeviceStats;
+		break;
+
+	case protocol::RequestHookTiming:
+		// Without POSE_HOOK_TIMING the request is refused quietly, the app stops asking after one.
+#ifdef POSE_HOOK_TIMING
+		if (driver->GetHookTiming(request.hookTimingQuery.openVRID, response.hookTiming))
+			response.type = protocol::ResponseHookTiming;
+#endif
+		break;
+
 	default:
 		LOG("Invalid IPC request: %d", request.type);
 		break;
@@ -8,17 +8,27 @@ static ServerTrackedDeviceProvider *Driver = nullptr;
 static Hook<void*(*)(vr::IVRDriverContext *, const char *, vr::EVRInitError *)> 
 	GetGenericInterfaceHook("IVRDriverContext::GetGenericInterface");
 
+static Hook<bool(*)(vr::IVRServerDriverHost *, const char *, vr::ETrackedDeviceClass, vr::ITrackedDeviceServerDriver *)>
+	TrackedDeviceAddedHook("IVRServerDriverHost005::TrackedDeviceAdded");
+
 static Hook<void(*)(vr::IVRServerDriverHost *, uint32_t, const vr::DriverPose_t &, uint32_t)>
 	TrackedDevicePoseUpdatedHook("IVRServerDriverHost005::TrackedDevicePoseUpdated");
 
+static bool DetourTrackedDeviceAdded(vr::IVRServerDriverHost *_this, const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver *pDriver)
+{
+	TRACE("ServerTrackedDeviceProvider::DetourTrackedDeviceAdded(%s, %d)", pchDeviceSerialNumber, eDeviceClass);
+
+	// The slot is not known until the device's first pose, which asks for it to be registered.
+	if (pchDeviceSerialNumber)
+		Driver->DeviceAdded(pchDeviceSerialNumber);
+
+	return TrackedDeviceAddedHook.originalFunc(_this, pchDeviceSerialNumber, eDeviceClass, pDriver);
+}
+
 static void DetourTrackedDevicePoseUpdated(vr::IVRServerDriverHost *_this, uint32_t unWhichDevice, const vr::DriverPose_t &newPose, uint32_t unPoseStructSize)
 {
 	//TRACE("ServerTrackedDeviceProvider::DetourTrackedDevicePoseUpdated(%d)", unWhichDevice);
-	auto pose = newPose;
-	if (Driver->HandleDevicePoseUpdated(unWhichDevice, pose))
-	{
-		TrackedDevicePoseUpdatedHook.originalFunc(_this, unWhichDevice, pose, unPoseStructSize);
-	}
+	Driver->PoseUpdated(_this, unWhichDevice, newPose, unPoseStructSize, TrackedDevicePoseUpdatedHook.originalFunc);
 }
 
 static void *DetourGetGenericInterface(vr::IVRDriverContext *_this, const char *pchInterfaceVersion, vr::EVRInitError *peError)
@@ -29,6 +39,12 @@ static void *DetourGetGenericInterface(vr::IVRDriverContext *_this, const char *
 	std::string iface(pchInterfaceVersion);
 	if (iface == "IVRServerDriverHost_005")
 	{
+		if (!IHook::Exists(TrackedDeviceAddedHook.name))
+		{
+			TrackedDeviceAddedHook.CreateHookInObjectVTable(originalInterface, 0, &DetourTrackedDeviceAdded);
+			IHook::Register(&TrackedDeviceAddedHook);
+		}
+
 		if (!IHook::Exists(TrackedDevicePoseUpdatedHook.name))
 		{
 			TrackedDevicePoseUpdatedHook.CreateHookInObjectVTable(originalInterface, 1, &DetourTrackedDevicePoseUpdated);
@@ -55,6 +71,14 @@ void InjectHooks(ServerTrackedDeviceProvider *driver, vr::IVRDriverContext *pDri
 	}
 }
 
+void PublishPose(uint32_t openVRID, const vr::DriverPose_t &pose)
+{
+	if (IHook::Exists(TrackedDevicePoseUpdatedHook.name))
+		TrackedDevicePoseUpdatedHook.originalFunc(vr::VRServerDriverHost(), openVRID, pose, sizeof pose);
+	else
+		vr::VRServerDriverHost()->TrackedDevicePoseUpdated(openVRID, pose, sizeof pose);
+}
+
 void DisableHooks()
 {
 	IHook::DestroyAll();
@@ -7,4 +7,7 @@ class ServerTrackedDeviceProvider;
 static void DetourTrackedDevicePoseUpdated(vr::IVRServerDriverHost * _this, uint32_t unWhichDevice, const vr::DriverPose_t & newPose, uint32_t unPoseStructSize);
 
 void InjectHooks(ServerTrackedDeviceProvider *driver, vr::IVRDriverContext *pDriverContext);
-void DisableHooks();
\ No newline at end of file
+void DisableHooks();
+
+// Sends SteamVR a pose of a device of the driver's own, bypassing the pose hook.
+void PublishPose(uint32_t openVRID, const vr::DriverPose_t &pose);
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "MovingPlatform.h"
+#include "QuaternionMath.h"
+
+#include <cmath>
+
+void LatestPoseCache::Store(uint32_t openVRID, const vr::DriverPose_t &pose)
+{
+	if (openVRID >= vr::k_unMaxTrackedDeviceCount || !pose.poseIsValid)
+		return;
+
+	auto &w = pose.qWorldFromDriverRotation;
+	auto &r = pose.qRotation;
+	double world[4] = { w.w, w.x, w.y, w.z }, rotation[4] = { r.w, r.x, r.y, r.z };
+
+	CachedPose cached;
+	Multiply(world, rotation, cached.rotation);
+	Rotate(world, pose.vecPosition, cached.position);
+	for (int i = 0; i < 3; i++)
+		cached.position[i] += pose.vecWorldFromDriverTranslation[i];
+	cached.valid = true;
+
+	slots[openVRID].pose.Store(cached);
+}
+
+void MovingPlatform::Arm(uint32_t platformID)
+{
+	device.store(platformID, std::memory_order_relaxed);
+	pending.store(true, std::memory_order_release);
+}
+
+void MovingPlatform::Anchor(const CachedPose &platform, const vr::HmdVector3d_t &translation, const vr::HmdQuaternion_t &rotation)
+{
+	double q[4] = { rotation.w, rotation.x, rotation.y, rotation.z };
+	double norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	for (auto &c : q)
+		c = norm > 0.0 ? c / norm : 0.0;
+	if (norm == 0.0)
+		q[0] = 1.0;
+
+	// platform⁻¹ · transform: the inverse rotation is the conjugate, its translation -R⁻¹ t.
+	const auto &p = platform.rotation;
+	double inverse[4] = { p[0], -p[1], -p[2], -p[3] };
+	double offset[3] = { translation.v[0] - platform.position[0], translation.v[1] - platform.position[1], translation.v[2] - platform.position[2] };
+
+	AnchorTransform a;
+	Multiply(inverse, q, a.rotation);
+	Rotate(inverse, offset, a.translation);
+	anchor.Store(a);
+
+	pending.store(false, std::memory_order_release);
+}
+
+void MovingPlatform::Stop()
+{
+	followers.store(0, std::memory_order_release);
+	pending.store(false, std::memory_order_relaxed);
+	device.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_relaxed);
+}
+
+bool MovingPlatform::Apply(const LatestPoseCache &cache, vr::DriverPose_t &pose) const
+{
+	uint32_t platformID = Device();
+	if (platformID >= vr::k_unMaxTrackedDeviceCount)
+		return false;
+
+	auto platform = cache.Load(platformID);
+	if (!platform.valid)
+		return false;
+
+	// The live transform is platform · anchor, then applied like any calibration transform.
+	auto a = anchor.Load();
+	double rotation[4], translation[3];
+	Multiply(platform.rotation, a.rotation, rotation);
+	Rotate(platform.rotation, a.translation, translation);
+	for (int i = 0; i < 3; i++)
+		translation[i] += platform.position[i];
+
+	auto &q = pose.qWorldFromDriverRotation;
+	double world[4] = { q.w, q.x, q.y, q.z }, moved[4], position[3];
+	Multiply(rotation, world, moved);
+	Rotate(rotation, pose.vecWorldFromDriverTranslation, position);
+
+	q = { moved[0], moved[1], moved[2], moved[3] };
+	for (int i = 0; i < 3; i++)
+		pose.vecWorldFromDriverTranslation[i] = position[i] + translation[i];
+	return true;
+}
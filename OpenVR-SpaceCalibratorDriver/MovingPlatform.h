@@ -0,0 +1,83 @@
+#pragma once
+
+// Moving-platform mode: a tracking system's transform that follows a device on a moving platform,
+// such as a tracker on a motion rig or in a vehicle, when the whole tracking system moves with it.
+//
+// When the platform is anchored, the system's transform at that moment is kept relative to the
+// platform device's pose at that moment, anchor = platform⁻¹ · transform. From then on every pose
+// of a following device gets the platform's latest pose composed with the anchor, so the system
+// moves with the platform without waiting for the app.
+//
+// The platform's pose comes from LatestPoseCache, which its pose thread writes and the followers'
+// pose threads read without locks.
+
+#include "SeqLock.h"
+
+#include <openvr_driver.h>
+
+#include <atomic>
+#include <cstdint>
+
+// A device's pose in its tracking space: the driver's pose moved by its world-from-driver
+// transform. The driver-from-head offset is left out, as a platform anchor absorbs it.
+struct CachedPose
+{
+	double rotation[4]; // w, x, y, z
+	double position[3];
+	bool valid;
+};
+
+// The latest valid pose of each device slot.
+class LatestPoseCache
+{
+public:
+	// The device's pose thread only. Invalid poses are not stored, so the last valid one stays.
+	void Store(uint32_t openVRID, const vr::DriverPose_t &pose);
+
+	// Any thread.
+	CachedPose Load(uint32_t openVRID) const { return slots[openVRID].pose.Load(); }
+
+private:
+	struct alignas(CacheLineSize) Slot
+	{
+		SeqLock<CachedPose> pose;
+	};
+
+	Slot slots[vr::k_unMaxTrackedDeviceCount];
+};
+
+class MovingPlatform
+{
+public:
+	// Writers, one at a time. Arm picks the platform device and asks for an anchor from its next
+	// pose; followers keep any previous anchor until then.
+	void Arm(uint32_t platformID);
+	void Anchor(const CachedPose &platform, const vr::HmdVector3d_t &translation, const vr::HmdQuaternion_t &rotation);
+	void SetFollowers(uint64_t mask) { followers.store(mask, std::memory_order_release); }
+	void Stop();
+
+	// Any thread.
+	uint32_t Device() const { return device.load(std::memory_order_relaxed); }
+	bool AnchorPending() const { return pending.load(std::memory_order_acquire); }
+	bool Following() const { return followers.load(std::memory_order_acquire) != 0; }
+	bool Follows(uint32_t openVRID) const
+	{
+		return openVRID < vr::k_unMaxTrackedDeviceCount && (followers.load(std::memory_order_acquire) >> openVRID) & 1;
+	}
+
+	// Pose threads. Moves a follower's pose by the platform's latest pose composed with the
+	// anchor. Returns false, leaving the pose alone, while the platform has no pose.
+	bool Apply(const LatestPoseCache &cache, vr::DriverPose_t &pose) const;
+
+private:
+	struct AnchorTransform
+	{
+		double rotation[4]; // w, x, y, z
+		double translation[3];
+	};
+
+	SeqLock<AnchorTransform> anchor;
+	std::atomic<uint32_t> device { vr::k_unTrackedDeviceIndexInvalid };
+	std::atomic<bool> pending { false };
+	std::atomic<uint64_t> followers { 0 };
+};
@@ -0,0 +1,120 @@
+#include "PoseFilter.h"
+
+#include <cmath>
+
+static const double TwoPi = 6.283185307179586;
+
+// Weight of a new sample in a first order low-pass at the cutoff, dt after the last one.
+static double Alpha(double cutoffHz, double dt)
+{
+	double r = TwoPi * cutoffHz * dt;
+	return r / (r + 1.0);
+}
+
+void PoseFilter::Configure(const SmoothingSettings &newSettings)
+{
+	Settings s;
+	s.smoothing = newSettings;
+	s.smoothing.enabled = newSettings.enabled && newSettings.minCutoffHz > 0.0 && newSettings.beta >= 0.0;
+	s.generation = ++generation;
+	settings.Store(s);
+	enabled.store(s.smoothing.enabled, std::memory_order_relaxed);
+}
+
+void PoseFilter::Restart(double timeSeconds, const vr::DriverPose_t &pose)
+{
+	auto &q = pose.qRotation;
+	for (int i = 0; i < 3; i++)
+	{
+		position[i] = pose.vecPosition[i];
+		velocity[i] = 0.0;
+		angularVelocity[i] = 0.0;
+	}
+	rotation[0] = q.w; rotation[1] = q.x; rotation[2] = q.y; rotation[3] = q.z;
+	lastTime = timeSeconds;
+	primed = true;
+}
+
+void PoseFilter::Apply(double timeSeconds, vr::DriverPose_t &pose)
+{
+	auto s = settings.Load();
+	if (!s.smoothing.enabled)
+		return;
+
+	if (!pose.poseIsValid)
+	{
+		primed = false;
+		return;
+	}
+
+	double dt = timeSeconds - lastTime;
+	if (!primed || s.generation != appliedGeneration || dt <= 0.0 || dt > MaxGapSeconds)
+	{
+		appliedGeneration = s.generation;
+		Restart(timeSeconds, pose);
+		return;
+	}
+	lastTime = timeSeconds;
+
+	double derivative = Alpha(DerivativeCutoffHz, dt), rate = 1.0 / dt;
+
+	// Position: the estimated velocity is the filtered step from the last output.
+	double step[3], speed2 = 0.0, reported2 = 0.0;
+	for (int i = 0; i < 3; i++)
+	{
+		step[i] = pose.vecPosition[i] - position[i];
+		velocity[i] += derivative * (step[i] * rate - velocity[i]);
+		speed2 += velocity[i] * velocity[i];
+		reported2 += pose.vecVelocity[i] * pose.vecVelocity[i];
+	}
+
+	// Rotation: the step from the last output is conj(last) * new, whose vector part is half the
+	// rotation vector for the small steps between poses.
+	auto &q = pose.qRotation;
+	double r[4] = { q.w, q.x, q.y, q.z };
+	if (r[0] * rotation[0] + r[1] * rotation[1] + r[2] * rotation[2] + r[3] * rotation[3] < 0.0)
+	{
+		for (auto &c : r)
+			c = -c;
+	}
+
+	const double *p = rotation;
+	double delta[3] = {
+		p[0] * r[1] - p[1] * r[0] - p[2] * r[3] + p[3] * r[2],
+		p[0] * r[2] + p[1] * r[3] - p[2] * r[0] - p[3] * r[1],
+		p[0] * r[3] - p[1] * r[2] + p[2] * r[1] - p[3] * r[0]
+	};
+
+	double angularSpeed2 = 0.0, reportedAngular2 = 0.0;
+	for (int i = 0; i < 3; i++)
+	{
+		angularVelocity[i] += derivative * (2.0 * rate * delta[i] - angularVelocity[i]);
+		angularSpeed2 += angularVelocity[i] * angularVelocity[i];
+		reportedAngular2 += pose.vecAngularVelocity[i] * pose.vecAngularVelocity[i];
+	}
+
+	// Alpha for both cutoffs with one division between them, which the pose path waits on.
+	double scale = TwoPi * dt;
+	double ra = scale * (s.smoothing.minCutoffHz + s.smoothing.beta * std::sqrt(speed2 > reported2 ? speed2 : reported2));
+	double rb = scale * (s.smoothing.minCutoffHz + s.smoothing.beta * std::sqrt(angularSpeed2 > reportedAngular2 ? angularSpeed2 : reportedAngular2));
+	double inverse = 1.0 / ((ra + 1.0) * (rb + 1.0));
+	double a = ra * (rb + 1.0) * inverse, b = rb * (ra + 1.0) * inverse;
+
+	for (int i = 0; i < 3; i++)
+	{
+		position[i] += a * step[i];
+		pose.vecPosition[i] = position[i];
+	}
+
+	double norm2 = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		rotation[i] += b * (r[i] - rotation[i]);
+		norm2 += rotation[i] * rotation[i];
+	}
+
+	double inverseNorm = 1.0 / std::sqrt(norm2);
+	for (auto &c : rotation)
+		c *= inverseNorm;
+	q = { rotation[0], rotation[1], rotation[2], rotation[3] };
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// Optional smoothing of one device's pose, a One-Euro filter: a low-pass filter whose cutoff
+// rises with the device's speed, so a device at rest is smoothed heavily and a moving one hardly
+// lags. Meant for trackers whose own tracking system jitters visibly next to the HMD's once
+// calibrated into its space.
+//
+// The filter works on the pose's position and rotation in the driver's space, before any
+// transform, which moves both rigidly and so does not change what the filter sees. Velocities
+// are left alone, so SteamVR keeps predicting with the device's own. The speed that sets the
+// cutoff is the larger of the device's reported velocity and the filter's own estimate, so the
+// cutoff rises from the first pose of a motion even though the estimate takes a while to follow.
+//
+// Every call does the same fixed amount of math, about a hundred floating point operations with
+// no history to walk and no allocation, which bench and driver smoothing keep in check. A device
+// that loses tracking, or whose poses stop for longer than MaxGapSeconds, starts over from its
+// next pose rather than sliding back into place.
+//
+// The state lives in the device's DeviceSlot and belongs to its pose thread; the settings may be
+// changed from any thread, one at a time.
+
+#include "SeqLock.h"
+
+#include <openvr_driver.h>
+
+#include <atomic>
+#include <cstdint>
+
+struct SmoothingSettings
+{
+	bool enabled = false;
+	double minCutoffHz = 1.0; // cutoff at rest
+	double beta = 50.0;       // cutoff added per meter per second, or per radian per second of rotation
+};
+
+class PoseFilter
+{
+public:
+	static constexpr double DerivativeCutoffHz = 1.0;
+	static constexpr double MaxGapSeconds = 0.25;
+
+	// Any thread, one at a time. The filter starts over from the next pose. Settings with a
+	// cutoff that is not positive or a negative beta disable it.
+	void Configure(const SmoothingSettings &newSettings);
+	bool Enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+	// The device's pose thread. timeSeconds is when the pose arrived, on a steady clock.
+	void Apply(double timeSeconds, vr::DriverPose_t &pose);
+
+private:
+	struct Settings
+	{
+		SmoothingSettings smoothing;
+		uint32_t generation;
+	};
+
+	void Restart(double timeSeconds, const vr::DriverPose_t &pose);
+
+	SeqLock<Settings> settings;
+	std::atomic<bool> enabled { false };
+	uint32_t generation = 0; // Configure's thread
+
+	// The pose thread's.
+	bool primed = false;
+	uint32_t appliedGeneration = 0;
+	double lastTime = 0.0;
+	double position[3] = {};
+	double velocity[3] = {};        // filtered estimate, m/s
+	double rotation[4] = { 1.0, 0.0, 0.0, 0.0 }; // w, x, y, z
+	double angularVelocity[3] = {}; // filtered estimate, rad/s
+};
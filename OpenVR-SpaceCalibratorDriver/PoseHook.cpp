@@ -0,0 +1,105 @@
+#include "PoseHook.h"
+
+bool PoseHook::HandleDevicePoseUpdated(uint32_t openVRID, int64_t nowNs, vr::DriverPose_t &pose)
+{
+	// Smoothed in the driver's space, before the transform moves it.
+	auto &device = devices[openVRID];
+	uint32_t stages = device.Stages();
+	if (stages & StageSmoothing)
+		device.filter.Apply(nowNs * 1e-9, pose);
+
+	// A follower's transform is the platform's, recomposed from its latest pose, in place of the
+	// fixed one; its mount offset still applies.
+	bool transformed;
+	if (FollowsPlatform(openVRID) && platform.Apply(poseCache, pose))
+	{
+		transforms.ApplyMount(openVRID, pose);
+		transformed = true;
+	}
+	else
+	{
+		transformed = transforms.Apply(openVRID, pose);
+	}
+
+	if (stages & StageTimeOffset)
+		device.CompensateLatency(pose);
+
+	device.CountPose(transformed);
+	return true;
+}
+
+void PoseHook::TapPose(int64_t timestampNs, uint32_t openVRID, const vr::DriverPose_t &before, const vr::DriverPose_t &after, bool forwarded)
+{
+	uint32_t flags = (HasDeviceTransform(openVRID) ? (uint32_t) PoseTapTransformed : 0u) | (forwarded ? (uint32_t) PoseTapForwarded : 0u);
+	poseTap.Record(timestampNs, openVRID, flags, before, after);
+}
+
+void PoseHook::JudgeStages(uint32_t openVRID, uint64_t cycles, bool tapped)
+{
+	auto &device = devices[openVRID];
+	double cyclesPerNs = cycleClock.CyclesPerNs();
+	if (!(cyclesPerNs > 0.0))
+		return;
+
+	uint32_t active = device.Stages() | (tapped ? (uint32_t) StageTap : 0u) | (FollowsPlatform(openVRID) ? (uint32_t) StagePlatform : 0u);
+	double budgetNs = stageBudgetNs.load(std::memory_order_relaxed), averageCycles;
+	uint32_t stage = device.watchdog.Judge(cycles, budgetNs * cyclesPerNs, active, averageCycles);
+	if (!stage)
+		return;
+
+	device.Degrade(stage);
+	StageTurnedOff(openVRID, stage, averageCycles / cyclesPerNs, budgetNs);
+}
+
+// From the platform's pose thread, once per anchor.
+void PoseHook::AnchorPlatform(uint32_t openVRID)
+{
+	std::lock_guard<std::mutex> lock(transformWriter);
+	if (!platform.AnchorPending() || platform.Device() != openVRID)
+		return;
+
+	auto pose = poseCache.Load(openVRID);
+	if (!pose.valid)
+		return;
+
+	// Without an enabled transform there is nothing to carry along, and the followers go back to
+	// theirs until the app sets one, which anchors the platform again.
+	RegisteredTransform tf;
+	bool enabled = registry.SystemTransform(platformSystem, tf) && tf.enabled;
+	platform.Anchor(pose, tf.translation, tf.rotation);
+	platform.SetFollowers(enabled ? registry.SystemTransformDevices(platformSystem) : 0);
+	PlatformAnchored(enabled);
+}
+
+void PoseHook::ApplyDeviceTransform(const protocol::SetDeviceTransform &newTransform)
+{
+	transforms.Set(newTransform);
+
+	// The app wants exactly this transform on the device's raw pose, with no platform, smoothing
+	// or time offset on top, until it sets the tracking system's transform again.
+	if (newTransform.openVRID < vr::k_unMaxTrackedDeviceCount)
+		devices[newTransform.openVRID].overridden.store(true, std::memory_order_relaxed);
+}
+
+int PoseHook::ApplySystemTransform(const std::string &trackingSystem, const RegisteredTransform &tf)
+{
+	registry.SetSystemTransform(trackingSystem, tf);
+
+	uint64_t ids = registry.SystemTransformDevices(trackingSystem);
+	int count = 0;
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		if ((ids >> id) & 1)
+		{
+			transforms.Set(protocol::SetDeviceTransform(id, tf.enabled, tf.translation, tf.rotation));
+			devices[id].overridden.store(false, std::memory_order_relaxed);
+			count++;
+		}
+	}
+
+	// A platform carrying the system anchors again with its next pose, to carry the new transform.
+	if (trackingSystem == platformSystem && platform.Device() != vr::k_unTrackedDeviceIndexInvalid)
+		platform.Arm(platform.Device());
+
+	return count;
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+// What the driver does with each pose SteamVR's drivers send it: the body of the detour on
+// IVRServerDriverHost::TrackedDevicePoseUpdated, and the state its pose threads read. Nothing here
+// needs Windows, MinHook or SteamVR itself, so the tools run the same code with a fake host.
+//
+// ServerTrackedDeviceProvider derives from it and adds the IPC server, registration from SteamVR's
+// device properties and the app's requests, which it writes into the state below under
+// transformWriter.
+
+#include "DeviceRegistry.h"
+#include "DeviceSlot.h"
+#include "FusedTracker.h"
+#include "FusedTrackerDevice.h"
+#include "HookTiming.h"
+#include "MovingPlatform.h"
+#include "PoseTap.h"
+#include "TransformTable.h"
+
+#include <openvr_driver.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+// The host's own TrackedDevicePoseUpdated, which the hook passes poses on to: the hooked
+// function's original in the driver, the fake host's in the tools.
+typedef void (*PoseForward)(vr::IVRServerDriverHost *host, uint32_t openVRID, const vr::DriverPose_t &pose, uint32_t poseSize);
+
+class PoseHook
+{
+public:
+	PoseHook() : fusedDevice(fusion) { }
+	virtual ~PoseHook() { }
+
+#ifdef POSE_HOOK_TIMING
+	static const bool TimesHook = true;
+#else
+	static const bool TimesHook = false;
+#endif
+
+	// The detour's body, on the device's pose thread. With POSE_HOOK_TIMING, Timed times a sample
+	// of calls for the app; the tools also run it untimed to see what timing costs.
+	template <bool Timed = TimesHook>
+	void PoseUpdated(vr::IVRServerDriverHost *host, uint32_t openVRID, const vr::DriverPose_t &newPose, uint32_t poseSize, PoseForward forward);
+
+	// nowNs is the pose tap's clock when the pose arrived, read by PoseUpdated whenever a stage
+	// needs it.
+	bool HandleDevicePoseUpdated(uint32_t openVRID, int64_t nowNs, vr::DriverPose_t &pose);
+
+	// Whether the device's poses go through HandleDevicePoseUpdated: a transform, a platform to
+	// follow or an optional stage.
+	bool HasDeviceTransform(uint32_t openVRID) const
+	{
+		return transforms.Enabled(openVRID) || FollowsPlatform(openVRID) || (openVRID < vr::k_unMaxTrackedDeviceCount && devices[openVRID].Stages());
+	}
+
+	// Whether HandleDevicePoseUpdated smooths the device's poses, and so needs the time.
+	bool SmoothsPose(uint32_t openVRID) const
+	{
+		return openVRID < vr::k_unMaxTrackedDeviceCount && (devices[openVRID].Stages() & StageSmoothing);
+	}
+
+	// Unless the watchdog turned it off for the device, or the app's own transform for it is in place.
+	bool FollowsPlatform(uint32_t openVRID) const
+	{
+		return platform.Follows(openVRID) && !(devices[openVRID].Degraded() & StagePlatform) && !devices[openVRID].Overridden();
+	}
+
+	// Caches the platform device's poses for the devices following it, and anchors the platform
+	// from its first pose after the app set it or the transform it carries.
+	void TrackPlatform(uint32_t openVRID, const vr::DriverPose_t &pose)
+	{
+		if (openVRID != platform.Device())
+			return;
+
+		poseCache.Store(openVRID, pose);
+		if (platform.AnchorPending())
+			AnchorPlatform(openVRID);
+	}
+
+	// Asks for a device to be registered from its first pose. The pose thread only marks the slot;
+	// the provider's RunFrame reads its properties, gives it the transform of its tracking system,
+	// or the driver's copy of the profile until the app takes over, and marks it registered.
+	void RegisterDevice(uint32_t openVRID)
+	{
+		if (openVRID >= vr::k_unMaxTrackedDeviceCount || devices[openVRID].registered.load(std::memory_order_acquire))
+			return;
+
+		uint64_t bit = 1ull << openVRID;
+		if (!(registrationPending.load(std::memory_order_relaxed) & bit))
+			registrationPending.fetch_or(bit, std::memory_order_release);
+	}
+
+	// For poses that bypass HandleDevicePoseUpdated, which counts its own.
+	void CountUntransformedPose(uint32_t openVRID)
+	{
+		if (openVRID < vr::k_unMaxTrackedDeviceCount)
+			devices[openVRID].CountPose(false);
+	}
+
+	// Whether the device is a source of the fused tracker.
+	bool FusesPose(uint32_t openVRID) const { return fusion.SourceIndex(openVRID) >= 0; }
+
+	// The source's pose thread, with the pose as SteamVR got it. Returns whether to publish a
+	// fused pose for the tracker, which is in SteamVR's slot fusedID.
+	bool FusePose(uint32_t openVRID, int64_t timestampNs, const vr::DriverPose_t &pose, uint32_t &fusedID, vr::DriverPose_t &fused)
+	{
+		fusedID = fusedDevice.ID();
+		return fusedID < vr::k_unMaxTrackedDeviceCount && fusion.Update(openVRID, timestampNs, pose, fused);
+	}
+
+	bool PoseTapEnabled(uint32_t openVRID) const
+	{
+		return poseTap.Enabled() && (openVRID >= vr::k_unMaxTrackedDeviceCount || !(devices[openVRID].Degraded() & StageTap));
+	}
+	void TapPose(int64_t timestampNs, uint32_t openVRID, const vr::DriverPose_t &before, const vr::DriverPose_t &after, bool forwarded);
+
+	// Profiling starts with the first stats query, so it costs nothing while the app is not running.
+	bool ProfilingEnabled() const { return profiling.load(std::memory_order_relaxed); }
+	void ProfilePose(int64_t timestampNs, uint32_t openVRID, const vr::DriverPose_t &pose) { devices[openVRID].profiler.AddPose(timestampNs, pose); }
+
+	// Whether the watchdog times this call of the device's. See StageWatchdog.
+	bool WatchStages(uint32_t openVRID)
+	{
+		return openVRID < vr::k_unMaxTrackedDeviceCount && stageBudgetNs.load(std::memory_order_relaxed) > 0.0 && devices[openVRID].watchdog.Sample();
+	}
+	void JudgeStages(uint32_t openVRID, uint64_t cycles, bool tapped);
+
+#ifdef POSE_HOOK_TIMING
+	bool SampleHookTiming(uint32_t openVRID)
+	{
+		return openVRID < vr::k_unMaxTrackedDeviceCount && devices[openVRID].hookCycles.Sample();
+	}
+	void TimeHook(uint32_t openVRID, uint64_t cycles)
+	{
+		if (openVRID < vr::k_unMaxTrackedDeviceCount)
+			devices[openVRID].hookCycles.Add(cycles);
+	}
+#endif
+
+protected:
+	// Guarded by transformWriter. The app's own transform for one device, which takes it off its
+	// system's transform and the stages that would move it away from the raw pose.
+	void ApplyDeviceTransform(const protocol::SetDeviceTransform &newTransform);
+
+	// Guarded by transformWriter. A tracking system's transform, for its registered devices and
+	// those registering later. Returns how many were registered.
+	int ApplySystemTransform(const std::string &trackingSystem, const RegisteredTransform &tf);
+
+	// What the provider logs: the platform anchored from its pose thread, with transformWriter
+	// held, and the watchdog turning a stage off for a device from the device's pose thread.
+	virtual void PlatformAnchored(bool followed) = 0;
+	virtual void StageTurnedOff(uint32_t openVRID, uint32_t stage, double averageNs, double budgetNs) = 0;
+
+	TransformTable transforms;
+
+	// Serializes TransformTable::Set and the registry between the IPC thread, RunFrame registering
+	// devices, SteamVR adding them and the platform's pose thread anchoring it.
+	std::mutex transformWriter;
+	DeviceRegistry registry;
+
+	LatestPoseCache poseCache;
+	MovingPlatform platform;
+	std::string platformSystem; // guarded by transformWriter
+
+	FusedTracker fusion;
+	FusedTrackerDevice fusedDevice;
+
+	// Slots whose pose thread asked for registration, one bit per slot.
+	static_assert(vr::k_unMaxTrackedDeviceCount <= 64, "one pending bit per slot");
+	std::atomic<uint64_t> registrationPending { 0 };
+
+	PoseTap poseTap;
+
+	std::atomic<bool> profiling { false };
+	std::atomic<double> stageBudgetNs { protocol::DefaultStageBudgetNs };
+	CycleClock cycleClock;
+	DeviceSlot devices[vr::k_unMaxTrackedDeviceCount];
+
+private:
+	void AnchorPlatform(uint32_t openVRID);
+
+	// Fuses the source's pose as SteamVR got it into the fused tracker's, which goes to SteamVR
+	// directly rather than through the hook again.
+	void PublishFusedPose(vr::IVRServerDriverHost *host, uint32_t openVRID, int64_t nowNs, const vr::DriverPose_t &pose, PoseForward forward)
+	{
+		uint32_t fusedID;
+		vr::DriverPose_t fused;
+		if (FusePose(openVRID, nowNs, pose, fusedID, fused))
+			forward(host, fusedID, fused, sizeof fused);
+	}
+};
+
+// Times a sampled PoseUpdated call from its construction to the call's return, whichever way it
+// returns. Does nothing untimed.
+template <bool Timed>
+class ScopedHookTimer
+{
+public:
+	ScopedHookTimer(PoseHook &, uint32_t) { }
+};
+
+#ifdef POSE_HOOK_TIMING
+template <>
+class ScopedHookTimer<true>
+{
+public:
+	ScopedHookTimer(PoseHook &hook, uint32_t openVRID) : hook(hook), openVRID(openVRID), sampled(hook.SampleHookTiming(openVRID)), start(sampled ? ReadCycleCounter() : 0) { }
+	~ScopedHookTimer()
+	{
+		if (sampled)
+			hook.TimeHook(openVRID, ReadCycleCounter() - start);
+	}
+
+private:
+	PoseHook &hook;
+	uint32_t openVRID;
+	bool sampled;
+	uint64_t start;
+};
+#endif
+
+template <bool Timed>
+void PoseHook::PoseUpdated(vr::IVRServerDriverHost *host, uint32_t openVRID, const vr::DriverPose_t &newPose, uint32_t poseSize, PoseForward forward)
+{
+	ScopedHookTimer<Timed> timer(*this, openVRID);
+	bool tap = PoseTapEnabled(openVRID), profile = ProfilingEnabled(), fuse = FusesPose(openVRID);
+	int64_t now = tap || profile || fuse || SmoothsPose(openVRID) ? PoseTap::Now() : 0;
+
+	RegisterDevice(openVRID);
+	TrackPlatform(openVRID, newPose);
+
+	// The watchdog times the driver's own part of a sample of calls, leaving out SteamVR's.
+	bool watched = WatchStages(openVRID);
+
+	// Devices without a transform get SteamVR's own pose back, uncopied.
+	if (!HasDeviceTransform(openVRID))
+	{
+		forward(host, openVRID, newPose, poseSize);
+		CountUntransformedPose(openVRID);
+
+		// Only fusing and recording add to these calls.
+		bool timed = watched && (tap || profile || fuse);
+		uint64_t start = timed ? ReadCycleCounter() : 0;
+		if (fuse)
+			PublishFusedPose(host, openVRID, now, newPose, forward);
+		if (profile)
+			ProfilePose(now, openVRID, newPose);
+		if (tap)
+			TapPose(now, openVRID, newPose, newPose, true);
+		if (timed)
+			JudgeStages(openVRID, ReadCycleCounter() - start, tap);
+		return;
+	}
+
+	uint64_t start = watched ? ReadCycleCounter() : 0;
+	auto pose = newPose;
+	bool forwarded = HandleDevicePoseUpdated(openVRID, now, pose);
+	uint64_t own = watched ? ReadCycleCounter() - start : 0;
+	if (forwarded)
+		forward(host, openVRID, pose, poseSize);
+
+	// Fused and recorded after SteamVR has the pose, so none of them adds to its latency.
+	if (watched)
+		start = ReadCycleCounter();
+	if (fuse && forwarded)
+		PublishFusedPose(host, openVRID, now, pose, forward);
+	if (profile)
+		ProfilePose(now, openVRID, newPose);
+	if (tap)
+		TapPose(now, openVRID, newPose, pose, forwarded);
+	if (watched)
+		JudgeStages(openVRID, own + ReadCycleCounter() - start, tap);
+}
@@ -0,0 +1,223 @@
+#include "PoseKernel.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define POSE_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles intrinsics for any instruction set; GCC and Clang need the function marked.
+#if defined(POSE_KERNEL_X86) && !defined(_MSC_VER)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+PoseTransform IdentityPoseTransform()
+{
+	PoseTransform tf;
+	memset(&tf, 0, sizeof tf);
+	SetPoseTransformRotation(tf, { 1.0, 0.0, 0.0, 0.0 });
+	return tf;
+}
+
+void SetPoseTransformRotation(PoseTransform &tf, const vr::HmdQuaternion_t &rotation)
+{
+	auto q = rotation;
+	double norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+	if (norm > 0.0)
+		q = { q.w / norm, q.x / norm, q.y / norm, q.z / norm };
+	else
+		q = { 1.0, 0.0, 0.0, 0.0 };
+
+	tf.rotation[0] = q.w;
+	tf.rotation[1] = q.x;
+	tf.rotation[2] = q.y;
+	tf.rotation[3] = q.z;
+
+	auto &c = tf.columns;
+	c[0][0] = 1.0 - 2.0 * (q.y * q.y + q.z * q.z);
+	c[0][1] = 2.0 * (q.x * q.y + q.w * q.z);
+	c[0][2] = 2.0 * (q.x * q.z - q.w * q.y);
+	c[1][0] = 2.0 * (q.x * q.y - q.w * q.z);
+	c[1][1] = 1.0 - 2.0 * (q.x * q.x + q.z * q.z);
+	c[1][2] = 2.0 * (q.y * q.z + q.w * q.x);
+	c[2][0] = 2.0 * (q.x * q.z + q.w * q.y);
+	c[2][1] = 2.0 * (q.y * q.z - q.w * q.x);
+	c[2][2] = 1.0 - 2.0 * (q.x * q.x + q.y * q.y);
+	c[0][3] = c[1][3] = c[2][3] = 0.0;
+}
+
+void SetPoseTransformTranslation(PoseTransform &tf, const vr::HmdVector3d_t &translation)
+{
+	for (int i = 0; i < 3; i++)
+		tf.translation[i] = translation.v[i];
+	tf.translation[3] = 0.0;
+}
+
+// Terms are summed in the order of the transform's components, which the AVX2 kernel and
+// TransformTable::Apply follow too.
+static inline void ApplyScalar(const PoseTransform &tf, vr::DriverPose_t &pose)
+{
+	auto &q = pose.qWorldFromDriverRotation;
+	double w = tf.rotation[0], x = tf.rotation[1], y = tf.rotation[2], z = tf.rotation[3];
+	vr::HmdQuaternion_t rotation = {
+		(w * q.w) - (x * q.x) - (y * q.y) - (z * q.z),
+		(w * q.x) + (x * q.w) + (y * q.z) - (z * q.y),
+		(w * q.y) - (x * q.z) + (y * q.w) + (z * q.x),
+		(w * q.z) + (x * q.y) - (y * q.x) + (z * q.w)
+	};
+
+	auto &t = pose.vecWorldFromDriverTranslation;
+	auto &c = tf.columns;
+	double translation[3];
+	for (int i = 0; i < 3; i++)
+		translation[i] = c[0][i] * t[0] + c[1][i] * t[1] + c[2][i] * t[2] + tf.translation[i];
+
+	q = rotation;
+	t[0] = translation[0];
+	t[1] = translation[1];
+	t[2] = translation[2];
+}
+
+#ifdef POSE_KERNEL_X86
+
+static bool CpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// AVX needs the OS to save the upper register halves as well.
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+// The product of the transform's rotation a with the pose's rotation q, lane by lane, is
+// a.w * q + a.x * (-x, w, -z, y) + a.y * (-y, z, w, -x) + a.z * (-z, -y, x, w), where the
+// vectors are q's components permuted. Multiplying by the signs is exact.
+AVX2_TARGET static inline void ApplyAvx2(const PoseTransform &tf, vr::DriverPose_t &pose)
+{
+	double *qp = &pose.qWorldFromDriverRotation.w;
+	double *tp = pose.vecWorldFromDriverTranslation;
+
+	__m256d q = _mm256_loadu_pd(qp);
+	__m256d qx = _mm256_permute_pd(q, 0x5);
+	__m256d qy = _mm256_permute4x64_pd(q, _MM_SHUFFLE(1, 0, 3, 2));
+	__m256d qz = _mm256_permute4x64_pd(q, _MM_SHUFFLE(0, 1, 2, 3));
+
+	__m256d aw = _mm256_broadcast_sd(&tf.rotation[0]);
+	__m256d ax = _mm256_mul_pd(_mm256_broadcast_sd(&tf.rotation[1]), _mm256_setr_pd(-1.0, 1.0, -1.0, 1.0));
+	__m256d ay = _mm256_mul_pd(_mm256_broadcast_sd(&tf.rotation[2]), _mm256_setr_pd(-1.0, 1.0, 1.0, -1.0));
+	__m256d az = _mm256_mul_pd(_mm256_broadcast_sd(&tf.rotation[3]), _mm256_setr_pd(-1.0, -1.0, 1.0, 1.0));
+
+	__m256d rotation = _mm256_mul_pd(aw, q);
+	rotation = _mm256_add_pd(rotation, _mm256_mul_pd(ax, qx));
+	rotation = _mm256_add_pd(rotation, _mm256_mul_pd(ay, qy));
+	rotation = _mm256_add_pd(rotation, _mm256_mul_pd(az, qz));
+
+	__m256d translation = _mm256_mul_pd(_mm256_loadu_pd(tf.columns[0]), _mm256_broadcast_sd(&tp[0]));
+	translation = _mm256_add_pd(translation, _mm256_mul_pd(_mm256_loadu_pd(tf.columns[1]), _mm256_broadcast_sd(&tp[1])));
+	translation = _mm256_add_pd(translation, _mm256_mul_pd(_mm256_loadu_pd(tf.columns[2]), _mm256_broadcast_sd(&tp[2])));
+	translation = _mm256_add_pd(translation, _mm256_loadu_pd(tf.translation));
+
+	_mm256_storeu_pd(qp, rotation);
+	_mm256_maskstore_pd(tp, _mm256_setr_epi64x(-1, -1, -1, 0), translation);
+}
+
+AVX2_TARGET static void TransformPosesAvx2(const PoseTransform &tf, vr::DriverPose_t *poses, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		ApplyAvx2(tf, poses[i]);
+}
+
+AVX2_TARGET static void TransformPosesAvx2(const PoseTransform *transforms, const uint32_t *openVRIDs, vr::DriverPose_t *poses, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &tf = transforms[openVRIDs[i]];
+		if (tf.enabled)
+			ApplyAvx2(tf, poses[i]);
+	}
+}
+
+#endif
+
+const char *PoseKernelName(PoseKernel kernel)
+{
+	switch (kernel)
+	{
+	case PoseKernel::Scalar: return "scalar";
+	case PoseKernel::Avx2: return "avx2";
+	}
+	return "unknown";
+}
+
+bool PoseKernelSupported(PoseKernel kernel)
+{
+	if (kernel == PoseKernel::Scalar)
+		return true;
+
+#ifdef POSE_KERNEL_X86
+	static const bool avx2 = CpuSupportsAvx2();
+	return kernel == PoseKernel::Avx2 && avx2;
+#else
+	return false;
+#endif
+}
+
+PoseKernel BestPoseKernel()
+{
+	static const PoseKernel best = PoseKernelSupported(PoseKernel::Avx2) ? PoseKernel::Avx2 : PoseKernel::Scalar;
+	return best;
+}
+
+void TransformPoses(const PoseTransform &tf, vr::DriverPose_t *poses, size_t count, PoseKernel kernel)
+{
+	if (!tf.enabled)
+		return;
+
+#ifdef POSE_KERNEL_X86
+	if (kernel == PoseKernel::Avx2 && PoseKernelSupported(kernel))
+	{
+		TransformPosesAvx2(tf, poses, count);
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < count; i++)
+		ApplyScalar(tf, poses[i]);
+}
+
+void TransformPoses(const PoseTransform *transforms, const uint32_t *openVRIDs, vr::DriverPose_t *poses, size_t count, PoseKernel kernel)
+{
+#ifdef POSE_KERNEL_X86
+	if (kernel == PoseKernel::Avx2 && PoseKernelSupported(kernel))
+	{
+		TransformPosesAvx2(transforms, openVRIDs, poses, count);
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &tf = transforms[openVRIDs[i]];
+		if (tf.enabled)
+			ApplyScalar(tf, poses[i]);
+	}
+}
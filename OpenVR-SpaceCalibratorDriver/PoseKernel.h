@@ -0,0 +1,51 @@
+#pragma once
+
+// Applies calibration transforms to many driver poses in one call, for replaying traces,
+// post-processing pose taps and updating several devices at once. The math is the same as
+// TransformTable::Apply: one quaternion product for the orientation and one matrix-vector
+// multiply-add for the translation, with the rotation normalized and expanded beforehand.
+//
+// There is a scalar kernel and, on x86, an AVX2 kernel that is picked at run time when the CPU
+// supports it. The AVX2 kernel works on one pose at a time with the four quaternion components,
+// or the three matrix rows, in one register, because poses are far apart in memory. It multiplies
+// and adds in the scalar kernel's order without fusing, so both agree to the bit unless the
+// compiler fused multiplies and adds in the scalar code.
+
+#include <openvr_driver.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// A transform prepared for the kernels. Vectors are padded to four lanes with zeros.
+struct alignas(32) PoseTransform
+{
+	double rotation[4];    // w, x, y, z, normalized
+	double columns[3][4];  // of the rotation matrix
+	double translation[4];
+	bool enabled;
+};
+
+// A disabled identity transform.
+PoseTransform IdentityPoseTransform();
+
+// Normalizes the rotation and expands it into the matrix. A zero quaternion becomes the identity.
+void SetPoseTransformRotation(PoseTransform &tf, const vr::HmdQuaternion_t &rotation);
+void SetPoseTransformTranslation(PoseTransform &tf, const vr::HmdVector3d_t &translation);
+
+enum class PoseKernel
+{
+	Scalar,
+	Avx2,
+};
+
+const char *PoseKernelName(PoseKernel kernel);
+bool PoseKernelSupported(PoseKernel kernel);
+
+// The fastest kernel the CPU supports.
+PoseKernel BestPoseKernel();
+
+// Applies one transform to every pose. Does nothing if the transform is disabled.
+void TransformPoses(const PoseTransform &tf, vr::DriverPose_t *poses, size_t count, PoseKernel kernel = BestPoseKernel());
+
+// Applies transforms[openVRIDs[i]] to poses[i], skipping disabled transforms.
+void TransformPoses(const PoseTransform *transforms, const uint32_t *openVRIDs, vr::DriverPose_t *poses, size_t count, PoseKernel kernel = BestPoseKernel());
@@ -0,0 +1,171 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "PoseTap.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+PoseTap::PoseTap(size_t capacityLog2) :
+	mask(((uint64_t) 1 << capacityLog2) - 1),
+	enqueuePos(0), enabled(false), stopping(false), written(0), dropped(0), startNs(0)
+{
+}
+
+PoseTap::~PoseTap()
+{
+	Stop();
+}
+
+int64_t PoseTap::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool PoseTap::Start(const std::string &path)
+{
+	Stop();
+
+	file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+
+	PoseTapFileHeader header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, PoseTapMagic, sizeof header.magic);
+	header.version = PoseTapVersion;
+	header.headerSize = sizeof header;
+	header.recordSize = sizeof(PoseTapRecord);
+	header.poseSize = sizeof(vr::DriverPose_t);
+	header.startUnixNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	if (fwrite(&header, sizeof header, 1, file) != 1)
+	{
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+
+	// Every recording starts on a ring of its own, which Stop frees once no pose thread is left
+	// inside Record and the writer has written out its records.
+	slots.reset(new Slot[mask + 1]);
+	for (uint64_t i = 0; i <= mask; i++)
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	enqueuePos.store(0, std::memory_order_relaxed);
+	dequeuePos = 0;
+
+	startNs.store(Now(), std::memory_order_relaxed);
+	written.store(0, std::memory_order_relaxed);
+	dropped.store(0, std::memory_order_relaxed);
+	stopping.store(false, std::memory_order_relaxed);
+	writer = std::thread(&PoseTap::WriterThread, this);
+	enabled.store(true, std::memory_order_release);
+	return true;
+}
+
+void PoseTap::Stop()
+{
+	// Pairs with Record: a pose thread either sees the tap disabled or is counted here, so none
+	// reads this recording's clock or claims a slot once the wait is over.
+	enabled.store(false);
+	while (recording.load() != 0)
+		std::this_thread::yield();
+
+	if (!writer.joinable())
+		return;
+
+	stopping.store(true, std::memory_order_release);
+	writer.join();
+
+	fclose(file);
+	file = nullptr;
+	slots.reset();
+}
+
+void PoseTap::Record(int64_t timestampNs, uint32_t openVRID, uint32_t flags, const vr::DriverPose_t &before, const vr::DriverPose_t &after)
+{
+	recording.fetch_add(1);
+	if (enabled.load())
+		Enqueue(timestampNs, openVRID, flags, before, after);
+	recording.fetch_sub(1, std::memory_order_release);
+}
+
+void PoseTap::Enqueue(int64_t timestampNs, uint32_t openVRID, uint32_t flags, const vr::DriverPose_t &before, const vr::DriverPose_t &after)
+{
+	Slot *slot;
+	uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		slot = &slots[pos & mask];
+		uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+		int64_t diff = (int64_t) (sequence - pos);
+		if (diff == 0)
+		{
+			if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// The writer has not freed this slot yet, the ring is full.
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+		{
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	auto &record = slot->record;
+	record.timestampNs = timestampNs - startNs.load(std::memory_order_relaxed);
+	record.openVRID = openVRID;
+	record.flags = flags;
+	record.before = before;
+	record.after = after;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+size_t PoseTap::Drain(PoseTapRecord *buffer, size_t count)
+{
+	size_t n = 0;
+	while (n < count)
+	{
+		auto &slot = slots[dequeuePos & mask];
+		if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+			break;
+
+		// Poses that arrived before Start, whose pose thread saw the tap enabled only afterwards,
+		// have negative timestamps and are skipped.
+		if (slot.record.timestampNs >= 0)
+			buffer[n++] = slot.record;
+
+		slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+		dequeuePos++;
+	}
+	return n;
+}
+
+void PoseTap::WriterThread()
+{
+	std::vector<PoseTapRecord> buffer(256);
+
+	for (;;)
+	{
+		bool last = stopping.load(std::memory_order_acquire);
+
+		size_t n;
+		while ((n = Drain(buffer.data(), buffer.size())) > 0)
+		{
+			if (fwrite(buffer.data(), sizeof(PoseTapRecord), n, file) != n)
+				dropped.fetch_add(n, std::memory_order_relaxed);
+			else
+				written.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		if (last)
+			break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+
+	fflush(file);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// Native rate recording of the poses passing through the driver's pose hook, before and after the
+// calibration transform. Pose threads push records into a lock-free ring and never wait; a writer
+// thread drains the ring to a file. When the writer falls behind, records are dropped and counted
+// rather than slowing SteamVR down.
+//
+// A tap file is a PoseTapFileHeader followed by PoseTapRecords in the order they left the ring,
+// which is the order the pose threads claimed ring slots in.
+
+#include <openvr_driver.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+static const char PoseTapMagic[8] = { 'S', 'C', 'P', 'O', 'S', 'T', 'A', 'P' };
+static const uint32_t PoseTapVersion = 1;
+
+struct PoseTapFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t recordSize; // sizeof(PoseTapRecord) when written
+	uint32_t poseSize;   // sizeof(vr::DriverPose_t) when written
+	int64_t startUnixNs; // wall clock time at timestampNs 0
+	uint32_t reserved[4];
+};
+
+enum PoseTapRecordFlags : uint32_t
+{
+	PoseTapTransformed = 1, // the device had a transform enabled
+	PoseTapForwarded = 2,   // the pose was passed on to SteamVR
+};
+
+struct PoseTapRecord
+{
+	int64_t timestampNs; // steady clock at hook entry, relative to the tap start
+	uint32_t openVRID;
+	uint32_t flags;      // PoseTapRecordFlags
+	vr::DriverPose_t before, after;
+};
+
+class PoseTap
+{
+public:
+	// 8192 records hold a few hundred milliseconds of 1 kHz poses from a dozen devices. The ring,
+	// several megabytes, is only allocated while recording.
+	explicit PoseTap(size_t capacityLog2 = 13);
+	~PoseTap();
+
+	// Opens the file and starts the writer. Returns false if the file cannot be created.
+	bool Start(const std::string &path);
+
+	// Stops recording, waits for pose threads still inside Record and writes out everything
+	// already in the ring.
+	void Stop();
+
+	// One load, the only cost of a tap that is not recording.
+	bool Enabled() const { return enabled.load(std::memory_order_acquire); }
+
+	// Steady clock in nanoseconds, for taking the timestamp at hook entry.
+	static int64_t Now();
+
+	// Called from pose threads. Never blocks; drops the record if the ring is full, and does
+	// nothing once the tap is stopping.
+	void Record(int64_t timestampNs, uint32_t openVRID, uint32_t flags, const vr::DriverPose_t &before, const vr::DriverPose_t &after);
+
+	// Statistics of the current or last recording.
+	uint64_t Written() const { return written.load(std::memory_order_relaxed); }
+	uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+	struct Slot
+	{
+		// Bounded MPMC queue after Dmitry Vyukov: a slot is free for the producer claiming
+		// position p when sequence == p, and holds a record for the consumer when sequence == p + 1.
+		std::atomic<uint64_t> sequence;
+		PoseTapRecord record;
+	};
+
+	void Enqueue(int64_t timestampNs, uint32_t openVRID, uint32_t flags, const vr::DriverPose_t &before, const vr::DriverPose_t &after);
+
+	// Moves records from the ring to the file until stopping, then once more.
+	void WriterThread();
+	size_t Drain(PoseTapRecord *buffer, size_t count);
+
+	std::unique_ptr<Slot[]> slots; // only while recording
+	const uint64_t mask;
+
+	alignas(64) std::atomic<uint64_t> enqueuePos;
+	alignas(64) uint64_t dequeuePos = 0; // writer thread only
+
+	// recording counts the pose threads inside Record, which Stop waits out. It shares the line
+	// of enabled, which the hook has just read anyway.
+	alignas(64) std::atomic<bool> enabled;
+	std::atomic<uint32_t> recording { 0 };
+	std::atomic<bool> stopping;
+	std::atomic<uint64_t> written, dropped;
+	std::atomic<int64_t> startNs;
+
+	FILE *file = nullptr;
+	std::thread writer;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+// Quaternion math shared by the driver's profile parsing, device profiling, moving platform and
+// fused tracker. Rotations are unit quaternions as w, x, y, z, either as vr::HmdQuaternion_t or as
+// plain arrays of four doubles.
+
+#include <openvr_driver.h>
+
+inline vr::HmdQuaternion_t Multiply(const vr::HmdQuaternion_t &lhs, const vr::HmdQuaternion_t &rhs)
+{
+	return {
+		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
+		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
+		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
+		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
+	};
+}
+
+inline void Multiply(const double a[4], const double b[4], double out[4])
+{
+	out[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+	out[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+	out[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+	out[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+}
+
+// v + w * u + (x, y, z) x u with u = 2 (x, y, z) x v, as for mount offsets in TransformTable.
+inline void Rotate(const double q[4], const double v[3], double out[3])
+{
+	double u[3] = {
+		2.0 * (q[2] * v[2] - q[3] * v[1]),
+		2.0 * (q[3] * v[0] - q[1] * v[2]),
+		2.0 * (q[1] * v[1] - q[2] * v[0])
+	};
+	out[0] = v[0] + q[0] * u[0] + (q[2] * u[2] - q[3] * u[1]);
+	out[1] = v[1] + q[0] * u[1] + (q[3] * u[0] - q[1] * u[2]);
+	out[2] = v[2] + q[0] * u[2] + (q[1] * u[1] - q[2] * u[0]);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// Single writer, many reader sequence lock for small trivially copyable values. Stores never wait
+// and loads never block the writer; a load that overlaps a store retries. The value is kept in
+// atomic words, so concurrent access is well defined and clean under ThreadSanitizer.
+//
+// The words are stored with release and loaded with acquire rather than fenced, which costs
+// nothing on x86 and keeps every ordering visible to ThreadSanitizer, which ignores fences. A
+// load that sees any word of a store therefore also sees the odd sequence written before it.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Per-device state that different threads write is aligned to this, so no two slots share a line.
+static const size_t CacheLineSize = 64;
+
+template<class T> class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied bytewise");
+	static const size_t Words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+	SeqLock() : sequence(0)
+	{
+		for (auto &word : data)
+			word.store(0, std::memory_order_relaxed);
+	}
+
+	// Only one thread may store at a time.
+	void Store(const T &value)
+	{
+		uint64_t words[Words] = {};
+		memcpy(words, &value, sizeof(T));
+
+		uint64_t seq = sequence.load(std::memory_order_relaxed);
+		sequence.store(seq + 1, std::memory_order_relaxed);
+
+		for (size_t i = 0; i < Words; i++)
+			data[i].store(words[i], std::memory_order_release);
+
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	T Load() const
+	{
+		uint64_t words[Words];
+		for (;;)
+		{
+			uint64_t seq = sequence.load(std::memory_order_acquire);
+			if (seq & 1)
+				continue;
+
+			for (size_t i = 0; i < Words; i++)
+				words[i] = data[i].load(std::memory_order_acquire);
+
+			if (sequence.load(std::memory_order_relaxed) == seq)
+				break;
+		}
+
+		T value;
+		memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+private:
+	std::atomic<uint64_t> sequence; // odd while a store is in progress
+	std::atomic<uint64_t> data[Words];
+};
@@ -2,13 +2,46 @@
 #include "Logging.h"
 #include "InterfaceHookInjector.h"
 
+#include <cstring>
+#include <stdexcept>
+#include <windows.h>
+
+// Where the app saves its profile, see Configuration.cpp.
+static const char *ProfileRegistryKey = "Software\\OpenVR-SpaceCalibrator";
+
+static std::string ReadProfileJson()
+{
+	DWORD size = 0;
+	if (RegGetValueA(HKEY_CURRENT_USER_LOCAL_SETTINGS, ProfileRegistryKey, "Config", RRF_RT_REG_SZ, 0, 0, &size) != ERROR_SUCCESS || size == 0)
+		return "";
+
+	std::string str(size, '\0');
+	if (RegGetValueA(HKEY_CURRENT_USER_LOCAL_SETTINGS, ProfileRegistryKey, "Config", RRF_RT_REG_SZ, 0, &str[0], &size) != ERROR_SUCCESS)
+		return "";
+
+	str.resize(size - 1);
+	return str;
+}
+
+static bool DeviceStringProperty(uint32_t openVRID, vr::ETrackedDeviceProperty prop, std::string &value)
+{
+	auto properties = vr::VRProperties();
+	vr::ETrackedPropertyError err = vr::TrackedProp_Success;
+	value = properties->GetStringProperty(properties->TrackedDeviceToPropertyContainer(openVRID), prop, &err);
+	return err == vr::TrackedProp_Success;
+}
+
+static protocol::SetDeviceTransform DeviceTransformRequest(uint32_t openVRID, const RegisteredTransform &tf)
+{
+	return protocol::SetDeviceTransform(openVRID, tf.enabled, tf.translation, tf.rotation);
+}
+
 vr::EVRInitError ServerTrackedDeviceProvider::Init(vr::IVRDriverContext *pDriverContext)
 {
 	TRACE("ServerTrackedDeviceProvider::Init()");
 	VR_INIT_SERVER_DRIVER_CONTEXT(pDriverContext);
 
-	memset(transforms, 0, vr::k_unMaxTrackedDeviceCount * sizeof DeviceTransform);
-
+	LoadProfile();
 	InjectHooks(this, pDriverContext);
 	server.Run();
 
@@ -20,49 +53,532 @@ void ServerTrackedDeviceProvider::Cleanup()
 	TRACE("ServerTrackedDeviceProvider::Cleanup()");
 	server.Stop();
 	DisableHooks();
+	poseTap.Stop();
+
+	{
+		std::lock_guard<std::mutex> lock(transformWriter);
+		for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+		{
+			auto &device = devices[id];
+			uint64_t poses = device.poses.load(std::memory_order_relaxed);
+			if (poses)
+				LOG("Device %u (%s): %llu poses, %llu transformed", id, registry.Serial(id).c_str(), (unsigned long long) poses, (unsigned long long) device.transformedPoses.load(std::memory_order_relaxed));
+		}
+	}
+
 	VR_CLEANUP_SERVER_DRIVER_CONTEXT();
 }
 
-inline vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t &lhs, const vr::HmdQuaternion_t &rhs) {
-	return {
-		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
-		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
-		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
-		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
-	};
+// Frames before RunFrame asks again for the properties of a device SteamVR does not know yet,
+// doubling from one with each attempt.
+static const uint64_t MaxRegistrationRetryFrames = 64;
+
+// SteamVR takes new devices from its main loop; the fused tracker is added once, on the first
+// request for it, and stays until SteamVR restarts.
+void ServerTrackedDeviceProvider::RunFrame()
+{
+	RegisterPending();
+
+	if (!fusedAddPending.exchange(false))
+		return;
+
+	if (vr::VRServerDriverHost()->TrackedDeviceAdded(FusedTrackerDevice::Serial, vr::TrackedDeviceClass_GenericTracker, &fusedDevice))
+		LOG("Fused tracker %s added", FusedTrackerDevice::Serial);
+	else
+		LOG("Fused tracker %s could not be added", FusedTrackerDevice::Serial);
 }
 
-inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const double(&vector)[3]) {
-	vr::HmdQuaternion_t vectorQuat = { 0.0, vector[0], vector[1] , vector[2] };
-	vr::HmdQuaternion_t conjugate = { quat.w, -quat.x, -quat.y, -quat.z };
-	auto rotatedVectorQuat = quat * vectorQuat * conjugate;
-	return { rotatedVectorQuat.x, rotatedVectorQuat.y, rotatedVectorQuat.z };
+void ServerTrackedDeviceProvider::LoadProfile()
+{
+	auto json = ReadProfileJson();
+	if (json.empty())
+	{
+		LOG("No saved profile, transforms wait for the app");
+	}
+	else
+	{
+		try
+		{
+			profile = ParseDriverProfile(json);
+			LOG("Loaded profile for %s devices in %s space", profile.targetTrackingSystem.c_str(), profile.referenceTrackingSystem.c_str());
+
+			std::lock_guard<std::mutex> lock(transformWriter);
+			ApplyProfileSettings();
+		}
+		catch (const std::runtime_error &e)
+		{
+			LOG("Error loading profile: %s", e.what());
+		}
+	}
+}
+
+// Guarded by transformWriter. What the app would send along with the profile's transform, set by
+// serial and tracking system before any device registers, so Register resolves it for each device
+// as it does the app's. None of it depends on the HMD, as with the app.
+void ServerTrackedDeviceProvider::ApplyProfileSettings()
+{
+	for (auto &entry : profile.mountOffsets)
+	{
+		RegisteredTransform offset;
+		offset.enabled = true;
+		offset.translation = { { entry.translation[0], entry.translation[1], entry.translation[2] } };
+		offset.rotation = { entry.rotation[0], entry.rotation[1], entry.rotation[2], entry.rotation[3] };
+		registry.SetMountOffset(entry.serial, offset);
+	}
+
+	for (auto &entry : profile.smoothing)
+	{
+		SmoothingSettings smoothing;
+		smoothing.enabled = true;
+		smoothing.minCutoffHz = entry.minCutoffHz;
+		smoothing.beta = entry.beta;
+		registry.SetSmoothing(entry.serial, smoothing);
+	}
+
+	for (auto &entry : profile.timeOffsetsMs)
+		registry.SetTimeOffset(entry.first, entry.second / 1000.0);
+
+	stageBudgetNs.store(profile.stageBudgetNs, std::memory_order_relaxed);
+
+	if (!profile.platformSerial.empty())
+	{
+		platformSystem = profile.targetTrackingSystem;
+		platformSerial = profile.platformSerial;
+	}
+
+	if (!profile.fusedPrimarySerial.empty())
+	{
+		fusedSerials[0] = profile.fusedPrimarySerial;
+		fusedSerials[1] = profile.fusedSecondarySerial;
+		fusion.Configure(profile.fusedBlend);
+		fusedRequested = true;
+		fusedAddPending.store(true);
+	}
+
+	LOG("Profile has %zu mount offsets, %zu smoothed devices, %zu time offsets, a %.0f ns stage budget%s%s",
+		profile.mountOffsets.size(), profile.smoothing.size(), profile.timeOffsetsMs.size(), profile.stageBudgetNs,
+		platformSerial.empty() ? "" : ", a moving platform", fusedRequested ? ", a fused tracker" : "");
+}
+
+// Registers the slots whose pose threads asked since the last frame. A slot that cannot be
+// registered yet is left to ask again with its next pose, and is not tried before its backoff.
+void ServerTrackedDeviceProvider::RegisterPending()
+{
+	frame++;
+	uint64_t pending = registrationPending.exchange(0, std::memory_order_acquire);
+	for (uint32_t id = 0; pending; id++, pending >>= 1)
+	{
+		auto &retry = registrationRetries[id];
+		if (!(pending & 1) || frame < retry.nextFrame)
+			continue;
+
+		if (Register(id))
+		{
+			retry = RegistrationRetry();
+			continue;
+		}
+
+		uint64_t wait = retry.attempts < 6 ? 1ull << retry.attempts : MaxRegistrationRetryFrames;
+		retry.nextFrame = frame + wait;
+		retry.attempts++;
+	}
+}
+
+// RunFrame. Returns false while SteamVR does not know the device's properties yet, or, for a
+// device the profile may apply to, the HMD's tracking system.
+bool ServerTrackedDeviceProvider::Register(uint32_t openVRID)
+{
+	std::string trackingSystem, serial, hmdSystem;
+	if (!DeviceStringProperty(openVRID, vr::Prop_TrackingSystemName_String, trackingSystem) ||
+		!DeviceStringProperty(openVRID, vr::Prop_SerialNumber_String, serial))
+		return false;
+	bool hmdKnown = DeviceStringProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_TrackingSystemName_String, hmdSystem);
+
+	std::lock_guard<std::mutex> lock(transformWriter);
+	auto &device = devices[openVRID];
+	if (device.registered.load(std::memory_order_relaxed))
+		return true;
+
+	bool profilePending = !appInCharge && profile.valid && trackingSystem == profile.targetTrackingSystem;
+	if (profilePending && !hmdKnown)
+		return false;
+
+	bool replaced = registry.Register(openVRID, trackingSystem, serial);
+	RegisteredTransform tf;
+	bool resolved = registry.ResolveTransform(openVRID, tf);
+	if (resolved || replaced)
+		device.overridden.store(false, std::memory_order_relaxed);
+
+	if (resolved)
+	{
+		transforms.Set(DeviceTransformRequest(openVRID, tf));
+		LOG("Registered %s device %s in slot %u with its tracking system's transform", trackingSystem.c_str(), serial.c_str(), openVRID);
+	}
+	else if (profilePending && DriverProfileApplies(profile, openVRID, hmdSystem, trackingSystem))
+	{
+		// As the tracking system's transform, the one the app would set, so the devices registering
+		// later resolve it and a moving platform has it to carry.
+		auto &t = profile.translation;
+		auto &q = profile.rotation;
+		tf.enabled = true;
+		tf.translation = { { t[0], t[1], t[2] } };
+		tf.rotation = { q[0], q[1], q[2], q[3] };
+		ApplySystemTransform(trackingSystem, tf);
+		LOG("Registered %s device %s in slot %u and applied the profile to %s devices from its first pose", trackingSystem.c_str(), serial.c_str(), openVRID, trackingSystem.c_str());
+	}
+	else
+	{
+		// Whatever the slot's last device was given does not carry over to a new one.
+		if (replaced && transforms.Enabled(openVRID))
+			transforms.Set(protocol::SetDeviceTransform(openVRID, false));
+		LOG("Registered %s device %s in slot %u", trackingSystem.c_str(), serial.c_str(), openVRID);
+	}
+
+	RegisteredTransform offset;
+	if (registry.ResolveMountOffset(openVRID, offset))
+		transforms.SetMount(openVRID, offset.enabled, offset.translation, offset.rotation);
+	else if (replaced && transforms.MountEnabled(openVRID))
+		transforms.SetMount(openVRID, false, { { 0.0, 0.0, 0.0 } }, { 1.0, 0.0, 0.0, 0.0 });
+
+	SmoothingSettings smoothing;
+	if (registry.ResolveSmoothing(openVRID, smoothing))
+		device.SetSmoothing(smoothing);
+	else if (replaced && device.filter.Enabled())
+		device.SetSmoothing(SmoothingSettings());
+
+	double timeOffset = registry.ResolveTimeOffset(openVRID);
+	if (timeOffset != device.timeOffset.load(std::memory_order_relaxed))
+		device.SetTimeOffset(timeOffset);
+
+	for (int source = 0; source < FusedTracker::Sources; source++)
+	{
+		if (serial == fusedSerials[source])
+			fusion.SetSource(source, openVRID);
+		else if (fusion.Source(source) == openVRID)
+			fusion.SetSource(source, vr::k_unTrackedDeviceIndexInvalid);
+	}
+
+	if (!platformSerial.empty())
+	{
+		if (serial == platformSerial)
+			ArmPlatform(openVRID);
+		else if (openVRID == platform.Device())
+		{
+			platform.Stop();
+			LOG("Moving platform %s lost its slot %u", platformSerial.c_str(), openVRID);
+		}
+		else if (platform.Following() && platform.Follows(openVRID) != (((registry.SystemTransformDevices(platformSystem) >> openVRID) & 1) != 0))
+			platform.SetFollowers(registry.SystemTransformDevices(platformSystem));
+	}
+
+	device.registered.store(true, std::memory_order_release);
+	return true;
+}
+
+void ServerTrackedDeviceProvider::DeviceAdded(const char *serial)
+{
+	std::lock_guard<std::mutex> lock(transformWriter);
+	uint32_t openVRID = registry.Unregister(serial);
+	if (openVRID == vr::k_unTrackedDeviceIndexInvalid)
+		return;
+
+	devices[openVRID].registered.store(false, std::memory_order_release);
+	LOG("Device %s added again, registering slot %u after its next pose", serial, openVRID);
+}
+
+// Guarded by transformWriter. The app only sends what differs from the driver's defaults, so the
+// profile's mount offsets, smoothing, time offsets and stage budget go back to those; the app's
+// scan sets its own right after the transform that took over. It always sends the moving platform
+// and the fused tracker.
+void ServerTrackedDeviceProvider::TakeOverFromProfile()
+{
+	if (appInCharge)
+		return;
+
+	appInCharge = true;
+	if (!profile.valid)
+		return;
+
+	for (auto &entry : profile.mountOffsets)
+	{
+		registry.SetMountOffset(entry.serial, RegisteredTransform());
+		uint32_t openVRID = registry.FindSerial(entry.serial);
+		if (openVRID != vr::k_unTrackedDeviceIndexInvalid)
+			transforms.SetMount(openVRID, false, { { 0.0, 0.0, 0.0 } }, { 1.0, 0.0, 0.0, 0.0 });
+	}
+
+	for (auto &entry : profile.smoothing)
+	{
+		registry.SetSmoothing(entry.serial, SmoothingSettings());
+		uint32_t openVRID = registry.FindSerial(entry.serial);
+		if (openVRID != vr::k_unTrackedDeviceIndexInvalid)
+			devices[openVRID].SetSmoothing(SmoothingSettings());
+	}
+
+	for (auto &entry : profile.timeOffsetsMs)
+	{
+		registry.SetTimeOffset(entry.first, 0.0);
+		uint64_t ids = registry.SystemDevices(entry.first);
+		for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+		{
+			if ((ids >> id) & 1)
+				devices[id].SetTimeOffset(0.0);
+		}
+	}
+
+	stageBudgetNs.store(protocol::DefaultStageBudgetNs, std::memory_order_relaxed);
+	LOG("App took over transforms and settings from the driver's profile");
+}
+
+// Guarded by transformWriter. Followers keep any previous anchor until the platform's next pose.
+void ServerTrackedDeviceProvider::ArmPlatform(uint32_t openVRID)
+{
+	if (registry.TrackingSystem(openVRID) == platformSystem)
+	{
+		platform.Stop();
+		LOG("Moving platform %s is itself a %s device, not following it", platformSerial.c_str(), platformSystem.c_str());
+		return;
+	}
+
+	platform.Arm(openVRID);
+	LOG("Moving platform %s in slot %u, anchoring %s devices from its next pose", platformSerial.c_str(), openVRID, platformSystem.c_str());
+}
+
+// Guarded by transformWriter, which AnchorPlatform holds.
+void ServerTrackedDeviceProvider::PlatformAnchored(bool followed)
+{
+	if (followed)
+		LOG("Moving platform %s anchored, %s devices follow it", platformSerial.c_str(), platformSystem.c_str());
+	else
+		LOG("Moving platform %s anchored, %s devices have no transform to follow it with", platformSerial.c_str(), platformSystem.c_str());
 }
 
 void ServerTrackedDeviceProvider::SetDeviceTransform(const protocol::SetDeviceTransform &newTransform)
 {
-	auto &tf = transforms[newTransform.openVRID];
+	std::lock_guard<std::mutex> lock(transformWriter);
+	TakeOverFromProfile();
+	ApplyDeviceTransform(newTransform);
+}
+
+void ServerTrackedDeviceProvider::SetSystemTransform(const protocol::SetSystemTransform &newTransform)
+{
+	std::string trackingSystem(newTransform.trackingSystem, strnlen(newTransform.trackingSystem, sizeof newTransform.trackingSystem));
+	RegisteredTransform tf;
 	tf.enabled = newTransform.enabled;
+	tf.translation = newTransform.translation;
+	tf.rotation = newTransform.rotation;
 
-	if (newTransform.updateTranslation)
-		tf.translation = newTransform.translation;
+	std::lock_guard<std::mutex> lock(transformWriter);
+	TakeOverFromProfile();
+	int count = ApplySystemTransform(trackingSystem, tf);
+	LOG("Transform for %s devices %s, %d registered", trackingSystem.c_str(), tf.enabled ? "set" : "disabled", count);
+}
 
-	if (newTransform.updateRotation)
-		tf.rotation = newTransform.rotation;
+void ServerTrackedDeviceProvider::SetMountOffsets(const protocol::SetMountOffsets &newOffsets)
+{
+	uint32_t count = newOffsets.count < protocol::MaxMountOffsets ? newOffsets.count : protocol::MaxMountOffsets;
+
+	std::lock_guard<std::mutex> lock(transformWriter);
+	int registered = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		auto &entry = newOffsets.offsets[i];
+		std::string serial(entry.serial, strnlen(entry.serial, sizeof entry.serial));
+		RegisteredTransform offset;
+		offset.enabled = entry.enabled;
+		offset.translation = entry.translation;
+		offset.rotation = entry.rotation;
+		registry.SetMountOffset(serial, offset);
+
+		uint32_t openVRID = registry.FindSerial(serial);
+		if (openVRID != vr::k_unTrackedDeviceIndexInvalid)
+		{
+			transforms.SetMount(openVRID, offset.enabled, offset.translation, offset.rotation);
+			registered++;
+		}
+	}
+
+	LOG("Mount offsets set for %u devices, %d registered", count, registered);
 }
 
-bool ServerTrackedDeviceProvider::HandleDevicePoseUpdated(uint32_t openVRID, vr::DriverPose_t &pose)
+void ServerTrackedDeviceProvider::SetMovingPlatform(const protocol::SetMovingPlatform &newPlatform)
 {
-	auto &tf = transforms[openVRID];
-	if (tf.enabled)
+	std::string trackingSystem(newPlatform.trackingSystem, strnlen(newPlatform.trackingSystem, sizeof newPlatform.trackingSystem));
+	std::string serial(newPlatform.serial, strnlen(newPlatform.serial, sizeof newPlatform.serial));
+
+	std::lock_guard<std::mutex> lock(transformWriter);
+	if (!newPlatform.enabled || trackingSystem.empty() || serial.empty())
 	{
-		pose.qWorldFromDriverRotation = tf.rotation * pose.qWorldFromDriverRotation;
+		if (!platformSerial.empty())
+			LOG("Moving platform %s stopped, %s devices back to their transform", platformSerial.c_str(), platformSystem.c_str());
 
-		vr::HmdVector3d_t rotatedTranslation = quaternionRotateVector(tf.rotation, pose.vecWorldFromDriverTranslation);
-		pose.vecWorldFromDriverTranslation[0] = rotatedTranslation.v[0] + tf.translation.v[0];
-		pose.vecWorldFromDriverTranslation[1] = rotatedTranslation.v[1] + tf.translation.v[1];
-		pose.vecWorldFromDriverTranslation[2] = rotatedTranslation.v[2] + tf.translation.v[2];
+		platform.Stop();
+		platformSystem.clear();
+		platformSerial.clear();
+		return;
 	}
-	return true;
+
+	platformSystem = trackingSystem;
+	platformSerial = serial;
+
+	uint32_t openVRID = registry.FindSerial(serial);
+	if (openVRID != vr::k_unTrackedDeviceIndexInvalid)
+	{
+		ArmPlatform(openVRID);
+	}
+	else
+	{
+		platform.Stop();
+		LOG("Moving platform %s for %s devices set, waiting for it to register", serial.c_str(), trackingSystem.c_str());
+	}
+}
+
+void ServerTrackedDeviceProvider::SetSmoothing(const protocol::SetSmoothing &newSmoothing)
+{
+	uint32_t count = newSmoothing.count < protocol::MaxDeviceSmoothing ? newSmoothing.count : protocol::MaxDeviceSmoothing;
+
+	std::lock_guard<std::mutex> lock(transformWriter);
+	int registered = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		auto &entry = newSmoothing.devices[i];
+		std::string serial(entry.serial, strnlen(entry.serial, sizeof entry.serial));
+		SmoothingSettings smoothing;
+		smoothing.enabled = entry.enabled;
+		smoothing.minCutoffHz = entry.minCutoffHz;
+		smoothing.beta = entry.beta;
+		registry.SetSmoothing(serial, smoothing);
+
+		uint32_t openVRID = registry.FindSerial(serial);
+		if (openVRID != vr::k_unTrackedDeviceIndexInvalid)
+		{
+			devices[openVRID].SetSmoothing(smoothing);
+			registered++;
+		}
+	}
+
+	LOG("Smoothing set for %u devices, %d registered", count, registered);
 }
 
+void ServerTrackedDeviceProvider::SetTimeOffset(const protocol::SetTimeOffset &newOffset)
+{
+	std::string trackingSystem(newOffset.trackingSystem, strnlen(newOffset.trackingSystem, sizeof newOffset.trackingSystem));
+
+	std::lock_guard<std::mutex> lock(transformWriter);
+	registry.SetTimeOffset(trackingSystem, newOffset.seconds);
+
+	uint64_t ids = registry.SystemDevices(trackingSystem);
+	int count = 0;
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		if ((ids >> id) & 1)
+		{
+			devices[id].SetTimeOffset(newOffset.seconds);
+			count++;
+		}
+	}
+
+	LOG("Time offset for %s devices set to %.1f ms, %d registered", trackingSystem.c_str(), newOffset.seconds * 1000.0, count);
+}
+
+void ServerTrackedDeviceProvider::SetStageBudget(const protocol::SetStageBudget &newBudget)
+{
+	stageBudgetNs.store(newBudget.budgetNs > 0.0 ? newBudget.budgetNs : 0.0, std::memory_order_relaxed);
+	if (newBudget.budgetNs > 0.0)
+		LOG("Optional pose stages budget set to %.0f ns per pose", newBudget.budgetNs);
+	else
+		LOG("Optional pose stages watchdog turned off");
+}
+
+void ServerTrackedDeviceProvider::SetFusedTracker(const protocol::SetFusedTracker &newTracker)
+{
+	std::string serials[FusedTracker::Sources] = {
+		std::string(newTracker.primarySerial, strnlen(newTracker.primarySerial, sizeof newTracker.primarySerial)),
+		std::string(newTracker.secondarySerial, strnlen(newTracker.secondarySerial, sizeof newTracker.secondarySerial)),
+	};
+
+	std::lock_guard<std::mutex> lock(transformWriter);
+	if (!newTracker.enabled || serials[0].empty() || serials[1].empty() || serials[0] == serials[1])
+	{
+		if (fusion.Enabled())
+		{
+			fusion.Stop();
+			uint32_t fusedID = fusedDevice.ID();
+			if (fusedID < vr::k_unMaxTrackedDeviceCount)
+				PublishPose(fusedID, fusion.LastPose());
+			LOG("Fused tracker stopped");
+		}
+		fusedSerials[0].clear();
+		fusedSerials[1].clear();
+		return;
+	}
+
+	int registered = 0;
+	for (int source = 0; source < FusedTracker::Sources; source++)
+	{
+		fusedSerials[source] = serials[source];
+		uint32_t openVRID = registry.FindSerial(serials[source]);
+		fusion.SetSource(source, openVRID);
+		if (openVRID != vr::k_unTrackedDeviceIndexInvalid)
+			registered++;
+	}
+	fusion.Configure(newTracker.blend);
+
+	if (!fusedRequested)
+	{
+		fusedRequested = true;
+		fusedAddPending.store(true);
+	}
+
+	LOG("Fused tracker from %s and %s, %s, %d of them registered", serials[0].c_str(), serials[1].c_str(), newTracker.blend ? "blended" : "switched", registered);
+}
+
+void ServerTrackedDeviceProvider::StageTurnedOff(uint32_t openVRID, uint32_t stage, double averageNs, double budgetNs)
+{
+	LOG("Pose hook for device %u took %.0f ns per pose on average, over its %.0f ns budget; %s turned off for it until SteamVR restarts",
+		openVRID, averageNs, budgetNs, StageName(stage));
+}
+
+void ServerTrackedDeviceProvider::SetPoseTap(const protocol::SetPoseTap &tap)
+{
+	if (!tap.enabled)
+	{
+		if (poseTap.Enabled())
+		{
+			poseTap.Stop();
+			LOG("Pose tap stopped, %llu poses written, %llu dropped", (unsigned long long) poseTap.Written(), (unsigned long long) poseTap.Dropped());
+		}
+		return;
+	}
+
+	tm now = TimeForLog();
+	char path[64];
+	snprintf(path, sizeof path, "space_calibrator_poses-%04d%02d%02d-%02d%02d%02d.sctap",
+		now.tm_year + 1900, now.tm_mon + 1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec);
+
+	if (poseTap.Start(path))
+		LOG("Pose tap recording to %s", path);
+	else
+		LOG("Pose tap could not create %s", path);
+}
+
+void ServerTrackedDeviceProvider::GetDeviceStats(protocol::DeviceStatsTable &table)
+{
+	if (!profiling.exchange(true))
+		LOG("Device profiling started");
+
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+		table.devices[id] = devices[id].profiler.Stats();
+}
+
+#ifdef POSE_HOOK_TIMING
+bool ServerTrackedDeviceProvider::GetHookTiming(uint32_t openVRID, protocol::HookTiming &timing)
+{
+	if (openVRID >= vr::k_unMaxTrackedDeviceCount)
+		return false;
+
+	devices[openVRID].hookCycles.Read(timing);
+	timing.cyclesPerNs = cycleClock.CyclesPerNs();
+	return true;
+}
+#endif
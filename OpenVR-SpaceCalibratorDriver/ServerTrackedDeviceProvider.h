@@ -1,10 +1,14 @@
 #pragma once
 
 #include "IPCServer.h"
+#include "DriverProfile.h"
+#include "PoseHook.h"
 
 #include <openvr_driver.h>
+#include <atomic>
+#include <string>
 
-class ServerTrackedDeviceProvider : public vr::IServerTrackedDeviceProvider
+class ServerTrackedDeviceProvider : public vr::IServerTrackedDeviceProvider, public PoseHook
 {
 public:
 	////// Start vr::IServerTrackedDeviceProvider functions
@@ -19,7 +23,7 @@ public:
 	virtual const char * const *GetInterfaceVersions() { return vr::k_InterfaceVersions; }
 
 	/** Allows the driver do to some work in the main loop of the server. */
-	virtual void RunFrame() { }
+	virtual void RunFrame() override;
 
 	/** Returns true if the driver wants to block Standby mode. */
 	virtual bool ShouldBlockStandbyMode() { return false; }
@@ -36,17 +40,51 @@ public:
 
 	ServerTrackedDeviceProvider() : server(this) { }
 	void SetDeviceTransform(const protocol::SetDeviceTransform &newTransform);
-	bool HandleDevicePoseUpdated(uint32_t openVRID, vr::DriverPose_t &pose);
+	void SetSystemTransform(const protocol::SetSystemTransform &newTransform);
+	void SetMountOffsets(const protocol::SetMountOffsets &newOffsets);
+	void SetMovingPlatform(const protocol::SetMovingPlatform &newPlatform);
+	void SetSmoothing(const protocol::SetSmoothing &newSmoothing);
+	void SetTimeOffset(const protocol::SetTimeOffset &newOffset);
+	void SetStageBudget(const protocol::SetStageBudget &newBudget);
+	void SetFusedTracker(const protocol::SetFusedTracker &newTracker);
+	void SetPoseTap(const protocol::SetPoseTap &tap);
+	void GetDeviceStats(protocol::DeviceStatsTable &table);
+#ifdef POSE_HOOK_TIMING
+	bool GetHookTiming(uint32_t openVRID, protocol::HookTiming &timing);
+#endif
+
+	// From TrackedDeviceAdded, before SteamVR assigns the device a slot.
+	void DeviceAdded(const char *serial);
+
+protected:
+	virtual void PlatformAnchored(bool followed) override;
+	virtual void StageTurnedOff(uint32_t openVRID, uint32_t stage, double averageNs, double budgetNs) override;
 
 private:
+	void LoadProfile();
+	void ApplyProfileSettings();
+	void RegisterPending();
+	bool Register(uint32_t openVRID);
+	void TakeOverFromProfile();
+	void ArmPlatform(uint32_t openVRID);
+
 	IPCServer server;
 
-	struct DeviceTransform
+	DriverProfile profile;
+	bool appInCharge = false; // guarded by transformWriter
+
+	std::string platformSerial; // guarded by transformWriter
+
+	std::string fusedSerials[FusedTracker::Sources]; // guarded by transformWriter
+	bool fusedRequested = false;                     // guarded by transformWriter
+	std::atomic<bool> fusedAddPending { false };     // added to SteamVR from RunFrame
+
+	// RunFrame's backoff for slots whose properties SteamVR does not know yet.
+	struct RegistrationRetry
 	{
-		bool enabled = false;
-		vr::HmdVector3d_t translation;
-		vr::HmdQuaternion_t rotation;
+		uint32_t attempts = 0;
+		uint64_t nextFrame = 0;
 	};
-
-	DeviceTransform transforms[vr::k_unMaxTrackedDeviceCount];
+	RegistrationRetry registrationRetries[vr::k_unMaxTrackedDeviceCount];
+	uint64_t frame = 0;
 };
\ No newline at end of file
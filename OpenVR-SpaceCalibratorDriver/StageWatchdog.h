@@ -0,0 +1,77 @@
+#pragma once
+
+// Keeps the optional stages of the pose hook within a time budget per call. SteamVR calls the
+// hook on its drivers' pose threads, so with many trackers a slow hook delays every device after
+// it; when a device's stages take longer than the budget on average, the watchdog turns them
+// off one at a time, least needed first, until the device is back within it or only its
+// calibration is left.
+//
+// One call in SampleEvery is timed with the cycle counter, from the hook's entry to its return
+// without SteamVR's own handling of the pose, so watching costs the other calls one increment.
+// A stage turned off stays off for the device's slot until SteamVR restarts, and the driver logs
+// each one once.
+//
+// The state is per device and belongs to its pose thread.
+
+#include <cstdint>
+
+// Optional stages of the pose hook, one bit each, numbered in the order the watchdog turns them
+// off. A time offset costs a subtraction and is never turned off.
+enum DeviceStage : uint32_t
+{
+	StageTap = 1,        // recording the device's poses to the pose tap
+	StageSmoothing = 2,
+	StagePlatform = 4,   // following a moving platform rather than the fixed transform
+	StageTimeOffset = 8,
+};
+
+static const uint32_t DegradableStages = StageTap | StageSmoothing | StagePlatform;
+
+// Stages that change the pose, left out while the app's own transform for a device is in place.
+static const uint32_t OverriddenStages = StageSmoothing | StagePlatform | StageTimeOffset;
+
+inline const char *StageName(uint32_t stage)
+{
+	switch (stage)
+	{
+	case StageTap: return "pose tap";
+	case StageSmoothing: return "smoothing";
+	case StagePlatform: return "moving platform";
+	case StageTimeOffset: return "time offset";
+	default: return "stage";
+	}
+}
+
+class StageWatchdog
+{
+public:
+	static const uint32_t SampleEvery = 16; // a power of two
+	static const uint32_t MinSamples = 32;  // before the first verdict and after each stage off
+
+	// Whether to time this call.
+	bool Sample() { return (++calls & (SampleEvery - 1)) == 0; }
+
+	// Adds a timed call. Returns the stage to turn off, the first of the active ones that can be,
+	// once the average is over the budget, or 0. The average starts over after a stage is off.
+	uint32_t Judge(uint64_t cycles, double budgetCycles, uint32_t activeStages, double &averageCycles)
+	{
+		samples++;
+		average += ((double) cycles - average) / (double) (samples < MinSamples ? samples : MinSamples);
+		averageCycles = average;
+		if (samples < MinSamples || average <= budgetCycles)
+			return 0;
+
+		uint32_t degradable = activeStages & DegradableStages;
+		if (!degradable)
+			return 0;
+
+		samples = 0;
+		average = 0.0;
+		return degradable & (~degradable + 1);
+	}
+
+private:
+	uint32_t calls = 0;
+	uint32_t samples = 0;
+	double average = 0.0; // cycles, the mean of the first samples, then exponentially weighted
+};
@@ -0,0 +1,202 @@
+#include "TransformTable.h"
+
+TransformTable::TransformTable()
+{
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		transforms[id] = IdentityPoseTransform();
+		mounts[id] = IdentityPoseTransform();
+		slots[id].sequence.store(0, std::memory_order_relaxed);
+		Publish(id);
+	}
+}
+
+void TransformTable::Set(const protocol::SetDeviceTransform &newTransform)
+{
+	if (newTransform.openVRID >= vr::k_unMaxTrackedDeviceCount)
+		return;
+
+	auto &tf = transforms[newTransform.openVRID];
+	tf.enabled = newTransform.enabled;
+
+	if (newTransform.updateTranslation)
+		SetPoseTransformTranslation(tf, newTransform.translation);
+
+	if (newTransform.updateRotation)
+		SetPoseTransformRotation(tf, newTransform.rotation);
+
+	Publish(newTransform.openVRID);
+}
+
+void TransformTable::SetMount(uint32_t openVRID, bool enabled, const vr::HmdVector3d_t &translation, const vr::HmdQuaternion_t &rotation)
+{
+	if (openVRID >= vr::k_unMaxTrackedDeviceCount)
+		return;
+
+	auto &mount = mounts[openVRID];
+	mount.enabled = enabled;
+	SetPoseTransformTranslation(mount, translation);
+	SetPoseTransformRotation(mount, rotation);
+	Publish(openVRID);
+}
+
+void TransformTable::Publish(uint32_t openVRID)
+{
+	auto &tf = transforms[openVRID];
+	auto &slot = slots[openVRID];
+
+	uint64_t seq = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(seq + 1, std::memory_order_relaxed);
+
+	slot.enabled.store(tf.enabled, std::memory_order_release);
+	for (int i = 0; i < 3; i++)
+		slot.translation[i].store(tf.translation[i], std::memory_order_release);
+
+	for (int i = 0; i < 4; i++)
+		slot.rotation[i].store(tf.rotation[i], std::memory_order_release);
+
+	for (int i = 0; i < 9; i++)
+		slot.matrix[i].store(tf.columns[i % 3][i / 3], std::memory_order_release);
+
+	auto &mount = mounts[openVRID];
+	slot.mountEnabled.store(mount.enabled, std::memory_order_release);
+	for (int i = 0; i < 3; i++)
+		slot.mountTranslation[i].store(mount.translation[i], std::memory_order_release);
+	for (int i = 0; i < 4; i++)
+		slot.mountRotation[i].store(mount.rotation[i], std::memory_order_release);
+
+	slot.sequence.store(seq + 2, std::memory_order_release);
+
+	// Set runs on one thread at a time, so a plain read-modify-write is enough.
+	uint64_t bit = 1ull << openVRID, mask = enabledMask.load(std::memory_order_relaxed);
+	enabledMask.store(tf.enabled || mount.enabled ? mask | bit : mask & ~bit, std::memory_order_relaxed);
+}
+
+bool TransformTable::Apply(uint32_t openVRID, vr::DriverPose_t &pose) const
+{
+	return ApplyParts(openVRID, pose, true);
+}
+
+bool TransformTable::ApplyMount(uint32_t openVRID, vr::DriverPose_t &pose) const
+{
+	return ApplyParts(openVRID, pose, false);
+}
+
+inline bool TransformTable::ApplyParts(uint32_t openVRID, vr::DriverPose_t &pose, bool world) const
+{
+	auto &slot = slots[openVRID];
+	const auto acquire = std::memory_order_acquire;
+
+	auto &q = pose.qWorldFromDriverRotation;
+	auto &t = pose.vecWorldFromDriverTranslation;
+	vr::HmdQuaternion_t rotation;
+	double translation[3];
+
+	auto &hq = pose.qDriverFromHeadRotation;
+	auto &ht = pose.vecDriverFromHeadTranslation;
+	vr::HmdQuaternion_t mountRotation;
+	double mountTranslation[3];
+
+	// Computes into locals and only writes the pose once the slot is known not to have changed.
+	for (;;)
+	{
+		uint64_t seq = slot.sequence.load(acquire);
+		if (seq & 1)
+			continue;
+
+		bool enabled = world && slot.enabled.load(acquire);
+		if (enabled)
+		{
+			double w = slot.rotation[0].load(acquire), x = slot.rotation[1].load(acquire);
+			double y = slot.rotation[2].load(acquire), z = slot.rotation[3].load(acquire);
+			rotation = {
+				(w * q.w) - (x * q.x) - (y * q.y) - (z * q.z),
+				(w * q.x) + (x * q.w) + (y * q.z) - (z * q.y),
+				(w * q.y) - (x * q.z) + (y * q.w) + (z * q.x),
+				(w * q.z) + (x * q.y) - (y * q.x) + (z * q.w)
+			};
+
+			for (int i = 0; i < 3; i++)
+			{
+				translation[i] = slot.matrix[3 * i].load(acquire) * t[0] + slot.matrix[3 * i + 1].load(acquire) * t[1] +
+					slot.matrix[3 * i + 2].load(acquire) * t[2] + slot.translation[i].load(acquire);
+			}
+		}
+
+		// The mount offset follows the driver's own driver-from-head offset: its rotation multiplies
+		// from the right, and its translation is turned by the pose's rotation, as
+		// v + w * u + (x, y, z) x u with u = 2 (x, y, z) x v.
+		bool mounted = slot.mountEnabled.load(acquire);
+		if (mounted)
+		{
+			double w = slot.mountRotation[0].load(acquire), x = slot.mountRotation[1].load(acquire);
+			double y = slot.mountRotation[2].load(acquire), z = slot.mountRotation[3].load(acquire);
+			mountRotation = {
+				(hq.w * w) - (hq.x * x) - (hq.y * y) - (hq.z * z),
+				(hq.w * x) + (hq.x * w) + (hq.y * z) - (hq.z * y),
+				(hq.w * y) - (hq.x * z) + (hq.y * w) + (hq.z * x),
+				(hq.w * z) + (hq.x * y) - (hq.y * x) + (hq.z * w)
+			};
+
+			double v[3] = { slot.mountTranslation[0].load(acquire), slot.mountTranslation[1].load(acquire), slot.mountTranslation[2].load(acquire) };
+			double u[3] = {
+				2.0 * (hq.y * v[2] - hq.z * v[1]),
+				2.0 * (hq.z * v[0] - hq.x * v[2]),
+				2.0 * (hq.x * v[1] - hq.y * v[0])
+			};
+			mountTranslation[0] = ht[0] + v[0] + hq.w * u[0] + (hq.y * u[2] - hq.z * u[1]);
+			mountTranslation[1] = ht[1] + v[1] + hq.w * u[1] + (hq.z * u[0] - hq.x * u[2]);
+			mountTranslation[2] = ht[2] + v[2] + hq.w * u[2] + (hq.x * u[1] - hq.y * u[0]);
+		}
+
+		if (slot.sequence.load(std::memory_order_relaxed) != seq)
+			continue;
+		if (!enabled && !mounted)
+			return false;
+
+		if (enabled)
+		{
+			q = rotation;
+			t[0] = translation[0];
+			t[1] = translation[1];
+			t[2] = translation[2];
+		}
+
+		if (mounted)
+		{
+			hq = mountRotation;
+			ht[0] = mountTranslation[0];
+			ht[1] = mountTranslation[1];
+			ht[2] = mountTranslation[2];
+		}
+		return true;
+	}
+}
+
+bool TransformTable::Get(uint32_t openVRID, PoseTransform &tf) const
+{
+	auto &slot = slots[openVRID];
+	const auto acquire = std::memory_order_acquire;
+
+	for (;;)
+	{
+		uint64_t seq = slot.sequence.load(acquire);
+		if (seq & 1)
+			continue;
+
+		tf.enabled = slot.enabled.load(acquire);
+		for (int i = 0; i < 3; i++)
+			tf.translation[i] = slot.translation[i].load(acquire);
+		for (int i = 0; i < 4; i++)
+			tf.rotation[i] = slot.rotation[i].load(acquire);
+		for (int i = 0; i < 9; i++)
+			tf.columns[i % 3][i / 3] = slot.matrix[i].load(acquire);
+
+		if (slot.sequence.load(std::memory_order_relaxed) == seq)
+			break;
+	}
+
+	tf.translation[3] = 0.0;
+	tf.columns[0][3] = tf.columns[1][3] = tf.columns[2][3] = 0.0;
+	return tf.enabled;
+}
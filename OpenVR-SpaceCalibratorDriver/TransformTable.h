@@ -0,0 +1,83 @@
+#pragma once
+
+// The calibration transform of every device slot. The IPC thread sets transforms while SteamVR's
+// pose threads apply them; each slot is guarded by a sequence number like SeqLock, so a pose
+// thread never waits for the IPC thread and never applies half of an update.
+//
+// Everything the pose path needs is derived when a transform is set: the rotation is normalized
+// and expanded into a matrix, so applying a transform takes one quaternion product for the
+// orientation and one matrix-vector multiply-add for the translation. Pose threads read the
+// fields in place rather than copying the slot out first, which would cost more than the math.
+//
+// A slot can also hold a mount offset, which moves the device within its own space rather than
+// its tracking space, so it is applied to the pose's driver-from-head transform instead. Both
+// parts are prepared when either is set and read under the same sequence number, so a pose sees
+// them from the same moment and pays for one slot read.
+//
+// Which slots have either part enabled is also kept in one bitmask, so the pose hook can forward
+// the poses of devices without a transform, usually most of them, without copying or touching
+// their slots.
+//
+// The same math is available for many poses at once through PoseKernel, with the transforms
+// taken from the table by Get; the kernels do not apply mount offsets.
+
+#include "../Protocol.h"
+#include "PoseKernel.h"
+#include "SeqLock.h"
+
+#include <atomic>
+
+class TransformTable
+{
+public:
+	TransformTable();
+
+	// One thread at a time, usually the IPC thread. Requests that only update the translation or the
+	// rotation keep the other part.
+	void Set(const protocol::SetDeviceTransform &newTransform);
+
+	// Like Set, for the slot's mount offset, which replaces the previous one whole.
+	void SetMount(uint32_t openVRID, bool enabled, const vr::HmdVector3d_t &translation, const vr::HmdQuaternion_t &rotation);
+	bool MountEnabled(uint32_t openVRID) const { return mounts[openVRID].enabled; } // Set's thread
+
+	// Pose threads. Returns whether a transform or mount offset was applied.
+	bool Apply(uint32_t openVRID, vr::DriverPose_t &pose) const;
+
+	// Pose threads. Only the mount offset, for devices whose transform comes from elsewhere.
+	bool ApplyMount(uint32_t openVRID, vr::DriverPose_t &pose) const;
+
+	// Any thread. Copies the slot's transform out for the pose kernels, without the mount offset,
+	// and returns whether it is enabled.
+	bool Get(uint32_t openVRID, PoseTransform &tf) const;
+
+	// Any thread, any ID. Apply still checks the slot, so a pose racing with an update is safe either way.
+	bool Enabled(uint32_t openVRID) const
+	{
+		return openVRID < vr::k_unMaxTrackedDeviceCount && (enabledMask.load(std::memory_order_relaxed) >> openVRID) & 1;
+	}
+
+private:
+	// Fields are atomic so reads racing with an update are well defined; the sequence tells the
+	// reader to retry. Stored with release and loaded with acquire, as in SeqLock.
+	struct alignas(CacheLineSize) Slot
+	{
+		std::atomic<uint64_t> sequence; // odd while the IPC thread updates the slot
+		std::atomic<bool> enabled;
+		std::atomic<double> translation[3];
+		std::atomic<double> rotation[4]; // w, x, y, z
+		std::atomic<double> matrix[9];   // row major
+		std::atomic<bool> mountEnabled;
+		std::atomic<double> mountTranslation[3];
+		std::atomic<double> mountRotation[4]; // w, x, y, z, normalized
+	};
+
+	void Publish(uint32_t openVRID);
+	bool ApplyParts(uint32_t openVRID, vr::DriverPose_t &pose, bool world) const;
+
+	static_assert(vr::k_unMaxTrackedDeviceCount <= 64, "one enabled bit per device");
+
+	PoseTransform transforms[vr::k_unMaxTrackedDeviceCount]; // the writer's copies
+	PoseTransform mounts[vr::k_unMaxTrackedDeviceCount];
+	Slot slots[vr::k_unMaxTrackedDeviceCount];
+	std::atomic<uint64_t> enabledMask { 0 };
+};
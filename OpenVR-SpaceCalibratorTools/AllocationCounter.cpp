@@ -0,0 +1,114 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> Allocations(0), Frees(0), AllocatedBytes(0);
+
+AllocationCounts CurrentAllocationCounts()
+{
+	AllocationCounts counts;
+	counts.allocations = Allocations.load(std::memory_order_relaxed);
+	counts.frees = Frees.load(std::memory_order_relaxed);
+	counts.bytes = AllocatedBytes.load(std::memory_order_relaxed);
+	return counts;
+}
+
+static inline void CountAlloc(size_t size)
+{
+	Allocations.fetch_add(1, std::memory_order_relaxed);
+	AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static inline void CountFree(void *ptr)
+{
+	if (ptr)
+		Frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+
+// glibc lets the executable interpose the allocator entry points, and exports the
+// real implementations under their __libc_ names.
+extern "C"
+{
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *ptr, size_t size);
+	void *__libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void *ptr);
+
+	void *malloc(size_t size)
+	{
+		CountAlloc(size);
+		return __libc_malloc(size);
+	}
+
+	void *calloc(size_t count, size_t size)
+	{
+		CountAlloc(count * size);
+		return __libc_calloc(count, size);
+	}
+
+	void *realloc(void *ptr, size_t size)
+	{
+		CountAlloc(size);
+		if (ptr)
+			CountFree(ptr);
+		return __libc_realloc(ptr, size);
+	}
+
+	void *memalign(size_t alignment, size_t size)
+	{
+		CountAlloc(size);
+		return __libc_memalign(alignment, size);
+	}
+
+	void *aligned_alloc(size_t alignment, size_t size)
+	{
+		CountAlloc(size);
+		return __libc_memalign(alignment, size);
+	}
+
+	int posix_memalign(void **ptr, size_t alignment, size_t size)
+	{
+		CountAlloc(size);
+		*ptr = __libc_memalign(alignment, size);
+		return *ptr ? 0 : ENOMEM;
+	}
+
+	void free(void *ptr)
+	{
+		CountFree(ptr);
+		__libc_free(ptr);
+	}
+}
+
+#else
+
+static void *CountedNew(size_t size)
+{
+	CountAlloc(size);
+
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+static void CountedDelete(void *ptr)
+{
+	CountFree(ptr);
+	free(ptr);
+}
+
+void *operator new(size_t size) { return CountedNew(size); }
+void *operator new[](size_t size) { return CountedNew(size); }
+void operator delete(void *ptr) noexcept { CountedDelete(ptr); }
+void operator delete[](void *ptr) noexcept { CountedDelete(ptr); }
+void operator delete(void *ptr, size_t) noexcept { CountedDelete(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { CountedDelete(ptr); }
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Process-wide heap allocation counters for the tools binary.
+//
+// With glibc the C allocation functions are interposed, which covers both C++ containers
+// and Eigen (which allocates through std::malloc). Elsewhere the global operator new/delete
+// are replaced instead, so Eigen's dynamic matrices are not visible in the counts.
+struct AllocationCounts
+{
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t bytes = 0;
+};
+
+AllocationCounts CurrentAllocationCounts();
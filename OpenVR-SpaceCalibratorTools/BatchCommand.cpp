@@ -0,0 +1,294 @@
+#include "Tools.h"
+#include "TraceCalibration.h"
+#include "../OpenVR-SpaceCalibrator/ProfileJson.h"
+
+#include <picojson.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+struct BatchEntry
+{
+	std::string path, profilePath;
+	TraceCalibration result;
+	double wallMs = 0.0;
+};
+
+static std::string BaseName(const std::string &path)
+{
+	size_t slash = path.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+static void ReadList(const std::string &listPath, std::vector<std::string> &paths)
+{
+	std::ifstream in(listPath);
+	if (!in)
+		throw std::runtime_error("cannot open list " + listPath);
+
+	std::string line;
+	while (std::getline(in, line))
+	{
+		while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+			line.pop_back();
+		if (!line.empty() && line[0] != '#')
+			paths.push_back(line);
+	}
+}
+
+static void LoadPreset(const std::string &path, TraceCalibrationOptions &options)
+{
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error("cannot open preset " + path);
+
+	CalibrationContext::Preset preset;
+	ParsePreset(preset, in);
+	options.sampleCount = preset.sampleCount;
+	options.gates = preset.gates;
+}
+
+static void CalibrateEntry(BatchEntry &entry, const TraceCalibrationOptions &options, const std::string &outDir, CalibrationWorkspace &workspace)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	try
+	{
+		PoseTraceReader trace;
+		trace.Open(entry.path);
+		entry.result = CalibrateTrace(trace, options, workspace);
+	}
+	catch (const std::runtime_error &e)
+	{
+		entry.result = TraceCalibration();
+		entry.result.message = e.what();
+	}
+
+	if (entry.result.status == TraceCalibration::Ok && !outDir.empty())
+	{
+		CalibrationContext ctx;
+		ToProfile(entry.result, ctx);
+
+		entry.profilePath = outDir + "/" + BaseName(entry.path) + ".json";
+		std::ofstream out(entry.profilePath);
+		WriteProfile(ctx, out);
+		if (!out)
+		{
+			entry.result.status = TraceCalibration::Error;
+			entry.result.message = "cannot write profile " + entry.profilePath;
+			entry.profilePath.clear();
+		}
+	}
+
+	entry.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string CsvField(const std::string &text)
+{
+	if (text.find_first_of(",\"\n") == std::string::npos)
+		return text;
+
+	std::string quoted = "\"";
+	for (char c : text)
+		quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+	return quoted + "\"";
+}
+
+static void WriteCsv(const std::string &path, const std::vector<BatchEntry> &entries)
+{
+	std::ofstream csv(path);
+	if (!csv)
+		throw std::runtime_error("cannot write " + path);
+
+	csv << "trace,status,reference,target,reference_system,target_system,ticks,samples,deltas,"
+		"yaw,pitch,roll,x,y,z,rotation_std_x,rotation_std_y,rotation_std_z,translation_std_x,translation_std_y,translation_std_z,"
+		"rotation_fallback,translation_fallback,recalibrate,collection_s,solve_ms,uncertainty_ms,wall_ms,profile,message\n";
+
+	for (auto &e : entries)
+	{
+		auto &r = e.result;
+		auto &u = r.uncertainty;
+		csv << CsvField(e.path) << "," << StatusName(r.status) << "," << r.reference << "," << r.target << ","
+			<< CsvField(r.referenceTrackingSystem) << "," << CsvField(r.targetTrackingSystem) << ","
+			<< r.ticks << "," << r.sampleCount << "," << r.rotationDeltas << ","
+			<< r.rotation(1) << "," << r.rotation(2) << "," << r.rotation(0) << ","
+			<< r.translation(0) << "," << r.translation(1) << "," << r.translation(2) << ","
+			<< u.rotation(0) << "," << u.rotation(1) << "," << u.rotation(2) << ","
+			<< u.translation(0) << "," << u.translation(1) << "," << u.translation(2) << ","
+			<< r.rotationFallback << "," << r.translationFallback << "," << (u.valid && u.TooHigh()) << ","
+			<< r.collectionSeconds << "," << r.solveMs << "," << r.uncertaintyMs << "," << e.wallMs << ","
+			<< CsvField(e.profilePath) << "," << CsvField(r.message) << "\n";
+	}
+}
+
+static picojson::array Triple(const Eigen::Vector3d &v)
+{
+	picojson::array arr;
+	for (int i = 0; i < 3; i++)
+		arr.push_back(picojson::value(v(i)));
+	return arr;
+}
+
+static void WriteJson(const std::string &path, const std::vector<BatchEntry> &entries)
+{
+	picojson::array list;
+	for (auto &e : entries)
+	{
+		auto &r = e.result;
+		picojson::object obj;
+		obj["trace"].set<std::string>(e.path);
+		obj["status"].set<std::string>(StatusName(r.status));
+		if (!r.message.empty())
+			obj["message"].set<std::string>(r.message);
+		obj["ticks"] = picojson::value((double) r.ticks);
+		obj["wall_ms"] = picojson::value(e.wallMs);
+
+		if (r.status != TraceCalibration::Error)
+		{
+			obj["reference"] = picojson::value((double) r.reference);
+			obj["target"] = picojson::value((double) r.target);
+			obj["reference_tracking_system"].set<std::string>(r.referenceTrackingSystem);
+			obj["target_tracking_system"].set<std::string>(r.targetTrackingSystem);
+			obj["samples"] = picojson::value((double) r.sampleCount);
+		}
+
+		if (r.status == TraceCalibration::Ok)
+		{
+			obj["deltas"] = picojson::value((double) r.rotationDeltas);
+			obj["yaw"] = picojson::value(r.rotation(1));
+			obj["pitch"] = picojson::value(r.rotation(2));
+			obj["roll"] = picojson::value(r.rotation(0));
+			obj["x"] = picojson::value(r.translation(0));
+			obj["y"] = picojson::value(r.translation(1));
+			obj["z"] = picojson::value(r.translation(2));
+			obj["rotation_fallback"] = picojson::value(r.rotationFallback);
+			obj["translation_fallback"] = picojson::value(r.translationFallback);
+			obj["collection_s"] = picojson::value(r.collectionSeconds);
+			obj["solve_ms"] = picojson::value(r.solveMs);
+
+			if (r.uncertainty.valid)
+			{
+				obj["rotation_std_deg"].set<picojson::array>(Triple(r.uncertainty.rotation));
+				obj["translation_std_cm"].set<picojson::array>(Triple(r.uncertainty.translation));
+				obj["recalibrate"] = picojson::value(r.uncertainty.TooHigh());
+				obj["uncertainty_ms"] = picojson::value(r.uncertaintyMs);
+			}
+
+			if (!e.profilePath.empty())
+				obj["profile"].set<std::string>(e.profilePath);
+		}
+
+		list.push_back(picojson::value(obj));
+	}
+
+	std::ofstream out(path);
+	if (!out)
+		throw std::runtime_error("cannot write " + path);
+
+	out << picojson::value(list).serialize(true);
+}
+
+int RunBatch(int argc, char **argv)
+{
+	std::vector<std::string> paths;
+	std::string outDir, csvPath, jsonPath;
+	TraceCalibrationOptions options;
+	unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--list")
+			ReadList(OptionValue(i, argc, argv), paths);
+		else if (arg == "--out")
+			outDir = OptionValue(i, argc, argv);
+		else if (arg == "--csv")
+			csvPath = OptionValue(i, argc, argv);
+		else if (arg == "--json")
+			jsonPath = OptionValue(i, argc, argv);
+		else if (arg == "--jobs")
+			jobs = (unsigned) std::max(1, std::stoi(OptionValue(i, argc, argv)));
+		else if (arg == "--samples")
+			options.sampleCount = (size_t) std::stoul(OptionValue(i, argc, argv));
+		else if (arg == "--preset")
+			LoadPreset(OptionValue(i, argc, argv), options);
+		else if (arg == "--precision")
+			options.precision = ParsePrecision(OptionValue(i, argc, argv));
+		else if (arg == "--reference")
+			options.reference = std::stoi(OptionValue(i, argc, argv));
+		else if (arg == "--target")
+			options.target = std::stoi(OptionValue(i, argc, argv));
+		else if (arg == "--no-uncertainty")
+			options.uncertainty = false;
+		else if (arg.compare(0, 2, "--") == 0)
+			throw std::runtime_error("unknown option " + arg);
+		else
+			paths.push_back(arg);
+	}
+
+	if (paths.empty())
+		throw std::runtime_error("expected trace files");
+
+	std::vector<BatchEntry> entries(paths.size());
+	for (size_t i = 0; i < paths.size(); i++)
+		entries[i].path = paths[i];
+
+	jobs = std::min<unsigned>(jobs, (unsigned) entries.size());
+
+	// Workers pull the next trace from a shared counter, so one long trace does not hold up a
+	// fixed share of the others. Each worker keeps its workspace warm across its traces.
+	std::atomic<size_t> next(0);
+	std::mutex printMutex;
+	size_t done = 0;
+
+	auto worker = [&] {
+		CalibrationWorkspace workspace;
+		for (size_t i = next++; i < entries.size(); i = next++)
+		{
+			auto &entry = entries[i];
+			CalibrateEntry(entry, options, outDir, workspace);
+
+			std::lock_guard<std::mutex> lock(printMutex);
+			auto &r = entry.result;
+			printf("[%zu/%zu] %s: %s", ++done, entries.size(), entry.path.c_str(), StatusName(r.status));
+			if (r.status == TraceCalibration::Ok)
+				printf(" yaw=%.2f pitch=%.2f roll=%.2f x=%.2f y=%.2f z=%.2f%s", r.rotation(1), r.rotation(2), r.rotation(0),
+					r.translation(0), r.translation(1), r.translation(2), r.uncertainty.valid && r.uncertainty.TooHigh() ? " (recalibrate)" : "");
+			else
+				printf(" (%s)", r.message.c_str());
+			printf("\n");
+			fflush(stdout);
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned t = 1; t < jobs; t++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &thread : threads)
+		thread.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t counts[4] = {};
+	for (auto &entry : entries)
+		counts[entry.result.status]++;
+
+	printf("\n%zu traces in %.2f s on %u threads: %zu ok, %zu aborted, %zu incomplete, %zu errors\n", entries.size(), seconds, jobs,
+		counts[TraceCalibration::Ok], counts[TraceCalibration::Aborted], counts[TraceCalibration::Incomplete], counts[TraceCalibration::Error]);
+
+	if (!csvPath.empty())
+		WriteCsv(csvPath, entries);
+	if (!jsonPath.empty())
+		WriteJson(jsonPath, entries);
+
+	return counts[TraceCalibration::Error] ? 1 : 0;
+}
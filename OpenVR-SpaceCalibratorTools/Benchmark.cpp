@@ -0,0 +1,94 @@
+#include "Benchmark.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+const void *volatile BenchmarkSink = nullptr;
+
+struct RegisteredBenchmark
+{
+	std::string name;
+	BenchmarkFunc func;
+	std::vector<int64_t> args;
+};
+
+static std::vector<RegisteredBenchmark> &Registry()
+{
+	static std::vector<RegisteredBenchmark> benchmarks;
+	return benchmarks;
+}
+
+BenchmarkRegistration::BenchmarkRegistration(const char *name, BenchmarkFunc func, std::vector<int64_t> args)
+{
+	Registry().push_back({ name, func, args });
+}
+
+size_t PeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return (size_t) usage.ru_maxrss * 1024;
+	return 0;
+#endif
+}
+
+static BenchmarkState RunOnce(const RegisteredBenchmark &benchmark, int64_t arg, double minSeconds)
+{
+	uint64_t iterations = 1;
+	for (;;)
+	{
+		BenchmarkState state(arg, iterations);
+		benchmark.func(state);
+
+		if (state.ElapsedSeconds() >= minSeconds || iterations >= (1ull << 30))
+			return state;
+
+		// Aim a bit past the minimum time, growing at most 10x per round like google-benchmark.
+		double perIteration = state.ElapsedSeconds() / iterations;
+		double wanted = perIteration > 0.0 ? minSeconds * 1.4 / perIteration : iterations * 10.0;
+		uint64_t next = (uint64_t) wanted;
+		if (next > iterations * 10)
+			next = iterations * 10;
+		iterations = next > iterations ? next : iterations + 1;
+	}
+}
+
+void RunRegisteredBenchmarks(const std::string &filter, double minSeconds)
+{
+	printf("%-34s %14s %11s %11s %12s %14s %10s\n", "Benchmark", "Time", "Iterations", "ns/item", "allocs/iter", "bytes/iter", "Peak RSS");
+	printf("%s\n", std::string(112, '-').c_str());
+
+	for (auto &benchmark : Registry())
+	{
+		for (auto arg : benchmark.args)
+		{
+			std::string name = benchmark.name + "/" + std::to_string(arg);
+			if (!filter.empty() && name.find(filter) == std::string::npos)
+				continue;
+
+			auto state = RunOnce(benchmark, arg, minSeconds);
+			double iterations = (double) state.Iterations();
+			double nsPerIteration = state.ElapsedSeconds() * 1e9 / iterations;
+			double nsPerItem = state.ItemsPerIteration() > 0.0 ? nsPerIteration / state.ItemsPerIteration() : nsPerIteration;
+
+			printf("%-34s %11.0f ns %11llu %11.2f %12.1f %14.0f %7.1f MB\n",
+				name.c_str(), nsPerIteration, (unsigned long long) state.Iterations(), nsPerItem,
+				state.Allocations().allocations / iterations, state.Allocations().bytes / iterations,
+				PeakResidentBytes() / (1024.0 * 1024.0));
+			fflush(stdout);
+		}
+	}
+}
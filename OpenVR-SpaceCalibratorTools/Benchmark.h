@@ -0,0 +1,89 @@
+#pragma once
+
+// Minimal benchmark harness modelled on google-benchmark: benchmarks register themselves
+// with a list of arguments and loop on state.KeepRunning(). Setup done before the loop
+// is excluded from both timing and allocation counts.
+
+#include "AllocationCounter.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BenchmarkState
+{
+public:
+	BenchmarkState(int64_t arg, uint64_t iterations) : arg(arg), maxIterations(iterations) { }
+
+	bool KeepRunning()
+	{
+		if (iterations == 0)
+			Start();
+
+		if (iterations < maxIterations)
+		{
+			iterations++;
+			return true;
+		}
+
+		Stop();
+		return false;
+	}
+
+	int64_t range() const { return arg; }
+
+	// Work items (e.g. sample pairs) processed per iteration, used to report time per item.
+	void SetItemsPerIteration(double items) { itemsPerIteration = items; }
+
+	double ElapsedSeconds() const { return elapsed; }
+	uint64_t Iterations() const { return iterations; }
+	double ItemsPerIteration() const { return itemsPerIteration; }
+	const AllocationCounts &Allocations() const { return allocations; }
+
+private:
+	void Start()
+	{
+		startAllocations = CurrentAllocationCounts();
+		startTime = std::chrono::steady_clock::now();
+	}
+
+	void Stop()
+	{
+		auto endTime = std::chrono::steady_clock::now();
+		auto endAllocations = CurrentAllocationCounts();
+		elapsed = std::chrono::duration<double>(endTime - startTime).count();
+		allocations.allocations = endAllocations.allocations - startAllocations.allocations;
+		allocations.frees = endAllocations.frees - startAllocations.frees;
+		allocations.bytes = endAllocations.bytes - startAllocations.bytes;
+	}
+
+	int64_t arg;
+	uint64_t maxIterations, iterations = 0;
+	double itemsPerIteration = 0.0, elapsed = 0.0;
+	std::chrono::steady_clock::time_point startTime;
+	AllocationCounts startAllocations, allocations;
+};
+
+typedef void (*BenchmarkFunc)(BenchmarkState &state);
+
+struct BenchmarkRegistration
+{
+	BenchmarkRegistration(const char *name, BenchmarkFunc func, std::vector<int64_t> args);
+};
+
+#define BENCHMARK_ARGS(func, ...) \
+	static BenchmarkRegistration func##Registration(#func, func, { __VA_ARGS__ })
+
+extern const void *volatile BenchmarkSink;
+
+// Keeps the compiler from discarding a computed value.
+template<class T> inline void DoNotOptimize(const T &value)
+{
+	BenchmarkSink = &value;
+}
+
+size_t PeakResidentBytes();
+
+// Runs every registered benchmark whose name contains filter, and prints a result table.
+void RunRegisteredBenchmarks(const std::string &filter, double minSeconds);
@@ -0,0 +1,279 @@
+#include "Tools.h"
+#include "Benchmark.h"
+#include "SyntheticSamples.h"
+
+#include <Eigen/Dense>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+
+// Sample counts of the calibration speeds, plus a large stress size.
+#define CALIBRATION_SIZES 100, 250, 500, 2000
+
+static const std::vector<Sample> &RotationSamples(int64_t n)
+{
+	static std::map<int64_t, std::vector<Sample>> cache;
+	auto &samples = cache[n];
+	if (samples.empty())
+	{
+		auto scenario = StandardScenarios()[1];
+		scenario.sampleCount = (size_t) n;
+		samples = GenerateRotationSamples(scenario);
+	}
+	return samples;
+}
+
+static const std::vector<Sample> &TranslationSamples(int64_t n)
+{
+	static std::map<int64_t, std::vector<Sample>> cache;
+	auto &samples = cache[n];
+	if (samples.empty())
+	{
+		auto scenario = StandardScenarios()[1];
+		scenario.sampleCount = (size_t) n;
+		samples = GenerateTranslationSamples(scenario, scenario.rotation);
+	}
+	return samples;
+}
+
+static double PairCount(int64_t n)
+{
+	return (double) n * (double) (n - 1) / 2.0;
+}
+
+static void BM_DeltaRotationSamples(BenchmarkState &state)
+{
+	auto &samples = RotationSamples(state.range());
+	state.SetItemsPerIteration(PairCount(state.range()));
+
+	while (state.KeepRunning())
+	{
+		size_t valid = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+			for (size_t j = 0; j < i; j++)
+				valid += DeltaRotationSamples(samples[i], samples[j]).valid;
+		DoNotOptimize(valid);
+	}
+}
+BENCHMARK_ARGS(BM_DeltaRotationSamples, CALIBRATION_SIZES);
+
+static void BM_RotationPairLoop(BenchmarkState &state)
+{
+	auto &samples = RotationSamples(state.range());
+	CalibrationWorkspace workspace;
+	state.SetItemsPerIteration(PairCount(state.range()));
+
+	while (state.KeepRunning())
+	{
+		auto acc = AccumulateRotationDeltas(samples, workspace);
+		DoNotOptimize(acc);
+	}
+}
+BENCHMARK_ARGS(BM_RotationPairLoop, CALIBRATION_SIZES);
+
+static void BM_TranslationPairLoop(BenchmarkState &state)
+{
+	auto &samples = TranslationSamples(state.range());
+	CalibrationWorkspace workspace;
+	AccumulateTranslationSystem(samples, workspace);
+	state.SetItemsPerIteration(PairCount(state.range()));
+
+	while (state.KeepRunning())
+	{
+		auto acc = AccumulateTranslationSystem(samples, workspace);
+		DoNotOptimize(acc);
+	}
+}
+BENCHMARK_ARGS(BM_TranslationPairLoop, CALIBRATION_SIZES);
+
+static void BM_RotationPairLoopMixed(BenchmarkState &state)
+{
+	auto &samples = RotationSamples(state.range());
+	CalibrationWorkspace workspace;
+	AccumulateRotationDeltasMixed(samples, workspace);
+	state.SetItemsPerIteration(PairCount(state.range()));
+
+	while (state.KeepRunning())
+	{
+		auto acc = AccumulateRotationDeltasMixed(samples, workspace);
+		DoNotOptimize(acc);
+	}
+}
+BENCHMARK_ARGS(BM_RotationPairLoopMixed, CALIBRATION_SIZES);
+
+static void BM_TranslationPairLoopMixed(BenchmarkState &state)
+{
+	auto &samples = TranslationSamples(state.range());
+	CalibrationWorkspace workspace;
+	AccumulateTranslationSystemMixed(samples, workspace);
+	state.SetItemsPerIteration(PairCount(state.range()));
+
+	while (state.KeepRunning())
+	{
+		auto acc = AccumulateTranslationSystemMixed(samples, workspace);
+		DoNotOptimize(acc);
+	}
+}
+BENCHMARK_ARGS(BM_TranslationPairLoopMixed, CALIBRATION_SIZES);
+
+static void BM_KabschSVD(BenchmarkState &state)
+{
+	CalibrationWorkspace workspace;
+	auto acc = AccumulateRotationDeltas(RotationSamples(state.range()), workspace);
+
+	while (state.KeepRunning())
+	{
+		Eigen::Matrix3d rot = SolveRotationKabsch(acc);
+		DoNotOptimize(rot);
+	}
+}
+BENCHMARK_ARGS(BM_KabschSVD, CALIBRATION_SIZES);
+
+static void BM_TranslationSolve(BenchmarkState &state)
+{
+	CalibrationWorkspace workspace;
+	auto acc = AccumulateTranslationSystem(TranslationSamples(state.range()), workspace);
+
+	while (state.KeepRunning())
+	{
+		Eigen::Vector3d trans = SolveTranslationSystem(acc);
+		DoNotOptimize(trans);
+	}
+}
+BENCHMARK_ARGS(BM_TranslationSolve, CALIBRATION_SIZES);
+
+static void BM_CalibrateRotation(BenchmarkState &state)
+{
+	auto &samples = RotationSamples(state.range());
+	CalibrationWorkspace workspace;
+	CalibrateRotation(samples, workspace);
+	state.SetItemsPerIteration(PairCount(state.range()));
+
+	while (state.KeepRunning())
+	{
+		Eigen::Vector3d euler = CalibrateRotation(samples, workspace);
+		DoNotOptimize(euler);
+	}
+}
+BENCHMARK_ARGS(BM_CalibrateRotation, CALIBRATION_SIZES);
+
+static void BM_CalibrateTranslation(BenchmarkState &state)
+{
+	auto &samples = TranslationSamples(state.range());
+	CalibrationWorkspace workspace;
+	CalibrateTranslation(samples, workspace);
+	state.SetItemsPerIteration(PairCount(state.range()));
+
+	while (state.KeepRunning())
+	{
+		Eigen::Vector3d trans = CalibrateTranslation(samples, workspace);
+		DoNotOptimize(trans);
+	}
+}
+BENCHMARK_ARGS(BM_CalibrateTranslation, CALIBRATION_SIZES);
+
+static void BM_AxisFromRotationMatrix3(BenchmarkState &state)
+{
+	auto &samples = RotationSamples(state.range());
+	state.SetItemsPerIteration((double) samples.size());
+
+	while (state.KeepRunning())
+	{
+		Eigen::Vector3d sum(0, 0, 0);
+		for (auto &sample : samples)
+			sum += AxisFromRotationMatrix3(sample.ref.rot);
+		DoNotOptimize(sum);
+	}
+}
+BENCHMARK_ARGS(BM_AxisFromRotationMatrix3, CALIBRATION_SIZES);
+
+static void BM_VRRotationQuat(BenchmarkState &state)
+{
+	std::vector<Eigen::Vector3d> angles;
+	for (auto &sample : RotationSamples(state.range()))
+		angles.push_back(sample.ref.rot.eulerAngles(2, 1, 0) * 180.0 / EIGEN_PI);
+	state.SetItemsPerIteration((double) angles.size());
+
+	while (state.KeepRunning())
+	{
+		double sum = 0.0;
+		for (auto &euler : angles)
+			sum += VRRotationQuat(euler).w;
+		DoNotOptimize(sum);
+	}
+}
+BENCHMARK_ARGS(BM_VRRotationQuat, CALIBRATION_SIZES);
+
+// Minimum time of func over repeated runs, taking at least minSeconds in total.
+template<class Func> static double BestSeconds(double minSeconds, Func func)
+{
+	double best = 1e30, total = 0.0;
+	do
+	{
+		auto start = std::chrono::steady_clock::now();
+		func();
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = std::min(best, elapsed);
+		total += elapsed;
+	} while (total < minSeconds);
+	return best;
+}
+
+// Compares complete mixed and double precision solves on the benchmark samples.
+static void ReportMixedPrecision(double minSeconds)
+{
+	auto &scenario = StandardScenarios()[1];
+
+	printf("\nMixed precision vs double (%s samples)\n", scenario.name.c_str());
+	printf("%8s %13s %13s %14s %14s %10s\n", "samples", "rot speedup", "trans speedup", "rot delta deg", "trans delta cm", "fallback");
+
+	for (int64_t n : { CALIBRATION_SIZES })
+	{
+		auto &rotationSamples = RotationSamples(n);
+		auto &translationSamples = TranslationSamples(n);
+
+		CalibrationWorkspace full, mixed;
+		mixed.precision = SolverPrecision::Mixed;
+
+		Eigen::Vector3d fullRotation, mixedRotation, fullTranslation, mixedTranslation;
+		double fullRotationTime = BestSeconds(minSeconds, [&] { fullRotation = CalibrateRotation(rotationSamples, full); });
+		double mixedRotationTime = BestSeconds(minSeconds, [&] { mixedRotation = CalibrateRotation(rotationSamples, mixed); });
+		double fullTranslationTime = BestSeconds(minSeconds, [&] { fullTranslation = CalibrateTranslation(translationSamples, full); });
+		double mixedTranslationTime = BestSeconds(minSeconds, [&] { mixedTranslation = CalibrateTranslation(translationSamples, mixed); });
+
+		const char *fallback = mixed.rotationFallback && mixed.translationFallback ? "both"
+			: mixed.rotationFallback ? "rotation"
+			: mixed.translationFallback ? "translation"
+			: "none";
+
+		printf("%8lld %12.2fx %12.2fx %14.6f %14.6f %10s\n", (long long) n,
+			fullRotationTime / mixedRotationTime, fullTranslationTime / mixedTranslationTime,
+			RotationErrorDegrees(mixedRotation, fullRotation), (mixedTranslation - fullTranslation).norm(), fallback);
+	}
+}
+
+int RunBenchmarks(int argc, char **argv)
+{
+	std::string filter;
+	double minSeconds = 0.5;
+
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--filter")
+			filter = OptionValue(i, argc, argv);
+		else if (arg == "--min-time")
+			minSeconds = std::stod(OptionValue(i, argc, argv));
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	RunRegisteredBenchmarks(filter, minSeconds);
+
+	// The report is selected by the filter like a benchmark, under the name of the function.
+	if (std::string("ReportMixedPrecision").find(filter) != std::string::npos)
+		ReportMixedPrecision(minSeconds);
+	return 0;
+}
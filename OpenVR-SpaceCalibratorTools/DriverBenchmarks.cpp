@@ -0,0 +1,294 @@
+#include "Benchmark.h"
+#include "DriverReference.h"
+#include "../OpenVR-SpaceCalibratorDriver/HookTiming.h"
+#include "../OpenVR-SpaceCalibratorDriver/MovingPlatform.h"
+#include "../OpenVR-SpaceCalibratorDriver/PoseFilter.h"
+#include "../OpenVR-SpaceCalibratorDriver/SeqLock.h"
+#include "../OpenVR-SpaceCalibratorDriver/TransformTable.h"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Poses per iteration, spread round robin over the benchmark's device count.
+static const size_t PoseBatch = 1024;
+
+// Random unit transforms for the device slots, and poses with random world-from-driver
+// transforms to apply them to, the same for every benchmark.
+struct DriverBenchmarkData
+{
+	std::vector<ReferenceTransform> transforms;
+	std::vector<vr::DriverPose_t> poses;
+
+	explicit DriverBenchmarkData(size_t devices)
+	{
+		std::mt19937 rng(1);
+		std::normal_distribution<double> normal;
+
+		auto randomRotation = [&]() {
+			vr::HmdQuaternion_t q = { normal(rng), normal(rng), normal(rng), normal(rng) };
+			double norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+			return vr::HmdQuaternion_t { q.w / norm, q.x / norm, q.y / norm, q.z / norm };
+		};
+
+		for (size_t i = 0; i < devices; i++)
+			transforms.push_back({ { normal(rng), normal(rng), normal(rng) }, randomRotation() });
+
+		poses.resize(PoseBatch);
+		for (auto &pose : poses)
+		{
+			memset(&pose, 0, sizeof pose);
+			pose.poseIsValid = true;
+			pose.qWorldFromDriverRotation = randomRotation();
+			for (int i = 0; i < 3; i++)
+				pose.vecWorldFromDriverTranslation[i] = normal(rng);
+		}
+	}
+};
+
+// The reference math from a plain array, the cost of the math alone.
+static void BM_PoseTransformReference(BenchmarkState &state)
+{
+	DriverBenchmarkData data((size_t) state.range());
+	std::vector<vr::DriverPose_t> poses = data.poses;
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < PoseBatch; i++)
+			ReferenceApply(data.transforms[i % data.transforms.size()], poses[i]);
+		DoNotOptimize(poses[0]);
+	}
+}
+BENCHMARK_ARGS(BM_PoseTransformReference, 1, 16);
+
+// The transform table as it was before precomputation: the slot copied out of its SeqLock, then
+// the reference math.
+static void BM_PoseTransformSeqLock(BenchmarkState &state)
+{
+	DriverBenchmarkData data((size_t) state.range());
+	std::vector<vr::DriverPose_t> poses = data.poses;
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	struct Slot
+	{
+		bool enabled;
+		ReferenceTransform transform;
+	};
+
+	std::vector<SeqLock<Slot>> slots(data.transforms.size());
+	for (size_t id = 0; id < data.transforms.size(); id++)
+		slots[id].Store({ true, data.transforms[id] });
+
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < PoseBatch; i++)
+		{
+			auto slot = slots[i % slots.size()].Load();
+			if (slot.enabled)
+				ReferenceApply(slot.transform, poses[i]);
+		}
+		DoNotOptimize(poses[0]);
+	}
+}
+BENCHMARK_ARGS(BM_PoseTransformSeqLock, 1, 16);
+
+// The driver's transform table: slots read in place and precomputed rotation matrices.
+static void BM_PoseTransformTable(BenchmarkState &state)
+{
+	DriverBenchmarkData data((size_t) state.range());
+	std::vector<vr::DriverPose_t> poses = data.poses;
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	TransformTable table;
+	for (uint32_t id = 0; id < data.transforms.size(); id++)
+		table.Set(protocol::SetDeviceTransform(id, true, data.transforms[id].translation, data.transforms[id].rotation));
+
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < PoseBatch; i++)
+			table.Apply((uint32_t) (i % data.transforms.size()), poses[i]);
+		DoNotOptimize(poses[0]);
+	}
+}
+BENCHMARK_ARGS(BM_PoseTransformTable, 1, 16);
+
+// The batch kernels, with each pose's transform looked up by device as in the table benchmark.
+static void PoseKernelBenchmark(BenchmarkState &state, PoseKernel kernel)
+{
+	DriverBenchmarkData data((size_t) state.range());
+	std::vector<vr::DriverPose_t> poses = data.poses;
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	std::vector<PoseTransform> transforms(data.transforms.size());
+	for (size_t id = 0; id < transforms.size(); id++)
+	{
+		transforms[id] = IdentityPoseTransform();
+		transforms[id].enabled = true;
+		SetPoseTransformTranslation(transforms[id], data.transforms[id].translation);
+		SetPoseTransformRotation(transforms[id], data.transforms[id].rotation);
+	}
+
+	std::vector<uint32_t> ids(PoseBatch);
+	for (size_t i = 0; i < PoseBatch; i++)
+		ids[i] = (uint32_t) (i % transforms.size());
+
+	if (!PoseKernelSupported(kernel))
+		kernel = PoseKernel::Scalar;
+
+	while (state.KeepRunning())
+	{
+		TransformPoses(transforms.data(), ids.data(), poses.data(), PoseBatch, kernel);
+		DoNotOptimize(poses[0]);
+	}
+}
+
+static void BM_PoseKernelScalar(BenchmarkState &state) { PoseKernelBenchmark(state, PoseKernel::Scalar); }
+BENCHMARK_ARGS(BM_PoseKernelScalar, 1, 16);
+
+// Falls back to the scalar kernel on CPUs without AVX2.
+static void BM_PoseKernelAvx2(BenchmarkState &state) { PoseKernelBenchmark(state, PoseKernel::Avx2); }
+BENCHMARK_ARGS(BM_PoseKernelAvx2, 1, 16);
+
+// Stands in for SteamVR's TrackedDevicePoseUpdated, called through a pointer so that the pose
+// has to be materialized in memory as it is for the real call.
+static void ForwardPose(const vr::DriverPose_t &pose) { DoNotOptimize(pose); }
+static void (*volatile ForwardPoseFunc)(const vr::DriverPose_t &) = ForwardPose;
+
+// The pose hook's body for 16 devices, of which the argument's worth have a transform.
+static void PoseHookBenchmark(BenchmarkState &state, bool passThrough)
+{
+	const size_t devices = 16;
+	DriverBenchmarkData data(devices);
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	TransformTable table;
+	for (uint32_t id = 0; id < (uint32_t) state.range(); id++)
+		table.Set(protocol::SetDeviceTransform(id, true, data.transforms[id].translation, data.transforms[id].rotation));
+
+	auto forward = ForwardPoseFunc;
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < PoseBatch; i++)
+		{
+			uint32_t id = (uint32_t) (i % devices);
+			const auto &newPose = data.poses[i];
+			if (passThrough && !table.Enabled(id))
+			{
+				forward(newPose);
+				continue;
+			}
+
+			auto pose = newPose;
+			table.Apply(id, pose);
+			forward(pose);
+		}
+	}
+}
+
+// Every pose copied and looked up in the table, as the hook did before the enabled mask.
+static void BM_PoseHookCopy(BenchmarkState &state) { PoseHookBenchmark(state, false); }
+BENCHMARK_ARGS(BM_PoseHookCopy, 0, 4, 16);
+
+// Poses of devices without a transform forwarded by reference.
+static void BM_PoseHookPassThrough(BenchmarkState &state) { PoseHookBenchmark(state, true); }
+BENCHMARK_ARGS(BM_PoseHookPassThrough, 0, 4, 16);
+
+// The pose hook for 16 devices with transforms, of which the argument's worth follow a moving
+// platform in slot 16, whose pose thread updates the latest-pose cache every 16 poses.
+static void BM_PoseHookPlatform(BenchmarkState &state)
+{
+	const size_t devices = 16;
+	const uint32_t platformID = 16;
+	DriverBenchmarkData data(devices);
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	TransformTable table;
+	for (uint32_t id = 0; id < devices; id++)
+		table.Set(protocol::SetDeviceTransform(id, true, data.transforms[id].translation, data.transforms[id].rotation));
+
+	LatestPoseCache cache;
+	MovingPlatform platform;
+	platform.Arm(platformID);
+	cache.Store(platformID, data.poses[0]);
+	platform.Anchor(cache.Load(platformID), data.transforms[0].translation, data.transforms[0].rotation);
+	platform.SetFollowers((1ull << state.range()) - 1);
+
+	auto forward = ForwardPoseFunc;
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < PoseBatch; i++)
+		{
+			uint32_t id = (uint32_t) (i % devices);
+			if (id == 0)
+				cache.Store(platformID, data.poses[(i / devices) % PoseBatch]);
+
+			auto pose = data.poses[i];
+			if (platform.Follows(id) && platform.Apply(cache, pose))
+				table.ApplyMount(id, pose);
+			else
+				table.Apply(id, pose);
+			forward(pose);
+		}
+	}
+}
+BENCHMARK_ARGS(BM_PoseHookPlatform, 0, 4, 16);
+
+// The pose filters of the argument's worth of devices, each on poses 1 ms apart of a device
+// moving and turning, so the cutoff changes with every pose.
+static void BM_PoseFilter(BenchmarkState &state)
+{
+	const size_t devices = (size_t) state.range();
+	DriverBenchmarkData data(devices);
+	std::vector<vr::DriverPose_t> poses = data.poses;
+	for (size_t i = 0; i < PoseBatch; i++)
+	{
+		double step = (double) (i / devices), half = 0.001 * step + (double) (i % devices);
+		poses[i].qRotation = { std::cos(half), 0.0, std::sin(half), 0.0 };
+		poses[i].vecPosition[0] = 0.001 * step;
+	}
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	SmoothingSettings settings;
+	settings.enabled = true;
+	std::unique_ptr<PoseFilter[]> filters(new PoseFilter[devices]);
+	for (size_t id = 0; id < devices; id++)
+		filters[id].Configure(settings);
+
+	double time = 0.0;
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < PoseBatch; i++)
+		{
+			auto pose = poses[i];
+			filters[i % devices].Apply(time + 0.001 * (double) (i / devices), pose);
+			DoNotOptimize(pose);
+		}
+		time += 0.001 * (double) (PoseBatch / devices);
+	}
+}
+BENCHMARK_ARGS(BM_PoseFilter, 1, 16);
+
+// What POSE_HOOK_TIMING adds to every pose: a sample count, and for one pose in SampleEvery two
+// cycle counter reads and a histogram increment, for the argument's worth of devices.
+static void BM_HookTiming(BenchmarkState &state)
+{
+	const size_t devices = (size_t) state.range();
+	std::unique_ptr<CycleHistogram[]> histograms(new CycleHistogram[devices]);
+	state.SetItemsPerIteration((double) PoseBatch);
+
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < PoseBatch; i++)
+		{
+			auto &histogram = histograms[i % devices];
+			if (!histogram.Sample())
+				continue;
+			uint64_t start = ReadCycleCounter();
+			histogram.Add(ReadCycleCounter() - start);
+		}
+	}
+}
+BENCHMARK_ARGS(BM_HookTiming, 1, 16);
@@ -0,0 +1,1288 @@
+#include "Tools.h"
+#include "DriverReference.h"
+#include "FakeDriverHost.h"
+#include "../OpenVR-SpaceCalibratorDriver/DeviceRegistry.h"
+#include "../OpenVR-SpaceCalibratorDriver/DeviceSlot.h"
+#include "../OpenVR-SpaceCalibratorDriver/FusedTracker.h"
+#include "../OpenVR-SpaceCalibratorDriver/HookTiming.h"
+#include "../OpenVR-SpaceCalibratorDriver/MovingPlatform.h"
+#include "../OpenVR-SpaceCalibratorDriver/PoseFilter.h"
+#include "../OpenVR-SpaceCalibratorDriver/PoseHook.h"
+#include "../OpenVR-SpaceCalibratorDriver/PoseTap.h"
+#include "../OpenVR-SpaceCalibratorDriver/TransformTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Values of update k: every component of the translation and rotation derives from k, so a pose
+// thread can tell from the result alone whether it saw one update whole. Applied to a pose with
+// an identity world transform, the translation comes back exactly and the rotation to rounding.
+static vr::HmdVector3d_t StressTranslation(double k) { return { k, k + 0.25, k + 0.5 }; }
+static vr::HmdQuaternion_t StressRotation(double k)
+{
+	double half = std::fmod(k, 6000.0) * 0.0005, s = std::sin(half) / std::sqrt(14.0);
+	return { std::cos(half), s, 2.0 * s, 3.0 * s };
+}
+
+static bool SameRotation(const vr::HmdQuaternion_t &a, const vr::HmdQuaternion_t &b)
+{
+	return std::abs(a.w - b.w) < 1e-12 && std::abs(a.x - b.x) < 1e-12 && std::abs(a.y - b.y) < 1e-12 && std::abs(a.z - b.z) < 1e-12;
+}
+
+// Sets transforms from one thread, the way the IPC thread does, while pose threads apply them,
+// and checks that no pose thread ever sees a partial update. Even updates set both parts, odd
+// updates only the translation, so the rotation may lag the translation by one. Also meant to
+// be run under ThreadSanitizer.
+static int DriverStress(int threads, double seconds, uint32_t devices)
+{
+	TransformTable table;
+	std::atomic<bool> stop(false);
+	std::vector<uint64_t> applied(threads), errors(threads);
+	uint64_t updates = 0;
+
+	auto poseThread = [&](int index) {
+		vr::DriverPose_t pose;
+		memset(&pose, 0, sizeof pose);
+
+		uint64_t n = 0, bad = 0;
+		for (uint32_t id = index % devices; !stop.load(std::memory_order_relaxed); id = (id + 1) % devices)
+		{
+			memset(pose.vecWorldFromDriverTranslation, 0, sizeof pose.vecWorldFromDriverTranslation);
+			pose.qWorldFromDriverRotation = { 1.0, 0.0, 0.0, 0.0 };
+			if (!table.Apply(id, pose))
+				continue;
+
+			n++;
+			double k = pose.vecWorldFromDriverTranslation[0];
+			auto t = StressTranslation(k);
+			bool whole = memcmp(t.v, pose.vecWorldFromDriverTranslation, sizeof t.v) == 0;
+			bool paired = SameRotation(pose.qWorldFromDriverRotation, StressRotation(k)) ||
+				(((uint64_t) k & 1) && SameRotation(pose.qWorldFromDriverRotation, StressRotation(k - 1.0)));
+			if (!whole || !paired)
+				bad++;
+		}
+
+		applied[index] = n;
+		errors[index] = bad;
+	};
+
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++)
+		pool.emplace_back(poseThread, t);
+
+	auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+	while (std::chrono::steady_clock::now() < end)
+	{
+		for (int i = 0; i < 1000; i++, updates++)
+		{
+			double k = (double) (updates / devices);
+			uint32_t id = (uint32_t) (updates % devices);
+			if (((uint64_t) k & 1) == 0)
+				table.Set(protocol::SetDeviceTransform(id, true, StressTranslation(k), StressRotation(k)));
+			else
+				table.Set(protocol::SetDeviceTransform(id, true, StressTranslation(k)));
+		}
+	}
+
+	stop = true;
+	for (auto &thread : pool)
+		thread.join();
+
+	uint64_t totalApplied = 0, totalErrors = 0;
+	for (int t = 0; t < threads; t++)
+	{
+		totalApplied += applied[t];
+		totalErrors += errors[t];
+	}
+
+	printf("%d pose threads, %u devices, %.1f s: %llu updates set, %llu poses transformed\n", threads, devices, seconds,
+		(unsigned long long) updates, (unsigned long long) totalApplied);
+
+	if (totalErrors)
+	{
+		printf("FAIL %llu poses saw a partial update\n", (unsigned long long) totalErrors);
+		return 1;
+	}
+
+	printf("ok\n");
+	return 0;
+}
+
+// Largest difference between two poses' world-from-driver transforms.
+static double WorldFromDriverDifference(const vr::DriverPose_t &a, const vr::DriverPose_t &b)
+{
+	auto &qa = a.qWorldFromDriverRotation, &qb = b.qWorldFromDriverRotation;
+	double d = std::max(std::max(std::abs(qa.w - qb.w), std::abs(qa.x - qb.x)), std::max(std::abs(qa.y - qb.y), std::abs(qa.z - qb.z)));
+	for (int i = 0; i < 3; i++)
+		d = std::max(d, std::abs(a.vecWorldFromDriverTranslation[i] - b.vecWorldFromDriverTranslation[i]));
+	return d;
+}
+
+// Largest difference between two poses' driver-from-head transforms, where mount offsets go.
+static double DriverFromHeadDifference(const vr::DriverPose_t &a, const vr::DriverPose_t &b)
+{
+	auto &qa = a.qDriverFromHeadRotation, &qb = b.qDriverFromHeadRotation;
+	double d = std::max(std::max(std::abs(qa.w - qb.w), std::abs(qa.x - qb.x)), std::max(std::abs(qa.y - qb.y), std::abs(qa.z - qb.z)));
+	for (int i = 0; i < 3; i++)
+		d = std::max(d, std::abs(a.vecDriverFromHeadTranslation[i] - b.vecDriverFromHeadTranslation[i]));
+	return d;
+}
+
+// Largest difference between two results of transforming input by tf, in ulps of the largest
+// term of the computation: one for rotations, the larger translation for translations. Both
+// results are summed in the same order, so they only differ where the compiler fused a multiply
+// and an add.
+static double KernelDifferenceUlps(const vr::DriverPose_t &input, const vr::DriverPose_t &a, const vr::DriverPose_t &b, const PoseTransform &tf)
+{
+	double magnitude = 1.0;
+	for (int i = 0; i < 3; i++)
+		magnitude = std::max(magnitude, std::max(std::abs(input.vecWorldFromDriverTranslation[i]), std::abs(tf.translation[i])));
+
+	auto &qa = a.qWorldFromDriverRotation, &qb = b.qWorldFromDriverRotation;
+	double rotation = std::max(std::max(std::abs(qa.w - qb.w), std::abs(qa.x - qb.x)), std::max(std::abs(qa.y - qb.y), std::abs(qa.z - qb.z)));
+	double translation = 0.0;
+	for (int i = 0; i < 3; i++)
+		translation = std::max(translation, std::abs(a.vecWorldFromDriverTranslation[i] - b.vecWorldFromDriverTranslation[i]));
+
+	return std::max(rotation / DBL_EPSILON, translation / (magnitude * DBL_EPSILON));
+}
+
+// Applies random transforms to random poses through the transform table and through the
+// reference math, and fails if they differ by more than rounding, likewise for mount offsets
+// with and without a transform in the same slot. Then applies the transforms through each pose
+// kernel the CPU supports, which must match the table to within two ulps. Transforms
+// are unit quaternions with translations of up to ten meters, as the app sends them.
+static int DriverCheck(int count)
+{
+	std::mt19937 rng(7);
+	std::normal_distribution<double> normal;
+	std::uniform_real_distribution<double> meters(-10.0, 10.0);
+
+	auto randomRotation = [&]() {
+		vr::HmdQuaternion_t q = { normal(rng), normal(rng), normal(rng), normal(rng) };
+		double norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+		return vr::HmdQuaternion_t { q.w / norm, q.x / norm, q.y / norm, q.z / norm };
+	};
+
+	TransformTable table;
+	double worst = 0.0;
+	for (int n = 0; n < count; n++)
+	{
+		uint32_t id = (uint32_t) (n % vr::k_unMaxTrackedDeviceCount);
+		ReferenceTransform tf = { { meters(rng), meters(rng), meters(rng) }, randomRotation() };
+		table.Set(protocol::SetDeviceTransform(id, true, tf.translation, tf.rotation));
+
+		vr::DriverPose_t expected;
+		memset(&expected, 0, sizeof expected);
+		expected.qWorldFromDriverRotation = randomRotation();
+		for (int i = 0; i < 3; i++)
+			expected.vecWorldFromDriverTranslation[i] = meters(rng);
+
+		auto actual = expected;
+		ReferenceApply(tf, expected);
+		table.Apply(id, actual);
+		worst = std::max(worst, WorldFromDriverDifference(expected, actual));
+	}
+
+	printf("%d transforms: largest difference to the reference %.3g\n", count, worst);
+
+	// A few ulps of the ten meter translations.
+	bool failed = worst > 1e-13;
+
+	double worstMount = 0.0;
+	for (int n = 0; n < count; n++)
+	{
+		uint32_t id = (uint32_t) (n % vr::k_unMaxTrackedDeviceCount);
+		bool transformed = n % 2 == 0;
+		ReferenceTransform tf = { { meters(rng), meters(rng), meters(rng) }, randomRotation() };
+		ReferenceTransform mount = { { meters(rng), meters(rng), meters(rng) }, randomRotation() };
+		table.Set(protocol::SetDeviceTransform(id, transformed, tf.translation, tf.rotation));
+		table.SetMount(id, true, mount.translation, mount.rotation);
+
+		vr::DriverPose_t expected;
+		memset(&expected, 0, sizeof expected);
+		expected.qWorldFromDriverRotation = randomRotation();
+		expected.qDriverFromHeadRotation = randomRotation();
+		for (int i = 0; i < 3; i++)
+		{
+			expected.vecWorldFromDriverTranslation[i] = meters(rng);
+			expected.vecDriverFromHeadTranslation[i] = meters(rng);
+		}
+
+		auto actual = expected;
+		if (transformed)
+			ReferenceApply(tf, expected);
+		ReferenceApplyMount(mount, expected);
+		failed |= !table.Apply(id, actual) || !table.Enabled(id);
+		worstMount = std::max(worstMount, std::max(WorldFromDriverDifference(expected, actual), DriverFromHeadDifference(expected, actual)));
+	}
+
+	printf("%d mount offsets: largest difference to the reference %.3g\n", count, worstMount);
+	failed |= worstMount > 1e-13;
+
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+		table.SetMount(id, false, { { 0.0, 0.0, 0.0 } }, { 1.0, 0.0, 0.0, 0.0 });
+
+	// The pose kernels against the table, on every device slot at once with some disabled, and
+	// on one slot through the single transform entry point.
+	PoseTransform transforms[vr::k_unMaxTrackedDeviceCount];
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		vr::HmdVector3d_t translation = { meters(rng), meters(rng), meters(rng) };
+		table.Set(protocol::SetDeviceTransform(id, id % 5 != 0, translation, randomRotation()));
+		table.Get(id, transforms[id]);
+	}
+
+	std::vector<uint32_t> ids(count);
+	std::vector<vr::DriverPose_t> poses(count);
+	for (int n = 0; n < count; n++)
+	{
+		ids[n] = (uint32_t) (rng() % vr::k_unMaxTrackedDeviceCount);
+		memset(&poses[n], 0, sizeof poses[n]);
+		poses[n].qWorldFromDriverRotation = randomRotation();
+		for (int i = 0; i < 3; i++)
+			poses[n].vecWorldFromDriverTranslation[i] = meters(rng);
+	}
+
+	auto expected = poses, single = poses;
+	for (int n = 0; n < count; n++)
+	{
+		table.Apply(ids[n], expected[n]);
+		table.Apply(1, single[n]);
+	}
+
+	for (auto kernel : { PoseKernel::Scalar, PoseKernel::Avx2 })
+	{
+		if (!PoseKernelSupported(kernel))
+		{
+			printf("%s kernel: not supported by this CPU\n", PoseKernelName(kernel));
+			continue;
+		}
+
+		auto many = poses, one = poses;
+		TransformPoses(transforms, ids.data(), many.data(), many.size(), kernel);
+		TransformPoses(transforms[1], one.data(), one.size(), kernel);
+
+		double worstUlps = 0.0;
+		for (int n = 0; n < count; n++)
+		{
+			worstUlps = std::max(worstUlps, KernelDifferenceUlps(poses[n], expected[n], many[n], transforms[ids[n]]));
+			worstUlps = std::max(worstUlps, KernelDifferenceUlps(poses[n], single[n], one[n], transforms[1]));
+		}
+
+		printf("%s kernel: largest difference to the transform table %.2f ulp\n", PoseKernelName(kernel), worstUlps);
+		failed |= worstUlps > 2.0;
+	}
+
+	if (failed)
+	{
+		printf("FAIL\n");
+		return 1;
+	}
+
+	printf("ok\n");
+	return 0;
+}
+
+// Walks the registry through what SteamVR and the app do to it: devices of two tracking systems
+// register, the app sets one system's transform, a device is added again, a slot changes hands,
+// a serial moves to another slot and takes its mount offset and smoothing along. Fails on the
+// first lookup that answers wrongly.
+static int DriverRegistryCheck()
+{
+	DeviceRegistry registry;
+	int failures = 0;
+	auto expect = [&](bool ok, const char *what) {
+		if (!ok)
+		{
+			printf("FAIL %s\n", what);
+			failures++;
+		}
+	};
+
+	for (uint32_t id = 1; id <= 4; id++)
+		registry.Register(id, "lighthouse", "LHR-" + std::to_string(id));
+	for (uint32_t id = 5; id <= 7; id++)
+		registry.Register(id, "oculus", "WMHD-" + std::to_string(id));
+
+	expect(registry.SystemDevices("lighthouse") == 0x1e, "lighthouse slots");
+	expect(registry.SystemDevices("oculus") == 0xe0, "oculus slots");
+	expect(registry.SystemDevices("unknown") == 0, "unknown system has no slots");
+	expect(registry.FindSerial("WMHD-6") == 6, "serial lookup");
+	expect(registry.FindSerial("LHR-9") == vr::k_unTrackedDeviceIndexInvalid, "unknown serial");
+
+	RegisteredTransform tf, resolved;
+	tf.enabled = true;
+	tf.translation = { { 1.0, 2.0, 3.0 } };
+	registry.SetSystemTransform("oculus", tf);
+	expect(registry.ResolveTransform(5, resolved) && resolved.enabled && resolved.translation.v[2] == 3.0, "system transform resolves");
+	expect(!registry.ResolveTransform(1, resolved), "other system has no transform");
+	expect(!registry.ResolveTransform(9, resolved), "unregistered slot has no transform");
+
+	// The HMD is registered with its system but keeps its own pose.
+	registry.Register(vr::k_unTrackedDeviceIndex_Hmd, "oculus", "WMHD-HMD");
+	expect(registry.SystemDevices("oculus") == 0xe1 && registry.SystemTransformDevices("oculus") == 0xe0, "HMD left out of its system's transform");
+	expect(!registry.ResolveTransform(vr::k_unTrackedDeviceIndex_Hmd, resolved), "HMD has no system transform");
+	registry.Unregister("WMHD-HMD");
+
+	// SteamVR adding a device again.
+	expect(registry.Unregister("WMHD-6") == 6, "unregister returns the slot");
+	expect(!registry.Registered(6) && registry.SystemDevices("oculus") == 0xa0, "unregistered slot leaves its system");
+	expect(!registry.Register(6, "oculus", "WMHD-6"), "same device again is no change");
+	expect(registry.ResolveTransform(6, resolved), "registered again resolves");
+
+	// A slot taken over by another device, and a serial moving slots.
+	expect(registry.Register(7, "lighthouse", "LHR-7"), "new device in a slot replaces the old");
+	expect(registry.SystemDevices("oculus") == 0x60 && registry.SystemDevices("lighthouse") == 0x9e, "slot changes system");
+	expect(registry.FindSerial("WMHD-7") == vr::k_unTrackedDeviceIndexInvalid, "replaced serial is gone");
+	registry.Register(9, "lighthouse", "LHR-1");
+	expect(registry.FindSerial("LHR-1") == 9 && !registry.Registered(1), "serial moves slots");
+	expect(registry.SystemDevices("lighthouse") == 0x29c, "moved serial leaves its old slot");
+
+	// Mount offsets follow the serial, wherever it is registered.
+	RegisteredTransform mount;
+	mount.enabled = true;
+	mount.translation = { { 0.0, 0.1, 0.0 } };
+	registry.SetMountOffset("LHR-1", mount);
+	expect(registry.ResolveMountOffset(9, resolved) && resolved.translation.v[1] == 0.1, "mount offset resolves by serial");
+	expect(!registry.ResolveMountOffset(2, resolved), "other serial has no mount offset");
+	registry.Register(3, "lighthouse", "LHR-1");
+	expect(registry.ResolveMountOffset(3, resolved) && !registry.ResolveMountOffset(9, resolved), "mount offset moves with the serial");
+
+	SmoothingSettings smoothing, resolvedSmoothing;
+	smoothing.enabled = true;
+	smoothing.beta = 20.0;
+	registry.SetSmoothing("LHR-1", smoothing);
+	expect(registry.ResolveSmoothing(3, resolvedSmoothing) && resolvedSmoothing.beta == 20.0, "smoothing resolves by serial");
+	expect(!registry.ResolveSmoothing(2, resolvedSmoothing), "other serial has no smoothing");
+
+	// Time offsets follow the tracking system.
+	registry.SetTimeOffset("oculus", 0.025);
+	expect(registry.ResolveTimeOffset(5) == 0.025, "time offset resolves by system");
+	expect(registry.ResolveTimeOffset(2) == 0.0 && registry.ResolveTimeOffset(12) == 0.0, "other system and unregistered slot have no time offset");
+	registry.Register(5, "lighthouse", "LHR-5");
+	expect(registry.ResolveTimeOffset(5) == 0.0, "time offset stays with the system");
+
+	if (failures)
+		return 1;
+
+	printf("ok\n");
+	return 0;
+}
+
+// A rigid transform in the reference math's terms, for working out where a device truly is.
+struct RigidTransform
+{
+	vr::HmdQuaternion_t rotation;
+	vr::HmdVector3d_t translation;
+};
+
+static RigidTransform Compose(const RigidTransform &a, const RigidTransform &b)
+{
+	vr::HmdQuaternion_t vectorQuat = { 0.0, b.translation.v[0], b.translation.v[1], b.translation.v[2] };
+	vr::HmdQuaternion_t conjugate = { a.rotation.w, -a.rotation.x, -a.rotation.y, -a.rotation.z };
+	auto rotated = ReferenceMultiply(ReferenceMultiply(a.rotation, vectorQuat), conjugate);
+	return { ReferenceMultiply(a.rotation, b.rotation), { rotated.x + a.translation.v[0], rotated.y + a.translation.v[1], rotated.z + a.translation.v[2] } };
+}
+
+// Where SteamVR puts a device: its pose moved by its world-from-driver transform.
+static RigidTransform WorldPose(const vr::DriverPose_t &pose)
+{
+	auto &t = pose.vecWorldFromDriverTranslation;
+	RigidTransform world = { pose.qWorldFromDriverRotation, { t[0], t[1], t[2] } };
+	return Compose(world, { pose.qRotation, { pose.vecPosition[0], pose.vecPosition[1], pose.vecPosition[2] } });
+}
+
+// Largest difference between two rigid transforms, quaternion components and meters alike.
+static double RigidDifference(const RigidTransform &a, const RigidTransform &b)
+{
+	auto qa = a.rotation, qb = b.rotation;
+	if (qa.w * qb.w + qa.x * qb.x + qa.y * qb.y + qa.z * qb.z < 0.0)
+		qb = { -qb.w, -qb.x, -qb.y, -qb.z };
+
+	double d = std::max(std::max(std::abs(qa.w - qb.w), std::abs(qa.x - qb.x)), std::max(std::abs(qa.y - qb.y), std::abs(qa.z - qb.z)));
+	for (int i = 0; i < 3; i++)
+		d = std::max(d, std::abs(a.translation.v[i] - b.translation.v[i]));
+	return d;
+}
+
+static vr::DriverPose_t DevicePose(const RigidTransform &device)
+{
+	vr::DriverPose_t pose;
+	memset(&pose, 0, sizeof pose);
+	pose.poseIsValid = true;
+	pose.qWorldFromDriverRotation = { 1.0, 0.0, 0.0, 0.0 };
+	pose.qDriverFromHeadRotation = { 1.0, 0.0, 0.0, 0.0 };
+	pose.qRotation = device.rotation;
+	for (int i = 0; i < 3; i++)
+		pose.vecPosition[i] = device.translation.v[i];
+	return pose;
+}
+
+// The driver's own pose hook, driven into a fake host. The provider's writers are reduced to what
+// the checks set up, under the same lock, and what the provider would log is kept instead.
+class CheckedPoseHook : public PoseHook
+{
+public:
+	int anchors = 0;
+	std::vector<uint32_t> turnedOff[vr::k_unMaxTrackedDeviceCount];
+
+	void Update(vr::IVRServerDriverHost *host, uint32_t openVRID, const vr::DriverPose_t &pose)
+	{
+		PoseUpdated(host, openVRID, pose, sizeof pose, FakeDriverHost::Forward);
+	}
+
+	// As RunFrame registers a device from its first pose.
+	void Register(uint32_t openVRID, const std::string &trackingSystem, const std::string &serial)
+	{
+		std::lock_guard<std::mutex> lock(transformWriter);
+		registry.Register(openVRID, trackingSystem, serial);
+		devices[openVRID].registered.store(true, std::memory_order_release);
+	}
+
+	void SetSystemTransform(const std::string &trackingSystem, const RigidTransform &system)
+	{
+		RegisteredTransform tf;
+		tf.enabled = true;
+		tf.translation = system.translation;
+		tf.rotation = system.rotation;
+		std::lock_guard<std::mutex> lock(transformWriter);
+		ApplySystemTransform(trackingSystem, tf);
+	}
+
+	void SetDeviceTransform(const protocol::SetDeviceTransform &tf)
+	{
+		std::lock_guard<std::mutex> lock(transformWriter);
+		ApplyDeviceTransform(tf);
+	}
+
+	// The platform's devices anchor from its next pose, as once it registered.
+	void ArmPlatform(const std::string &trackingSystem, uint32_t openVRID)
+	{
+		std::lock_guard<std::mutex> lock(transformWriter);
+		platformSystem = trackingSystem;
+		platform.Arm(openVRID);
+	}
+
+	void StopPlatform()
+	{
+		std::lock_guard<std::mutex> lock(transformWriter);
+		platform.Stop();
+	}
+
+	void SetStageBudget(double ns) { stageBudgetNs.store(ns, std::memory_order_relaxed); }
+	DeviceSlot &Device(uint32_t openVRID) { return devices[openVRID]; }
+	PoseTap &Tap() { return poseTap; }
+
+protected:
+	virtual void PlatformAnchored(bool) override { anchors++; }
+	virtual void StageTurnedOff(uint32_t openVRID, uint32_t stage, double, double) override { turnedOff[openVRID].push_back(stage); }
+};
+
+struct LatencySummary
+{
+	double median, p99, max;
+};
+
+static LatencySummary SummarizeLatency(std::vector<double> &ns)
+{
+	std::sort(ns.begin(), ns.end());
+	return { ns[ns.size() / 2], ns[std::min(ns.size() - 1, ns.size() * 99 / 100)], ns.back() };
+}
+
+// A tracking system on a moving rig, such as an inside-out headset in a motion simulator, with a
+// tracker of the fixed reference system on the rig as the platform. The rig moves and turns
+// while the devices on it hold still in their own space; every pose SteamVR receives through
+// the fake host must put the device where the rig truly carried it. Then times poses from the
+// hook's entry to the host with fixed transforms and while following the platform, and fails
+// if the median of the latter exceeds the budget.
+static int DriverPlatformCheck(int count, double budgetNs)
+{
+	std::mt19937 rng(11);
+	std::normal_distribution<double> normal;
+	std::uniform_real_distribution<double> meters(-2.0, 2.0);
+
+	auto randomRotation = [&]() {
+		vr::HmdQuaternion_t q = { normal(rng), normal(rng), normal(rng), normal(rng) };
+		double norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+		return vr::HmdQuaternion_t { q.w / norm, q.x / norm, q.y / norm, q.z / norm };
+	};
+	auto randomTransform = [&]() { return RigidTransform { randomRotation(), { { meters(rng), meters(rng), meters(rng) } } }; };
+
+	// Where the rig has carried everything on it after time t, the identity at 0.
+	auto rig = [](double t) {
+		double half = 0.15 * std::sin(t), tilt = 0.05 * std::sin(3.0 * t);
+		vr::HmdQuaternion_t yaw = { std::cos(half), 0.0, std::sin(half), 0.0 }, roll = { std::cos(tilt), 0.0, 0.0, std::sin(tilt) };
+		return RigidTransform { ReferenceMultiply(yaw, roll), { { std::sin(t), 0.2 * (1.0 - std::cos(t)), 0.5 * t } } };
+	};
+
+	const uint32_t platformID = 1, firstFollower = 2, followerCount = 4;
+	static CheckedPoseHook hook;
+	FakeDriverHost host;
+	vr::IVRServerDriverHost *steamVR = &host;
+
+	// The watchdog has a check of its own; here one preempted sample must not turn following off.
+	hook.SetStageBudget(0.0);
+
+	auto system = randomTransform(), platformOnRig = randomTransform();
+	std::vector<RigidTransform> followers;
+	hook.Register(platformID, "lighthouse", "LHR-PLATFORM");
+	for (uint32_t n = 0; n < followerCount; n++)
+	{
+		followers.push_back(randomTransform());
+		hook.Register(firstFollower + n, "oculus", "WMHD-" + std::to_string(n));
+	}
+	hook.SetSystemTransform("oculus", system);
+
+	double staticError = 0.0, movingError = 0.0;
+	for (uint32_t n = 0; n < followerCount; n++)
+	{
+		hook.Update(steamVR, firstFollower + n, DevicePose(followers[n]));
+		staticError = std::max(staticError, RigidDifference(WorldPose(host.Last(firstFollower + n).pose), Compose(system, followers[n])));
+	}
+
+	// The followers are the system's devices with its transform, from the platform's first pose.
+	hook.ArmPlatform("oculus", platformID);
+	for (int k = 0; k < count; k++)
+	{
+		auto carried = rig(k * 0.001);
+		hook.Update(steamVR, platformID, DevicePose(Compose(carried, platformOnRig)));
+
+		uint32_t n = (uint32_t) k % followerCount;
+		hook.Update(steamVR, firstFollower + n, DevicePose(followers[n]));
+		auto truth = Compose(carried, Compose(system, followers[n]));
+		movingError = std::max(movingError, RigidDifference(WorldPose(host.Last(firstFollower + n).pose), truth));
+	}
+	int anchors = hook.anchors;
+
+	// The app disabling a follower's transform mid-follow, as when it calibrates the device, gets
+	// it the raw pose back; setting the system's transform again has it follow again.
+	hook.SetDeviceTransform(protocol::SetDeviceTransform(firstFollower, false));
+	auto carried = rig(count * 0.001);
+	hook.Update(steamVR, platformID, DevicePose(Compose(carried, platformOnRig)));
+	auto raw = DevicePose(followers[0]);
+	hook.Update(steamVR, firstFollower, raw);
+	bool rawBack = memcmp(&host.Last(firstFollower).pose, &raw, sizeof raw) == 0;
+	hook.SetSystemTransform("oculus", system);
+	hook.Update(steamVR, firstFollower, raw);
+	double overriddenError = RigidDifference(WorldPose(host.Last(firstFollower).pose), Compose(carried, Compose(system, followers[0])));
+	movingError = std::max(movingError, overriddenError);
+
+	// Stopped, the devices go back to their fixed transform.
+	hook.StopPlatform();
+	hook.Update(steamVR, firstFollower, DevicePose(followers[0]));
+	staticError = std::max(staticError, RigidDifference(WorldPose(host.Last(firstFollower).pose), Compose(system, followers[0])));
+
+	printf("fixed transform error %.3g, following the platform %.3g over %d poses\n", staticError, movingError, count);
+
+	// The platform's pose thread updates the cache every fourth pose, as a tracker at a quarter
+	// of the followers' combined rate would.
+	auto time = [&](bool following) {
+		if (following)
+			hook.ArmPlatform("oculus", platformID);
+
+		std::vector<double> ns;
+		ns.reserve(count);
+		for (int k = 0; k < count; k++)
+		{
+			if (k % 4 == 0)
+				hook.Update(steamVR, platformID, DevicePose(Compose(rig(k * 0.001), platformOnRig)));
+
+			uint32_t id = firstFollower + (uint32_t) k % followerCount;
+			auto pose = DevicePose(followers[id - firstFollower]);
+			auto start = std::chrono::steady_clock::now();
+			hook.Update(steamVR, id, pose);
+			ns.push_back(std::chrono::duration<double, std::nano>(host.Last(id).at - start).count());
+		}
+
+		hook.StopPlatform();
+		return SummarizeLatency(ns);
+	};
+
+	auto fixed = time(false), moving = time(true);
+	printf("hook to host, fixed transform: median %.0f ns, p99 %.0f ns, max %.0f ns\n", fixed.median, fixed.p99, fixed.max);
+	printf("hook to host, moving platform: median %.0f ns, p99 %.0f ns, max %.0f ns (budget %.0f ns)\n", moving.median, moving.p99, moving.max, budgetNs);
+
+	int failures = 0;
+	if (anchors != 1)
+	{
+		printf("FAIL platform anchored %d times from one arming\n", anchors);
+		failures++;
+	}
+	if (staticError > 1e-12 || movingError > 1e-9)
+	{
+		printf("FAIL devices not where the platform carried them\n");
+		failures++;
+	}
+	if (!rawBack)
+	{
+		printf("FAIL device with its transform disabled does not get its raw pose\n");
+		failures++;
+	}
+	if (moving.median > budgetNs)
+	{
+		printf("FAIL median latency over budget\n");
+		failures++;
+	}
+
+	if (failures)
+		return 1;
+
+	printf("ok\n");
+	return 0;
+}
+
+// Angle between two rotations, in degrees.
+static double AngleDegrees(const vr::HmdQuaternion_t &a, const vr::HmdQuaternion_t &b)
+{
+	double dot = std::abs(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z);
+	return 2.0 * std::acos(std::min(1.0, dot)) * 180.0 / 3.141592653589793;
+}
+
+// Feeds the pose filter a tracker at 1 kHz with half a millimeter and a twentieth of a degree of
+// noise per axis: at rest, where it must take out most of the noise, and moving at 1 m/s and
+// turning at 2 rad/s, where it must lag less than one 90 Hz frame of that motion, both with and
+// without the tracker reporting its velocity. Then checks that lost tracking and gaps start the
+// filter over, and fails if a call costs more than the budget.
+static int DriverSmoothingCheck(int count, double budgetNs)
+{
+	std::mt19937 rng(13);
+	std::normal_distribution<double> normal;
+	const double dt = 0.001, positionNoise = 0.0005, rotationNoise = 0.05 * 3.141592653589793 / 180.0;
+	const double speed = 1.0, turnRate = 2.0, frame = 1.0 / 90.0;
+
+	SmoothingSettings settings;
+	settings.enabled = true;
+	int failures = 0;
+	auto expect = [&](bool ok, const char *what) {
+		if (!ok)
+		{
+			printf("FAIL %s\n", what);
+			failures++;
+		}
+	};
+
+	// The truth at time t, moving or not, and a noisy, valid pose of it.
+	auto truth = [&](double t, bool moving) {
+		double half = moving ? 0.5 * turnRate * t : 0.0;
+		return RigidTransform { { std::cos(half), 0.0, std::sin(half), 0.0 }, { { moving ? speed * t : 0.0, 1.2, 0.3 } } };
+	};
+	auto noisy = [&](const RigidTransform &tf, bool moving, bool reportVelocity) {
+		auto pose = DevicePose(tf);
+		double x = 0.5 * rotationNoise * normal(rng), y = 0.5 * rotationNoise * normal(rng), z = 0.5 * rotationNoise * normal(rng);
+		pose.qRotation = ReferenceMultiply(pose.qRotation, { std::sqrt(1.0 - x * x - y * y - z * z), x, y, z });
+		for (int i = 0; i < 3; i++)
+			pose.vecPosition[i] += positionNoise * normal(rng);
+		if (moving && reportVelocity)
+		{
+			pose.vecVelocity[0] = speed;
+			pose.vecAngularVelocity[1] = turnRate;
+		}
+		return pose;
+	};
+
+	// Runs two seconds and returns the mean position and rotation error over the second one.
+	struct Errors { double inMeters, outMeters, inDegrees, outDegrees; };
+	auto run = [&](bool moving, bool reportVelocity) {
+		PoseFilter filter;
+		filter.Configure(settings);
+		Errors e = {};
+		int n = 0;
+		for (int k = 0; k < 2000; k++)
+		{
+			auto tf = truth(k * dt, moving);
+			auto pose = noisy(tf, moving, reportVelocity);
+			auto input = pose;
+			filter.Apply(k * dt, pose);
+			if (k < 1000)
+				continue;
+
+			for (int i = 0; i < 3; i++)
+			{
+				e.inMeters += std::abs(input.vecPosition[i] - tf.translation.v[i]);
+				e.outMeters += std::abs(pose.vecPosition[i] - tf.translation.v[i]);
+			}
+			e.inDegrees += AngleDegrees(input.qRotation, tf.rotation);
+			e.outDegrees += AngleDegrees(pose.qRotation, tf.rotation);
+			n++;
+		}
+		e.inMeters /= n; e.outMeters /= n; e.inDegrees /= n; e.outDegrees /= n;
+		return e;
+	};
+
+	auto rest = run(false, false);
+	printf("at rest: %.3f mm, %.4f deg in, %.3f mm, %.4f deg out\n", rest.inMeters * 1000.0, rest.inDegrees, rest.outMeters * 1000.0, rest.outDegrees);
+	expect(rest.outMeters < rest.inMeters / 3.0 && rest.outDegrees < rest.inDegrees / 3.0, "noise at rest not reduced threefold");
+
+	for (bool reportVelocity : { true, false })
+	{
+		auto moving = run(true, reportVelocity);
+		printf("moving, velocity %s: %.3f mm, %.4f deg out, one frame is %.1f mm, %.2f deg\n", reportVelocity ? "reported" : "estimated",
+			moving.outMeters * 1000.0, moving.outDegrees, speed * frame * 1000.0, turnRate * frame * 180.0 / 3.141592653589793);
+		expect(moving.outMeters < speed * frame && moving.outDegrees < turnRate * frame * 180.0 / 3.141592653589793, "lags a frame or more while moving");
+	}
+
+	// Lost tracking and gaps start over from the next pose, which passes unchanged.
+	PoseFilter filter;
+	filter.Configure(settings);
+	for (int k = 0; k < 10; k++)
+	{
+		auto pose = noisy(truth(0.0, false), false, false);
+		filter.Apply(k * dt, pose);
+	}
+	auto far = DevicePose(truth(0.0, false));
+	far.vecPosition[0] = 5.0;
+	auto pose = far;
+	filter.Apply(10 * dt + PoseFilter::MaxGapSeconds * 2.0, pose);
+	expect(pose.vecPosition[0] == 5.0, "gap does not restart");
+	pose = far;
+	pose.poseIsValid = false;
+	pose.vecPosition[0] = 9.0;
+	filter.Apply(12 * dt + PoseFilter::MaxGapSeconds * 2.0, pose);
+	expect(pose.vecPosition[0] == 9.0, "invalid pose is changed");
+	pose = far;
+	filter.Apply(13 * dt + PoseFilter::MaxGapSeconds * 2.0, pose);
+	expect(pose.vecPosition[0] == 5.0, "lost tracking does not restart");
+
+	// The app's own transform for a device, as while calibrating it, turns off its smoothing and
+	// time offset until its system's transform is set again.
+	static DeviceSlot slot;
+	slot.SetSmoothing(settings);
+	slot.SetTimeOffset(0.02);
+	slot.overridden.store(true);
+	expect(slot.Stages() == 0, "overridden device still smoothed or compensated");
+	slot.overridden.store(false);
+	expect(slot.Stages() == (StageSmoothing | StageTimeOffset), "stages not back after the override");
+
+	// Cost per call, over poses prepared beforehand.
+	std::vector<vr::DriverPose_t> poses(1024);
+	for (size_t k = 0; k < poses.size(); k++)
+		poses[k] = noisy(truth(k * dt, true), true, false);
+
+	filter.Configure(settings);
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < count; k++)
+	{
+		auto p = poses[k & 1023];
+		filter.Apply(k * dt, p);
+		if (p.vecPosition[0] == -1.0)
+			printf(" ");
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+	printf("%.1f ns per pose (budget %.0f ns)\n", ns, budgetNs);
+	expect(ns <= budgetNs, "over budget");
+
+	if (failures)
+		return 1;
+
+	printf("ok\n");
+	return 0;
+}
+
+// Checks the hook timing histograms: that durations land in their log2 buckets, that calls of a
+// known length read back as that long, that pose threads timing their own devices lose no sampled
+// call, and that timing costs a call at most the budget on average, from the same hook run with
+// and without it.
+static int DriverTimingCheck(int count, double budgetNs)
+{
+#ifndef POSE_HOOK_TIMING
+	(void) count;
+	(void) budgetNs;
+	throw std::runtime_error("the tools were built without POSE_HOOK_TIMING");
+#else
+	int failures = 0;
+	auto expect = [&](bool ok, const char *what) {
+		if (!ok)
+		{
+			printf("FAIL %s\n", what);
+			failures++;
+		}
+	};
+
+	CycleClock clock;
+	expect(CycleHistogram::BitWidth(0) == 0 && CycleHistogram::BitWidth(1) == 1 && CycleHistogram::BitWidth(3) == 2 && CycleHistogram::BitWidth(1024) == 11, "log2 buckets");
+
+	auto buckets = std::unique_ptr<CycleHistogram>(new CycleHistogram);
+	buckets->Add(0);
+	buckets->Add(1000);
+	buckets->Add(1ull << 40);
+	protocol::HookTiming timing;
+	buckets->Read(timing);
+	expect(timing.calls == 3 && timing.buckets[0] == 1 && timing.buckets[10] == 1 && timing.buckets[CycleHistogram::Buckets - 1] == 1, "durations land in their buckets");
+
+	// Calls spinning for 2 us read back as between 2 and 4 us, the bucket's upper end.
+	auto spin = std::unique_ptr<CycleHistogram>(new CycleHistogram);
+	for (int k = 0; k < 2000; k++)
+	{
+		uint64_t start = ReadCycleCounter();
+		auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(2);
+		while (std::chrono::steady_clock::now() < until) { }
+		spin->Add(ReadCycleCounter() - start);
+	}
+	spin->Read(timing);
+	timing.cyclesPerNs = clock.CyclesPerNs();
+	double spinNs = CycleHistogram::PercentileNs(timing, 0.5);
+	printf("cycle counter %.3f GHz, 2 us calls read as under %.0f ns\n", timing.cyclesPerNs, spinNs);
+	expect(spinNs >= 2000.0 && spinNs <= 4400.0, "known durations read back");
+
+	static CheckedPoseHook hook;
+	FakeDriverHost host;
+	vr::IVRServerDriverHost *steamVR = &host;
+	const uint32_t devices = 4;
+	auto pose = DevicePose(RigidTransform { { 1.0, 0.0, 0.0, 0.0 }, { { 0.1, 1.2, -0.3 } } });
+	for (uint32_t id = 0; id < devices; id++)
+	{
+		hook.Register(id, "oculus", "WMHD-" + std::to_string(id));
+		hook.SetDeviceTransform(protocol::SetDeviceTransform(id, true, { 0.5, 0.0, 0.25 }, { 0.9238795, 0.0, 0.3826834, 0.0 }));
+	}
+
+	std::vector<std::thread> threads;
+	for (uint32_t id = 0; id < devices; id++)
+		threads.emplace_back([&, id]() {
+			for (int k = 0; k < count; k++)
+				hook.PoseUpdated<true>(steamVR, id, pose, sizeof pose, FakeDriverHost::Forward);
+		});
+	for (auto &thread : threads)
+		thread.join();
+
+	bool complete = true;
+	for (uint32_t id = 0; id < devices; id++)
+	{
+		hook.Device(id).hookCycles.Read(timing);
+		complete = complete && timing.calls == (uint64_t) count / CycleHistogram::SampleEvery;
+	}
+	expect(complete, "sampled calls lost between pose threads");
+
+	timing.cyclesPerNs = clock.CyclesPerNs();
+	printf("hook to host: half under %.0f ns, 99%% under %.0f ns\n", CycleHistogram::PercentileNs(timing, 0.5), CycleHistogram::PercentileNs(timing, 0.99));
+
+	// Alternating rounds with and without timing, the fastest of each, to see past the machine's
+	// own noise.
+	double untimed = DBL_MAX, timed = DBL_MAX, readNs = DBL_MAX;
+	for (int round = 0; round < 20; round++)
+	{
+		uint64_t sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int k = 0; k < count; k++)
+			sum += ReadCycleCounter();
+		readNs = std::min(readNs, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count);
+		if (sum == 1)
+			printf(" ");
+
+		for (bool on : { false, true })
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (int k = 0; k < count; k++)
+			{
+				if (on)
+					hook.PoseUpdated<true>(steamVR, (uint32_t) k % devices, pose, sizeof pose, FakeDriverHost::Forward);
+				else
+					hook.PoseUpdated<false>(steamVR, (uint32_t) k % devices, pose, sizeof pose, FakeDriverHost::Forward);
+			}
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+			(on ? timed : untimed) = std::min(on ? timed : untimed, ns);
+		}
+	}
+	double overhead = timed - untimed;
+	printf("cycle counter reads take %.1f ns, one call in %u timed\n", readNs, CycleHistogram::SampleEvery);
+	printf("hook %.1f ns untimed, %.1f ns timed: %.1f ns per call for timing (budget %.0f ns)\n", untimed, timed, overhead, budgetNs);
+	expect(overhead <= budgetNs, "timing over budget");
+
+	if (failures)
+		return 1;
+
+	printf("ok\n");
+	return 0;
+#endif
+}
+
+// A tracker with every optional stage on, following a platform tracker of another system. With
+// a budget far above what the stages cost, the watchdog must leave them alone; with one no hook
+// can meet, it must turn them off one at a time, the tap first and the platform last, and leave
+// the tracker on its fixed transform. Then fails if watching costs a call more than the budget,
+// from the same hook with and without the watchdog.
+static int DriverWatchdogCheck(int count, double budgetNs)
+{
+	int failures = 0;
+	auto expect = [&](bool ok, const char *what) {
+		if (!ok)
+		{
+			printf("FAIL %s\n", what);
+			failures++;
+		}
+	};
+
+	const uint32_t trackerID = 1, platformID = 2, plainID = 3;
+	static CheckedPoseHook hook;
+	FakeDriverHost host;
+	vr::IVRServerDriverHost *steamVR = &host;
+
+	// The tracker's system follows the platform, the plain device's only has a transform.
+	RigidTransform system = { { 0.9238795325112867, 0.0, 0.3826834323650898, 0.0 }, { { 0.5, 0.0, 0.25 } } };
+	RigidTransform tracker = { { 1.0, 0.0, 0.0, 0.0 }, { { 0.1, 1.2, -0.3 } } };
+	auto platformPose = DevicePose(RigidTransform { { 1.0, 0.0, 0.0, 0.0 }, { { 0.0, 0.5, 2.0 } } });
+	hook.Register(trackerID, "oculus", "WMHD-TRACKER");
+	hook.Register(platformID, "lighthouse", "LHR-PLATFORM");
+	hook.Register(plainID, "vive", "LHR-PLAIN");
+	hook.SetSystemTransform("oculus", system);
+	hook.SetSystemTransform("vive", system);
+
+	SmoothingSettings smoothing;
+	smoothing.enabled = true;
+	hook.Device(trackerID).SetSmoothing(smoothing);
+	hook.ArmPlatform("oculus", platformID);
+	hook.Update(steamVR, platformID, platformPose);
+
+	// The tap records every device, the platform's too, to a file removed afterwards.
+	const char *tapPath = "driver-watchdog-check.sctap";
+	if (!hook.Tap().Start(tapPath))
+		throw std::runtime_error(std::string("cannot create ") + tapPath);
+
+	auto run = [&](int poses) {
+		for (int k = 0; k < poses; k++)
+		{
+			if (k % 4 == 0)
+				hook.Update(steamVR, platformID, platformPose);
+			hook.Update(steamVR, trackerID, DevicePose(tracker));
+		}
+	};
+
+	hook.SetStageBudget(1e6);
+	run(count);
+	expect(hook.turnedOff[trackerID].empty() && hook.turnedOff[platformID].empty() && hook.Device(trackerID).Degraded() == 0, "stages within the budget turned off");
+
+	hook.SetStageBudget(1e-3);
+	run(count);
+	hook.Tap().Stop();
+	std::remove(tapPath);
+
+	auto &turnedOff = hook.turnedOff[trackerID];
+	printf("turned off in order:");
+	for (auto stage : turnedOff)
+		printf(" %s,", StageName(stage));
+	printf(" then nothing left\n");
+	expect(turnedOff == std::vector<uint32_t>({ StageTap, StageSmoothing, StagePlatform }), "stages turned off once each, least needed first");
+	expect(hook.Device(trackerID).Degraded() == DegradableStages, "stages stay off");
+	expect(RigidDifference(WorldPose(host.Last(trackerID).pose), Compose(system, tracker)) < 1e-12, "tracker left on its fixed transform");
+
+	// A device with only a transform, so the watchdog has nothing to turn off and only its own
+	// cost differs between the runs.
+	auto plainPose = DevicePose(tracker);
+	double unwatched = DBL_MAX, watched = DBL_MAX;
+	for (int round = 0; round < 30; round++)
+	{
+		for (bool on : { false, true })
+		{
+			hook.SetStageBudget(on ? 1e9 : 0.0);
+			auto start = std::chrono::steady_clock::now();
+			for (int k = 0; k < count; k++)
+				hook.Update(steamVR, plainID, plainPose);
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+			(on ? watched : unwatched) = std::min(on ? watched : unwatched, ns);
+		}
+	}
+	printf("hook %.1f ns unwatched, %.1f ns watched: %.1f ns per call for the watchdog (budget %.0f ns)\n", unwatched, watched, watched - unwatched, budgetNs);
+	expect(watched - unwatched <= budgetNs, "watchdog over budget");
+
+	if (failures)
+		return 1;
+
+	printf("ok\n");
+	return 0;
+}
+
+// Two rigidly attached devices circling the play space: a primary of the reference system at
+// 90 Hz and a faster secondary of a calibrated system at 250 Hz, whose poses carry the
+// calibration. Runs the fused tracker through the primary losing tracking, the secondary
+// tracking poorly and drifting off, then going silent, blending and switching, and fails unless
+// the fused pose stays on the primary's true pose throughout without jumping, at the faster
+// source's rate while both report. Then fails if a pose costs the fusion more than the budget.
+static int DriverFusionCheck(int count, double budgetNs)
+{
+	const double turnRate = 1.5, radius = 0.4, drift = 0.01;
+	const int64_t ms = 1000000, primaryPeriod = 11111111, secondaryPeriod = 4 * ms, end = 5500 * ms, base = 1000 * ms;
+	const uint32_t primaryID = 3, secondaryID = 5;
+	int failures = 0;
+	auto expect = [&](bool ok, const char *what) {
+		if (!ok)
+		{
+			printf("FAIL %s\n", what);
+			failures++;
+		}
+	};
+
+	auto inverse = [](const RigidTransform &tf) {
+		auto &t = tf.translation.v;
+		return Compose({ { tf.rotation.w, -tf.rotation.x, -tf.rotation.y, -tf.rotation.z }, { { 0.0, 0.0, 0.0 } } }, { { 1.0, 0.0, 0.0, 0.0 }, { { -t[0], -t[1], -t[2] } } });
+	};
+	auto rotate = [](const vr::HmdQuaternion_t &q, const vr::HmdVector3d_t &v) {
+		return Compose({ q, { { 0.0, 0.0, 0.0 } } }, { { 1.0, 0.0, 0.0, 0.0 }, v }).translation;
+	};
+
+	// The primary's true pose turning about the vertical, and its velocity.
+	auto truth = [&](double t) {
+		double half = 0.5 * turnRate * t;
+		return RigidTransform { { std::cos(half), 0.0, std::sin(half), 0.0 }, { { radius * std::cos(turnRate * t), 1.2, radius * std::sin(turnRate * t) } } };
+	};
+	auto velocity = [&](double t) {
+		return vr::HmdVector3d_t { { -radius * turnRate * std::sin(turnRate * t), 0.0, radius * turnRate * std::cos(turnRate * t) } };
+	};
+	const vr::HmdVector3d_t spin = { { 0.0, turnRate, 0.0 } };
+
+	// The primary in the secondary's frame, and the secondary's system in the reference's.
+	RigidTransform mount = { { 0.9659258262890683, 0.25881904510252074, 0.0, 0.0 }, { { 0.03, -0.05, 0.08 } } };
+	RigidTransform calibration = { { 0.9848077530122080, 0.0, 0.17364817766693033, 0.0 }, { { 0.5, 0.0, -0.2 } } };
+
+	std::mt19937 rng(17);
+	std::normal_distribution<double> normal;
+	double noise = 1.0;
+
+	auto primaryPose = [&](double t, bool tracked) {
+		auto pose = DevicePose(truth(t));
+		auto v = velocity(t);
+		for (int i = 0; i < 3; i++)
+		{
+			pose.vecPosition[i] += 0.0002 * noise * normal(rng);
+			pose.vecVelocity[i] = v.v[i];
+			pose.vecAngularVelocity[i] = spin.v[i];
+		}
+		pose.deviceIsConnected = true;
+		pose.poseIsValid = tracked;
+		pose.result = tracked ? vr::TrackingResult_Running_OK : vr::TrackingResult_Running_OutOfRange;
+		return pose;
+	};
+
+	// In its own driver space, with the calibration as its world-from-driver transform.
+	auto secondaryPose = [&](double t, double driftMeters) {
+		auto primary = truth(t);
+		auto world = Compose(primary, inverse(mount));
+		vr::HmdVector3d_t lever, v = velocity(t), worldVelocity;
+		for (int i = 0; i < 3; i++)
+			lever.v[i] = world.translation.v[i] - primary.translation.v[i];
+		worldVelocity.v[0] = v.v[0] + spin.v[1] * lever.v[2] - spin.v[2] * lever.v[1];
+		worldVelocity.v[1] = v.v[1] + spin.v[2] * lever.v[0] - spin.v[0] * lever.v[2];
+		worldVelocity.v[2] = v.v[2] + spin.v[0] * lever.v[1] - spin.v[1] * lever.v[0];
+		world.translation.v[0] += driftMeters;
+
+		auto toDriver = inverse(calibration);
+		auto pose = DevicePose(Compose(toDriver, world));
+		auto driverVelocity = rotate(toDriver.rotation, worldVelocity), driverSpin = rotate(toDriver.rotation, spin);
+		pose.qWorldFromDriverRotation = calibration.rotation;
+		for (int i = 0; i < 3; i++)
+		{
+			pose.vecWorldFromDriverTranslation[i] = calibration.translation.v[i];
+			pose.vecPosition[i] += 0.0005 * noise * normal(rng);
+			pose.vecVelocity[i] = driverVelocity.v[i];
+			pose.vecAngularVelocity[i] = driverSpin.v[i];
+		}
+		pose.deviceIsConnected = true;
+		pose.poseIsValid = true;
+		pose.result = driftMeters > 0.0 ? vr::TrackingResult_Running_OutOfRange : vr::TrackingResult_Running_OK;
+		return pose;
+	};
+
+	// RMS error in each stretch, after the tracker settled into it, and the largest jump of the
+	// fused pose between two of its poses beyond the truth's own motion.
+	struct Stretch { const char *name; double from, to, meters, degrees; int fused, sources; };
+	struct Run { Stretch stretches[4]; double jump; bool valid, stopped; };
+
+	auto run = [&](bool blend) {
+		FusedTracker fusion;
+		fusion.SetSource(FusedTracker::Primary, primaryID);
+		fusion.SetSource(FusedTracker::Secondary, secondaryID);
+		fusion.Configure(blend);
+
+		Run r = { {
+			{ "both tracking", 1.0, 2.0, 0.0, 0.0, 0, 0 },
+			{ "primary lost", 2.2, 3.0, 0.0, 0.0, 0, 0 },
+			{ "secondary drifting", 3.6, 4.5, 0.0, 0.0, 0, 0 },
+			{ "secondary silent", 4.6, 5.5, 0.0, 0.0, 0, 0 },
+		}, 0.0, true, false };
+		vr::DriverPose_t fused, previous;
+		RigidTransform previousTruth;
+		bool hasPrevious = false;
+
+		for (int64_t nextPrimary = 0, nextSecondary = 0; nextPrimary < end || nextSecondary < end;)
+		{
+			bool primary = nextPrimary <= nextSecondary;
+			int64_t tNs = primary ? nextPrimary : nextSecondary;
+			double t = (double) tNs * 1e-9;
+			(primary ? nextPrimary : nextSecondary) += primary ? primaryPeriod : secondaryPeriod;
+			if (!primary && t >= 4.5)
+				continue;
+
+			auto pose = primary ? primaryPose(t, t < 2.0 || t >= 3.0) : secondaryPose(t, t < 3.0 ? 0.0 : drift * (t - 3.0 < 0.5 ? (t - 3.0) / 0.5 : 1.0));
+			bool published = fusion.Update(primary ? primaryID : secondaryID, base + tNs, pose, fused);
+			auto truthNow = truth(t);
+
+			for (auto &s : r.stretches)
+			{
+				if (t < s.from || t >= s.to)
+					continue;
+				if (primary == (s.from > 4.0))
+					s.sources++;
+				if (!published)
+					continue;
+
+				double degrees = AngleDegrees(fused.qRotation, truthNow.rotation);
+				for (int i = 0; i < 3; i++)
+					s.meters += (fused.vecPosition[i] - truthNow.translation.v[i]) * (fused.vecPosition[i] - truthNow.translation.v[i]);
+				s.degrees += degrees * degrees;
+				s.fused++;
+			}
+
+			if (!published || t < 0.5)
+				continue;
+
+			r.valid = r.valid && fused.poseIsValid;
+			if (hasPrevious)
+			{
+				double step = 0.0;
+				for (int i = 0; i < 3; i++)
+				{
+					double d = (fused.vecPosition[i] - previous.vecPosition[i]) - (truthNow.translation.v[i] - previousTruth.translation.v[i]);
+					step += d * d;
+				}
+				r.jump = std::max(r.jump, std::sqrt(step));
+			}
+			previous = fused;
+			previousTruth = truthNow;
+			hasPrevious = true;
+		}
+
+		for (auto &s : r.stretches)
+		{
+			s.meters = std::sqrt(s.meters / std::max(s.fused, 1));
+			s.degrees = std::sqrt(s.degrees / std::max(s.fused, 1));
+		}
+
+		fusion.Stop();
+		auto stopped = fusion.LastPose();
+		r.stopped = !stopped.poseIsValid && !stopped.deviceIsConnected;
+		return r;
+	};
+
+	// Accuracy with noisy sources; jumps without noise, where any would be the fusion's own.
+	for (bool blend : { true, false })
+	{
+		noise = 1.0;
+		auto noisy = run(blend);
+		noise = 0.0;
+		auto clean = run(blend);
+
+		printf("%s:\n", blend ? "blend" : "switch");
+		for (auto &s : noisy.stretches)
+			printf("  %-18s %.2f mm, %.3f deg RMS off, %d fused poses for %d of the faster source's\n", s.name, s.meters * 1000.0, s.degrees, s.fused, s.sources);
+		printf("  largest jump without noise %.3f mm\n", clean.jump * 1000.0);
+
+		auto &s = noisy.stretches;
+		expect(noisy.valid && clean.valid, "fused pose lost tracking");
+		expect(s[0].meters < 0.001 && s[0].degrees < 0.1, "off the primary while both track");
+		expect(s[1].meters < 0.002 && s[1].degrees < 0.1, "off the primary while it is lost");
+		expect(s[2].meters < (blend ? drift * 0.3 : 0.001) && s[2].degrees < 0.1, "follows the drifting secondary");
+		expect(s[3].meters < 0.001 && s[3].degrees < 0.1, "off the primary once the secondary is silent");
+		expect(std::abs(s[0].fused - s[0].sources) <= 1 && std::abs(s[3].fused - s[3].sources) <= 1, "not at the faster source's rate");
+		expect(clean.jump < 0.001, "fused pose jumps");
+		expect(noisy.stopped, "stopped tracker still connected");
+	}
+
+	// Cost per source pose, both tracking, over poses prepared beforehand.
+	struct Event { uint32_t id; int64_t tNs; vr::DriverPose_t pose; };
+	std::vector<Event> events;
+	for (int64_t nextPrimary = 0, nextSecondary = 0; events.size() < 1024;)
+	{
+		bool primary = nextPrimary <= nextSecondary;
+		int64_t tNs = primary ? nextPrimary : nextSecondary;
+		events.push_back({ primary ? primaryID : secondaryID, tNs, primary ? primaryPose(tNs * 1e-9, true) : secondaryPose(tNs * 1e-9, 0.0) });
+		(primary ? nextPrimary : nextSecondary) += primary ? primaryPeriod : secondaryPeriod;
+	}
+	int64_t span = events.back().tNs + secondaryPeriod;
+
+	FusedTracker fusion;
+	fusion.SetSource(FusedTracker::Primary, primaryID);
+	fusion.SetSource(FusedTracker::Secondary, secondaryID);
+	fusion.Configure(true);
+	vr::DriverPose_t fused;
+	int published = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < count; k++)
+	{
+		auto &e = events[k & 1023];
+		published += fusion.Update(e.id, base + e.tNs + (int64_t) (k / 1024) * span, e.pose, fused);
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+	printf("%.1f ns per source pose, %d of %d fused (budget %.0f ns)\n", ns, published, count, budgetNs);
+	expect(ns <= budgetNs, "over budget");
+
+	if (failures)
+		return 1;
+
+	printf("ok\n");
+	return 0;
+}
+
+int RunDriver(int argc, char **argv)
+{
+	if (argc < 1)
+		throw std::runtime_error("expected check, stress, registry, platform, smoothing, timing, watchdog, fusion or profile");
+
+	std::string action = argv[0];
+	if (action == "profile")
+	{
+		if (argc != 2)
+			throw std::runtime_error("expected a profile file");
+		return CheckDriverProfile(argv[1]);
+	}
+	if (action == "registry")
+		return DriverRegistryCheck();
+
+	int threads = 8;
+	double seconds = 2.0;
+	uint32_t devices = 4;
+	int count = 100000;
+	double budgetNs = -1.0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--threads")
+			threads = std::max(1, std::stoi(OptionValue(i, argc, argv)));
+		else if (arg == "--seconds")
+			seconds = std::stod(OptionValue(i, argc, argv));
+		else if (arg == "--devices")
+			devices = (uint32_t) std::max(1, std::min((int) vr::k_unMaxTrackedDeviceCount, std::stoi(OptionValue(i, argc, argv))));
+		else if (arg == "--count")
+			count = std::max(1, std::stoi(OptionValue(i, argc, argv)));
+		else if (arg == "--budget-ns")
+			budgetNs = std::stod(OptionValue(i, argc, argv));
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	if (action == "check")
+		return DriverCheck(count);
+	if (action == "stress")
+		return DriverStress(threads, seconds, devices);
+	if (action == "platform")
+		return DriverPlatformCheck(count, budgetNs < 0.0 ? 1000.0 : budgetNs);
+	if (action == "smoothing")
+		return DriverSmoothingCheck(count, budgetNs < 0.0 ? 200.0 : budgetNs);
+	if (action == "timing")
+		return DriverTimingCheck(count, budgetNs < 0.0 ? 20.0 : budgetNs);
+	if (action == "watchdog")
+		return DriverWatchdogCheck(count, budgetNs < 0.0 ? 20.0 : budgetNs);
+	if (action == "fusion")
+		return DriverFusionCheck(count, budgetNs < 0.0 ? 500.0 : budgetNs);
+
+	throw std::runtime_error("unknown driver action " + action);
+}
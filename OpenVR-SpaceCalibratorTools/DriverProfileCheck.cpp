@@ -0,0 +1,84 @@
+#include "Tools.h"
+#include "../OpenVR-SpaceCalibrator/Calibration.h"
+#include "../OpenVR-SpaceCalibrator/ProfileJson.h"
+#include "../OpenVR-SpaceCalibratorDriver/DriverProfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// The largest difference between a driver quaternion and translation and the app's.
+static double Difference(const double q[4], const double t[3], const vr::HmdQuaternion_t &rotation, const vr::HmdVector3d_t &translation)
+{
+	double d = std::max(std::max(std::abs(q[0] - rotation.w), std::abs(q[1] - rotation.x)), std::max(std::abs(q[2] - rotation.y), std::abs(q[3] - rotation.z)));
+	for (int i = 0; i < 3; i++)
+		d = std::max(d, std::abs(t[i] - translation.v[i]));
+	return d;
+}
+
+// Reads a profile file the way the driver reads the saved profile at startup, and fails unless
+// it yields the transform and settings the app would send for the same profile.
+int CheckDriverProfile(const std::string &path)
+{
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error("cannot open profile " + path);
+
+	std::stringstream json;
+	json << in.rdbuf();
+
+	auto profile = ParseDriverProfile(json.str());
+
+	CalibrationContext ctx;
+	ParseProfile(ctx, json);
+	auto rotation = VRRotationQuat(ctx.calibratedRotation);
+	auto translation = VRTranslationVec(ctx.calibratedTranslation);
+
+	auto &q = profile.rotation;
+	auto &t = profile.translation;
+	printf("Applies to %s devices while the HMD is %s\n", profile.targetTrackingSystem.c_str(), profile.referenceTrackingSystem.c_str());
+	printf("Rotation (w x y z)  %.9f %.9f %.9f %.9f\n", q[0], q[1], q[2], q[3]);
+	printf("Translation (m)     %.6f %.6f %.6f\n", t[0], t[1], t[2]);
+
+	double d = Difference(q, t, rotation, translation);
+	bool same = profile.referenceTrackingSystem == ctx.referenceTrackingSystem && profile.targetTrackingSystem == ctx.targetTrackingSystem;
+
+	same = same && profile.mountOffsets.size() == ctx.mountOffsets.size();
+	for (size_t i = 0; same && i < profile.mountOffsets.size(); i++)
+	{
+		auto &offset = profile.mountOffsets[i];
+		same = offset.serial == ctx.mountOffsets[i].serial;
+		d = std::max(d, Difference(offset.rotation, offset.translation, VRRotationQuat(ctx.mountOffsets[i].rotation), VRTranslationVec(ctx.mountOffsets[i].translation)));
+	}
+
+	same = same && profile.smoothing.size() == ctx.smoothing.size();
+	for (size_t i = 0; same && i < profile.smoothing.size(); i++)
+	{
+		auto &smoothing = profile.smoothing[i];
+		same = smoothing.serial == ctx.smoothing[i].serial && smoothing.minCutoffHz == ctx.smoothing[i].minCutoffHz && smoothing.beta == ctx.smoothing[i].beta;
+	}
+
+	same = same && profile.timeOffsetsMs == ctx.timeOffsetsMs && profile.stageBudgetNs == ctx.stageBudgetNs && profile.platformSerial == ctx.platformSerial &&
+		profile.fusedPrimarySerial == ctx.fusedTracker.primarySerial && profile.fusedSecondarySerial == ctx.fusedTracker.secondarySerial &&
+		(profile.fusedPrimarySerial.empty() || profile.fusedBlend == ctx.fusedTracker.blend);
+
+	printf("%zu mount offsets, %zu smoothed devices, %zu time offsets, stage budget %.0f ns\n",
+		profile.mountOffsets.size(), profile.smoothing.size(), profile.timeOffsetsMs.size(), profile.stageBudgetNs);
+	if (!profile.platformSerial.empty())
+		printf("Moving platform %s\n", profile.platformSerial.c_str());
+	if (!profile.fusedPrimarySerial.empty())
+		printf("Fused tracker from %s and %s, %s\n", profile.fusedPrimarySerial.c_str(), profile.fusedSecondarySerial.c_str(), profile.fusedBlend ? "blended" : "switched");
+	printf("Largest difference to the app's transforms %.3g\n", d);
+
+	if (!same || d > 1e-12)
+	{
+		printf("FAIL\n");
+		return 1;
+	}
+
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// The driver's pose transform as it was before the transform table precomputed rotation
+// matrices: a quaternion product for the orientation and a quaternion sandwich for the
+// translation, straight from the transform the app sent. Kept as the reference that faster
+// driver code is checked and benchmarked against.
+
+#include <openvr_driver.h>
+
+struct ReferenceTransform
+{
+	vr::HmdVector3d_t translation;
+	vr::HmdQuaternion_t rotation;
+};
+
+inline vr::HmdQuaternion_t ReferenceMultiply(const vr::HmdQuaternion_t &lhs, const vr::HmdQuaternion_t &rhs)
+{
+	return {
+		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
+		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
+		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
+		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
+	};
+}
+
+inline void ReferenceApply(const ReferenceTransform &tf, vr::DriverPose_t &pose)
+{
+	pose.qWorldFromDriverRotation = ReferenceMultiply(tf.rotation, pose.qWorldFromDriverRotation);
+
+	auto &v = pose.vecWorldFromDriverTranslation;
+	vr::HmdQuaternion_t vectorQuat = { 0.0, v[0], v[1], v[2] };
+	vr::HmdQuaternion_t conjugate = { tf.rotation.w, -tf.rotation.x, -tf.rotation.y, -tf.rotation.z };
+	auto rotated = ReferenceMultiply(ReferenceMultiply(tf.rotation, vectorQuat), conjugate);
+
+	v[0] = rotated.x + tf.translation.v[0];
+	v[1] = rotated.y + tf.translation.v[1];
+	v[2] = rotated.z + tf.translation.v[2];
+}
+
+// A mount offset, which the transform table composes with the pose's driver-from-head transform.
+inline void ReferenceApplyMount(const ReferenceTransform &mount, vr::DriverPose_t &pose)
+{
+	auto &q = pose.qDriverFromHeadRotation;
+	auto &v = mount.translation.v;
+	vr::HmdQuaternion_t vectorQuat = { 0.0, v[0], v[1], v[2] };
+	vr::HmdQuaternion_t conjugate = { q.w, -q.x, -q.y, -q.z };
+	auto rotated = ReferenceMultiply(ReferenceMultiply(q, vectorQuat), conjugate);
+
+	pose.vecDriverFromHeadTranslation[0] += rotated.x;
+	pose.vecDriverFromHeadTranslation[1] += rotated.y;
+	pose.vecDriverFromHeadTranslation[2] += rotated.z;
+	q = ReferenceMultiply(q, mount.rotation);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Stand-in for SteamVR's IVRServerDriverHost, for driving the driver's pose path without SteamVR.
+// Keeps the last pose of each device and when it arrived, so a check can compare what SteamVR
+// would have received against the truth and time the hook from its entry to SteamVR.
+//
+// Everything but TrackedDevicePoseUpdated does nothing. A device's slot is written only by the
+// thread calling for that device, as SteamVR's drivers do.
+
+#include <openvr_driver.h>
+
+#include <chrono>
+#include <cstdint>
+
+class FakeDriverHost : public vr::IVRServerDriverHost
+{
+public:
+	struct Received
+	{
+		vr::DriverPose_t pose;
+		std::chrono::steady_clock::time_point at;
+		uint64_t count = 0;
+	};
+
+	const Received &Last(uint32_t openVRID) const { return received[openVRID]; }
+
+	// Any host's TrackedDevicePoseUpdated, for PoseHook to pass poses on to as the detour passes
+	// them to SteamVR's.
+	static void Forward(vr::IVRServerDriverHost *host, uint32_t openVRID, const vr::DriverPose_t &pose, uint32_t poseSize)
+	{
+		host->TrackedDevicePoseUpdated(openVRID, pose, poseSize);
+	}
+
+	void TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t &newPose, uint32_t) override
+	{
+		auto &slot = received[unWhichDevice];
+		slot.at = std::chrono::steady_clock::now();
+		slot.pose = newPose;
+		slot.count++;
+	}
+
+	bool TrackedDeviceAdded(const char *, vr::ETrackedDeviceClass, vr::ITrackedDeviceServerDriver *) override { return true; }
+	void VsyncEvent(double) override { }
+	void VendorSpecificEvent(uint32_t, vr::EVREventType, const vr::VREvent_Data_t &, double) override { }
+	bool IsExiting() override { return false; }
+	bool PollNextEvent(vr::VREvent_t *, uint32_t) override { return false; }
+	void GetRawTrackedDevicePoses(float, vr::TrackedDevicePose_t *, uint32_t) override { }
+	void TrackedDeviceDisplayTransformUpdated(uint32_t, vr::HmdMatrix34_t, vr::HmdMatrix34_t) override { }
+	void RequestRestart(const char *, const char *, const char *, const char *) override { }
+	uint32_t GetFrameTimings(vr::Compositor_FrameTiming *, uint32_t) override { return 0; }
+
+private:
+	Received received[vr::k_unMaxTrackedDeviceCount];
+};
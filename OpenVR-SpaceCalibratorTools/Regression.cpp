@@ -0,0 +1,284 @@
+#include "Tools.h"
+#include "AllocationCounter.h"
+#include "SyntheticSamples.h"
+
+#include <Eigen/Dense>
+#include <picojson.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+// Absolute limits each scenario must stay within, regardless of any baseline.
+struct ScenarioLimits
+{
+	const char *scenario;
+	double rotationErrorDeg;
+	double translationErrorCm;
+	double solveMs;
+};
+
+static const ScenarioLimits Limits[] = {
+	{ "exact-fast",      0.001, 0.01,   50.0 },
+	{ "noisy-fast",      0.15,  0.5,    50.0 },
+	{ "noisy-slow",      0.05,  0.15,  250.0 },
+	{ "noisy-very-slow", 0.05,  0.15, 1000.0 },
+	{ "latency-20ms",    1.25,  4.0,   250.0 },
+	{ "outliers-5pct",   0.65,  2.0,   250.0 },
+	{ "figure-eight",    0.05,  0.15,  250.0 },
+	{ "planar-yaw",      0.1,   0.3,   250.0 },
+};
+
+// Relative slack allowed against a recorded baseline before a result counts as a regression.
+static const double AccuracySlack = 1.25, AccuracyFloor = 0.005;
+static const double SpeedSlack = 1.5, SpeedFloorMs = 1.0;
+
+// Budget for the cross-validated uncertainty of both stages, on top of the solves themselves.
+static const double UncertaintyBudgetMs = 50.0;
+
+struct ScenarioResult
+{
+	std::string name;
+	size_t samples, deltas;
+	double rotationErrorDeg, translationErrorCm;
+	double rotationMs, translationMs;
+	uint64_t warmAllocations;
+	CalibrationUncertainty uncertainty;
+	double uncertaintyMs;
+};
+
+template<class Func> static double MinTimeMs(int repeat, Func func)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeat; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		func();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+static ScenarioResult RunScenario(const SyntheticScenario &scenario, SolverPrecision precision, int repeat)
+{
+	ScenarioResult result;
+	result.name = scenario.name;
+	result.samples = scenario.sampleCount;
+
+	CalibrationWorkspace workspace;
+	workspace.precision = precision;
+
+	auto rotationSamples = GenerateRotationSamples(scenario);
+	Eigen::Vector3d rotation;
+	result.rotationMs = MinTimeMs(repeat, [&] {
+		rotation = CalibrateRotation(rotationSamples, workspace);
+	});
+	result.deltas = workspace.rotationDeltaCount;
+
+	// Like a real session, the translation stage sees the rotation that was actually solved.
+	auto translationSamples = GenerateTranslationSamples(scenario, rotation);
+	Eigen::Vector3d translation;
+	result.translationMs = MinTimeMs(repeat, [&] {
+		translation = CalibrateTranslation(translationSamples, workspace);
+	});
+
+	// The workspace has now seen this problem size, so a complete solve must not touch the heap.
+	auto before = CurrentAllocationCounts();
+	CalibrateRotation(rotationSamples, workspace);
+	CalibrateTranslation(translationSamples, workspace);
+	result.warmAllocations = CurrentAllocationCounts().allocations - before.allocations;
+
+	result.uncertaintyMs = MinTimeMs(repeat, [&] {
+		result.uncertainty.rotation = RotationUncertainty(rotationSamples, rotation);
+		result.uncertainty.translation = TranslationUncertainty(translationSamples);
+	});
+	result.uncertainty.valid = true;
+
+	result.rotationErrorDeg = RotationErrorDegrees(rotation, scenario.rotation);
+	result.translationErrorCm = (translation - scenario.translation).norm();
+	return result;
+}
+
+static picojson::object LoadBaseline(const std::string &path)
+{
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error("cannot open baseline " + path);
+
+	picojson::value v;
+	std::string err = picojson::parse(v, in);
+	if (!err.empty())
+		throw std::runtime_error(err);
+
+	if (!v.is<picojson::object>())
+		throw std::runtime_error("baseline is not an object");
+
+	return v.get<picojson::object>();
+}
+
+static void WriteBaseline(const std::string &path, const std::vector<ScenarioResult> &results)
+{
+	picojson::object baseline;
+	for (auto &r : results)
+	{
+		picojson::object entry;
+		entry["rotation_error_deg"].set<double>(r.rotationErrorDeg);
+		entry["translation_error_cm"].set<double>(r.translationErrorCm);
+		entry["rotation_ms"].set<double>(r.rotationMs);
+		entry["translation_ms"].set<double>(r.translationMs);
+		baseline[r.name].set<picojson::object>(entry);
+	}
+
+	std::ofstream out(path);
+	if (!out)
+		throw std::runtime_error("cannot write baseline " + path);
+
+	out << picojson::value(baseline).serialize(true);
+}
+
+static bool CheckAgainst(const char *scenario, const char *what, double value, double limit)
+{
+	if (value <= limit)
+		return true;
+
+	printf("FAIL %s: %s %.4f exceeds %.4f\n", scenario, what, value, limit);
+	return false;
+}
+
+// Limit for the translation of the single-axis case, which the normal equations miss by over 10 cm.
+static const double IllConditionedTranslationCm = 0.01;
+
+// Solves the translation of rotation about one axis with the true rotation applied, so only the
+// translation solve's own conditioning is tested. Without noise the answer is exact, and a solve
+// that squares the condition number loses it to rounding.
+static bool CheckIllConditionedTranslation(SolverPrecision precision)
+{
+	SyntheticScenario scenario;
+	scenario.name = "single-axis";
+	scenario.motion = MotionPattern::SingleAxis;
+	scenario.rotation = Eigen::Vector3d(12.0, -140.0, 4.5);
+	scenario.translation = Eigen::Vector3d(35.0, -12.0, 140.0);
+
+	auto samples = GenerateTranslationSamples(scenario, scenario.rotation);
+	CalibrationWorkspace workspace;
+	workspace.precision = precision;
+	double error = (CalibrateTranslation(samples, workspace) - scenario.translation).norm();
+
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(AccumulateTranslationSystem(samples, workspace).r);
+	auto singular = svd.singularValues();
+	printf("\n%s translation: condition number %.3g, error %.6f cm%s\n", scenario.name.c_str(), singular(0) / singular(2), error,
+		workspace.translationFallback ? ", mixed precision fell back to double" : "");
+	return CheckAgainst(scenario.name.c_str(), "ill-conditioned translation error (cm)", error, IllConditionedTranslationCm);
+}
+
+static bool CheckResult(const ScenarioResult &r, const picojson::object *baseline)
+{
+	bool ok = true;
+
+	for (auto &limits : Limits)
+	{
+		if (r.name != limits.scenario)
+			continue;
+
+		ok &= CheckAgainst(limits.scenario, "rotation error (deg)", r.rotationErrorDeg, limits.rotationErrorDeg);
+		ok &= CheckAgainst(limits.scenario, "translation error (cm)", r.translationErrorCm, limits.translationErrorCm);
+		ok &= CheckAgainst(limits.scenario, "solve time (ms)", r.rotationMs + r.translationMs, limits.solveMs);
+	}
+
+	ok &= CheckAgainst(r.name.c_str(), "heap allocations after warm-up", (double) r.warmAllocations, 0.0);
+	ok &= CheckAgainst(r.name.c_str(), "uncertainty time (ms)", r.uncertaintyMs, UncertaintyBudgetMs);
+
+	if (!baseline)
+		return ok;
+
+	auto it = baseline->find(r.name);
+	if (it == baseline->end() || !it->second.is<picojson::object>())
+		return ok;
+
+	auto entry = it->second.get<picojson::object>();
+	auto accuracy = [](double base) { return std::max(base * AccuracySlack, base + AccuracyFloor); };
+	auto speed = [](double base) { return base * SpeedSlack + SpeedFloorMs; };
+	const char *name = r.name.c_str();
+
+	ok &= CheckAgainst(name, "rotation error vs baseline (deg)", r.rotationErrorDeg, accuracy(entry["rotation_error_deg"].get<double>()));
+	ok &= CheckAgainst(name, "translation error vs baseline (cm)", r.translationErrorCm, accuracy(entry["translation_error_cm"].get<double>()));
+	ok &= CheckAgainst(name, "rotation time vs baseline (ms)", r.rotationMs, speed(entry["rotation_ms"].get<double>()));
+	ok &= CheckAgainst(name, "translation time vs baseline (ms)", r.translationMs, speed(entry["translation_ms"].get<double>()));
+	return ok;
+}
+
+int RunRegression(int argc, char **argv)
+{
+	std::string csvPath, baselinePath, writeBaselinePath;
+	int repeat = 3;
+	SolverPrecision precision = SolverPrecision::Double;
+
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--csv")
+			csvPath = OptionValue(i, argc, argv);
+		else if (arg == "--baseline")
+			baselinePath = OptionValue(i, argc, argv);
+		else if (arg == "--write-baseline")
+			writeBaselinePath = OptionValue(i, argc, argv);
+		else if (arg == "--repeat")
+			repeat = std::max(1, std::stoi(OptionValue(i, argc, argv)));
+		else if (arg == "--precision")
+			precision = ParsePrecision(OptionValue(i, argc, argv));
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	picojson::object baseline;
+	if (!baselinePath.empty())
+		baseline = LoadBaseline(baselinePath);
+
+	std::vector<ScenarioResult> results;
+	bool ok = true;
+
+	printf("%-18s %8s %8s %12s %12s %10s %10s %11s %11s %8s\n",
+		"scenario", "samples", "deltas", "rot err deg", "trans err cm", "rot ms", "trans ms", "rot std deg", "trans std cm", "cv ms");
+	for (auto &scenario : StandardScenarios())
+	{
+		auto r = RunScenario(scenario, precision, repeat);
+		printf("%-18s %8zu %8zu %12.4f %12.4f %10.3f %10.3f %11.4f %11.4f %8.3f%s\n",
+			r.name.c_str(), r.samples, r.deltas, r.rotationErrorDeg, r.translationErrorCm, r.rotationMs, r.translationMs,
+			r.uncertainty.rotation.maxCoeff(), r.uncertainty.translation.maxCoeff(), r.uncertaintyMs,
+			r.uncertainty.TooHigh() ? "  recalibrate recommended" : "");
+		results.push_back(r);
+	}
+
+	for (auto &r : results)
+		ok &= CheckResult(r, baselinePath.empty() ? nullptr : &baseline);
+	ok &= CheckIllConditionedTranslation(precision);
+
+	if (!csvPath.empty())
+	{
+		std::ofstream csv(csvPath);
+		if (!csv)
+			throw std::runtime_error("cannot write " + csvPath);
+
+		csv << "scenario,samples,deltas,rotation_error_deg,translation_error_cm,rotation_ms,translation_ms,"
+			"rotation_std_x,rotation_std_y,rotation_std_z,translation_std_x,translation_std_y,translation_std_z,uncertainty_ms\n";
+		for (auto &r : results)
+		{
+			auto &u = r.uncertainty;
+			csv << r.name << "," << r.samples << "," << r.deltas << ","
+				<< r.rotationErrorDeg << "," << r.translationErrorCm << ","
+				<< r.rotationMs << "," << r.translationMs << ","
+				<< u.rotation(0) << "," << u.rotation(1) << "," << u.rotation(2) << ","
+				<< u.translation(0) << "," << u.translation(1) << "," << u.translation(2) << ","
+				<< r.uncertaintyMs << "\n";
+		}
+	}
+
+	if (!writeBaselinePath.empty())
+		WriteBaseline(writeBaselinePath, results);
+
+	printf(ok ? "All scenarios passed\n" : "Regressions detected\n");
+	return ok ? 0 : 1;
+}
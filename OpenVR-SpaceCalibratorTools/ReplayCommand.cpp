@@ -0,0 +1,211 @@
+#include "Tools.h"
+#include "ReplaySystem.h"
+#include "TraceCalibration.h"
+#include "../OpenVR-SpaceCalibrator/Calibration.h"
+#include "../OpenVR-SpaceCalibrator/Configuration.h"
+#include "../OpenVR-SpaceCalibrator/ProfileJson.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+static std::string ProfileOutputPath;
+
+// Calibration.cpp saves through this when a calibration finishes. The app's version writes to
+// the registry; a replay writes to the --profile file, if one was given.
+void SaveProfile(CalibrationContext &ctx)
+{
+	if (ProfileOutputPath.empty())
+		return;
+
+	std::ofstream out(ProfileOutputPath);
+	WriteProfile(ctx, out);
+	if (!out)
+		throw std::runtime_error("cannot write profile " + ProfileOutputPath);
+}
+
+struct ReplayOptions
+{
+	int reference = -1, target = -1;
+	CalibrationContext::Speed speed = CalibrationContext::FAST;
+	CalibrationContext::Preset preset;
+	std::string applyPath;
+};
+
+struct ReplayResult
+{
+	double wallSeconds = 0.0;
+	uint64_t requests = 0;
+	uint64_t digest = 0;
+};
+
+static CalibrationContext::Speed ParseSpeed(const std::string &name)
+{
+	if (name == "fast")
+		return CalibrationContext::FAST;
+	if (name == "slow")
+		return CalibrationContext::SLOW;
+	if (name == "very-slow")
+		return CalibrationContext::VERY_SLOW;
+
+	throw std::runtime_error("unknown calibration speed " + name);
+}
+
+static void LoadProfileFile(CalibrationContext &ctx, const std::string &path)
+{
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error("cannot open profile " + path);
+
+	ParseProfile(ctx, in);
+}
+
+static ReplayResult ReplayOnce(const PoseTraceReader &trace, const ReplayOptions &options)
+{
+	ReplayDriver driver;
+	ReplayVRSystem system(trace, driver);
+	InstallReplaySystem(&system);
+	InitCalibrator(driver);
+
+	CalCtx = CalibrationContext();
+	auto &ctx = CalCtx;
+	double startTime = trace.Tick(0).appTime;
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (!options.applyPath.empty())
+	{
+		LoadProfileFile(ctx, options.applyPath);
+		ctx.timeLastTick = ctx.timeLastScan = -std::numeric_limits<double>::infinity();
+	}
+	else
+	{
+		auto reference = trace.DeviceInfo(0, options.reference), target = trace.DeviceInfo(0, options.target);
+		ctx.referenceID = options.reference;
+		ctx.targetID = options.target;
+		ctx.referenceTrackingSystem = reference->trackingSystem;
+		ctx.targetTrackingSystem = target->trackingSystem;
+		ctx.calibrationSpeed = options.speed;
+		ctx.preset = options.preset;
+
+		// A recording starts one tick after the button press, so the press is replayed against
+		// the first recorded poses, a little more than a tick interval earlier.
+		StartCalibration();
+		ctx.timeLastTick = -std::numeric_limits<double>::infinity();
+		system.SetTick(0);
+		CalibrationTick(startTime - 0.1);
+	}
+
+	for (size_t i = 0; i < trace.TickCount(); i++)
+	{
+		system.SetTick(i);
+		CalibrationTick(trace.Tick(i).appTime);
+	}
+
+	ReplayResult result;
+	result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.requests = driver.RequestCount();
+	result.digest = driver.Digest();
+
+	InstallReplaySystem(nullptr);
+	return result;
+}
+
+int RunReplay(int argc, char **argv)
+{
+	if (argc < 1)
+		throw std::runtime_error("expected a trace file");
+
+	ReplayOptions options;
+	int repeat = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--reference")
+			options.reference = std::stoi(OptionValue(i, argc, argv));
+		else if (arg == "--target")
+			options.target = std::stoi(OptionValue(i, argc, argv));
+		else if (arg == "--speed")
+			options.speed = ParseSpeed(OptionValue(i, argc, argv));
+		else if (arg == "--preset")
+		{
+			std::string path = OptionValue(i, argc, argv);
+			std::ifstream in(path);
+			if (!in)
+				throw std::runtime_error("cannot open preset " + path);
+			ParsePreset(options.preset, in);
+			options.speed = CalibrationContext::PRESET;
+		}
+		else if (arg == "--apply")
+			options.applyPath = OptionValue(i, argc, argv);
+		else if (arg == "--profile")
+			ProfileOutputPath = OptionValue(i, argc, argv);
+		else if (arg == "--repeat")
+			repeat = std::max(1, std::stoi(OptionValue(i, argc, argv)));
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	PoseTraceReader trace;
+	trace.Open(argv[0]);
+	if (trace.TickCount() == 0)
+		throw std::runtime_error("trace has no ticks");
+
+	if (options.applyPath.empty())
+		SelectCalibrationDevices(trace, options.reference, options.target);
+
+	auto first = ReplayOnce(trace, options);
+
+	// Later runs only have to match the first, their calibration log would be a repeat of it.
+	bool deterministic = true;
+	double totalWall = first.wallSeconds;
+	{
+		std::ostringstream discard;
+		auto saved = std::cerr.rdbuf(discard.rdbuf());
+		for (int run = 1; run < repeat; run++)
+		{
+			auto result = ReplayOnce(trace, options);
+			totalWall += result.wallSeconds;
+			if (result.digest != first.digest || result.requests != first.requests)
+				deterministic = false;
+		}
+		std::cerr.rdbuf(saved);
+	}
+
+	auto &ctx = CalCtx;
+	double traceSeconds = trace.Tick(trace.TickCount() - 1).appTime - trace.Tick(0).appTime;
+	double wall = totalWall / repeat;
+
+	printf("\nreplayed %zu ticks (%.2f s of trace) in %.2f ms, %.0fx real time\n",
+		trace.TickCount(), traceSeconds, wall * 1e3, wall > 0.0 ? traceSeconds / wall : 0.0);
+	printf("poses %s\n", (trace.Header().flags & TraceFlagRawPoses)
+		? "are raw, driver transforms applied during replay" : "include the recorded driver transforms, requests captured only");
+
+	if (options.applyPath.empty())
+	{
+		if (ctx.validProfile)
+		{
+			auto &rot = ctx.calibratedRotation, &trans = ctx.calibratedTranslation;
+			printf("calibration: yaw=%.2f pitch=%.2f roll=%.2f x=%.2f y=%.2f z=%.2f\n", rot[1], rot[2], rot[0], trans[0], trans[1], trans[2]);
+		}
+		else
+		{
+			printf("calibration did not finish\n");
+		}
+	}
+
+	printf("driver requests: %llu, digest %016llx\n", (unsigned long long) first.requests, (unsigned long long) first.digest);
+
+	if (repeat > 1)
+		printf("%s over %d replays\n", deterministic ? "deterministic" : "NOT deterministic", repeat);
+
+	if (!deterministic)
+		return 1;
+	return options.applyPath.empty() && !ctx.validProfile ? 1 : 0;
+}
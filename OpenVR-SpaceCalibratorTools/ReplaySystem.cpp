@@ -0,0 +1,369 @@
+#include "ReplaySystem.h"
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cstring>
+
+protocol::Response ReplayDriver::SendBlocking(const protocol::Request &request)
+{
+	if (request.type == protocol::RequestSetSystemTransform)
+	{
+		// Mirrors ServerTrackedDeviceProvider::SetSystemTransform, resolved per device when poses are served.
+		auto &req = request.setSystemTransform;
+		std::string trackingSystem(req.trackingSystem, strnlen(req.trackingSystem, sizeof req.trackingSystem));
+
+		auto &tf = systemTransforms[trackingSystem];
+		tf.enabled = req.enabled;
+		tf.translation = req.translation;
+		tf.rotation = req.rotation;
+		tf.request = ++requests;
+
+		double q[4] = { req.rotation.w, req.rotation.x, req.rotation.y, req.rotation.z };
+		Hash(trackingSystem.data(), trackingSystem.size() + 1);
+		Hash(&req.enabled, sizeof req.enabled);
+		Hash(req.translation.v, sizeof req.translation.v);
+		Hash(q, sizeof q);
+		return protocol::Response(protocol::ResponseSuccess);
+	}
+
+	if (request.type == protocol::RequestSetMountOffsets)
+	{
+		// Recorded but not applied: a mount offset moves a device within its own space, which
+		// only changes the fixed offset between the devices a calibration solves for anyway.
+		auto &req = request.setMountOffsets;
+		if (req.count > protocol::MaxMountOffsets)
+			return protocol::Response(protocol::ResponseInvalid);
+
+		for (uint32_t i = 0; i < req.count; i++)
+		{
+			auto &offset = req.offsets[i];
+			double q[4] = { offset.rotation.w, offset.rotation.x, offset.rotation.y, offset.rotation.z };
+			Hash(offset.serial, strnlen(offset.serial, sizeof offset.serial) + 1);
+			Hash(&offset.enabled, sizeof offset.enabled);
+			Hash(offset.translation.v, sizeof offset.translation.v);
+			Hash(q, sizeof q);
+		}
+
+		requests++;
+		return protocol::Response(protocol::ResponseSuccess);
+	}
+
+	if (request.type == protocol::RequestSetSmoothing)
+	{
+		// Recorded but not applied: smoothing takes out noise the calibration averages over anyway.
+		auto &req = request.setSmoothing;
+		if (req.count > protocol::MaxDeviceSmoothing)
+			return protocol::Response(protocol::ResponseInvalid);
+
+		for (uint32_t i = 0; i < req.count; i++)
+		{
+			auto &device = req.devices[i];
+			Hash(device.serial, strnlen(device.serial, sizeof device.serial) + 1);
+			Hash(&device.enabled, sizeof device.enabled);
+			Hash(&device.minCutoffHz, sizeof device.minCutoffHz);
+			Hash(&device.beta, sizeof device.beta);
+		}
+
+		requests++;
+		return protocol::Response(protocol::ResponseSuccess);
+	}
+
+	if (request.type == protocol::RequestSetTimeOffset)
+	{
+		// Recorded but not applied: the calibration samples devices at rest, where a time offset
+		// moves nothing.
+		auto &req = request.setTimeOffset;
+		Hash(req.trackingSystem, strnlen(req.trackingSystem, sizeof req.trackingSystem) + 1);
+		Hash(&req.seconds, sizeof req.seconds);
+
+		requests++;
+		return protocol::Response(protocol::ResponseSuccess);
+	}
+
+	if (request.type == protocol::RequestSetStageBudget)
+	{
+		// Recorded but not applied: replays have no pose hook to watch.
+		Hash(&request.setStageBudget.budgetNs, sizeof request.setStageBudget.budgetNs);
+
+		requests++;
+		return protocol::Response(protocol::ResponseSuccess);
+	}
+
+	if (request.type == protocol::RequestSetFusedTracker)
+	{
+		// Recorded but not applied: the fused tracker is a device of its own, which the
+		// calibration never samples.
+		auto &req = request.setFusedTracker;
+		Hash(req.primarySerial, strnlen(req.primarySerial, sizeof req.primarySerial) + 1);
+		Hash(req.secondarySerial, strnlen(req.secondarySerial, sizeof req.secondarySerial) + 1);
+		Hash(&req.enabled, sizeof req.enabled);
+		Hash(&req.blend, sizeof req.blend);
+
+		requests++;
+		return protocol::Response(protocol::ResponseSuccess);
+	}
+
+	if (request.type == protocol::RequestSetMovingPlatform)
+	{
+		// Recorded but not applied: traces are of fixed play spaces, whose platform never moves.
+		auto &req = request.setMovingPlatform;
+		Hash(req.trackingSystem, strnlen(req.trackingSystem, sizeof req.trackingSystem) + 1);
+		Hash(req.serial, strnlen(req.serial, sizeof req.serial) + 1);
+		Hash(&req.enabled, sizeof req.enabled);
+
+		requests++;
+		return protocol::Response(protocol::ResponseSuccess);
+	}
+
+	if (request.type != protocol::RequestSetDeviceTransform)
+		return protocol::Response(protocol::ResponseInvalid);
+
+	// Mirrors ServerTrackedDeviceProvider::SetDeviceTransform.
+	auto &req = request.setDeviceTransform;
+	if (req.openVRID >= vr::k_unMaxTrackedDeviceCount)
+		return protocol::Response(protocol::ResponseInvalid);
+
+	auto &tf = transforms[req.openVRID];
+	tf.enabled = req.enabled;
+
+	if (req.updateTranslation)
+		tf.translation = req.translation;
+
+	if (req.updateRotation)
+		tf.rotation = req.rotation;
+
+	tf.request = ++requests;
+
+	// Fields are hashed one by one, the request itself has padding with unspecified contents.
+	Hash(&req.openVRID, sizeof req.openVRID);
+	Hash(&req.enabled, sizeof req.enabled);
+	Hash(&req.updateTranslation, sizeof req.updateTranslation);
+	Hash(&req.updateRotation, sizeof req.updateRotation);
+	if (req.updateTranslation)
+		Hash(req.translation.v, sizeof req.translation.v);
+	if (req.updateRotation)
+	{
+		double q[4] = { req.rotation.w, req.rotation.x, req.rotation.y, req.rotation.z };
+		Hash(q, sizeof q);
+	}
+
+	return protocol::Response(protocol::ResponseSuccess);
+}
+
+void ReplayDriver::Reset()
+{
+	for (auto &tf : transforms)
+		tf = Transform();
+	systemTransforms.clear();
+
+	requests = 0;
+	digest = ReplayDriver().digest;
+}
+
+const ReplayDriver::Transform &ReplayDriver::DeviceTransform(uint32_t slot, const char *trackingSystem) const
+{
+	// As in the driver, a system transform never applies to the HMD.
+	auto system = systemTransforms.find(trackingSystem);
+	if (slot != vr::k_unTrackedDeviceIndex_Hmd && system != systemTransforms.end() && system->second.request > transforms[slot].request)
+		return system->second;
+	return transforms[slot];
+}
+
+void ReplayDriver::Hash(const void *data, size_t size)
+{
+	auto bytes = static_cast<const unsigned char *>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		digest ^= bytes[i];
+		digest *= 1099511628211ull;
+	}
+}
+
+vr::HmdMatrix34_t ReplayVRSystem::Identity()
+{
+	vr::HmdMatrix34_t m = {};
+	m.m[0][0] = m.m[1][1] = m.m[2][2] = 1.0f;
+	return m;
+}
+
+const TraceDeviceInfo *ReplayVRSystem::Info(vr::TrackedDeviceIndex_t unDeviceIndex) const
+{
+	if (tick >= trace.TickCount())
+		return nullptr;
+
+	auto info = trace.DeviceInfo(tick, unDeviceIndex);
+	if (!info || info->deviceClass == vr::TrackedDeviceClass_Invalid)
+		return nullptr;
+
+	return info;
+}
+
+void ApplyDriverTransform(const ReplayDriver::Transform &tf, vr::TrackedDevicePose_t &pose)
+{
+	// The driver premultiplies the device's world-from-driver transform, which moves the
+	// absolute pose and its velocities the same way.
+	Eigen::Quaterniond rot(tf.rotation.w, tf.rotation.x, tf.rotation.y, tf.rotation.z);
+	Eigen::Matrix3d r = rot.toRotationMatrix();
+	Eigen::Vector3d t(tf.translation.v[0], tf.translation.v[1], tf.translation.v[2]);
+
+	auto &m = pose.mDeviceToAbsoluteTracking.m;
+	Eigen::Matrix3d deviceRot;
+	Eigen::Vector3d devicePos;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			deviceRot(i, j) = m[i][j];
+		devicePos(i) = m[i][3];
+	}
+
+	deviceRot = r * deviceRot;
+	devicePos = r * devicePos + t;
+
+	Eigen::Vector3d velocity = r * Eigen::Vector3d(pose.vVelocity.v[0], pose.vVelocity.v[1], pose.vVelocity.v[2]);
+	Eigen::Vector3d angular = r * Eigen::Vector3d(pose.vAngularVelocity.v[0], pose.vAngularVelocity.v[1], pose.vAngularVelocity.v[2]);
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			m[i][j] = (float) deviceRot(i, j);
+		m[i][3] = (float) devicePos(i);
+		pose.vVelocity.v[i] = (float) velocity(i);
+		pose.vAngularVelocity.v[i] = (float) angular(i);
+	}
+}
+
+void ReplayVRSystem::GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin, float, vr::TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount)
+{
+	uint32_t count = std::min(unTrackedDevicePoseArrayCount, vr::k_unMaxTrackedDeviceCount);
+	if (tick >= trace.TickCount())
+	{
+		memset(pTrackedDevicePoseArray, 0, count * sizeof(vr::TrackedDevicePose_t));
+		return;
+	}
+
+	memcpy(pTrackedDevicePoseArray, trace.Tick(tick).poses, count * sizeof(vr::TrackedDevicePose_t));
+
+	if (!AppliesTransforms())
+		return;
+
+	for (uint32_t id = 0; id < count; id++)
+	{
+		auto info = Info(id);
+		auto &tf = driver.DeviceTransform(id, info ? info->trackingSystem : "");
+		if (tf.enabled && pTrackedDevicePoseArray[id].bPoseIsValid)
+			ApplyDriverTransform(tf, pTrackedDevicePoseArray[id]);
+	}
+}
+
+uint32_t ReplayVRSystem::GetSortedTrackedDeviceIndicesOfClass(vr::ETrackedDeviceClass eTrackedDeviceClass, vr::TrackedDeviceIndex_t *punTrackedDeviceIndexArray, uint32_t unTrackedDeviceIndexArrayCount, vr::TrackedDeviceIndex_t)
+{
+	// Slot order rather than distance order, which is all a trace can answer.
+	uint32_t found = 0;
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		if (GetTrackedDeviceClass(id) != eTrackedDeviceClass)
+			continue;
+
+		if (punTrackedDeviceIndexArray && found < unTrackedDeviceIndexArrayCount)
+			punTrackedDeviceIndexArray[found] = id;
+		found++;
+	}
+	return found;
+}
+
+vr::TrackedDeviceIndex_t ReplayVRSystem::GetTrackedDeviceIndexForControllerRole(vr::ETrackedControllerRole unDeviceType)
+{
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		if (GetControllerRoleForTrackedDeviceIndex(id) == unDeviceType)
+			return id;
+	}
+	return vr::k_unTrackedDeviceIndexInvalid;
+}
+
+vr::ETrackedControllerRole ReplayVRSystem::GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t unDeviceIndex)
+{
+	auto info = Info(unDeviceIndex);
+	return info ? (vr::ETrackedControllerRole) info->controllerRole : vr::TrackedControllerRole_Invalid;
+}
+
+vr::ETrackedDeviceClass ReplayVRSystem::GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDeviceIndex)
+{
+	auto info = Info(unDeviceIndex);
+	return info ? (vr::ETrackedDeviceClass) info->deviceClass : vr::TrackedDeviceClass_Invalid;
+}
+
+bool ReplayVRSystem::IsTrackedDeviceConnected(vr::TrackedDeviceIndex_t unDeviceIndex)
+{
+	return Info(unDeviceIndex) != nullptr;
+}
+
+uint32_t ReplayVRSystem::GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop, char *pchValue, uint32_t unBufferSize, vr::ETrackedPropertyError *pError)
+{
+	if (pchValue && unBufferSize)
+		*pchValue = 0;
+
+	auto info = Info(unDeviceIndex);
+	if (!info)
+		return Unknown(pError, 0u);
+
+	const char *value;
+	if (prop == vr::Prop_TrackingSystemName_String)
+		value = info->trackingSystem;
+	else if (prop == vr::Prop_SerialNumber_String)
+		value = info->serial;
+	else
+		return Unknown(pError, 0u);
+
+	uint32_t required = (uint32_t) strlen(value) + 1;
+	if (!pchValue || required > unBufferSize)
+	{
+		if (pError)
+			*pError = vr::TrackedProp_BufferTooSmall;
+		return required;
+	}
+
+	memcpy(pchValue, value, required);
+	if (pError)
+		*pError = vr::TrackedProp_Success;
+	return required;
+}
+
+static ReplayVRSystem *InstalledSystem = nullptr;
+static uint32_t InitToken = 1;
+
+void InstallReplaySystem(ReplayVRSystem *system)
+{
+	InstalledSystem = system;
+	InitToken++;
+}
+
+// The OpenVR entry points, normally exported by openvr_api.
+
+namespace vr
+{
+	void *VR_CALLTYPE VR_GetGenericInterface(const char *pchInterfaceVersion, EVRInitError *peError)
+	{
+		if (InstalledSystem && strcmp(pchInterfaceVersion, IVRSystem_Version) == 0)
+		{
+			if (peError)
+				*peError = VRInitError_None;
+			return static_cast<IVRSystem *>(InstalledSystem);
+		}
+
+		if (peError)
+			*peError = VRInitError_Init_InterfaceNotFound;
+		return nullptr;
+	}
+
+	bool VR_CALLTYPE VR_IsInterfaceVersionValid(const char *pchInterfaceVersion)
+	{
+		return strcmp(pchInterfaceVersion, IVRSystem_Version) == 0;
+	}
+
+	uint32_t VR_CALLTYPE VR_GetInitToken()
+	{
+		return InitToken;
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+// Stand-ins for SteamVR and the driver, for running the calibrator's own CalibrationTick and
+// ScanAndApplyProfile against a recorded pose trace instead of live hardware.
+//
+// The tools define the OpenVR entry points themselves (VR_GetGenericInterface and friends), so
+// vr::VRSystem() inside Calibration.cpp resolves to whichever ReplayVRSystem is installed.
+
+#include "../OpenVR-SpaceCalibrator/DriverConnection.h"
+#include "../OpenVR-SpaceCalibrator/PoseTrace.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Records the transforms the calibrator sends, with the same update semantics as the driver.
+class ReplayDriver : public DriverConnection
+{
+public:
+	struct Transform
+	{
+		bool enabled = false;
+		vr::HmdVector3d_t translation = { { 0.0, 0.0, 0.0 } };
+		vr::HmdQuaternion_t rotation = { 1.0, 0.0, 0.0, 0.0 };
+		uint64_t request = 0; // which request set it, the newer of a device's and its system's applies
+	};
+
+	void Connect() override { }
+	protocol::Response SendBlocking(const protocol::Request &request) override;
+
+	void Reset();
+
+	// The transform the driver would apply to the device in the slot, which belongs to the tracking system.
+	const Transform &DeviceTransform(uint32_t slot, const char *trackingSystem) const;
+	uint64_t RequestCount() const { return requests; }
+
+	// FNV-1a over every request field that affects the driver, in arrival order. Equal digests
+	// mean two replays drove the driver identically.
+	uint64_t Digest() const { return digest; }
+
+private:
+	void Hash(const void *data, size_t size);
+
+	Transform transforms[vr::k_unMaxTrackedDeviceCount];
+	std::unordered_map<std::string, Transform> systemTransforms;
+	uint64_t requests = 0;
+	uint64_t digest = 14695981039346656037ull;
+};
+
+// Moves a pose by a driver transform, the way the driver's pose hook does.
+void ApplyDriverTransform(const ReplayDriver::Transform &tf, vr::TrackedDevicePose_t &pose);
+
+// Serves the poses and device identities of one trace tick at a time. When the trace holds raw
+// poses (TraceFlagRawPoses), the transforms set on the ReplayDriver are applied to them the way
+// the driver would; recorded sessions already contain the driver's effect and are served as is.
+class ReplayVRSystem : public vr::IVRSystem
+{
+public:
+	ReplayVRSystem(const PoseTraceReader &trace, const ReplayDriver &driver) : trace(trace), driver(driver) { }
+
+	void SetTick(size_t index) { tick = index; }
+	size_t Tick() const { return tick; }
+
+	bool AppliesTransforms() const { return (trace.Header().flags & TraceFlagRawPoses) != 0; }
+
+	void GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin eOrigin, float fPredictedSecondsToPhotonsFromNow, vr::TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override;
+	uint32_t GetSortedTrackedDeviceIndicesOfClass(vr::ETrackedDeviceClass eTrackedDeviceClass, vr::TrackedDeviceIndex_t *punTrackedDeviceIndexArray, uint32_t unTrackedDeviceIndexArrayCount, vr::TrackedDeviceIndex_t unRelativeToTrackedDeviceIndex = vr::k_unTrackedDeviceIndex_Hmd) override;
+	vr::TrackedDeviceIndex_t GetTrackedDeviceIndexForControllerRole(vr::ETrackedControllerRole unDeviceType) override;
+	vr::ETrackedControllerRole GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t unDeviceIndex) override;
+	vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDeviceIndex) override;
+	bool IsTrackedDeviceConnected(vr::TrackedDeviceIndex_t unDeviceIndex) override;
+	uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop, char *pchValue, uint32_t unBufferSize, vr::ETrackedPropertyError *pError = 0L) override;
+
+	// Everything below is unused by the calibrator and answers like a runtime without a display.
+	void GetRecommendedRenderTargetSize(uint32_t *pnWidth, uint32_t *pnHeight) override { *pnWidth = *pnHeight = 0; }
+	vr::HmdMatrix44_t GetProjectionMatrix(vr::EVREye, float, float) override { return vr::HmdMatrix44_t(); }
+	void GetProjectionRaw(vr::EVREye, float *pfLeft, float *pfRight, float *pfTop, float *pfBottom) override { *pfLeft = *pfRight = *pfTop = *pfBottom = 0.0f; }
+	bool ComputeDistortion(vr::EVREye, float, float, vr::DistortionCoordinates_t *) override { return false; }
+	vr::HmdMatrix34_t GetEyeToHeadTransform(vr::EVREye) override { return vr::HmdMatrix34_t(); }
+	bool GetTimeSinceLastVsync(float *, uint64_t *) override { return false; }
+	int32_t GetD3D9AdapterIndex() override { return -1; }
+	void GetDXGIOutputInfo(int32_t *pnAdapterIndex) override { *pnAdapterIndex = -1; }
+	void GetOutputDevice(uint64_t *pnDevice, vr::ETextureType, VkInstance_T * = nullptr) override { *pnDevice = 0; }
+	bool IsDisplayOnDesktop() override { return false; }
+	bool SetDisplayVisibility(bool) override { return false; }
+	void ResetSeatedZeroPose() override { }
+	vr::HmdMatrix34_t GetSeatedZeroPoseToStandingAbsoluteTrackingPose() override { return Identity(); }
+	vr::HmdMatrix34_t GetRawZeroPoseToStandingAbsoluteTrackingPose() override { return Identity(); }
+	vr::EDeviceActivityLevel GetTrackedDeviceActivityLevel(vr::TrackedDeviceIndex_t) override { return vr::k_EDeviceActivityLevel_UserInteraction; }
+	void ApplyTransform(vr::TrackedDevicePose_t *pOutputPose, const vr::TrackedDevicePose_t *pTrackedDevicePose, const vr::HmdMatrix34_t *) override { *pOutputPose = *pTrackedDevicePose; }
+	bool GetBoolTrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError = 0L) override { return Unknown(pError, false); }
+	float GetFloatTrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError = 0L) override { return Unknown(pError, 0.0f); }
+	int32_t GetInt32TrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError = 0L) override { return Unknown(pError, 0); }
+	uint64_t GetUint64TrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError = 0L) override { return Unknown(pError, (uint64_t) 0); }
+	vr::HmdMatrix34_t GetMatrix34TrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError = 0L) override { return Unknown(pError, vr::HmdMatrix34_t()); }
+	uint32_t GetArrayTrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::PropertyTypeTag_t, void *, uint32_t, vr::ETrackedPropertyError *pError = 0L) override { return Unknown(pError, 0u); }
+	const char *GetPropErrorNameFromEnum(vr::ETrackedPropertyError) override { return "TrackedProp_Replay"; }
+	bool PollNextEvent(vr::VREvent_t *, uint32_t) override { return false; }
+	bool PollNextEventWithPose(vr::ETrackingUniverseOrigin, vr::VREvent_t *, uint32_t, vr::TrackedDevicePose_t *) override { return false; }
+	const char *GetEventTypeNameFromEnum(vr::EVREventType) override { return "VREvent_Replay"; }
+	vr::HiddenAreaMesh_t GetHiddenAreaMesh(vr::EVREye, vr::EHiddenAreaMeshType = vr::k_eHiddenAreaMesh_Standard) override { return vr::HiddenAreaMesh_t(); }
+	bool GetControllerState(vr::TrackedDeviceIndex_t, vr::VRControllerState_t *, uint32_t) override { return false; }
+	bool GetControllerStateWithPose(vr::ETrackingUniverseOrigin, vr::TrackedDeviceIndex_t, vr::VRControllerState_t *, uint32_t, vr::TrackedDevicePose_t *) override { return false; }
+	void TriggerHapticPulse(vr::TrackedDeviceIndex_t, uint32_t, unsigned short) override { }
+	const char *GetButtonIdNameFromEnum(vr::EVRButtonId) override { return "k_EButton_Replay"; }
+	const char *GetControllerAxisTypeNameFromEnum(vr::EVRControllerAxisType) override { return "k_eControllerAxis_Replay"; }
+	bool IsInputAvailable() override { return true; }
+	bool IsSteamVRDrawingControllers() override { return false; }
+	bool ShouldApplicationPause() override { return false; }
+	bool ShouldApplicationReduceRenderingWork() override { return false; }
+	vr::EVRFirmwareError PerformFirmwareUpdate(vr::TrackedDeviceIndex_t) override { return vr::VRFirmwareError_Fail; }
+	void AcknowledgeQuit_Exiting() override { }
+	uint32_t GetAppContainerFilePaths(char *pchBuffer, uint32_t unBufferSize) override { if (pchBuffer && unBufferSize) *pchBuffer = 0; return 0; }
+	const char *GetRuntimeVersion() override { return "replay"; }
+
+private:
+	static vr::HmdMatrix34_t Identity();
+
+	template<class T> static T Unknown(vr::ETrackedPropertyError *pError, T value)
+	{
+		if (pError)
+			*pError = vr::TrackedProp_UnknownProperty;
+		return value;
+	}
+
+	const TraceDeviceInfo *Info(vr::TrackedDeviceIndex_t unDeviceIndex) const;
+
+	const PoseTraceReader &trace;
+	const ReplayDriver &driver;
+	size_t tick = 0;
+};
+
+// Makes vr::VRSystem() return the given system, or nullptr to uninstall it. Every install
+// invalidates the interface pointers OpenVR caches, like a fresh VR_Init would.
+void InstallReplaySystem(ReplayVRSystem *system);
@@ -0,0 +1,368 @@
+#include "Tools.h"
+#include "SyntheticSamples.h"
+#include "../OpenVR-SpaceCalibrator/ProfileJson.h"
+
+#include <picojson.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+// A parameter set to evaluate: the pair gates of the rotation solve and the samples per stage.
+struct SweepConfig
+{
+	RotationGates gates;
+	size_t samples;
+};
+
+struct SweepResult
+{
+	SweepConfig config;
+	size_t runs = 0, failedRuns = 0; // failed runs had fewer than three usable rotation pairs
+
+	// Error of a run relative to the recalibrate limits of CalibrationUncertainty, the larger of
+	// rotation and translation. Below 1 a calibration is as good as the app asks for.
+	double meanScore = 0.0, worstScore = 0.0;
+	double meanRotationErrorDeg = 0.0, meanTranslationErrorCm = 0.0;
+	double meanDeltas = 0.0;
+
+	double collectionSeconds = 0.0; // both stages at the scenario sample interval
+	double computeMs = 0.0;         // both solves, mean per run
+
+	bool collectionFront = false, computeFront = false;
+};
+
+static std::vector<double> ParseList(const std::string &text)
+{
+	std::vector<double> values;
+	std::stringstream in(text);
+	std::string item;
+	while (std::getline(in, item, ','))
+	{
+		if (!item.empty())
+			values.push_back(std::stod(item));
+	}
+
+	if (values.empty())
+		throw std::runtime_error("empty list " + text);
+	return values;
+}
+
+static double Score(double rotationErrorDeg, double translationErrorCm)
+{
+	return std::max(rotationErrorDeg / CalibrationUncertainty::RotationLimitDeg, translationErrorCm / CalibrationUncertainty::TranslationLimitCm);
+}
+
+static void EvaluateConfig(SweepResult &result, const std::vector<SyntheticScenario> &scenarios, int seeds, SolverPrecision precision, CalibrationWorkspace &workspace)
+{
+	auto &config = result.config;
+	workspace.precision = precision;
+	workspace.gates = config.gates;
+
+	double interval = 0.0;
+	for (auto &base : scenarios)
+	{
+		for (int seed = 0; seed < seeds; seed++)
+		{
+			SyntheticScenario scenario = base;
+			scenario.sampleCount = config.samples;
+			scenario.seed = base.seed + 7919 * seed;
+			interval += scenario.sampleInterval;
+			result.runs++;
+
+			auto rotationSamples = GenerateRotationSamples(scenario);
+			auto start = std::chrono::steady_clock::now();
+			auto rotation = CalibrateRotation(rotationSamples, workspace);
+			auto rotationEnd = std::chrono::steady_clock::now();
+			result.meanDeltas += (double) workspace.rotationDeltaCount;
+
+			if (workspace.rotationDeltaCount < 3)
+			{
+				result.failedRuns++;
+				continue;
+			}
+
+			auto translationSamples = GenerateTranslationSamples(scenario, rotation);
+			auto translationStart = std::chrono::steady_clock::now();
+			auto translation = CalibrateTranslation(translationSamples, workspace);
+			auto end = std::chrono::steady_clock::now();
+
+			result.computeMs += std::chrono::duration<double, std::milli>((rotationEnd - start) + (end - translationStart)).count();
+
+			double rotationError = RotationErrorDegrees(rotation, scenario.rotation);
+			double translationError = (translation - scenario.translation).norm();
+			double score = Score(rotationError, translationError);
+			if (!std::isfinite(score))
+			{
+				result.failedRuns++;
+				continue;
+			}
+
+			result.meanRotationErrorDeg += rotationError;
+			result.meanTranslationErrorCm += translationError;
+			result.meanScore += score;
+			result.worstScore = std::max(result.worstScore, score);
+		}
+	}
+
+	size_t solved = result.runs - result.failedRuns;
+	result.meanDeltas /= (double) result.runs;
+	result.collectionSeconds = 2.0 * config.samples * interval / (double) result.runs;
+
+	if (result.failedRuns > 0)
+	{
+		// A parameter set that can leave a calibration without a solution is never worth choosing.
+		result.meanScore = result.worstScore = std::numeric_limits<double>::infinity();
+	}
+	else
+	{
+		result.meanScore /= (double) solved;
+		result.meanRotationErrorDeg /= (double) solved;
+		result.meanTranslationErrorCm /= (double) solved;
+	}
+
+	if (solved > 0)
+		result.computeMs /= (double) solved;
+}
+
+// Marks the results no other result beats in both mean score and cost. Sorting by cost, then by
+// score, leaves the front as the running minima of the score.
+template<class Cost> static std::vector<size_t> MarkFront(std::vector<SweepResult> &results, Cost cost, bool SweepResult::*flag)
+{
+	std::vector<size_t> order(results.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		double ca = cost(results[a]), cb = cost(results[b]);
+		return ca != cb ? ca < cb : results[a].meanScore < results[b].meanScore;
+	});
+
+	std::vector<size_t> front;
+	double best = std::numeric_limits<double>::infinity();
+	for (auto i : order)
+	{
+		if (results[i].meanScore < best)
+		{
+			best = results[i].meanScore;
+			results[i].*flag = true;
+			front.push_back(i);
+		}
+	}
+	return front;
+}
+
+static void PrintFront(const char *title, const std::vector<SweepResult> &results, const std::vector<size_t> &front)
+{
+	printf("\n%s\n", title);
+	printf("  %7s %9s %8s %10s %10s %9s %9s %10s %10s\n", "samples", "angle", "axis", "collect_s", "compute_ms", "score", "worst", "rot_deg", "trans_cm");
+	for (auto i : front)
+	{
+		auto &r = results[i];
+		printf("  %7zu %9.3f %8.4f %10.1f %10.3f %9.3f %9.3f %10.4f %10.4f\n", r.config.samples, r.config.gates.minAngle, r.config.gates.minAxisNorm,
+			r.collectionSeconds, r.computeMs, r.meanScore, r.worstScore, r.meanRotationErrorDeg, r.meanTranslationErrorCm);
+	}
+}
+
+static void WriteCsv(const std::string &path, const std::vector<SweepResult> &results)
+{
+	std::ofstream csv(path);
+	if (!csv)
+		throw std::runtime_error("cannot write " + path);
+
+	csv << "samples,min_pair_angle,min_pair_axis_norm,runs,failed_runs,mean_deltas,mean_score,worst_score,"
+		"rotation_error_deg,translation_error_cm,collection_s,compute_ms,collection_front,compute_front\n";
+
+	for (auto &r : results)
+	{
+		csv << r.config.samples << "," << r.config.gates.minAngle << "," << r.config.gates.minAxisNorm << ","
+			<< r.runs << "," << r.failedRuns << "," << r.meanDeltas << "," << r.meanScore << "," << r.worstScore << ","
+			<< r.meanRotationErrorDeg << "," << r.meanTranslationErrorCm << "," << r.collectionSeconds << "," << r.computeMs << ","
+			<< r.collectionFront << "," << r.computeFront << "\n";
+	}
+}
+
+static void WriteJson(const std::string &path, const std::vector<SweepResult> &results)
+{
+	picojson::array list;
+	for (auto &r : results)
+	{
+		picojson::object obj;
+		obj["samples"] = picojson::value((double) r.config.samples);
+		obj["min_pair_angle"] = picojson::value(r.config.gates.minAngle);
+		obj["min_pair_axis_norm"] = picojson::value(r.config.gates.minAxisNorm);
+		obj["runs"] = picojson::value((double) r.runs);
+		obj["failed_runs"] = picojson::value((double) r.failedRuns);
+		obj["mean_deltas"] = picojson::value(r.meanDeltas);
+		obj["collection_s"] = picojson::value(r.collectionSeconds);
+		obj["compute_ms"] = picojson::value(r.computeMs);
+		obj["collection_front"] = picojson::value(r.collectionFront);
+		obj["compute_front"] = picojson::value(r.computeFront);
+
+		// JSON has no infinity, failed parameter sets simply have no scores.
+		if (r.failedRuns == 0)
+		{
+			obj["mean_score"] = picojson::value(r.meanScore);
+			obj["worst_score"] = picojson::value(r.worstScore);
+			obj["rotation_error_deg"] = picojson::value(r.meanRotationErrorDeg);
+			obj["translation_error_cm"] = picojson::value(r.meanTranslationErrorCm);
+		}
+
+		list.push_back(picojson::value(obj));
+	}
+
+	std::ofstream out(path);
+	if (!out)
+		throw std::runtime_error("cannot write " + path);
+
+	out << picojson::value(list).serialize(true);
+}
+
+int RunSweep(int argc, char **argv)
+{
+	std::vector<double> angles = { 0.2, 0.3, 0.4, 0.5, 0.6, 0.8 };
+	std::vector<double> axisNorms = { 0.002, 0.005, 0.01, 0.02, 0.05 };
+	std::vector<double> sampleCounts = { 50, 100, 150, 250, 350, 500 };
+	std::vector<SyntheticScenario> scenarios;
+	std::string csvPath, jsonPath, presetPath, presetName = "sweep";
+	double maxScore = 1.0;
+	int seeds = 1;
+	SolverPrecision precision = SolverPrecision::Mixed;
+	unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--scenario")
+			scenarios.push_back(FindScenario(OptionValue(i, argc, argv)));
+		else if (arg == "--seeds")
+			seeds = std::max(1, std::stoi(OptionValue(i, argc, argv)));
+		else if (arg == "--angles")
+			angles = ParseList(OptionValue(i, argc, argv));
+		else if (arg == "--axis-norms")
+			axisNorms = ParseList(OptionValue(i, argc, argv));
+		else if (arg == "--samples")
+			sampleCounts = ParseList(OptionValue(i, argc, argv));
+		else if (arg == "--precision")
+			precision = ParsePrecision(OptionValue(i, argc, argv));
+		else if (arg == "--jobs")
+			jobs = (unsigned) std::max(1, std::stoi(OptionValue(i, argc, argv)));
+		else if (arg == "--csv")
+			csvPath = OptionValue(i, argc, argv);
+		else if (arg == "--json")
+			jsonPath = OptionValue(i, argc, argv);
+		else if (arg == "--preset")
+			presetPath = OptionValue(i, argc, argv);
+		else if (arg == "--preset-name")
+			presetName = OptionValue(i, argc, argv);
+		else if (arg == "--max-score")
+			maxScore = std::stod(OptionValue(i, argc, argv));
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	if (scenarios.empty())
+		scenarios = StandardScenarios();
+
+	std::vector<SweepResult> results;
+	for (auto samples : sampleCounts)
+	{
+		if (samples < 10)
+			throw std::runtime_error("sample counts below 10 cannot calibrate");
+
+		for (auto angle : angles)
+		{
+			for (auto axisNorm : axisNorms)
+			{
+				SweepResult result;
+				result.config.samples = (size_t) samples;
+				result.config.gates.minAngle = angle;
+				result.config.gates.minAxisNorm = axisNorm;
+				results.push_back(result);
+			}
+		}
+	}
+
+	jobs = std::min<unsigned>(jobs, (unsigned) results.size());
+	printf("sweeping %zu parameter sets over %zu scenarios x %d seeds on %u threads\n", results.size(), scenarios.size(), seeds, jobs);
+
+	// Parameter sets differ a lot in cost, so workers pull them from a shared counter like batch does.
+	std::atomic<size_t> next(0);
+	auto worker = [&] {
+		CalibrationWorkspace workspace;
+		for (size_t i = next++; i < results.size(); i = next++)
+			EvaluateConfig(results[i], scenarios, seeds, precision, workspace);
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned t = 1; t < jobs; t++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &thread : threads)
+		thread.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t failed = 0;
+	for (auto &r : results)
+		failed += r.failedRuns > 0;
+	printf("done in %.2f s, %zu parameter sets left some run without enough rotation pairs\n", seconds, failed);
+
+	auto collectionFront = MarkFront(results, [](const SweepResult &r) { return r.collectionSeconds; }, &SweepResult::collectionFront);
+	auto computeFront = MarkFront(results, [](const SweepResult &r) { return r.computeMs; }, &SweepResult::computeFront);
+
+	PrintFront("Pareto front, error score vs collection time:", results, collectionFront);
+	PrintFront("Pareto front, error score vs compute time:", results, computeFront);
+
+	if (!csvPath.empty())
+		WriteCsv(csvPath, results);
+	if (!jsonPath.empty())
+		WriteJson(jsonPath, results);
+
+	if (collectionFront.empty())
+	{
+		printf("\nno parameter set calibrated every run\n");
+		return 1;
+	}
+
+	if (presetPath.empty())
+		return 0;
+
+	// The quickest collection that meets the score target, or the most accurate set if none does.
+	size_t chosen = collectionFront.back();
+	for (auto i : collectionFront)
+	{
+		if (results[i].meanScore <= maxScore)
+		{
+			chosen = i;
+			break;
+		}
+	}
+
+	auto &best = results[chosen];
+	if (best.meanScore > maxScore)
+		printf("\nno parameter set reaches a mean score of %.3f, using the most accurate one\n", maxScore);
+
+	CalibrationContext::Preset preset;
+	preset.valid = true;
+	preset.name = presetName;
+	preset.sampleCount = best.config.samples;
+	preset.gates = best.config.gates;
+
+	std::ofstream out(presetPath);
+	WritePreset(preset, out);
+	if (!out)
+		throw std::runtime_error("cannot write preset " + presetPath);
+
+	printf("\nwrote preset %s to %s: %zu samples, pair gates %.3f rad and %.4f, %.1f s collection, mean score %.3f\n",
+		preset.name.c_str(), presetPath.c_str(), preset.sampleCount, preset.gates.minAngle, preset.gates.minAxisNorm,
+		best.collectionSeconds, best.meanScore);
+	return 0;
+}
@@ -0,0 +1,262 @@
+#include "SyntheticSamples.h"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+struct RigidTransform
+{
+	Eigen::Matrix3d rot = Eigen::Matrix3d::Identity();
+	Eigen::Vector3d trans = Eigen::Vector3d::Zero();
+
+	RigidTransform operator*(const RigidTransform &rhs) const
+	{
+		RigidTransform out;
+		out.rot = rot * rhs.rot;
+		out.trans = rot * rhs.trans + trans;
+		return out;
+	}
+
+	RigidTransform Inverse() const
+	{
+		RigidTransform out;
+		out.rot = rot.transpose();
+		out.trans = -(out.rot * trans);
+		return out;
+	}
+};
+
+Eigen::Matrix3d RotationFromEuler(const Eigen::Vector3d &eulerdeg)
+{
+	// Same convention as VRRotationQuat.
+	Eigen::Vector3d euler = eulerdeg * EIGEN_PI / 180.0;
+	Eigen::Quaterniond q =
+		Eigen::AngleAxisd(euler(0), Eigen::Vector3d::UnitZ()) *
+		Eigen::AngleAxisd(euler(1), Eigen::Vector3d::UnitY()) *
+		Eigen::AngleAxisd(euler(2), Eigen::Vector3d::UnitX());
+	return q.toRotationMatrix();
+}
+
+double RotationErrorDegrees(const Eigen::Vector3d &eulerA, const Eigen::Vector3d &eulerB)
+{
+	Eigen::Matrix3d delta = RotationFromEuler(eulerA) * RotationFromEuler(eulerB).transpose();
+	double c = (delta.trace() - 1.0) / 2.0;
+	c = std::max(-1.0, std::min(1.0, c));
+	return acos(c) * 180.0 / EIGEN_PI;
+}
+
+// Pose of the reference device in reference space at a given time.
+static RigidTransform ReferenceTrajectory(MotionPattern motion, double t)
+{
+	RigidTransform pose;
+	Eigen::Vector3d center(0.2, 1.1, -0.3);
+
+	switch (motion)
+	{
+	case MotionPattern::Tumble:
+		pose.rot = (
+			Eigen::AngleAxisd(1.9 * sin(0.37 * t), Eigen::Vector3d::UnitY()) *
+			Eigen::AngleAxisd(1.2 * sin(0.53 * t + 0.4), Eigen::Vector3d::UnitX()) *
+			Eigen::AngleAxisd(1.4 * sin(0.71 * t + 1.1), Eigen::Vector3d::UnitZ())
+		).toRotationMatrix();
+		pose.trans = center + Eigen::Vector3d(0.15 * sin(0.3 * t), 0.1 * sin(0.45 * t), 0.15 * cos(0.3 * t));
+		break;
+
+	case MotionPattern::FigureEight:
+		pose.rot = (
+			Eigen::AngleAxisd(0.9 * sin(0.5 * t), Eigen::Vector3d::UnitY()) *
+			Eigen::AngleAxisd(0.8 * sin(t), Eigen::Vector3d::UnitX()) *
+			Eigen::AngleAxisd(0.6 * cos(0.5 * t), Eigen::Vector3d::UnitZ())
+		).toRotationMatrix();
+		pose.trans = center + Eigen::Vector3d(0.4 * sin(0.5 * t), 0.2 * sin(t), 0.1 * cos(0.5 * t));
+		break;
+
+	case MotionPattern::PlanarYaw:
+		pose.rot = (
+			Eigen::AngleAxisd(2.5 * sin(0.4 * t), Eigen::Vector3d::UnitY()) *
+			Eigen::AngleAxisd(0.05 * sin(1.3 * t), Eigen::Vector3d::UnitX())
+		).toRotationMatrix();
+		pose.trans = center + Eigen::Vector3d(0.1 * sin(0.4 * t), 0.0, 0.1 * cos(0.4 * t));
+		break;
+
+	case MotionPattern::SingleAxis:
+		pose.rot = (
+			Eigen::AngleAxisd(2.5 * sin(0.4 * t), Eigen::Vector3d::UnitY()) *
+			Eigen::AngleAxisd(1e-8 * sin(1.3 * t), Eigen::Vector3d::UnitX())
+		).toRotationMatrix();
+		pose.trans = center + Eigen::Vector3d(0.1 * sin(0.4 * t), 0.0, 0.1 * cos(0.4 * t));
+		break;
+	}
+
+	return pose;
+}
+
+class NoiseSource
+{
+public:
+	NoiseSource(const SyntheticScenario &scenario, uint32_t stream) :
+		scenario(scenario), rng(scenario.seed * 7919u + stream), unit(0.0, 1.0), uniform(0.0, 1.0) { }
+
+	RigidTransform Perturb(const RigidTransform &pose)
+	{
+		RigidTransform out = pose;
+
+		if (scenario.rotationNoise > 0.0)
+		{
+			Eigen::Vector3d axisAngle(unit(rng), unit(rng), unit(rng));
+			axisAngle *= scenario.rotationNoise;
+			double angle = axisAngle.norm();
+			if (angle > 0.0)
+				out.rot = Eigen::AngleAxisd(angle, axisAngle / angle).toRotationMatrix() * out.rot;
+		}
+
+		if (scenario.positionNoise > 0.0)
+			out.trans += Eigen::Vector3d(unit(rng), unit(rng), unit(rng)) * scenario.positionNoise;
+
+		return out;
+	}
+
+	// Simulates a tracking glitch: the pose jumps and twists for a single sample.
+	RigidTransform MaybeGlitch(const RigidTransform &pose)
+	{
+		if (scenario.outlierRate <= 0.0 || uniform(rng) >= scenario.outlierRate)
+			return pose;
+
+		RigidTransform out = pose;
+		Eigen::Vector3d axis(unit(rng), unit(rng), unit(rng));
+		out.rot = Eigen::AngleAxisd(0.3 + uniform(rng) * 0.5, axis.normalized()).toRotationMatrix() * out.rot;
+		out.trans += Eigen::Vector3d(unit(rng), unit(rng), unit(rng)) * 0.2;
+		return out;
+	}
+
+private:
+	const SyntheticScenario &scenario;
+	std::mt19937 rng;
+	std::normal_distribution<double> unit;
+	std::uniform_real_distribution<double> uniform;
+};
+
+static Pose ToPose(const RigidTransform &tf)
+{
+	Pose pose;
+	pose.rot = tf.rot;
+	pose.trans = tf.trans;
+	return pose;
+}
+
+static std::vector<Sample> GenerateSamples(const SyntheticScenario &scenario, const RigidTransform &applied, double startTime, uint32_t stream)
+{
+	// Calibration maps target space into reference space.
+	RigidTransform calibration;
+	calibration.rot = RotationFromEuler(scenario.rotation);
+	calibration.trans = scenario.translation * 0.01;
+	RigidTransform targetFromReference = calibration.Inverse();
+
+	RigidTransform mount;
+	mount.rot = RotationFromEuler(scenario.mountRotation);
+	mount.trans = scenario.mountOffset;
+
+	NoiseSource noise(scenario, stream);
+	std::vector<Sample> samples;
+	samples.reserve(scenario.sampleCount);
+
+	for (size_t i = 0; i < scenario.sampleCount; i++)
+	{
+		double t = startTime + i * scenario.sampleInterval;
+
+		RigidTransform ref = ReferenceTrajectory(scenario.motion, t);
+		RigidTransform lagged = ReferenceTrajectory(scenario.motion, t - scenario.latency);
+		RigidTransform target = applied * targetFromReference * lagged * mount;
+
+		ref = noise.Perturb(ref);
+		target = noise.MaybeGlitch(noise.Perturb(target));
+
+		samples.push_back(Sample(ToPose(ref), ToPose(target)));
+	}
+
+	return samples;
+}
+
+std::vector<Sample> GenerateRotationSamples(const SyntheticScenario &scenario)
+{
+	return GenerateSamples(scenario, RigidTransform(), 0.0, 0);
+}
+
+std::vector<Sample> GenerateTranslationSamples(const SyntheticScenario &scenario, const Eigen::Vector3d &appliedRotation)
+{
+	RigidTransform applied;
+	applied.rot = RotationFromEuler(appliedRotation);
+
+	// The translation stage starts right after the rotation stage in a real session.
+	double startTime = scenario.sampleCount * scenario.sampleInterval;
+	return GenerateSamples(scenario, applied, startTime, 1);
+}
+
+static SyntheticScenario MakeScenario(const char *name, MotionPattern motion, size_t sampleCount)
+{
+	SyntheticScenario s;
+	s.name = name;
+	s.motion = motion;
+	s.sampleCount = sampleCount;
+	s.rotation = Eigen::Vector3d(12.0, -140.0, 4.5);
+	s.translation = Eigen::Vector3d(35.0, -12.0, 140.0);
+	return s;
+}
+
+const std::vector<SyntheticScenario> &StandardScenarios()
+{
+	static std::vector<SyntheticScenario> scenarios;
+	if (!scenarios.empty())
+		return scenarios;
+
+	scenarios.push_back(MakeScenario("exact-fast", MotionPattern::Tumble, 100));
+
+	auto s = MakeScenario("noisy-fast", MotionPattern::Tumble, 100);
+	s.positionNoise = 0.001;
+	s.rotationNoise = 0.002;
+	scenarios.push_back(s);
+
+	s = MakeScenario("noisy-slow", MotionPattern::Tumble, 250);
+	s.positionNoise = 0.001;
+	s.rotationNoise = 0.002;
+	scenarios.push_back(s);
+
+	s = MakeScenario("noisy-very-slow", MotionPattern::Tumble, 500);
+	s.positionNoise = 0.001;
+	s.rotationNoise = 0.002;
+	scenarios.push_back(s);
+
+	s = MakeScenario("latency-20ms", MotionPattern::Tumble, 250);
+	s.positionNoise = 0.0005;
+	s.rotationNoise = 0.001;
+	s.latency = 0.02;
+	scenarios.push_back(s);
+
+	s = MakeScenario("outliers-5pct", MotionPattern::Tumble, 250);
+	s.positionNoise = 0.0005;
+	s.rotationNoise = 0.001;
+	s.outlierRate = 0.05;
+	scenarios.push_back(s);
+
+	s = MakeScenario("figure-eight", MotionPattern::FigureEight, 250);
+	s.positionNoise = 0.001;
+	s.rotationNoise = 0.002;
+	scenarios.push_back(s);
+
+	s = MakeScenario("planar-yaw", MotionPattern::PlanarYaw, 250);
+	s.positionNoise = 0.0005;
+	s.rotationNoise = 0.001;
+	scenarios.push_back(s);
+
+	return scenarios;
+}
+
+const SyntheticScenario &FindScenario(const std::string &name)
+{
+	for (auto &scenario : StandardScenarios())
+	{
+		if (scenario.name == name)
+			return scenario;
+	}
+	throw std::runtime_error("unknown scenario " + name);
+}
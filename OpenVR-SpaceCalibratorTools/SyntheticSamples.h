@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../OpenVR-SpaceCalibrator/CalibrationSolver.h"
+
+#include <Eigen/Geometry>
+#include <string>
+#include <vector>
+
+enum class MotionPattern
+{
+	// Slow tumbling through many orientations, like the recommended compass-style hand motion.
+	Tumble,
+	// Figure eight sweeps with moderate wrist rotation.
+	FigureEight,
+	// Rotation almost entirely around the vertical axis, a poorly conditioned case.
+	PlanarYaw,
+	// Rotation around the vertical axis with a tilt far below any tracking noise, which leaves the
+	// height of the translation barely determined. Without noise, its translation system has a
+	// condition number around 10^8, which solving the normal equations would square past what
+	// double precision holds.
+	SingleAxis,
+};
+
+// Describes a sample stream produced from a known rigid transform between two tracking systems.
+struct SyntheticScenario
+{
+	std::string name;
+
+	// Ground truth calibration, in the same units the profile stores: euler degrees and centimeters.
+	Eigen::Vector3d rotation = Eigen::Vector3d::Zero();
+	Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+
+	// Rigid offset between the reference and target device, expressed in the reference device frame.
+	Eigen::Vector3d mountOffset = Eigen::Vector3d(0.05, -0.02, 0.08);
+	Eigen::Vector3d mountRotation = Eigen::Vector3d(10.0, 35.0, -20.0);
+
+	size_t sampleCount = 100;
+	double sampleInterval = 0.05; // seconds, matches CalibrationTick
+
+	MotionPattern motion = MotionPattern::Tumble;
+	double positionNoise = 0.0;  // meters, standard deviation per axis
+	double rotationNoise = 0.0;  // radians, standard deviation per axis
+	double latency = 0.0;        // seconds the target system lags behind the reference system
+	double outlierRate = 0.0;    // fraction of samples with a glitched target pose
+
+	uint32_t seed = 1;
+};
+
+Eigen::Matrix3d RotationFromEuler(const Eigen::Vector3d &eulerdeg);
+
+// Generates samples for the rotation stage: target poses are reported in the raw target space.
+std::vector<Sample> GenerateRotationSamples(const SyntheticScenario &scenario);
+
+// Generates samples for the translation stage: target poses have appliedRotation (euler degrees)
+// already applied, mirroring the driver state after the rotation stage has finished.
+std::vector<Sample> GenerateTranslationSamples(const SyntheticScenario &scenario, const Eigen::Vector3d &appliedRotation);
+
+// Angle in degrees between the rotations described by two euler triples.
+double RotationErrorDegrees(const Eigen::Vector3d &eulerA, const Eigen::Vector3d &eulerB);
+
+const std::vector<SyntheticScenario> &StandardScenarios();
+
+// Looks up a standard scenario by name, throws if there is none.
+const SyntheticScenario &FindScenario(const std::string &name);
@@ -0,0 +1,604 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "Tools.h"
+#include "FakeDriverHost.h"
+#include "../OpenVR-SpaceCalibratorDriver/DeviceProfiler.h"
+#include "../OpenVR-SpaceCalibratorDriver/DeviceSlot.h"
+#include "../OpenVR-SpaceCalibratorDriver/PoseTap.h"
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class PoseTapReader
+{
+public:
+	~PoseTapReader()
+	{
+		if (file)
+			fclose(file);
+	}
+
+	void Open(const std::string &path)
+	{
+		file = fopen(path.c_str(), "rb");
+		if (!file)
+			throw std::runtime_error("cannot open " + path);
+
+		if (fread(&header, sizeof header, 1, file) != 1 || memcmp(header.magic, PoseTapMagic, sizeof header.magic) != 0)
+			throw std::runtime_error(path + " is not a pose tap");
+		if (header.version != PoseTapVersion || header.headerSize != sizeof header)
+			throw std::runtime_error(path + " has unsupported pose tap version " + std::to_string(header.version));
+		if (header.recordSize != sizeof(PoseTapRecord) || header.poseSize != sizeof(vr::DriverPose_t))
+			throw std::runtime_error(path + " was written by a driver with a different DriverPose_t");
+	}
+
+	// Reads up to count records, returns how many. A record cut short at the end is ignored.
+	size_t Read(PoseTapRecord *records, size_t count)
+	{
+		return fread(records, sizeof(PoseTapRecord), count, file);
+	}
+
+	const PoseTapFileHeader &Header() const { return header; }
+
+private:
+	FILE *file = nullptr;
+	PoseTapFileHeader header;
+};
+
+struct TapDeviceStats
+{
+	uint64_t count = 0, transformed = 0, forwarded = 0, invalid = 0;
+	int64_t first = 0, last = 0, maxGap = 0;
+};
+
+static int TapInfo(const std::string &path)
+{
+	PoseTapReader tap;
+	tap.Open(path);
+
+	time_t start = (time_t) (tap.Header().startUnixNs / 1000000000);
+	char startText[64];
+	strftime(startText, sizeof startText, "%Y-%m-%d %H:%M:%S UTC", gmtime(&start));
+
+	std::vector<TapDeviceStats> devices(vr::k_unMaxTrackedDeviceCount);
+	std::vector<PoseTapRecord> buffer(1024);
+	uint64_t total = 0, outOfRange = 0;
+	int64_t end = 0;
+
+	size_t n;
+	while ((n = tap.Read(buffer.data(), buffer.size())) > 0)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			auto &r = buffer[i];
+			total++;
+			if (r.openVRID >= vr::k_unMaxTrackedDeviceCount)
+			{
+				outOfRange++;
+				continue;
+			}
+
+			auto &d = devices[r.openVRID];
+			if (d.count == 0)
+				d.first = r.timestampNs;
+			else
+				d.maxGap = std::max(d.maxGap, r.timestampNs - d.last);
+
+			d.last = r.timestampNs;
+			d.count++;
+			d.transformed += (r.flags & PoseTapTransformed) != 0;
+			d.forwarded += (r.flags & PoseTapForwarded) != 0;
+			d.invalid += !r.before.poseIsValid;
+			end = std::max(end, r.timestampNs);
+		}
+	}
+
+	printf("version   %u\n", tap.Header().version);
+	printf("started   %s\n", startText);
+	printf("poses     %llu over %.3f s\n", (unsigned long long) total, end * 1e-9);
+	if (outOfRange)
+		printf("          %llu with an out of range device index\n", (unsigned long long) outOfRange);
+
+	printf("\n%4s %10s %10s %12s %12s %10s %10s\n", "slot", "poses", "rate_hz", "max_gap_ms", "transformed", "forwarded", "invalid");
+	for (uint32_t slot = 0; slot < vr::k_unMaxTrackedDeviceCount; slot++)
+	{
+		auto &d = devices[slot];
+		if (d.count == 0)
+			continue;
+
+		double span = (d.last - d.first) * 1e-9;
+		printf("%4u %10llu %10.1f %12.3f %12llu %10llu %10llu\n", slot, (unsigned long long) d.count,
+			span > 0.0 ? (d.count - 1) / span : 0.0, d.maxGap * 1e-6,
+			(unsigned long long) d.transformed, (unsigned long long) d.forwarded, (unsigned long long) d.invalid);
+	}
+	return 0;
+}
+
+// Runs the driver's device profiler over a tap, as it would have run live, and prints what the
+// app would show in its device panes at the end of the recording.
+static int TapProfile(const std::string &path)
+{
+	PoseTapReader tap;
+	tap.Open(path);
+
+	std::vector<DeviceProfiler> profilers(vr::k_unMaxTrackedDeviceCount);
+	std::vector<PoseTapRecord> buffer(1024);
+
+	size_t n;
+	while ((n = tap.Read(buffer.data(), buffer.size())) > 0)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			if (buffer[i].openVRID < vr::k_unMaxTrackedDeviceCount)
+				profilers[buffer[i].openVRID].AddPose(buffer[i].timestampNs, buffer[i].before);
+		}
+	}
+
+	printf("%4s %10s %8s %10s %10s %12s %12s %13s %8s\n", "slot", "poses", "invalid", "rate_hz", "jitter_ms", "max_gap_ms", "position_mm", "rotation_deg", "windows");
+	for (uint32_t slot = 0; slot < vr::k_unMaxTrackedDeviceCount; slot++)
+	{
+		auto stats = profilers[slot].Stats();
+		if (stats.poseCount == 0)
+			continue;
+
+		printf("%4u %10llu %8u %10.1f %10.3f %12.3f", slot, (unsigned long long) stats.poseCount, stats.invalidPoses, stats.updateRateHz, stats.intervalJitterMs, stats.maxIntervalMs);
+		if (stats.stationaryWindows > 0)
+			printf(" %12.4f %13.5f %8u\n", stats.positionNoiseMm, stats.rotationNoiseDeg, stats.stationaryWindows);
+		else
+			printf(" %12s %13s %8u\n", "-", "-", 0u);
+	}
+	return 0;
+}
+
+// Drives a PoseTap from several pose threads at once, like devices of different drivers updating
+// concurrently, then checks the file: every pose either written or counted as dropped, each
+// device's poses in order and intact. Also meant to be run under ThreadSanitizer.
+static int TapStress(const std::string &path, int threads, double seconds, double rate)
+{
+	PoseTap tap;
+	if (!tap.Start(path))
+		throw std::runtime_error("cannot create " + path);
+
+	std::atomic<bool> stop(false);
+	std::vector<uint64_t> produced(threads);
+	std::vector<double> recordNs(threads);
+
+	auto producer = [&](int device) {
+		vr::DriverPose_t before, after;
+		memset(&before, 0, sizeof before);
+		before.poseIsValid = true;
+		before.result = vr::TrackingResult_Running_OK;
+		before.qRotation.w = before.qWorldFromDriverRotation.w = before.qDriverFromHeadRotation.w = 1.0;
+
+		auto interval = std::chrono::nanoseconds(rate > 0.0 ? (int64_t) (1e9 / rate) : 0);
+		auto next = std::chrono::steady_clock::now();
+		double spent = 0.0;
+		uint64_t sequence = 0;
+
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			before.vecPosition[0] = (double) sequence;
+			after = before;
+			after.vecWorldFromDriverTranslation[0] = (double) sequence + 0.5;
+
+			int64_t now = PoseTap::Now();
+			tap.Record(now, (uint32_t) device, PoseTapForwarded, before, after);
+			spent += (double) (PoseTap::Now() - now);
+			sequence++;
+
+			if (interval.count() > 0)
+			{
+				next += interval;
+				std::this_thread::sleep_until(next);
+			}
+		}
+
+		produced[device] = sequence;
+		recordNs[device] = sequence ? spent / sequence : 0.0;
+	};
+
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++)
+		pool.emplace_back(producer, t);
+
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	stop = true;
+	for (auto &thread : pool)
+		thread.join();
+	tap.Stop();
+
+	uint64_t totalProduced = 0;
+	double meanNs = 0.0;
+	for (int t = 0; t < threads; t++)
+	{
+		totalProduced += produced[t];
+		meanNs += recordNs[t] / threads;
+	}
+
+	PoseTapReader reader;
+	reader.Open(path);
+	std::vector<PoseTapRecord> buffer(1024);
+	std::vector<int64_t> lastSequence(threads, -1);
+	uint64_t read = 0, errors = 0;
+
+	size_t n;
+	while ((n = reader.Read(buffer.data(), buffer.size())) > 0)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			auto &r = buffer[i];
+			read++;
+			if (r.openVRID >= (uint32_t) threads)
+			{
+				errors++;
+				continue;
+			}
+
+			auto sequence = (int64_t) r.before.vecPosition[0];
+			if (sequence <= lastSequence[r.openVRID] || r.after.vecWorldFromDriverTranslation[0] != sequence + 0.5 || r.timestampNs < 0)
+				errors++;
+			lastSequence[r.openVRID] = sequence;
+		}
+	}
+
+	printf("%d threads, %.1f s: %llu poses recorded, %llu written, %llu dropped, %.0f ns per Record\n", threads, seconds,
+		(unsigned long long) totalProduced, (unsigned long long) tap.Written(), (unsigned long long) tap.Dropped(), meanNs);
+
+	bool ok = true;
+	if (read != tap.Written())
+	{
+		printf("FAIL file holds %llu poses, writer reported %llu\n", (unsigned long long) read, (unsigned long long) tap.Written());
+		ok = false;
+	}
+	if (tap.Written() + tap.Dropped() != totalProduced)
+	{
+		printf("FAIL %llu poses neither written nor counted as dropped\n", (unsigned long long) (totalProduced - tap.Written() - tap.Dropped()));
+		ok = false;
+	}
+	if (errors)
+	{
+		printf("FAIL %llu poses out of order or torn\n", (unsigned long long) errors);
+		ok = false;
+	}
+
+	if (ok)
+		printf("ok\n");
+	return ok ? 0 : 1;
+}
+
+// A pose as it reached the hook, and when.
+struct TapSample
+{
+	int64_t arrivalNs;
+	vr::DriverPose_t pose;
+};
+
+static Eigen::Quaterniond ToEigen(const vr::HmdQuaternion_t &q) { return Eigen::Quaterniond(q.w, q.x, q.y, q.z); }
+static Eigen::Vector3d ToEigen(const double v[3]) { return Eigen::Vector3d(v[0], v[1], v[2]); }
+
+// Where SteamVR would show the device at queryNs: the pose dated its arrival plus its
+// poseTimeOffset, extrapolated to queryNs with its velocities, moved into its world space.
+static Eigen::Isometry3d PredictedPose(const TapSample &sample, int64_t queryNs)
+{
+	auto &pose = sample.pose;
+	double dt = (queryNs - sample.arrivalNs) * 1e-9 - pose.poseTimeOffset;
+
+	Eigen::Vector3d position = ToEigen(pose.vecPosition) + dt * ToEigen(pose.vecVelocity);
+	Eigen::Quaterniond rotation = ToEigen(pose.qRotation);
+	Eigen::Vector3d omega = ToEigen(pose.vecAngularVelocity);
+	if (omega.norm() > 0.0)
+		rotation = Eigen::Quaterniond(Eigen::AngleAxisd(omega.norm() * dt, omega.normalized())) * rotation;
+
+	Eigen::Isometry3d world = Eigen::Translation3d(ToEigen(pose.vecWorldFromDriverTranslation)) * ToEigen(pose.qWorldFromDriverRotation);
+	Eigen::Isometry3d driver = Eigen::Translation3d(position) * rotation;
+	Eigen::Isometry3d head = Eigen::Translation3d(ToEigen(pose.vecDriverFromHeadTranslation)) * ToEigen(pose.qDriverFromHeadRotation);
+	return world * driver * head;
+}
+
+struct RelativeSpread
+{
+	double positionMm = 0.0, rotationDeg = 0.0;
+	size_t count = 0;
+};
+
+// Replays the target's poses through a DeviceSlot compensating offsetSeconds, the way the hook
+// does, into a FakeDriverHost. At each reference pose both devices are predicted to its arrival,
+// and the spread of the target's pose relative to the reference's is measured. For devices fixed
+// to each other the relative pose is constant, so what spreads it is the target's poses being
+// predicted from the wrong time.
+static RelativeSpread MeasureSpread(const std::vector<TapSample> &reference, const std::vector<TapSample> &target, uint32_t targetID, double offsetSeconds)
+{
+	DeviceSlot slot;
+	slot.SetTimeOffset(offsetSeconds);
+	std::unique_ptr<FakeDriverHost> host(new FakeDriverHost());
+
+	std::vector<Eigen::Vector3d> positions;
+	std::vector<Eigen::Quaterniond> rotations;
+	positions.reserve(reference.size());
+	rotations.reserve(reference.size());
+
+	size_t next = 0;
+	int64_t targetArrival = -1;
+	for (auto &r : reference)
+	{
+		for (; next < target.size() && target[next].arrivalNs <= r.arrivalNs; next++)
+		{
+			vr::DriverPose_t pose = target[next].pose;
+			if (slot.Stages() & StageTimeOffset)
+				slot.CompensateLatency(pose);
+			host->TrackedDevicePoseUpdated(targetID, pose, sizeof pose);
+			targetArrival = target[next].arrivalNs;
+		}
+		if (targetArrival < 0)
+			continue;
+
+		Eigen::Isometry3d relative = PredictedPose(r, r.arrivalNs).inverse() * PredictedPose({ targetArrival, host->Last(targetID).pose }, r.arrivalNs);
+		positions.push_back(relative.translation());
+		rotations.push_back(Eigen::Quaterniond(relative.rotation()));
+	}
+
+	RelativeSpread spread;
+	spread.count = positions.size();
+	if (spread.count == 0)
+		return spread;
+
+	Eigen::Vector3d meanPosition = Eigen::Vector3d::Zero();
+	Eigen::Vector4d meanRotation = Eigen::Vector4d::Zero();
+	for (size_t i = 0; i < spread.count; i++)
+	{
+		meanPosition += positions[i];
+		meanRotation += rotations[i].dot(rotations[0]) < 0.0 ? (-rotations[i].coeffs()).eval() : rotations[i].coeffs();
+	}
+	meanPosition /= (double) spread.count;
+	Eigen::Quaterniond mean(meanRotation.normalized());
+
+	double positionSq = 0.0, rotationSq = 0.0;
+	for (size_t i = 0; i < spread.count; i++)
+	{
+		double angle = mean.angularDistance(rotations[i]);
+		positionSq += (positions[i] - meanPosition).squaredNorm();
+		rotationSq += angle * angle;
+	}
+	spread.positionMm = std::sqrt(positionSq / spread.count) * 1000.0;
+	spread.rotationDeg = std::sqrt(rotationSq / spread.count) * 180.0 / EIGEN_PI;
+	return spread;
+}
+
+// Measures how late the target device's poses reach the driver compared to the reference's, from a
+// tap recorded while the two were fixed to each other and moved around quickly, such as a tracker
+// strapped to the HMD. Uses the poses after the hook, so the tap should be recorded calibrated,
+// and a time offset already applied is measured on top of. Without a given offset, sweeps for the
+// one that makes the relative pose steadiest; with one, fails unless it steadies it.
+static int TapCompensate(const std::string &path, uint32_t referenceID, uint32_t targetID, double offsetMs, double maxMs)
+{
+	PoseTapReader tap;
+	tap.Open(path);
+
+	std::vector<TapSample> reference, target;
+	std::vector<PoseTapRecord> buffer(1024);
+	size_t n;
+	while ((n = tap.Read(buffer.data(), buffer.size())) > 0)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			auto &r = buffer[i];
+			if (!r.after.poseIsValid)
+				continue;
+			if (r.openVRID == referenceID)
+				reference.push_back({ r.timestampNs, r.after });
+			else if (r.openVRID == targetID)
+				target.push_back({ r.timestampNs, r.after });
+		}
+	}
+
+	// Records leave the ring in claim order, which may differ slightly from arrival order.
+	auto byArrival = [](const TapSample &a, const TapSample &b) { return a.arrivalNs < b.arrivalNs; };
+	std::stable_sort(reference.begin(), reference.end(), byArrival);
+	std::stable_sort(target.begin(), target.end(), byArrival);
+
+	printf("reference slot %u: %zu poses, target slot %u: %zu poses\n", referenceID, reference.size(), targetID, target.size());
+
+	auto none = MeasureSpread(reference, target, targetID, 0.0);
+	if (none.count < 2)
+	{
+		printf("FAIL no reference poses after the target's first\n");
+		return 1;
+	}
+
+	printf("\n%10s %12s %13s\n", "offset_ms", "position_mm", "rotation_deg");
+	auto print = [](double ms, const RelativeSpread &spread, const char *label) {
+		printf("%10.2f %12.3f %13.4f  %s\n", ms, spread.positionMm, spread.rotationDeg, label);
+	};
+	print(0.0, none, "none");
+
+	if (!std::isnan(offsetMs))
+	{
+		auto given = MeasureSpread(reference, target, targetID, offsetMs / 1000.0);
+		print(offsetMs, given, "given");
+		if (!(given.positionMm < none.positionMm))
+		{
+			printf("FAIL the offset does not steady the target against the reference\n");
+			return 1;
+		}
+		printf("ok\n");
+		return 0;
+	}
+
+	// Coarse, then fine around the best coarse step.
+	double bestMs = 0.0;
+	auto best = none;
+	auto sweep = [&](double from, double to, double step) {
+		for (double ms = from; ms <= to + step * 0.5; ms += step)
+		{
+			auto spread = MeasureSpread(reference, target, targetID, ms / 1000.0);
+			if (spread.positionMm < best.positionMm)
+			{
+				best = spread;
+				bestMs = ms;
+			}
+		}
+	};
+	sweep(-maxMs, maxMs, 0.5);
+	sweep(bestMs - 0.5, bestMs + 0.5, 0.05);
+	print(bestMs, best, "best");
+
+	printf("\nadd %.2f to the target tracking system's time_offsets_ms in the profile\n", bestMs);
+	return 0;
+}
+
+// The synthetic motion of TapSynth: an HMD turning and swaying quickly, with velocities.
+static Eigen::Isometry3d SynthHmd(double t)
+{
+	const double tau = 2.0 * EIGEN_PI;
+	Eigen::Quaterniond rotation = Eigen::AngleAxisd(1.2 * std::sin(tau * 0.6 * t), Eigen::Vector3d::UnitY())
+		* Eigen::AngleAxisd(0.4 * std::sin(tau * 0.9 * t), Eigen::Vector3d::UnitX());
+	Eigen::Vector3d position(0.3 * std::sin(tau * 0.7 * t), 1.6 + 0.1 * std::sin(tau * 1.3 * t), 0.2 * std::cos(tau * 0.5 * t));
+	return Eigen::Translation3d(position) * rotation;
+}
+
+static vr::DriverPose_t SynthPose(const Eigen::Isometry3d &mount, double t)
+{
+	const double h = 1e-5;
+	Eigen::Isometry3d now = SynthHmd(t) * mount, before = SynthHmd(t - h) * mount, after = SynthHmd(t + h) * mount;
+
+	vr::DriverPose_t pose;
+	memset(&pose, 0, sizeof pose);
+	pose.poseIsValid = true;
+	pose.deviceIsConnected = true;
+	pose.result = vr::TrackingResult_Running_OK;
+	pose.qWorldFromDriverRotation.w = pose.qDriverFromHeadRotation.w = 1.0;
+
+	Eigen::Quaterniond rotation(now.rotation());
+	Eigen::Vector3d velocity = (after.translation() - before.translation()) / (2.0 * h);
+	Eigen::AngleAxisd turn(Eigen::Quaterniond(after.rotation() * before.rotation().transpose()));
+	Eigen::Vector3d angularVelocity = turn.axis() * turn.angle() / (2.0 * h);
+
+	pose.qRotation = { rotation.w(), rotation.x(), rotation.y(), rotation.z() };
+	for (int i = 0; i < 3; i++)
+	{
+		pose.vecPosition[i] = now.translation()[i];
+		pose.vecVelocity[i] = velocity[i];
+		pose.vecAngularVelocity[i] = angularVelocity[i];
+	}
+	return pose;
+}
+
+// Writes a tap of an HMD in slot 0 at 1 kHz with a tracker fixed to it in slot 1 at 500 Hz, in
+// fast motion, the tracker's poses reaching the driver lagMs late: a recording tap compensate
+// should find lagMs in.
+static int TapSynth(const std::string &path, double lagMs, double seconds)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+		throw std::runtime_error("cannot create " + path);
+
+	PoseTapFileHeader header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, PoseTapMagic, sizeof header.magic);
+	header.version = PoseTapVersion;
+	header.headerSize = sizeof header;
+	header.recordSize = sizeof(PoseTapRecord);
+	header.poseSize = sizeof(vr::DriverPose_t);
+	header.startUnixNs = (int64_t) time(nullptr) * 1000000000;
+	fwrite(&header, sizeof header, 1, file);
+
+	Eigen::Isometry3d identity = Eigen::Isometry3d::Identity();
+	Eigen::Isometry3d tracker = Eigen::Translation3d(0.1, -0.05, 0.02) * Eigen::AngleAxisd(0.5, Eigen::Vector3d(1.0, 1.0, 0.0).normalized());
+
+	// The HMD on every millisecond, the tracker on every other half millisecond.
+	PoseTapRecord record;
+	memset(&record, 0, sizeof record);
+	record.flags = PoseTapForwarded;
+	uint64_t count = 0;
+	for (int64_t tick = 0; tick * 500000 < (int64_t) (seconds * 1e9); tick++)
+	{
+		if (tick % 2 == 0)
+		{
+			record.openVRID = 0;
+			record.before = SynthPose(identity, tick * 0.5e-3);
+		}
+		else if (tick % 4 == 1)
+		{
+			record.openVRID = 1;
+			record.before = SynthPose(tracker, tick * 0.5e-3 - lagMs / 1000.0);
+		}
+		else
+		{
+			continue;
+		}
+
+		record.timestampNs = tick * 500000;
+		record.after = record.before;
+		fwrite(&record, sizeof record, 1, file);
+		count++;
+	}
+
+	bool ok = fclose(file) == 0;
+	printf("%llu poses over %.1f s, slot 1 lagging slot 0 by %.2f ms\n", (unsigned long long) count, seconds, lagMs);
+	return ok ? 0 : 1;
+}
+
+int RunTap(int argc, char **argv)
+{
+	if (argc < 2)
+		throw std::runtime_error("expected info, profile, stress, synth or compensate and a file");
+
+	std::string action = argv[0], path = argv[1];
+	int threads = 8;
+	double seconds = 2.0, rate = 1000.0, lagMs = 20.0, offsetMs = NAN, maxMs = 100.0;
+	uint32_t referenceID = vr::k_unTrackedDeviceIndex_Hmd, targetID = 1;
+	bool secondsGiven = false;
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--threads")
+			threads = std::max(1, std::min((int) vr::k_unMaxTrackedDeviceCount, std::stoi(OptionValue(i, argc, argv))));
+		else if (arg == "--seconds")
+		{
+			seconds = std::stod(OptionValue(i, argc, argv));
+			secondsGiven = true;
+		}
+		else if (arg == "--rate")
+			rate = std::stod(OptionValue(i, argc, argv));
+		else if (arg == "--lag-ms")
+			lagMs = std::stod(OptionValue(i, argc, argv));
+		else if (arg == "--reference")
+			referenceID = (uint32_t) std::stoul(OptionValue(i, argc, argv));
+		else if (arg == "--target")
+			targetID = (uint32_t) std::stoul(OptionValue(i, argc, argv));
+		else if (arg == "--offset-ms")
+			offsetMs = std::stod(OptionValue(i, argc, argv));
+		else if (arg == "--max-ms")
+			maxMs = std::max(0.5, std::stod(OptionValue(i, argc, argv)));
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	if (action == "info")
+		return TapInfo(path);
+	if (action == "profile")
+		return TapProfile(path);
+	if (action == "stress")
+		return TapStress(path, threads, seconds, rate);
+	if (action == "synth")
+		return TapSynth(path, lagMs, secondsGiven ? seconds : 10.0);
+	if (action == "compensate")
+	{
+		if (referenceID >= vr::k_unMaxTrackedDeviceCount || targetID >= vr::k_unMaxTrackedDeviceCount || referenceID == targetID)
+			throw std::runtime_error("expected two different device slots");
+		return TapCompensate(path, referenceID, targetID, offsetMs, maxMs);
+	}
+
+	throw std::runtime_error("unknown tap action " + action);
+}
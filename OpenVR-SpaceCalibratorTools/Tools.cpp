@@ -0,0 +1,114 @@
+#include "Tools.h"
+#include "../OpenVR-SpaceCalibrator/CalibrationSolver.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+struct Command
+{
+	const char *name;
+	int (*run)(int argc, char **argv);
+	const char *usage;
+};
+
+static const Command Commands[] = {
+	{ "regress", RunRegression, "regress [--csv FILE] [--baseline FILE] [--write-baseline FILE] [--repeat N] [--precision double|mixed]\n"
+		"    Solve synthetic scenarios with known ground truth, fail on accuracy or speed regressions." },
+	{ "bench", RunBenchmarks, "bench [--filter SUBSTRING] [--min-time SECONDS]\n"
+		"    Microbenchmark the calibration kernels, reporting time per pair, allocations and peak RSS,\n"
+		"    then the speedup and accuracy delta of the mixed precision solver." },
+	{ "trace", RunTrace, "trace info|dump|synth FILE [--from SECONDS] [--count N] [--slot N] [--scenario NAME]\n"
+		"    Summarize a recorded pose trace, print device positions from a point in time,\n"
+		"    or write a raw trace of a synthetic regression scenario." },
+	{ "replay", RunReplay, "replay FILE [--reference SLOT] [--target SLOT] [--speed fast|slow|very-slow] [--preset FILE]\n"
+		"       [--apply PROFILE] [--profile OUT] [--repeat N]\n"
+		"    Run the calibrator on a pose trace as fast as possible, with the trace standing in for\n"
+		"    SteamVR and its timestamps as the clock. Calibrates, or with --apply only scans and\n"
+		"    applies a profile. --repeat checks that every run drives the driver identically." },
+	{ "batch", RunBatch, "batch FILE... [--list FILE] [--out DIR] [--csv FILE] [--json FILE] [--jobs N] [--samples N]\n"
+		"      [--preset FILE] [--precision double|mixed] [--reference SLOT] [--target SLOT] [--no-uncertainty]\n"
+		"    Calibrate many pose traces in parallel, writing a profile per trace to DIR and the\n"
+		"    results and timings of all of them as CSV or JSON." },
+	{ "sweep", RunSweep, "sweep [--scenario NAME]... [--seeds N] [--angles LIST] [--axis-norms LIST] [--samples LIST]\n"
+		"      [--precision double|mixed] [--jobs N] [--csv FILE] [--json FILE] [--preset FILE] [--preset-name NAME] [--max-score X]\n"
+		"    Calibrate the synthetic scenarios with every combination of rotation pair gates and sample\n"
+		"    count in parallel, print the Pareto fronts of error against collection and compute time,\n"
+		"    and write the quickest set within the error target as a calibration preset." },
+	{ "tap", RunTap, "tap info|profile|stress FILE [--threads N] [--seconds S] [--rate HZ], tap synth FILE [--lag-ms X] [--seconds S],\n"
+		"      tap compensate FILE [--reference SLOT] [--target SLOT] [--offset-ms X] [--max-ms X]\n"
+		"    Summarize a raw pose tap recorded by the driver, run the driver's jitter and noise\n"
+		"    profiler over it, or stress the driver's tap ring from several pose threads and check\n"
+		"    that the file it writes is complete and in order. compensate replays a tap of two devices\n"
+		"    fixed to each other through the driver's latency compensation and a fake SteamVR host to\n"
+		"    find how late the target's poses arrive, or check that a given offset steadies them; synth\n"
+		"    writes such a tap with a known lag." },
+	{ "driver", RunDriver, "driver check|stress [--count N] [--threads N] [--seconds S] [--devices N], driver registry, driver platform|smoothing|timing|watchdog|fusion [--count N] [--budget-ns N], driver profile FILE\n"
+		"    Check the driver's pose transform against the reference math on random transforms, or set\n"
+		"    device transforms from one thread while pose threads apply them, as the driver's IPC and\n"
+		"    pose threads do, and check that no pose sees a partial update. registry checks the driver's\n"
+		"    device registry lookups, platform that devices follow a moving platform through a fake\n"
+		"    SteamVR host within the latency budget, smoothing that the pose filter takes out noise\n"
+		"    without lagging a frame and within its budget, timing that the pose hook's timing\n"
+		"    histograms count every call in the right bucket within their budget, watchdog that the\n"
+		"    pose hook turns off a device's optional stages in order once over its time budget and\n"
+		"    that watching stays within the budget, fusion that the fused tracker follows two attached\n"
+		"    devices through either losing tracking without jumping, at the faster one's rate and\n"
+		"    within its budget, profile that the driver reads a saved profile into the transform and\n"
+		"    settings the app would send." },
+};
+
+std::string OptionValue(int &i, int argc, char **argv)
+{
+	if (i + 1 >= argc)
+		throw std::runtime_error(std::string("missing value for ") + argv[i]);
+
+	return argv[++i];
+}
+
+SolverPrecision ParsePrecision(const std::string &name)
+{
+	if (name == "double")
+		return SolverPrecision::Double;
+	if (name == "mixed")
+		return SolverPrecision::Mixed;
+
+	throw std::runtime_error("unknown precision " + name);
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr, "Usage: OpenVR-SpaceCalibratorTools <command> [options]\n\nCommands:\n");
+	for (auto &command : Commands)
+		fprintf(stderr, "  %s\n", command.usage);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	for (auto &command : Commands)
+	{
+		if (strcmp(argv[1], command.name) != 0)
+			continue;
+
+		try
+		{
+			return command.run(argc - 2, argv + 2);
+		}
+		catch (const std::runtime_error &e)
+		{
+			std::cerr << "Runtime error: " << e.what() << std::endl;
+			return 2;
+		}
+	}
+
+	fprintf(stderr, "Unknown command: %s\n\n", argv[1]);
+	PrintUsage();
+	return 2;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Entry points for the subcommands of OpenVR-SpaceCalibratorTools.
+// Each receives the arguments following the subcommand name and returns the process exit code.
+
+#include <string>
+
+// Declared here without CalibrationSolver.h, so commands built on the driver's openvr_driver.h can
+// include this too; the two OpenVR headers cannot share a translation unit.
+enum class SolverPrecision;
+
+// Returns the value following the option at argv[i] and advances i, throws if it is missing.
+std::string OptionValue(int &i, int argc, char **argv);
+
+// Parses "double" or "mixed", throws on anything else.
+SolverPrecision ParsePrecision(const std::string &name);
+
+int RunRegression(int argc, char **argv);
+int RunBenchmarks(int argc, char **argv);
+int RunTrace(int argc, char **argv);
+int RunReplay(int argc, char **argv);
+int RunBatch(int argc, char **argv);
+int RunSweep(int argc, char **argv);
+int RunTap(int argc, char **argv);
+int RunDriver(int argc, char **argv);
+
+// `driver profile FILE`, kept apart from RunDriver because it needs the app's openvr.h.
+int CheckDriverProfile(const std::string &path);
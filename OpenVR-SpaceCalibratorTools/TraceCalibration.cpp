@@ -0,0 +1,197 @@
+#include "TraceCalibration.h"
+#include "ReplaySystem.h"
+
+#include <chrono>
+#include <stdexcept>
+
+const char *StatusName(TraceCalibration::Status status)
+{
+	switch (status)
+	{
+	case TraceCalibration::Ok: return "ok";
+	case TraceCalibration::Aborted: return "aborted";
+	case TraceCalibration::Incomplete: return "incomplete";
+	default: return "error";
+	}
+}
+
+void SelectCalibrationDevices(const PoseTraceReader &trace, int &reference, int &target)
+{
+	auto systemOf = [&](int slot) -> std::string {
+		auto info = trace.TickCount() > 0 ? trace.DeviceInfo(0, (uint32_t) slot) : nullptr;
+		return info && info->deviceClass != vr::TrackedDeviceClass_Invalid ? info->trackingSystem : "";
+	};
+
+	for (int slot = 0; slot < (int) vr::k_unMaxTrackedDeviceCount && reference < 0; slot++)
+	{
+		if (!systemOf(slot).empty())
+			reference = slot;
+	}
+
+	if (reference < 0 || systemOf(reference).empty())
+		throw std::runtime_error("trace has no reference device at its first tick");
+
+	for (int slot = 0; slot < (int) vr::k_unMaxTrackedDeviceCount && target < 0; slot++)
+	{
+		auto system = systemOf(slot);
+		if (!system.empty() && system != systemOf(reference))
+			target = slot;
+	}
+
+	if (target < 0 || systemOf(target).empty())
+		throw std::runtime_error("trace has no target device in another tracking system at its first tick");
+}
+
+size_t CoveredSampleCount(size_t ticks)
+{
+	const size_t counts[] = { 500, 250, 100 };
+	for (auto count : counts)
+	{
+		if (2 * count <= ticks)
+			return count;
+	}
+	return 0;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TraceCalibration CalibrateTrace(const PoseTraceReader &trace, const TraceCalibrationOptions &options, CalibrationWorkspace &workspace)
+{
+	TraceCalibration result;
+	result.ticks = trace.TickCount();
+	if (result.ticks == 0)
+	{
+		result.status = TraceCalibration::Incomplete;
+		result.message = "trace has no ticks";
+		return result;
+	}
+
+	result.reference = options.reference;
+	result.target = options.target;
+	SelectCalibrationDevices(trace, result.reference, result.target);
+
+	result.referenceTrackingSystem = trace.DeviceInfo(0, result.reference)->trackingSystem;
+	result.targetTrackingSystem = trace.DeviceInfo(0, result.target)->trackingSystem;
+
+	result.sampleCount = options.sampleCount ? options.sampleCount : CoveredSampleCount(result.ticks);
+	if (result.sampleCount == 0)
+	{
+		result.status = TraceCalibration::Incomplete;
+		result.message = "trace is too short for any calibration speed";
+		return result;
+	}
+
+	workspace.precision = options.precision;
+	workspace.gates = result.gates = options.gates;
+	bool rawPoses = (trace.Header().flags & TraceFlagRawPoses) != 0;
+
+	// Mirrors the state machine of CalibrationTick: ticks closer than 0.05 s are skipped, a
+	// device that stops tracking aborts, and the translation stage sees the solved rotation.
+	ReplayDriver::Transform applied;
+	std::vector<Sample> samples;
+	samples.reserve(result.sampleCount);
+	bool translationStage = false;
+	double lastTime = -1e30, firstSampleTime = 0.0;
+
+	for (size_t i = 0; i < trace.TickCount(); i++)
+	{
+		auto tick = trace.Tick(i);
+		if (tick.appTime - lastTime < 0.05)
+			continue;
+		lastTime = tick.appTime;
+
+		vr::TrackedDevicePose_t reference = tick.poses[result.reference], target = tick.poses[result.target];
+		if (!reference.bPoseIsValid || !target.bPoseIsValid)
+		{
+			result.status = TraceCalibration::Aborted;
+			result.message = std::string(reference.bPoseIsValid ? "target" : "reference") + " device stopped tracking at tick " + std::to_string(i);
+			return result;
+		}
+
+		if (rawPoses && translationStage)
+			ApplyDriverTransform(applied, target);
+
+		if (!translationStage && samples.empty())
+			firstSampleTime = tick.appTime;
+
+		samples.push_back(Sample(Pose(reference.mDeviceToAbsoluteTracking), Pose(target.mDeviceToAbsoluteTracking)));
+		if (samples.size() < result.sampleCount)
+			continue;
+
+		auto start = std::chrono::steady_clock::now();
+		if (!translationStage)
+		{
+			result.rotation = CalibrateRotation(samples, workspace);
+			result.rotationDeltas = workspace.rotationDeltaCount;
+			result.rotationFallback = workspace.rotationFallback;
+			result.solveMs += ElapsedMs(start);
+
+			if (options.uncertainty)
+			{
+				start = std::chrono::steady_clock::now();
+				result.uncertainty.rotation = RotationUncertainty(samples, result.rotation, CrossValidationFolds, options.gates);
+				result.uncertaintyMs += ElapsedMs(start);
+			}
+
+			applied.enabled = true;
+			applied.rotation = VRRotationQuat(result.rotation);
+			translationStage = true;
+			samples.clear();
+			continue;
+		}
+
+		result.translation = CalibrateTranslation(samples, workspace);
+		result.translationFallback = workspace.translationFallback;
+		result.solveMs += ElapsedMs(start);
+
+		if (options.uncertainty)
+		{
+			start = std::chrono::steady_clock::now();
+			result.uncertainty.translation = TranslationUncertainty(samples);
+			result.uncertainty.valid = true;
+			result.uncertaintyMs += ElapsedMs(start);
+		}
+
+		result.collectionSeconds = tick.appTime - firstSampleTime;
+		result.status = TraceCalibration::Ok;
+		return result;
+	}
+
+	result.status = TraceCalibration::Incomplete;
+	result.message = "trace ended during the " + std::string(translationStage ? "translation" : "rotation") + " stage";
+	return result;
+}
+
+void ToProfile(const TraceCalibration &calibration, CalibrationContext &ctx)
+{
+	ctx.Clear();
+	ctx.referenceTrackingSystem = calibration.referenceTrackingSystem;
+	ctx.targetTrackingSystem = calibration.targetTrackingSystem;
+	ctx.calibratedRotation = calibration.rotation;
+	ctx.calibratedTranslation = calibration.translation;
+	ctx.uncertainty = calibration.uncertainty;
+
+	RotationGates defaults;
+	auto &gates = calibration.gates;
+	bool defaultGates = gates.minAngle == defaults.minAngle && gates.minAxisNorm == defaults.minAxisNorm;
+
+	if (defaultGates && calibration.sampleCount == 500)
+		ctx.calibrationSpeed = CalibrationContext::VERY_SLOW;
+	else if (defaultGates && calibration.sampleCount == 250)
+		ctx.calibrationSpeed = CalibrationContext::SLOW;
+	else if (defaultGates && calibration.sampleCount == 100)
+		ctx.calibrationSpeed = CalibrationContext::FAST;
+	else
+	{
+		ctx.calibrationSpeed = CalibrationContext::PRESET;
+		ctx.preset.valid = true;
+		ctx.preset.name = "custom";
+		ctx.preset.sampleCount = calibration.sampleCount;
+		ctx.preset.gates = gates;
+	}
+
+	ctx.validProfile = true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Calibrates a pose trace the way a calibration session in the app would, but calls the solver
+// directly instead of going through CalibrationTick. Nothing here touches global state, so many
+// traces can be calibrated at once, each on its own thread with its own workspace.
+
+#include "../OpenVR-SpaceCalibrator/Calibration.h"
+#include "../OpenVR-SpaceCalibrator/PoseTrace.h"
+
+#include <string>
+
+struct TraceCalibrationOptions
+{
+	int reference = -1, target = -1; // slots, -1 picks them like SelectCalibrationDevices
+	size_t sampleCount = 0;          // per stage, 0 picks the largest calibration speed the trace covers
+	SolverPrecision precision = SolverPrecision::Mixed;
+	RotationGates gates;
+	bool uncertainty = true;
+};
+
+struct TraceCalibration
+{
+	enum Status
+	{
+		Ok,
+		Aborted,    // a device stopped tracking, which aborts a calibration in the app too
+		Incomplete, // the trace ended before both stages had their samples
+		Error,      // the trace could not be read or has no pair of devices to calibrate
+	} status = Error;
+
+	std::string message;
+
+	int reference = -1, target = -1;
+	std::string referenceTrackingSystem, targetTrackingSystem;
+
+	size_t ticks = 0, sampleCount = 0, rotationDeltas = 0;
+	RotationGates gates;
+	Eigen::Vector3d rotation = Eigen::Vector3d::Zero();    // euler degrees, as in the profile
+	Eigen::Vector3d translation = Eigen::Vector3d::Zero(); // centimeters
+	CalibrationUncertainty uncertainty;
+	bool rotationFallback = false, translationFallback = false;
+
+	double collectionSeconds = 0.0; // trace time from the first to the last sample
+	double solveMs = 0.0, uncertaintyMs = 0.0;
+};
+
+const char *StatusName(TraceCalibration::Status status);
+
+// Picks the devices a user would most likely have chosen: the first device as reference, usually
+// the HMD, and the first device of another tracking system as target. Slots that are already
+// non-negative are kept. Throws if the first tick has no such devices.
+void SelectCalibrationDevices(const PoseTraceReader &trace, int &reference, int &target);
+
+// Largest per-stage sample count of the calibration speeds that a trace of this many ticks holds.
+size_t CoveredSampleCount(size_t ticks);
+
+TraceCalibration CalibrateTrace(const PoseTraceReader &trace, const TraceCalibrationOptions &options, CalibrationWorkspace &workspace);
+
+// Fills a context with a successful calibration, for writing it out as a profile. A sample count
+// or gates that no calibration speed uses are stored as a preset.
+void ToProfile(const TraceCalibration &calibration, CalibrationContext &ctx);
@@ -0,0 +1,192 @@
+#include "Tools.h"
+#include "../OpenVR-SpaceCalibrator/PoseTrace.h"
+#include "SyntheticSamples.h"
+
+#include <cstdio>
+#include <ctime>
+#include <stdexcept>
+
+static const char *DeviceClassName(int32_t deviceClass)
+{
+	switch (deviceClass)
+	{
+	case vr::TrackedDeviceClass_HMD: return "hmd";
+	case vr::TrackedDeviceClass_Controller: return "controller";
+	case vr::TrackedDeviceClass_GenericTracker: return "tracker";
+	case vr::TrackedDeviceClass_TrackingReference: return "reference";
+	case vr::TrackedDeviceClass_DisplayRedirect: return "display";
+	default: return "invalid";
+	}
+}
+
+static double Seconds(int64_t ns)
+{
+	return (double) ns * 1e-9;
+}
+
+static int TraceInfo(const PoseTraceReader &trace)
+{
+	auto &header = trace.Header();
+	time_t start = (time_t) (header.startUnixNs / 1000000000);
+	char startText[64];
+	strftime(startText, sizeof startText, "%Y-%m-%d %H:%M:%S UTC", gmtime(&start));
+
+	printf("version   %u\n", header.version);
+	printf("started   %s\n", startText);
+	printf("universe  %u\n", header.trackingUniverse);
+	printf("poses     %s\n", (header.flags & TraceFlagRawPoses) ? "raw" : "as calibrated during recording");
+	printf("ticks     %zu\n", trace.TickCount());
+
+	if (trace.TickCount() == 0)
+		return 0;
+
+	auto first = trace.Tick(0), last = trace.Tick(trace.TickCount() - 1);
+	double duration = Seconds(last.timestampNs - first.timestampNs);
+	printf("duration  %.3f s", duration);
+	if (duration > 0.0)
+		printf(" (%.1f ticks/s)", (trace.TickCount() - 1) / duration);
+	printf("\n\n");
+
+	printf("%4s %-11s %-20s %-32s %8s\n", "slot", "class", "tracking system", "serial", "valid");
+	for (uint32_t slot = 0; slot < vr::k_unMaxTrackedDeviceCount; slot++)
+	{
+		auto info = trace.DeviceInfo(trace.TickCount() - 1, slot);
+		if (!info || info->deviceClass == vr::TrackedDeviceClass_Invalid)
+			continue;
+
+		size_t valid = 0;
+		for (size_t i = 0; i < trace.TickCount(); i++)
+			valid += trace.Tick(i).poses[slot].bPoseIsValid;
+
+		printf("%4u %-11s %-20s %-32s %7.1f%%\n", slot, DeviceClassName(info->deviceClass),
+			info->trackingSystem, info->serial, 100.0 * valid / trace.TickCount());
+	}
+	return 0;
+}
+
+static int TraceDump(const PoseTraceReader &trace, double fromSeconds, size_t count, int slot)
+{
+	printf("%10s %10s %4s %5s %10s %10s %10s\n", "time s", "app time", "slot", "valid", "x", "y", "z");
+
+	size_t begin = trace.Seek((int64_t) (fromSeconds * 1e9));
+	for (size_t i = begin; i < trace.TickCount() && i - begin < count; i++)
+	{
+		auto tick = trace.Tick(i);
+		for (uint32_t s = 0; s < vr::k_unMaxTrackedDeviceCount; s++)
+		{
+			if (slot >= 0 && s != (uint32_t) slot)
+				continue;
+
+			auto info = trace.DeviceInfo(i, s);
+			if (slot < 0 && (!info || info->deviceClass == vr::TrackedDeviceClass_Invalid))
+				continue;
+
+			auto &pose = tick.poses[s];
+			auto &m = pose.mDeviceToAbsoluteTracking.m;
+			printf("%10.4f %10.4f %4u %5d %10.4f %10.4f %10.4f\n",
+				Seconds(tick.timestampNs), tick.appTime, s, pose.bPoseIsValid, m[0][3], m[1][3], m[2][3]);
+		}
+	}
+	return 0;
+}
+
+static vr::TrackedDevicePose_t TrackedPose(const Pose &pose)
+{
+	vr::TrackedDevicePose_t out = {};
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			out.mDeviceToAbsoluteTracking.m[i][j] = (float) pose.rot(i, j);
+		out.mDeviceToAbsoluteTracking.m[i][3] = (float) pose.trans(i);
+	}
+	out.eTrackingResult = vr::TrackingResult_Running_OK;
+	out.bPoseIsValid = true;
+	out.bDeviceIsConnected = true;
+	return out;
+}
+
+static TraceDeviceInfo SynthDevice(vr::ETrackedDeviceClass deviceClass, const char *trackingSystem, const char *serial)
+{
+	TraceDeviceInfo info;
+	info.deviceClass = deviceClass;
+	snprintf(info.trackingSystem, sizeof info.trackingSystem, "%s", trackingSystem);
+	snprintf(info.serial, sizeof info.serial, "%s", serial);
+	return info;
+}
+
+// Writes a raw trace of a synthetic scenario: an HMD in slot 0 as the reference and a tracker in
+// slot 1 as the target, moving long enough for both calibration stages plus a few seconds after.
+static int TraceSynth(const std::string &path, const std::string &scenarioName)
+{
+	const double TailSeconds = 3.0;
+
+	SyntheticScenario scenario = FindScenario(scenarioName);
+
+	// CalibrationTick runs at most every 0.05 s, which a 90 Hz frame loop reaches every fifth
+	// frame. Ticks exactly 0.05 s apart would be skipped whenever rounding lands just short.
+	scenario.sampleInterval = 5.0 / 90.0;
+	size_t calibrationTicks = 2 * scenario.sampleCount;
+	scenario.sampleCount = calibrationTicks + (size_t) (TailSeconds / scenario.sampleInterval);
+	auto samples = GenerateRotationSamples(scenario);
+
+	PoseTraceWriter trace;
+	trace.Open(path, vr::TrackingUniverseRawAndUncalibrated, TraceFlagRawPoses);
+	trace.SetDeviceInfo(0, SynthDevice(vr::TrackedDeviceClass_HMD, "lighthouse", "SYNTH-HMD"));
+	trace.SetDeviceInfo(1, SynthDevice(vr::TrackedDeviceClass_GenericTracker, "synthetic", "SYNTH-TRACKER"));
+
+	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount] = {};
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		double time = i * scenario.sampleInterval;
+		poses[0] = TrackedPose(samples[i].ref);
+		poses[1] = TrackedPose(samples[i].target);
+		trace.AppendTick(time, poses, (int64_t) (time * 1e9));
+	}
+	trace.Close();
+
+	auto &rot = scenario.rotation, &trans = scenario.translation;
+	printf("wrote %zu ticks of %s to %s\n", samples.size(), scenario.name.c_str(), path.c_str());
+	printf("ground truth: yaw=%.2f pitch=%.2f roll=%.2f x=%.2f y=%.2f z=%.2f\n", rot[1], rot[2], rot[0], trans[0], trans[1], trans[2]);
+	printf("calibrates with %zu samples per stage\n", calibrationTicks / 2);
+	return 0;
+}
+
+int RunTrace(int argc, char **argv)
+{
+	if (argc < 2)
+		throw std::runtime_error("expected a trace action and file");
+
+	std::string action = argv[0];
+	double fromSeconds = 0.0;
+	size_t count = 20;
+	int slot = -1;
+	std::string scenario = "noisy-fast";
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--from")
+			fromSeconds = std::stod(OptionValue(i, argc, argv));
+		else if (arg == "--count")
+			count = (size_t) std::stoul(OptionValue(i, argc, argv));
+		else if (arg == "--slot")
+			slot = std::stoi(OptionValue(i, argc, argv));
+		else if (arg == "--scenario")
+			scenario = OptionValue(i, argc, argv);
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	if (action == "synth")
+		return TraceSynth(argv[1], scenario);
+
+	PoseTraceReader trace;
+	trace.Open(argv[1]);
+
+	if (action == "info")
+		return TraceInfo(trace);
+	if (action == "dump")
+		return TraceDump(trace, fromSeconds, count, slot);
+
+	throw std::runtime_error("unknown trace action " + action);
+}
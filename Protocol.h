@@ -10,13 +10,23 @@
 
 namespace protocol
 {
-	const uint32_t Version = 1;
+	const uint32_t Version = 13;
 
 	enum RequestType
 	{
 		RequestInvalid,
 		RequestHandshake,
 		RequestSetDeviceTransform,
+		RequestSetPoseTap,
+		RequestDeviceStats,
+		RequestSetSystemTransform,
+		RequestSetMountOffsets,
+		RequestSetMovingPlatform,
+		RequestSetSmoothing,
+		RequestSetTimeOffset,
+		RequestHookTiming,
+		RequestSetStageBudget,
+		RequestSetFusedTracker,
 	};
 
 	enum ResponseType
@@ -24,6 +34,8 @@ namespace protocol
 		ResponseInvalid,
 		ResponseHandshake,
 		ResponseSuccess,
+		ResponseDeviceStats,
+		ResponseHookTiming,
 	};
 
 	struct Protocol
@@ -53,12 +65,164 @@ namespace protocol
 			openVRID(id), enabled(enabled), updateTranslation(true), updateRotation(true), translation(translation), rotation(rotation) { }
 	};
 
+	// Sets the transform of every device of a tracking system, present and future: the driver
+	// resolves it for each device as the device registers. A later SetDeviceTransform overrides it
+	// for one device, a later SetSystemTransform overrides those again.
+	struct SetSystemTransform
+	{
+		char trackingSystem[64]; // null terminated
+		bool enabled;
+		vr::HmdVector3d_t translation;
+		vr::HmdQuaternion_t rotation;
+	};
+
+	// Where a device sits on whatever it is mounted to, such as a tracker on a prop or a body
+	// strap, in the device's own space. Keyed by serial, so the driver keeps it for a device that
+	// appears later or in another slot, and applies it on top of the device's calibration.
+	struct MountOffset
+	{
+		char serial[64]; // null terminated
+		bool enabled;
+		vr::HmdVector3d_t translation;
+		vr::HmdQuaternion_t rotation;
+	};
+
+	const uint32_t MaxMountOffsets = 16;
+
+	// Sets the first count offsets in one request. Serials not listed keep their offsets.
+	struct SetMountOffsets
+	{
+		uint32_t count;
+		MountOffset offsets[MaxMountOffsets];
+	};
+
+	// Makes a tracking system's transform follow the live pose of a device of another system, the
+	// platform, for a tracking system that moves with a platform such as a motion rig. The driver
+	// anchors the system's transform to the platform's next pose and from then on composes the two
+	// for every pose. Keyed by serial, so the platform may appear later.
+	struct SetMovingPlatform
+	{
+		char trackingSystem[64]; // null terminated
+		char serial[64];         // null terminated
+		bool enabled;
+	};
+
+	// Smoothing of one device's pose by the driver, keyed by serial like mount offsets. A One-Euro
+	// filter: minCutoffHz sets how much the device is smoothed at rest, beta how quickly the
+	// smoothing lets go as it moves, in hertz per meter or radian per second.
+	struct DeviceSmoothing
+	{
+		char serial[64]; // null terminated
+		bool enabled;
+		double minCutoffHz;
+		double beta;
+	};
+
+	const uint32_t MaxDeviceSmoothing = 16;
+
+	// Sets the first count devices' smoothing in one request. Serials not listed keep theirs.
+	struct SetSmoothing
+	{
+		uint32_t count;
+		DeviceSmoothing devices[MaxDeviceSmoothing];
+	};
+
+	// How much older a tracking system's poses are than the reference system's when they reach
+	// the driver, as measured by the tools' tap compensate. The driver dates the system's poses
+	// back by as much through poseTimeOffset, so SteamVR predicts them that much further and
+	// they keep up with the HMD in fast motion. Zero turns it off.
+	struct SetTimeOffset
+	{
+		char trackingSystem[64]; // null terminated
+		double seconds;
+	};
+
+	// How long the pose hook's optional stages, the pose tap, smoothing and moving platforms, may
+	// take per pose on average before the driver turns them off for that device, in nanoseconds.
+	// Zero turns the watchdog off.
+	const double DefaultStageBudgetNs = 1000.0;
+
+	struct SetStageBudget
+	{
+		double budgetNs;
+	};
+
+	// A virtual tracker the driver adds to SteamVR, fused from two devices of different tracking
+	// systems that are rigidly attached to each other. It reports the primary's point at the
+	// faster device's rate, from both devices blended by tracking quality or switched to the
+	// better one, so it keeps tracking while either system loses sight of its device. Keyed by
+	// serial, so either device may appear later. There is one fused tracker; SteamVR keeps it
+	// until it restarts, disconnected while disabled.
+	struct SetFusedTracker
+	{
+		char primarySerial[64];   // null terminated
+		char secondarySerial[64]; // null terminated
+		bool enabled;
+		bool blend; // false to switch to the better device rather than blend the two
+	};
+
+	// Starts or stops recording every pose the driver sees to a file in its working directory.
+	struct SetPoseTap
+	{
+		bool enabled;
+	};
+
+	// Tracking quality of one device as measured by the driver on its native rate pose stream.
+	// Interval figures cover the last profiling window, noise figures all stationary windows so far,
+	// with older windows weighted down.
+	struct DeviceStats
+	{
+		uint64_t poseCount;
+		uint32_t invalidPoses;
+		uint32_t stationaryWindows;
+		double updateRateHz;
+		double intervalJitterMs; // standard deviation of the time between poses
+		double maxIntervalMs;
+		double positionNoiseMm;  // per axis standard deviation while the device is at rest
+		double rotationNoiseDeg;
+	};
+
+	// The stats of every device slot at once, so the app learns them all with one request.
+	struct DeviceStatsTable
+	{
+		DeviceStats devices[vr::k_unMaxTrackedDeviceCount];
+	};
+
+	struct HookTimingQuery
+	{
+		uint32_t openVRID;
+	};
+
+	const uint32_t HookTimingBuckets = 32;
+	const uint32_t HookTimingSampleEvery = 16;
+
+	// How long the driver's pose hook took for one device, from entry to return with SteamVR's own
+	// handling of the pose included, as a log2 histogram of cycle counter ticks: bucket b counts
+	// calls of 2^(b-1) up to 2^b ticks, the last one also longer calls. One call in
+	// HookTimingSampleEvery is timed, and calls counts those. Only drivers built with
+	// POSE_HOOK_TIMING answer.
+	struct HookTiming
+	{
+		uint64_t calls;
+		double cyclesPerNs; // the counter's rate, measured since the driver started
+		uint64_t buckets[HookTimingBuckets];
+	};
+
 	struct Request
 	{
 		RequestType type;
 
 		union {
 			SetDeviceTransform setDeviceTransform;
+			SetPoseTap setPoseTap;
+			SetSystemTransform setSystemTransform;
+			SetMountOffsets setMountOffsets;
+			SetMovingPlatform setMovingPlatform;
+			SetSmoothing setSmoothing;
+			SetTimeOffset setTimeOffset;
+			HookTimingQuery hookTimingQuery;
+			SetStageBudget setStageBudget;
+			SetFusedTracker setFusedTracker;
 		};
 
 		Request() : type(RequestInvalid) { }
@@ -71,6 +235,8 @@ namespace protocol
 
 		union {
 			Protocol protocol;
+			DeviceStatsTable deviceStats;
+			HookTiming hookTiming;
 		};
 
 		Response() : type(ResponseInvalid) { }